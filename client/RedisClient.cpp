@@ -0,0 +1,200 @@
+#include "client/RedisClient.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "codec/RedisEncoder.h"
+#include "codec/RedisReplyDecoder.h"
+#include "glog/logging.h"
+#include "wangle/channel/AsyncSocketHandler.h"
+#include "wangle/channel/OutputBufferingHandler.h"
+
+namespace client {
+
+folly::Future<codec::RedisValue> RedisClientDispatcher::send(std::vector<std::string>&& cmd) {
+  if (closed_) {
+    return folly::makeFuture<codec::RedisValue>(std::runtime_error("Redis connection is closed"));
+  }
+  pendingReplies_.emplace_back();
+  auto future = pendingReplies_.back().getFuture();
+  // Write errors close the socket, which fails all pending replies through readException
+  write(getContext(), codec::RedisMessage(codec::RedisValue(std::move(cmd))));
+  return future;
+}
+
+void RedisClientDispatcher::read(Context* ctx, codec::RedisMessage msg) {
+  if (msg.key == codec::RedisReplyDecoder::kProtocolErrorKey) {
+    // Cannot tell which requests the following bytes belong to, so give up the connection
+    fail(folly::make_exception_wrapper<std::runtime_error>(msg.val.error()));
+    close(ctx);
+    return;
+  }
+  if (msg.val == codec::RedisValue::goAway()) {
+    // The server is closing the connection, e.g., on idle timeout or shutdown
+    fail(folly::make_exception_wrapper<std::runtime_error>("Redis server closed the connection"));
+    close(ctx);
+    return;
+  }
+  if (pendingReplies_.empty()) {
+    LOG(ERROR) << "Received a redis reply without pending requests";
+    return;
+  }
+
+  auto promise = std::move(pendingReplies_.front());
+  pendingReplies_.pop_front();
+  promise.setValue(std::move(msg.val));
+}
+
+void RedisClientDispatcher::readEOF(Context* ctx) {
+  fail(folly::make_exception_wrapper<std::runtime_error>("Redis connection closed by server"));
+  close(ctx);
+}
+
+void RedisClientDispatcher::readException(Context* ctx, folly::exception_wrapper e) {
+  fail(e);
+  close(ctx);
+}
+
+void RedisClientDispatcher::fail(const folly::exception_wrapper& e) {
+  closed_ = true;
+  // Promises may trigger callbacks sending new requests, which are rejected since the connection is closed
+  auto pendingReplies = std::move(pendingReplies_);
+  pendingReplies_.clear();
+  for (auto& promise : pendingReplies) {
+    promise.setException(e);
+  }
+}
+
+RedisConnection::RedisConnection(folly::EventBase* evb, const folly::SocketAddress& address,
+                                 std::chrono::milliseconds connectTimeout)
+    : dispatcher_(std::make_shared<RedisClientDispatcher>()), pipeline_(RedisClientPipeline::create()) {
+  auto socket = folly::AsyncSocket::newSocket(evb);
+  pipeline_->addBack(wangle::AsyncSocketHandler(socket));
+  pipeline_->addBack(wangle::OutputBufferingHandler());
+  pipeline_->addBack(codec::RedisReplyDecoder());
+  pipeline_->addBack(codec::RedisEncoder());
+  pipeline_->addBack(dispatcher_);
+  pipeline_->finalize();
+
+  socket->connect(this, address, connectTimeout.count());
+  // The read callback can be installed while connecting, so replies are read as soon as the connection is up
+  pipeline_->transportActive();
+}
+
+RedisConnection::~RedisConnection() {
+  dispatcher_->fail(folly::make_exception_wrapper<std::runtime_error>("Redis connection destroyed"));
+  pipeline_->close();
+}
+
+void RedisConnection::connectErr(const folly::AsyncSocketException& ex) noexcept {
+  LOG(ERROR) << "Connecting to redis server failed: " << ex.what();
+  dispatcher_->fail(folly::make_exception_wrapper<folly::AsyncSocketException>(ex));
+}
+
+RedisClient::~RedisClient() {
+  cancelLoopCallback();
+  for (auto& pendingGet : pendingGets_) {
+    pendingGet.second.setException(std::runtime_error("Redis client destroyed"));
+  }
+}
+
+folly::Future<codec::RedisValue> RedisClient::execute(std::vector<std::string> cmd) {
+  if (!evb_->isInEventBaseThread()) {
+    return folly::via(evb_, [this, cmd]() mutable { return execute(std::move(cmd)); });
+  }
+  return nextConnection()->send(std::move(cmd));
+}
+
+folly::Future<codec::RedisValue> RedisClient::get(std::string key) {
+  if (!options_.coalesceGets) {
+    return execute({"get", std::move(key)});
+  }
+  if (!evb_->isInEventBaseThread()) {
+    return folly::via(evb_, [this, key]() mutable { return get(std::move(key)); });
+  }
+
+  pendingGets_.emplace_back(std::move(key), folly::Promise<codec::RedisValue>());
+  auto future = pendingGets_.back().second.getFuture();
+  if (!isLoopCallbackScheduled()) {
+    evb_->runInLoop(this);
+  }
+  return future;
+}
+
+void RedisClient::runLoopCallback() noexcept {
+  auto gets = std::move(pendingGets_);
+  pendingGets_.clear();
+  for (size_t begin = 0; begin < gets.size(); begin += options_.maxKeysPerMget) {
+    size_t end = std::min(gets.size(), begin + options_.maxKeysPerMget);
+    std::vector<PendingGet> batch(std::make_move_iterator(gets.begin() + begin),
+                                  std::make_move_iterator(gets.begin() + end));
+    sendMget(std::move(batch));
+  }
+}
+
+void RedisClient::sendMget(std::vector<PendingGet>&& gets) {
+  if (gets.size() == 1) {
+    // Nothing to coalesce with
+    auto& get = gets.front();
+    nextConnection()->send({"get", std::move(get.first)})
+        .then([promise = std::move(get.second)](folly::Try<codec::RedisValue>&& result) mutable {
+          promise.setTry(std::move(result));
+        });
+    return;
+  }
+
+  std::vector<std::string> cmd;
+  cmd.reserve(gets.size() + 1);
+  cmd.emplace_back("mget");
+  auto promises = std::make_shared<std::vector<folly::Promise<codec::RedisValue>>>();
+  promises->reserve(gets.size());
+  for (auto& get : gets) {
+    cmd.push_back(std::move(get.first));
+    promises->push_back(std::move(get.second));
+  }
+
+  nextConnection()->send(std::move(cmd)).then([promises](folly::Try<codec::RedisValue>&& result) {
+    if (result.hasException()) {
+      for (auto& promise : *promises) promise.setException(result.exception());
+      return;
+    }
+    const codec::RedisValue& reply = result.value();
+    if (reply.type() == codec::RedisValue::Type::kArray && reply.array().size() == promises->size()) {
+      for (size_t i = 0; i < promises->size(); i++) {
+        codec::RedisValue value(reply.array()[i]);
+        (*promises)[i].setValue(std::move(value));
+      }
+    } else {
+      // An error reply applies to every key, anything else means MGET is not supported as expected
+      codec::RedisValue error = reply.type() == codec::RedisValue::Type::kError
+                                    ? reply
+                                    : codec::RedisValue(codec::RedisValue::Type::kError, "Unexpected MGET reply");
+      for (auto& promise : *promises) {
+        codec::RedisValue value(error);
+        promise.setValue(std::move(value));
+      }
+    }
+  });
+}
+
+RedisConnection* RedisClient::nextConnection() {
+  DCHECK(evb_->isInEventBaseThread());
+  if (connections_.size() < options_.poolSize) {
+    // Connections are established lazily, one for each request until the pool is full
+    connections_.emplace_back(new RedisConnection(evb_, address_, options_.connectTimeout));
+    return connections_.back().get();
+  }
+
+  auto& connection = connections_[nextConnection_];
+  nextConnection_ = (nextConnection_ + 1) % connections_.size();
+  if (!connection->good()) {
+    connection.reset(new RedisConnection(evb_, address_, options_.connectTimeout));
+  }
+  return connection.get();
+}
+
+}  // namespace client
@@ -0,0 +1,130 @@
+#ifndef CLIENT_REDISCLIENT_H_
+#define CLIENT_REDISCLIENT_H_
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "codec/RedisMessage.h"
+#include "codec/RedisValue.h"
+#include "folly/SocketAddress.h"
+#include "folly/futures/Future.h"
+#include "folly/futures/Promise.h"
+#include "folly/io/IOBufQueue.h"
+#include "folly/io/async/AsyncSocket.h"
+#include "folly/io/async/EventBase.h"
+#include "wangle/channel/Handler.h"
+#include "wangle/channel/Pipeline.h"
+
+namespace client {
+
+using RedisClientPipeline = wangle::Pipeline<folly::IOBufQueue&, codec::RedisMessage>;
+
+// Match replies to requests on a single connection. Redis servers reply in request order, so outstanding requests are
+// kept as a FIFO queue of promises, which allows any number of requests to be pipelined.
+class RedisClientDispatcher : public wangle::HandlerAdapter<codec::RedisMessage> {
+ public:
+  RedisClientDispatcher() : pendingReplies_(), closed_(false) {}
+
+  // Send a command, e.g., {"get", "key"}, and return a future for its reply
+  folly::Future<codec::RedisValue> send(std::vector<std::string>&& cmd);
+
+  void read(Context* ctx, codec::RedisMessage msg) override;
+  void readEOF(Context* ctx) override;
+  void readException(Context* ctx, folly::exception_wrapper e) override;
+
+  // Fail all outstanding requests and stop accepting new ones
+  void fail(const folly::exception_wrapper& e);
+
+  bool closed() const { return closed_; }
+  size_t pendingCount() const { return pendingReplies_.size(); }
+
+ private:
+  std::deque<folly::Promise<codec::RedisValue>> pendingReplies_;
+  bool closed_;
+};
+
+// A pipelined connection to a redis server. It must be created, used, and destroyed in its EventBase thread.
+// Requests can be sent right away; they are buffered by the socket until the connection is established.
+class RedisConnection : private folly::AsyncSocket::ConnectCallback {
+ public:
+  RedisConnection(folly::EventBase* evb, const folly::SocketAddress& address,
+                  std::chrono::milliseconds connectTimeout);
+  ~RedisConnection();
+
+  folly::Future<codec::RedisValue> send(std::vector<std::string>&& cmd) {
+    return dispatcher_->send(std::move(cmd));
+  }
+
+  // A connection is no longer usable once it is closed or failed, and should be replaced
+  bool good() const { return !dispatcher_->closed(); }
+  size_t pendingCount() const { return dispatcher_->pendingCount(); }
+
+ private:
+  void connectSuccess() noexcept override {}
+  void connectErr(const folly::AsyncSocketException& ex) noexcept override;
+
+  std::shared_ptr<RedisClientDispatcher> dispatcher_;
+  RedisClientPipeline::Ptr pipeline_;
+};
+
+// An asynchronous redis client that spreads requests over a small pool of pipelined connections. All connections are
+// driven by a single EventBase. Commands can be issued from any thread and return futures; the futures are fulfilled
+// in the EventBase thread.
+//
+// Optionally, GETs issued in the same event loop iteration are coalesced into MGET commands, which saves server side
+// command dispatching on top of pipelining.
+class RedisClient : private folly::EventBase::LoopCallback {
+ public:
+  struct Options {
+    // Number of connections requests are spread over in round-robin order
+    size_t poolSize = 2;
+    std::chrono::milliseconds connectTimeout = std::chrono::milliseconds(1000);
+    // Only enable it for servers implementing MGET with the standard redis semantics
+    bool coalesceGets = false;
+    // Upper bound of keys in a single coalesced MGET
+    size_t maxKeysPerMget = 256;
+  };
+
+  RedisClient(folly::EventBase* evb, const folly::SocketAddress& address, Options options)
+      : evb_(evb), address_(address), options_(options), connections_(), nextConnection_(0), pendingGets_() {}
+
+  RedisClient(folly::EventBase* evb, const folly::SocketAddress& address) : RedisClient(evb, address, Options()) {}
+
+  // Must be destroyed in the EventBase thread. Outstanding requests fail.
+  ~RedisClient();
+
+  // Execute a command, e.g., {"set", "key", "value"}
+  folly::Future<codec::RedisValue> execute(std::vector<std::string> cmd);
+
+  // Get a single key, which may be coalesced with concurrent GETs into an MGET
+  folly::Future<codec::RedisValue> get(std::string key);
+
+  folly::EventBase* getEventBase() const { return evb_; }
+
+ private:
+  using PendingGet = std::pair<std::string, folly::Promise<codec::RedisValue>>;
+
+  // Send out coalesced GETs at the end of an event loop iteration
+  void runLoopCallback() noexcept override;
+
+  // Send a batch of GETs as a single MGET and distribute the elements of the reply
+  void sendMget(std::vector<PendingGet>&& gets);
+
+  // Pick a connection in round-robin order, replacing broken connections on the way
+  RedisConnection* nextConnection();
+
+  folly::EventBase* evb_;
+  const folly::SocketAddress address_;
+  const Options options_;
+  std::vector<std::unique_ptr<RedisConnection>> connections_;
+  size_t nextConnection_;
+  std::vector<PendingGet> pendingGets_;
+};
+
+}  // namespace client
+
+#endif  // CLIENT_REDISCLIENT_H_
@@ -0,0 +1,139 @@
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "client/RedisClient.h"
+#include "codec/RedisDecoder.h"
+#include "codec/RedisEncoder.h"
+#include "codec/RedisMessage.h"
+#include "folly/SocketAddress.h"
+#include "folly/io/async/EventBase.h"
+#include "gtest/gtest.h"
+#include "wangle/bootstrap/ServerBootstrap.h"
+#include "wangle/channel/AsyncSocketHandler.h"
+#include "wangle/channel/OutputBufferingHandler.h"
+
+namespace client {
+
+using ServerPipeline = wangle::Pipeline<folly::IOBufQueue&, codec::RedisMessage>;
+
+// A fake server replying "value-<key>" to GET and MGET, and recording the commands it receives
+class FakeRedisHandler : public wangle::HandlerAdapter<codec::RedisMessage> {
+ public:
+  static std::atomic<int> getCount;
+  static std::atomic<int> mgetCount;
+
+  void read(Context* ctx, codec::RedisMessage req) override {
+    const auto& cmd = req.val.bulkStringArray();
+    if (cmd[0] == "get") {
+      getCount++;
+      write(ctx, codec::RedisMessage(codec::RedisValue(codec::RedisValue::Type::kBulkString, "value-" + cmd[1])));
+    } else if (cmd[0] == "mget") {
+      mgetCount++;
+      std::vector<codec::RedisValue> values;
+      for (size_t i = 1; i < cmd.size(); i++) {
+        values.emplace_back(codec::RedisValue::Type::kBulkString, "value-" + cmd[i]);
+      }
+      write(ctx, codec::RedisMessage(codec::RedisValue(std::move(values))));
+    } else {
+      write(ctx, codec::RedisMessage(codec::RedisValue(codec::RedisValue::Type::kError, "Unknown command")));
+    }
+  }
+};
+
+std::atomic<int> FakeRedisHandler::getCount;
+std::atomic<int> FakeRedisHandler::mgetCount;
+
+class FakeRedisPipelineFactory : public wangle::PipelineFactory<ServerPipeline> {
+ public:
+  ServerPipeline::Ptr newPipeline(std::shared_ptr<folly::AsyncTransportWrapper> sock) override {
+    auto pipeline = ServerPipeline::create();
+    pipeline->addBack(wangle::AsyncSocketHandler(sock));
+    pipeline->addBack(wangle::OutputBufferingHandler());
+    pipeline->addBack(codec::RedisDecoder());
+    pipeline->addBack(codec::RedisEncoder());
+    pipeline->addBack(FakeRedisHandler());
+    pipeline->finalize();
+    return pipeline;
+  }
+};
+
+class RedisClientTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    FakeRedisHandler::getCount = 0;
+    FakeRedisHandler::mgetCount = 0;
+    server_.childPipeline(std::make_shared<FakeRedisPipelineFactory>());
+    server_.bind(0);
+    server_.getSockets()[0]->getAddress(&address_);
+  }
+
+  void TearDown() override {
+    stopServer();
+  }
+
+  void stopServer() {
+    if (!serverStopped_) {
+      server_.stop();
+      server_.join();
+      serverStopped_ = true;
+    }
+  }
+
+  wangle::ServerBootstrap<ServerPipeline> server_;
+  bool serverStopped_ = false;
+  folly::SocketAddress address_;
+  folly::EventBase evb_;
+};
+
+TEST_F(RedisClientTest, Execute) {
+  RedisClient client(&evb_, address_);
+  EXPECT_EQ(codec::RedisValue(codec::RedisValue::Type::kBulkString, "value-a"),
+            client.execute({"get", "a"}).getVia(&evb_));
+  EXPECT_EQ(codec::RedisValue::Type::kError, client.execute({"foo"}).getVia(&evb_).type());
+}
+
+TEST_F(RedisClientTest, Pipelining) {
+  RedisClient client(&evb_, address_);
+  std::vector<folly::Future<codec::RedisValue>> futures;
+  for (int i = 0; i < 100; i++) {
+    futures.push_back(client.get(std::to_string(i)));
+  }
+  auto results = folly::collect(futures).getVia(&evb_);
+  ASSERT_EQ(100, results.size());
+  for (int i = 0; i < 100; i++) {
+    // replies are matched to requests in order
+    EXPECT_EQ("value-" + std::to_string(i), results[i].bulkString());
+  }
+  EXPECT_EQ(100, FakeRedisHandler::getCount);
+  EXPECT_EQ(0, FakeRedisHandler::mgetCount);
+}
+
+TEST_F(RedisClientTest, CoalesceGets) {
+  RedisClient::Options options;
+  options.coalesceGets = true;
+  options.maxKeysPerMget = 4;
+  RedisClient client(&evb_, address_, options);
+
+  std::vector<folly::Future<codec::RedisValue>> futures;
+  for (int i = 0; i < 9; i++) {
+    futures.push_back(client.get(std::to_string(i)));
+  }
+  auto results = folly::collect(futures).getVia(&evb_);
+  ASSERT_EQ(9, results.size());
+  for (int i = 0; i < 9; i++) {
+    EXPECT_EQ("value-" + std::to_string(i), results[i].bulkString());
+  }
+  // 9 keys are sent as two MGETs of 4 keys and a single GET
+  EXPECT_EQ(2, FakeRedisHandler::mgetCount);
+  EXPECT_EQ(1, FakeRedisHandler::getCount);
+}
+
+TEST_F(RedisClientTest, ConnectionFailure) {
+  stopServer();
+  RedisClient client(&evb_, address_);
+  EXPECT_THROW(client.execute({"get", "a"}).getVia(&evb_), std::exception);
+}
+
+}  // namespace client
@@ -4,6 +4,7 @@
 #include "codec/RedisDecoder.h"
 #include "codec/RedisEncoder.h"
 #include "codec/RedisMessage.h"
+#include "codec/RedisReplyDecoder.h"
 #include "folly/io/IOBuf.h"
 #include "gtest/gtest.h"
 
@@ -383,4 +384,124 @@ TEST(RedisEncoder, Encode) {
   EXPECT_TRUE(equal(folly::IOBuf::copyBuffer("*2\r\n$1\r\na\r\n$1\r\nb\r\n"), encoder.encode(bulkStringArray)));
 }
 
+TEST(RedisReplyDecoder, Valid) {
+  RedisReplyDecoder decoder;
+  folly::IOBufQueue queue(folly::IOBufQueue::cacheChainLength());
+  RedisMessage result;
+  size_t needed = 0;
+
+  // every reply type round trips through the encoder
+  std::vector<RedisValue> values{
+    RedisValue(123),
+    RedisValue(-1),
+    RedisValue(RedisValue::Type::kError, "error"),
+    RedisValue(RedisValue::Type::kSimpleString, "OK"),
+    RedisValue(RedisValue::Type::kBulkString, "bulk\r\nstring"),
+    RedisValue(RedisValue::Type::kBulkString, ""),
+    RedisValue::nullString(),
+    RedisValue(std::vector<RedisValue>{RedisValue(1), RedisValue::nullString(),
+                                       RedisValue(std::vector<RedisValue>{RedisValue(RedisValue::Type::kError, "e")})}),
+    RedisValue::emptyListOrSet(),
+  };
+  for (const auto& value : values) {
+    queue.append(folly::IOBuf::copyBuffer(value.encode()));
+    EXPECT_TRUE(decoder.decode(nullptr, queue, result, needed));
+    EXPECT_EQ(value, result.val);
+    EXPECT_EQ(0, result.key);
+    EXPECT_EQ(0, queue.chainLength());
+  }
+
+  // null array is decoded as null string
+  queue.append(folly::IOBuf::copyBuffer("*-1\r\n"));
+  EXPECT_TRUE(decoder.decode(nullptr, queue, result, needed));
+  EXPECT_EQ(RedisValue::nullString(), result.val);
+
+  // pipelined replies are decoded one at a time
+  queue.append(folly::IOBuf::copyBuffer("+OK\r\n:1\r\n"));
+  EXPECT_TRUE(decoder.decode(nullptr, queue, result, needed));
+  EXPECT_EQ(RedisValue(RedisValue::Type::kSimpleString, "OK"), result.val);
+  EXPECT_TRUE(decoder.decode(nullptr, queue, result, needed));
+  EXPECT_EQ(RedisValue(1), result.val);
+  EXPECT_FALSE(decoder.decode(nullptr, queue, result, needed));
+}
+
+TEST(RedisReplyDecoder, Incomplete) {
+  RedisReplyDecoder decoder;
+  folly::IOBufQueue queue(folly::IOBufQueue::cacheChainLength());
+  RedisMessage result;
+  size_t needed = 0;
+
+  // feed a nested array one byte at a time, where complete tokens are consumed right away
+  std::string input = "*2\r\n$3\r\nabc\r\n*1\r\n:5\r\n";
+  for (size_t i = 0; i + 1 < input.size(); i++) {
+    queue.append(folly::IOBuf::copyBuffer(input.substr(i, 1)));
+    EXPECT_FALSE(decoder.decode(nullptr, queue, result, needed));
+    EXPECT_LE(queue.chainLength(), i + 1);
+  }
+  queue.append(folly::IOBuf::copyBuffer(input.substr(input.size() - 1)));
+  EXPECT_TRUE(decoder.decode(nullptr, queue, result, needed));
+  EXPECT_EQ(input, result.val.encode());
+  EXPECT_EQ(0, queue.chainLength());
+}
+
+TEST(RedisReplyDecoder, SplitReads) {
+  RedisReplyDecoder decoder;
+  folly::IOBufQueue queue(folly::IOBufQueue::cacheChainLength());
+  RedisMessage result;
+  size_t needed = 0;
+
+  // only the incomplete integer is left in the buffer
+  queue.append(folly::IOBuf::copyBuffer("*3\r\n$3\r\nabc\r\n:1"));
+  EXPECT_FALSE(decoder.decode(nullptr, queue, result, needed));
+  EXPECT_EQ(2, queue.chainLength());
+
+  // a partial bulk string asks for exactly the missing bytes
+  queue.append(folly::IOBuf::copyBuffer("\r\n$5\r\nhel"));
+  EXPECT_FALSE(decoder.decode(nullptr, queue, result, needed));
+  EXPECT_EQ(7, queue.chainLength());
+  EXPECT_EQ(4, needed);
+
+  queue.append(folly::IOBuf::copyBuffer("lo\r\n+OK\r\n"));
+  EXPECT_TRUE(decoder.decode(nullptr, queue, result, needed));
+  EXPECT_EQ(RedisValue(std::vector<RedisValue>{RedisValue(RedisValue::Type::kBulkString, "abc"), RedisValue(1),
+                                               RedisValue(RedisValue::Type::kBulkString, "hello")}),
+            result.val);
+  // the next reply starts from a clean state
+  EXPECT_TRUE(decoder.decode(nullptr, queue, result, needed));
+  EXPECT_EQ(RedisValue(RedisValue::Type::kSimpleString, "OK"), result.val);
+  EXPECT_EQ(0, queue.chainLength());
+}
+
+TEST(RedisReplyDecoder, OversizedHeaders) {
+  RedisReplyDecoder decoder;
+  folly::IOBufQueue queue(folly::IOBufQueue::cacheChainLength());
+  RedisMessage result;
+  size_t needed = 0;
+
+  // lengths from the wire are not allocated up front
+  queue.append(folly::IOBuf::copyBuffer("*2000000000\r\n:1\r\n"));
+  EXPECT_FALSE(decoder.decode(nullptr, queue, result, needed));
+  EXPECT_EQ(0, queue.chainLength());
+
+  RedisReplyDecoder bulkDecoder;
+  queue.append(folly::IOBuf::copyBuffer("$2000000000\r\nabc"));
+  EXPECT_FALSE(bulkDecoder.decode(nullptr, queue, result, needed));
+  EXPECT_EQ(2000000002 - 3, needed);
+}
+
+TEST(RedisReplyDecoder, Invalid) {
+  RedisReplyDecoder decoder;
+  folly::IOBufQueue queue(folly::IOBufQueue::cacheChainLength());
+  RedisMessage result;
+  size_t needed = 0;
+
+  for (const std::string input : {"?\r\n", ":abc\r\n", "$3\r\nabcde\r\n", "+OK\rX", "*2\r\n:1\r\n?"}) {
+    queue.append(folly::IOBuf::copyBuffer(input));
+    EXPECT_TRUE(decoder.decode(nullptr, queue, result, needed));
+    EXPECT_EQ(RedisReplyDecoder::kProtocolErrorKey, result.key);
+    EXPECT_EQ(RedisValue::Type::kError, result.val.type());
+    EXPECT_EQ(0, queue.chainLength());
+  }
+}
+
 }  // namespace codec
@@ -12,7 +12,7 @@
 namespace codec {
 
 // Decode Redis Array of Bulk String into a RedisValue as result
-bool RedisDecoder::decode(Context* ctx, folly::IOBufQueue& buf, RedisMessage& result, size_t& needed) {
+bool RedisDecoder::decodeRequest(folly::IOBufQueue& buf, RedisMessage& result, size_t& needed) {
   if (buf.chainLength() < kMinBytesNeeded) {
     needed = kMinBytesNeeded - buf.chainLength();
     return false;
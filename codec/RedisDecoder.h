@@ -4,6 +4,7 @@
 #include "wangle/codec/ByteToMessageDecoder.h"
 
 #include "codec/RedisMessage.h"
+#include "infra/Tracing.h"
 
 namespace codec {
 
@@ -15,7 +16,16 @@ namespace codec {
 // The goal of this decoder is parse such request into a RedisValue wrapped in a RedisMessage with default key.
 class RedisDecoder : public wangle::ByteToMessageDecoder<RedisMessage> {
  public:
-  bool decode(Context* ctx, folly::IOBufQueue& buf, RedisMessage& result, size_t& needed) override;
+  // Requests decoded from the bytes read are handled, and synchronous replies written, before it returns, so it is
+  // where sampling for tracing is decided.
+  void read(Context* ctx, folly::IOBufQueue& q) override {
+    infra::Tracing::RequestGuard guard;
+    wangle::ByteToMessageDecoder<RedisMessage>::read(ctx, q);
+  }
+
+  bool decode(Context* ctx, folly::IOBufQueue& buf, RedisMessage& result, size_t& needed) override {
+    return TRACE_CALL("RedisDecoder#decode", decodeRequest(buf, result, needed));
+  }
 
  private:
   enum class LengthFieldState {
@@ -24,6 +34,7 @@ class RedisDecoder : public wangle::ByteToMessageDecoder<RedisMessage> {
     kValid,
   };
   static constexpr size_t kMinBytesNeeded = 2;  // '\r\n'
+  bool decodeRequest(folly::IOBufQueue& buf, RedisMessage& result, size_t& needed);
   int64_t readLength(char typeIndicator, folly::io::Cursor* c, LengthFieldState* state, size_t* needed);
   void skipNoise(folly::io::Cursor* c);
 };
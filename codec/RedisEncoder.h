@@ -2,17 +2,24 @@
 #define CODEC_REDISENCODER_H_
 
 #include <memory>
+#include <utility>
 
 #include "codec/RedisMessage.h"
+#include "infra/Tracing.h"
 #include "wangle/codec/MessageToByteEncoder.h"
 
 namespace codec {
 
 class RedisEncoder : public wangle::MessageToByteEncoder<RedisMessage> {
  public:
+  // Encode the reply and flush it to the transport
+  folly::Future<folly::Unit> write(Context* ctx, RedisMessage msg) override {
+    return TRACE_CALL("RedisEncoder#write", wangle::MessageToByteEncoder<RedisMessage>::write(ctx, std::move(msg)));
+  }
+
   std::unique_ptr<folly::IOBuf> encode(RedisMessage& msg) override {
     // Key in a redis message is only for internal use. There is no need for encoding.
-    return folly::IOBuf::copyBuffer(msg.val.encode());
+    return TRACE_CALL("RedisEncoder#encode", folly::IOBuf::copyBuffer(msg.val.encode()));
   }
 };
 
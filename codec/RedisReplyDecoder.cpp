@@ -0,0 +1,152 @@
+#include "codec/RedisReplyDecoder.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "folly/Conv.h"
+#include "glog/logging.h"
+
+namespace codec {
+
+bool RedisReplyDecoder::decode(Context* ctx, folly::IOBufQueue& buf, RedisMessage& result, size_t& needed) {
+  while (true) {
+    if (buf.chainLength() == 0) {
+      needed = 1;
+      return false;
+    }
+
+    // Each token is consumed as soon as it is complete, so only an incomplete token is parsed again on the next read
+    folly::io::Cursor start(buf.front());
+    folly::io::Cursor curr(buf.front());
+    RedisValue value;
+    int64_t arrayLength;
+    size_t missing = 1;
+    switch (parseToken(&curr, &value, &arrayLength, &missing)) {
+      case ParseState::kMoreBytesNeeded:
+        needed = missing;
+        return false;
+      case ParseState::kInvalid:
+        LOG(ERROR) << "Received malformed redis reply";
+        result.key = kProtocolErrorKey;
+        result.val = RedisValue(RedisValue::Type::kError, "Protocol Error: Malformed reply");
+        partialArrays_.clear();
+        buf.clear();
+        needed = 1;
+        return true;
+      case ParseState::kValid:
+        buf.trimStart(curr - start);
+        break;
+    }
+
+    if (arrayLength > 0) {
+      partialArrays_.push_back(PartialArray{arrayLength, {}});
+      partialArrays_.back().elements.reserve(std::min(arrayLength, kMaxReserve));
+    } else if (addValue(std::move(value), &result.val)) {
+      result.key = 0;
+      needed = 0;
+      return true;
+    }
+  }
+}
+
+bool RedisReplyDecoder::addValue(RedisValue value, RedisValue* result) {
+  while (!partialArrays_.empty()) {
+    PartialArray& array = partialArrays_.back();
+    array.elements.push_back(std::move(value));
+    if (--array.remaining > 0) return false;
+    value = RedisValue(std::move(array.elements));
+    partialArrays_.pop_back();
+  }
+  *result = std::move(value);
+  return true;
+}
+
+RedisReplyDecoder::ParseState RedisReplyDecoder::parseToken(folly::io::Cursor* c, RedisValue* value,
+                                                            int64_t* arrayLength, size_t* needed) {
+  *arrayLength = -1;
+  if (c->totalLength() == 0) return ParseState::kMoreBytesNeeded;
+
+  char typeIndicator = c->read<char>();
+  switch (typeIndicator) {
+    case '+':
+    case '-': {
+      std::string line;
+      ParseState state = readLine(c, &line);
+      if (state == ParseState::kValid) {
+        *value = RedisValue(typeIndicator == '+' ? RedisValue::Type::kSimpleString : RedisValue::Type::kError,
+                            std::move(line));
+      }
+      return state;
+    }
+    case ':': {
+      int64_t integer;
+      ParseState state = readLength(c, &integer);
+      if (state == ParseState::kValid) *value = RedisValue(integer);
+      return state;
+    }
+    case '$': {
+      int64_t length;
+      ParseState state = readLength(c, &length);
+      if (state != ParseState::kValid) return state;
+      if (length < 0) {
+        *value = RedisValue::nullString();
+        return ParseState::kValid;
+      }
+      size_t available = c->totalLength();
+      if (available < static_cast<size_t>(length) + 2) {
+        *needed = static_cast<size_t>(length) + 2 - available;
+        return ParseState::kMoreBytesNeeded;
+      }
+      std::string str = length > 0 ? c->readFixedString(length) : "";
+      if (c->read<char>() != '\r' || c->read<char>() != '\n') return ParseState::kInvalid;
+      *value = RedisValue(RedisValue::Type::kBulkString, std::move(str));
+      return ParseState::kValid;
+    }
+    case '*': {
+      int64_t length;
+      ParseState state = readLength(c, &length);
+      if (state != ParseState::kValid) return state;
+      if (length < 0) {
+        *value = RedisValue::nullString();
+      } else if (length == 0) {
+        *value = RedisValue(std::vector<RedisValue>());
+      } else {
+        *arrayLength = length;
+      }
+      return ParseState::kValid;
+    }
+    default:
+      return ParseState::kInvalid;
+  }
+}
+
+RedisReplyDecoder::ParseState RedisReplyDecoder::readLine(folly::io::Cursor* c, std::string* line) {
+  try {
+    *line = c->readTerminatedString('\r');
+  } catch (const std::out_of_range&) {
+    // did not find the terminator char
+    return ParseState::kMoreBytesNeeded;
+  }
+  if (c->totalLength() == 0) return ParseState::kMoreBytesNeeded;
+  return c->read<char>() == '\n' ? ParseState::kValid : ParseState::kInvalid;
+}
+
+RedisReplyDecoder::ParseState RedisReplyDecoder::readLength(folly::io::Cursor* c, int64_t* length) {
+  std::string line;
+  ParseState state = readLine(c, &line);
+  if (state != ParseState::kValid) return state;
+  try {
+    *length = folly::to<int64_t>(line);
+    return ParseState::kValid;
+  } catch (const std::range_error&) {
+    return ParseState::kInvalid;
+  }
+}
+
+constexpr int64_t RedisReplyDecoder::kProtocolErrorKey;
+constexpr int64_t RedisReplyDecoder::kMaxReserve;
+
+}  // namespace codec
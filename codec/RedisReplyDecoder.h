@@ -0,0 +1,61 @@
+#ifndef CODEC_REDISREPLYDECODER_H_
+#define CODEC_REDISREPLYDECODER_H_
+
+#include <string>
+#include <vector>
+
+#include "folly/io/Cursor.h"
+#include "wangle/codec/ByteToMessageDecoder.h"
+
+#include "codec/RedisMessage.h"
+
+namespace codec {
+
+// A redis protocol decoder for replies sent from servers to clients. Unlike RedisDecoder, it decodes every RESP type,
+// i.e., Simple Strings, Errors, Integers, Bulk Strings, and (nested) Arrays. Null Bulk Strings and Null Arrays are
+// both decoded as kNullString.
+//
+// Arrays are decoded incrementally: every complete element is consumed from the buffer right away and kept in the
+// decoder until its array is complete, so a large reply arriving in many reads is parsed once.
+//
+// A client cannot recover from a malformed reply since it no longer knows which request the following bytes belong
+// to. In that case the decoder produces an error value with kProtocolErrorKey as its key, and the client is expected
+// to close the connection.
+class RedisReplyDecoder : public wangle::ByteToMessageDecoder<RedisMessage> {
+ public:
+  static constexpr int64_t kProtocolErrorKey = -1;
+  // Array lengths come from the wire, so at most this many elements are reserved up front
+  static constexpr int64_t kMaxReserve = 1024;
+
+  bool decode(Context* ctx, folly::IOBufQueue& buf, RedisMessage& result, size_t& needed) override;
+
+ private:
+  enum class ParseState {
+    kInvalid,
+    kMoreBytesNeeded,
+    kValid,
+  };
+
+  // An array whose header has been decoded but not all of its elements
+  struct PartialArray {
+    int64_t remaining;
+    std::vector<RedisValue> elements;
+  };
+
+  // Parse either a complete non-array value, or the header of an array into *arrayLength. *arrayLength is set to -1
+  // for anything but a non-empty array. For bulk strings waiting for more bytes, *needed is the number of bytes missing.
+  static ParseState parseToken(folly::io::Cursor* c, RedisValue* value, int64_t* arrayLength, size_t* needed);
+  static ParseState readLine(folly::io::Cursor* c, std::string* line);
+  static ParseState readLength(folly::io::Cursor* c, int64_t* length);
+
+  // Add a complete value to the innermost partial array, completing enclosing arrays as needed. Return true and set
+  // the value in *result when the whole reply is complete.
+  bool addValue(RedisValue value, RedisValue* result);
+
+  // Arrays being decoded from the outermost to the innermost
+  std::vector<PartialArray> partialArrays_;
+};
+
+}  // namespace codec
+
+#endif  // CODEC_REDISREPLYDECODER_H_
@@ -0,0 +1,35 @@
+#include <memory>
+
+#include "collections/CollectionsRedisHandler.h"
+#include "infra/HashEngine.h"
+#include "infra/ListEngine.h"
+#include "infra/SortedSetEngine.h"
+#include "pipeline/RedisHandler.h"
+#include "pipeline/RedisPipelineBootstrap.h"
+
+namespace collections {
+
+static std::shared_ptr<pipeline::RedisHandler> createCollectionsRedisHandler(
+    pipeline::RedisPipelineBootstrap* bootstrap) {
+  auto listEngine = std::make_shared<infra::ListEngine>(
+      bootstrap->getDatabaseManager(), bootstrap->getColumnFamily(infra::ListEngine::columnFamilyName()));
+  auto hashEngine = std::make_shared<infra::HashEngine>(
+      bootstrap->getDatabaseManager(), bootstrap->getColumnFamily(infra::HashEngine::columnFamilyName()));
+  auto sortedSetEngine = std::make_shared<infra::SortedSetEngine>(
+      bootstrap->getDatabaseManager(), bootstrap->getColumnFamily(infra::SortedSetEngine::columnFamilyName()));
+  return std::make_shared<CollectionsRedisHandler>(bootstrap->getDatabaseManager(), listEngine, hashEngine,
+                                                   sortedSetEngine);
+}
+
+static pipeline::RedisPipelineBootstrap::Config createConfig() {
+  pipeline::RedisPipelineBootstrap::Config config(&createCollectionsRedisHandler);
+  config.rocksDbCfConfiguratorMap[infra::ListEngine::columnFamilyName()] = &infra::ListEngine::optimizeColumnFamily;
+  config.rocksDbCfConfiguratorMap[infra::HashEngine::columnFamilyName()] = &infra::HashEngine::optimizeColumnFamily;
+  config.rocksDbCfConfiguratorMap[infra::SortedSetEngine::columnFamilyName()] =
+      &infra::SortedSetEngine::optimizeColumnFamily;
+  return config;
+}
+
+static auto redisPipelineBootstrap = pipeline::RedisPipelineBootstrap::create(createConfig());
+
+}  // namespace collections
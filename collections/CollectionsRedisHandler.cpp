@@ -0,0 +1,239 @@
+#include "collections/CollectionsRedisHandler.h"
+
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/algorithm/string/case_conv.hpp"
+#include "folly/Conv.h"
+#include "folly/Format.h"
+
+namespace collections {
+
+namespace {
+
+bool parseScore(const std::string& value, double* score) {
+  if (value == "+inf" || value == "-inf") {
+    *score = (value[0] == '-' ? -1 : 1) * std::numeric_limits<double>::infinity();
+    return true;
+  }
+  try {
+    *score = folly::to<double>(value);
+  } catch (folly::ConversionError&) {
+    return false;
+  }
+  return *score == *score;
+}
+
+// Bounds of ZRANGEBYSCORE are exclusive when starting with '('
+bool parseScoreBound(const std::string& value, infra::SortedSetEngine::ScoreBound* bound) {
+  bound->exclusive = !value.empty() && value[0] == '(';
+  return parseScore(bound->exclusive ? value.substr(1) : value, &bound->score);
+}
+
+codec::RedisValue errorInvalidScore() {
+  return codec::RedisValue(codec::RedisValue::Type::kError, "Value is not a valid float");
+}
+
+}  // namespace
+
+codec::RedisValue CollectionsRedisHandler::errorRocksDb(const rocksdb::Status& status) {
+  return errorResp(folly::sformat("RocksDB error: {}", status.ToString()));
+}
+
+codec::RedisValue CollectionsRedisHandler::push(const std::vector<std::string>& cmd, infra::ListEngine::End end) {
+  std::vector<std::string> values(cmd.begin() + 2, cmd.end());
+  int64_t length;
+  rocksdb::Status status = listEngine_->push(cmd[1], end, values, &length);
+  if (!status.ok()) return errorRocksDb(status);
+  return codec::RedisValue(length);
+}
+
+codec::RedisValue CollectionsRedisHandler::pop(const std::vector<std::string>& cmd, infra::ListEngine::End end) {
+  std::string value;
+  rocksdb::Status status = listEngine_->pop(cmd[1], end, &value);
+  if (status.IsNotFound()) return codec::RedisValue::nullString();
+  if (!status.ok()) return errorRocksDb(status);
+  return codec::RedisValue(codec::RedisValue::Type::kBulkString, std::move(value));
+}
+
+codec::RedisValue CollectionsRedisHandler::lrangeCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  int64_t start;
+  int64_t stop;
+  if (!parseInt(cmd[2], &start) || !parseInt(cmd[3], &stop)) return errorInvalidInteger();
+
+  std::vector<std::string> values;
+  rocksdb::Status status = listEngine_->range(cmd[1], start, stop, &values);
+  if (!status.ok()) return errorRocksDb(status);
+
+  std::vector<codec::RedisValue> elements;
+  elements.reserve(values.size());
+  for (auto& value : values) {
+    elements.emplace_back(codec::RedisValue::Type::kBulkString, std::move(value));
+  }
+  return codec::RedisValue(std::move(elements));
+}
+
+codec::RedisValue CollectionsRedisHandler::ltrimCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  int64_t start;
+  int64_t stop;
+  if (!parseInt(cmd[2], &start) || !parseInt(cmd[3], &stop)) return errorInvalidInteger();
+
+  rocksdb::Status status = listEngine_->trim(cmd[1], start, stop);
+  if (!status.ok()) return errorRocksDb(status);
+  return simpleStringOk();
+}
+
+codec::RedisValue CollectionsRedisHandler::llenCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  int64_t length;
+  rocksdb::Status status = listEngine_->length(cmd[1], &length);
+  if (!status.ok()) return errorRocksDb(status);
+  return codec::RedisValue(length);
+}
+
+codec::RedisValue CollectionsRedisHandler::setFields(const std::vector<std::string>& cmd, bool countAdded) {
+  if ((cmd.size() - 2) % 2 != 0) {
+    return codec::RedisValue(codec::RedisValue::Type::kError,
+                             folly::sformat(kWrongNumArgsTemplate, countAdded ? "hset" : "hmset"));
+  }
+
+  infra::HashEngine::FieldValues fieldValues;
+  fieldValues.reserve((cmd.size() - 2) / 2);
+  for (size_t i = 2; i < cmd.size(); i += 2) {
+    fieldValues.emplace_back(cmd[i], cmd[i + 1]);
+  }
+  int64_t added;
+  rocksdb::Status status = hashEngine_->set(cmd[1], fieldValues, countAdded ? &added : nullptr);
+  if (!status.ok()) return errorRocksDb(status);
+  return countAdded ? codec::RedisValue(added) : simpleStringOk();
+}
+
+codec::RedisValue CollectionsRedisHandler::hgetCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  std::string value;
+  rocksdb::Status status = hashEngine_->get(cmd[1], cmd[2], &value);
+  if (status.IsNotFound()) return codec::RedisValue::nullString();
+  if (!status.ok()) return errorRocksDb(status);
+  return codec::RedisValue(codec::RedisValue::Type::kBulkString, std::move(value));
+}
+
+codec::RedisValue CollectionsRedisHandler::hmgetCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  std::vector<std::string> fields(cmd.begin() + 2, cmd.end());
+  std::vector<std::string> values;
+  std::vector<rocksdb::Status> statuses = hashEngine_->multiGet(cmd[1], fields, &values);
+
+  std::vector<codec::RedisValue> elements;
+  elements.reserve(statuses.size());
+  for (size_t i = 0; i < statuses.size(); i++) {
+    if (statuses[i].IsNotFound()) {
+      elements.push_back(codec::RedisValue::nullString());
+    } else if (!statuses[i].ok()) {
+      return errorRocksDb(statuses[i]);
+    } else {
+      elements.emplace_back(codec::RedisValue::Type::kBulkString, std::move(values[i]));
+    }
+  }
+  return codec::RedisValue(std::move(elements));
+}
+
+codec::RedisValue CollectionsRedisHandler::hgetallCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  infra::HashEngine::FieldValues fieldValues;
+  rocksdb::Status status = hashEngine_->getAll(cmd[1], &fieldValues);
+  if (!status.ok()) return errorRocksDb(status);
+
+  std::vector<codec::RedisValue> elements;
+  elements.reserve(fieldValues.size() * 2);
+  for (auto& fieldValue : fieldValues) {
+    elements.emplace_back(codec::RedisValue::Type::kBulkString, std::move(fieldValue.first));
+    elements.emplace_back(codec::RedisValue::Type::kBulkString, std::move(fieldValue.second));
+  }
+  return codec::RedisValue(std::move(elements));
+}
+
+codec::RedisValue CollectionsRedisHandler::hdelCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  std::vector<std::string> fields(cmd.begin() + 2, cmd.end());
+  int64_t removed;
+  rocksdb::Status status = hashEngine_->del(cmd[1], fields, &removed);
+  if (!status.ok()) return errorRocksDb(status);
+  return codec::RedisValue(removed);
+}
+
+codec::RedisValue CollectionsRedisHandler::zaddCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  if ((cmd.size() - 2) % 2 != 0) {
+    return codec::RedisValue(codec::RedisValue::Type::kError, folly::sformat(kWrongNumArgsTemplate, "zadd"));
+  }
+
+  infra::SortedSetEngine::MemberScores memberScores;
+  memberScores.reserve((cmd.size() - 2) / 2);
+  for (size_t i = 2; i < cmd.size(); i += 2) {
+    double score;
+    if (!parseScore(cmd[i], &score)) return errorInvalidScore();
+    memberScores.emplace_back(cmd[i + 1], score);
+  }
+  int64_t added;
+  rocksdb::Status status = sortedSetEngine_->add(cmd[1], memberScores, &added);
+  if (!status.ok()) return errorRocksDb(status);
+  return codec::RedisValue(added);
+}
+
+codec::RedisValue CollectionsRedisHandler::zremCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  std::vector<std::string> members(cmd.begin() + 2, cmd.end());
+  int64_t removed;
+  rocksdb::Status status = sortedSetEngine_->remove(cmd[1], members, &removed);
+  if (!status.ok()) return errorRocksDb(status);
+  return codec::RedisValue(removed);
+}
+
+codec::RedisValue CollectionsRedisHandler::zrangebyscoreCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  infra::SortedSetEngine::ScoreBound min;
+  infra::SortedSetEngine::ScoreBound max;
+  if (!parseScoreBound(cmd[2], &min) || !parseScoreBound(cmd[3], &max)) return errorInvalidScore();
+
+  bool withScores = false;
+  int64_t offset = 0;
+  int64_t count = -1;
+  for (size_t i = 4; i < cmd.size(); i++) {
+    const std::string option = boost::to_lower_copy(cmd[i]);
+    if (option == "withscores") {
+      withScores = true;
+    } else if (option == "limit" && i + 2 < cmd.size()) {
+      if (!parseInt(cmd[i + 1], &offset) || !parseInt(cmd[i + 2], &count)) return errorInvalidInteger();
+      i += 2;
+    } else {
+      return errorSyntaxError();
+    }
+  }
+  // like redis, a negative offset selects nothing
+  if (offset < 0) return codec::RedisValue(std::vector<codec::RedisValue>());
+
+  infra::SortedSetEngine::MemberScores memberScores;
+  rocksdb::Status status = sortedSetEngine_->rangeByScore(cmd[1], min, max, offset, count, &memberScores);
+  if (!status.ok()) return errorRocksDb(status);
+
+  std::vector<codec::RedisValue> elements;
+  elements.reserve(memberScores.size() * (withScores ? 2 : 1));
+  for (auto& memberScore : memberScores) {
+    elements.emplace_back(codec::RedisValue::Type::kBulkString, std::move(memberScore.first));
+    if (withScores) {
+      elements.emplace_back(codec::RedisValue::Type::kBulkString, folly::to<std::string>(memberScore.second));
+    }
+  }
+  return codec::RedisValue(std::move(elements));
+}
+
+codec::RedisValue CollectionsRedisHandler::zrankCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  int64_t rank;
+  rocksdb::Status status = sortedSetEngine_->rank(cmd[1], cmd[2], &rank);
+  if (status.IsNotFound()) return codec::RedisValue::nullString();
+  if (!status.ok()) return errorRocksDb(status);
+  return codec::RedisValue(rank);
+}
+
+codec::RedisValue CollectionsRedisHandler::zcardCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  int64_t cardinality;
+  rocksdb::Status status = sortedSetEngine_->cardinality(cmd[1], &cardinality);
+  if (!status.ok()) return errorRocksDb(status);
+  return codec::RedisValue(cardinality);
+}
+
+}  // namespace collections
@@ -0,0 +1,121 @@
+#ifndef COLLECTIONS_COLLECTIONSREDISHANDLER_H_
+#define COLLECTIONS_COLLECTIONSREDISHANDLER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "codec/RedisValue.h"
+#include "infra/HashEngine.h"
+#include "infra/ListEngine.h"
+#include "infra/SortedSetEngine.h"
+#include "pipeline/DatabaseManager.h"
+#include "pipeline/RedisHandler.h"
+#include "rocksdb/status.h"
+
+namespace collections {
+
+// A redis handler exposing collections stored element by element in RocksDB, so that updating one element does not
+// rewrite the whole collection:
+//   LPUSH/RPUSH key value [value ...]   Push values to the head or tail. Reply with the length of the list.
+//   LPOP/RPOP key                       Remove and reply with the head or tail, or null if the list is empty.
+//   LRANGE key start stop               Reply with the elements from start to stop, counting from the tail if negative.
+//   LTRIM key start stop                Keep only the elements from start to stop.
+//   LLEN key                            Reply with the length of the list.
+//   HSET key field value [field value ...]
+//                                       Set fields of a hash. Reply with the number of fields added.
+//   HMSET key field value [field value ...]
+//                                       Set fields of a hash without counting them first. Reply with OK.
+//   HGET key field                      Reply with the value of a field, or null if it does not exist.
+//   HMGET key field [field ...]         Reply with the value of each field, or null for fields that do not exist.
+//   HGETALL key                         Reply with every field followed by its value.
+//   HDEL key field [field ...]          Delete fields of a hash. Reply with the number of fields removed.
+//   ZADD key score member [score member ...]
+//                                       Add members or update their scores. Reply with the number of members added.
+//   ZREM key member [member ...]        Remove members. Reply with the number of members removed.
+//   ZRANGEBYSCORE key min max [WITHSCORES] [LIMIT offset count]
+//                                       Reply with members in score order, where bounds may be -inf, +inf or
+//                                       exclusive with a leading '('.
+//   ZRANK key member                    Reply with the rank of a member, which is estimated for large ranks, or null.
+//   ZCARD key                           Reply with the number of members.
+class CollectionsRedisHandler : public pipeline::RedisHandler {
+ public:
+  CollectionsRedisHandler(std::shared_ptr<pipeline::DatabaseManager> databaseManager,
+                          std::shared_ptr<infra::ListEngine> listEngine, std::shared_ptr<infra::HashEngine> hashEngine,
+                          std::shared_ptr<infra::SortedSetEngine> sortedSetEngine)
+      : RedisHandler(databaseManager),
+        listEngine_(listEngine),
+        hashEngine_(hashEngine),
+        sortedSetEngine_(sortedSetEngine) {}
+
+  const CommandHandlerTable& getCommandHandlerTable() const override {
+    static const CommandHandlerTable commandHandlerTable(mergeWithDefaultCommandHandlerTable({
+        {"lpush", {static_cast<CommandHandlerFunc>(&CollectionsRedisHandler::lpushCommand), 2, -1}},
+        {"rpush", {static_cast<CommandHandlerFunc>(&CollectionsRedisHandler::rpushCommand), 2, -1}},
+        {"lpop", {static_cast<CommandHandlerFunc>(&CollectionsRedisHandler::lpopCommand), 1, 1}},
+        {"rpop", {static_cast<CommandHandlerFunc>(&CollectionsRedisHandler::rpopCommand), 1, 1}},
+        {"lrange", {static_cast<CommandHandlerFunc>(&CollectionsRedisHandler::lrangeCommand), 3, 3}},
+        {"ltrim", {static_cast<CommandHandlerFunc>(&CollectionsRedisHandler::ltrimCommand), 3, 3}},
+        {"llen", {static_cast<CommandHandlerFunc>(&CollectionsRedisHandler::llenCommand), 1, 1}},
+        {"hset", {static_cast<CommandHandlerFunc>(&CollectionsRedisHandler::hsetCommand), 3, -1}},
+        {"hmset", {static_cast<CommandHandlerFunc>(&CollectionsRedisHandler::hmsetCommand), 3, -1}},
+        {"hget", {static_cast<CommandHandlerFunc>(&CollectionsRedisHandler::hgetCommand), 2, 2}},
+        {"hmget", {static_cast<CommandHandlerFunc>(&CollectionsRedisHandler::hmgetCommand), 2, -1}},
+        {"hgetall", {static_cast<CommandHandlerFunc>(&CollectionsRedisHandler::hgetallCommand), 1, 1}},
+        {"hdel", {static_cast<CommandHandlerFunc>(&CollectionsRedisHandler::hdelCommand), 2, -1}},
+        {"zadd", {static_cast<CommandHandlerFunc>(&CollectionsRedisHandler::zaddCommand), 3, -1}},
+        {"zrem", {static_cast<CommandHandlerFunc>(&CollectionsRedisHandler::zremCommand), 2, -1}},
+        {"zrangebyscore", {static_cast<CommandHandlerFunc>(&CollectionsRedisHandler::zrangebyscoreCommand), 3, 6}},
+        {"zrank", {static_cast<CommandHandlerFunc>(&CollectionsRedisHandler::zrankCommand), 2, 2}},
+        {"zcard", {static_cast<CommandHandlerFunc>(&CollectionsRedisHandler::zcardCommand), 1, 1}},
+    }));
+    return commandHandlerTable;
+  }
+
+ private:
+  codec::RedisValue errorRocksDb(const rocksdb::Status& status);
+
+  codec::RedisValue push(const std::vector<std::string>& cmd, infra::ListEngine::End end);
+  codec::RedisValue pop(const std::vector<std::string>& cmd, infra::ListEngine::End end);
+  // Reply with the number of fields added, or OK without looking them up first
+  codec::RedisValue setFields(const std::vector<std::string>& cmd, bool countAdded);
+
+  codec::RedisValue lpushCommand(const std::vector<std::string>& cmd, Context* ctx) {
+    return push(cmd, infra::ListEngine::End::kLeft);
+  }
+  codec::RedisValue rpushCommand(const std::vector<std::string>& cmd, Context* ctx) {
+    return push(cmd, infra::ListEngine::End::kRight);
+  }
+  codec::RedisValue lpopCommand(const std::vector<std::string>& cmd, Context* ctx) {
+    return pop(cmd, infra::ListEngine::End::kLeft);
+  }
+  codec::RedisValue rpopCommand(const std::vector<std::string>& cmd, Context* ctx) {
+    return pop(cmd, infra::ListEngine::End::kRight);
+  }
+  codec::RedisValue lrangeCommand(const std::vector<std::string>& cmd, Context* ctx);
+  codec::RedisValue ltrimCommand(const std::vector<std::string>& cmd, Context* ctx);
+  codec::RedisValue llenCommand(const std::vector<std::string>& cmd, Context* ctx);
+  codec::RedisValue hsetCommand(const std::vector<std::string>& cmd, Context* ctx) {
+    return setFields(cmd, true);
+  }
+  codec::RedisValue hmsetCommand(const std::vector<std::string>& cmd, Context* ctx) {
+    return setFields(cmd, false);
+  }
+  codec::RedisValue hgetCommand(const std::vector<std::string>& cmd, Context* ctx);
+  codec::RedisValue hmgetCommand(const std::vector<std::string>& cmd, Context* ctx);
+  codec::RedisValue hgetallCommand(const std::vector<std::string>& cmd, Context* ctx);
+  codec::RedisValue hdelCommand(const std::vector<std::string>& cmd, Context* ctx);
+  codec::RedisValue zaddCommand(const std::vector<std::string>& cmd, Context* ctx);
+  codec::RedisValue zremCommand(const std::vector<std::string>& cmd, Context* ctx);
+  codec::RedisValue zrangebyscoreCommand(const std::vector<std::string>& cmd, Context* ctx);
+  codec::RedisValue zrankCommand(const std::vector<std::string>& cmd, Context* ctx);
+  codec::RedisValue zcardCommand(const std::vector<std::string>& cmd, Context* ctx);
+
+  std::shared_ptr<infra::ListEngine> listEngine_;
+  std::shared_ptr<infra::HashEngine> hashEngine_;
+  std::shared_ptr<infra::SortedSetEngine> sortedSetEngine_;
+};
+
+}  // namespace collections
+
+#endif  // COLLECTIONS_COLLECTIONSREDISHANDLER_H_
@@ -33,7 +33,7 @@ class KeyValueHandler: public pipeline::RedisHandler {
     rocksdb::Slice key = rocksdb::Slice(cmd[1]);
 
     std::string value;
-    rocksdb::Status status = db()->Get(rocksdb::ReadOptions(), key, &value);
+    rocksdb::Status status = coalescedGet(db()->DefaultColumnFamily(), key, &value);
 
     if (status.ok()) {
       return codec::RedisValue(codec::RedisValue::Type::kBulkString, std::move(value));
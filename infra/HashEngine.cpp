@@ -0,0 +1,184 @@
+#include "infra/HashEngine.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "infra/KeyEncoding.h"
+#include "rocksdb/cache.h"
+#include "rocksdb/db.h"
+#include "rocksdb/filter_policy.h"
+#include "rocksdb/iterator.h"
+#include "rocksdb/options.h"
+#include "rocksdb/slice.h"
+#include "rocksdb/slice_transform.h"
+#include "rocksdb/status.h"
+#include "rocksdb/table.h"
+#include "rocksdb/write_batch.h"
+
+namespace infra {
+
+namespace {
+
+// Size of the hash prefix at the start of a field key, or 0 if the key is too short to hold one
+size_t prefixSize(const rocksdb::Slice& fieldKey) {
+  if (fieldKey.size() < kKeyLengthSize) return 0;
+  size_t length = readBigEndian(fieldKey.data(), kKeyLengthSize);
+  return fieldKey.size() < kKeyLengthSize + length ? 0 : kKeyLengthSize + length;
+}
+
+class HashPrefixTransform : public rocksdb::SliceTransform {
+ public:
+  const char* Name() const override { return "infra.HashEngine.HashPrefix"; }
+
+  rocksdb::Slice Transform(const rocksdb::Slice& key) const override {
+    return rocksdb::Slice(key.data(), prefixSize(key));
+  }
+
+  bool InDomain(const rocksdb::Slice& key) const override { return prefixSize(key) > 0; }
+
+  bool InRange(const rocksdb::Slice& dst) const override { return false; }
+};
+
+}  // namespace
+
+void HashEngine::optimizeColumnFamily(int defaultBlockCacheSizeMb, rocksdb::ColumnFamilyOptions* options) {
+  rocksdb::BlockBasedTableOptions blockBasedOptions;
+  blockBasedOptions.block_cache = rocksdb::NewLRUCache(static_cast<size_t>(defaultBlockCacheSizeMb * 1024 * 1024));
+  // full filters hold both whole field keys for HGET and hash prefixes for HGETALL
+  blockBasedOptions.filter_policy.reset(rocksdb::NewBloomFilterPolicy(10, false));
+  blockBasedOptions.whole_key_filtering = true;
+  options->table_factory.reset(rocksdb::NewBlockBasedTableFactory(blockBasedOptions));
+  options->prefix_extractor.reset(newPrefixExtractor());
+  options->memtable_prefix_bloom_size_ratio = 0.1;
+}
+
+const rocksdb::SliceTransform* HashEngine::newPrefixExtractor() {
+  return new HashPrefixTransform();
+}
+
+std::string HashEngine::encodePrefix(const std::string& key) {
+  std::string prefix;
+  prefix.reserve(kKeyLengthSize + key.size());
+  appendLengthPrefixed(key, &prefix);
+  return prefix;
+}
+
+std::string HashEngine::encodeFieldKey(const std::string& key, const std::string& field) {
+  std::string fieldKey = encodePrefix(key);
+  fieldKey.append(field);
+  return fieldKey;
+}
+
+rocksdb::Status HashEngine::set(const std::string& key, const FieldValues& fieldValues, int64_t* added) {
+  if (!added) {
+    rocksdb::WriteBatch writeBatch;
+    for (const auto& fieldValue : fieldValues) {
+      writeBatch.Put(columnFamily_, encodeFieldKey(key, fieldValue.first), fieldValue.second);
+    }
+    // still serialized with counted writes, whose counts would be off if a field appeared between lookup and write
+    std::lock_guard<std::mutex> guard(locks_.get(key));
+    return databaseManager_->db()->Write(rocksdb::WriteOptions(), &writeBatch);
+  }
+
+  std::vector<std::string> fields;
+  fields.reserve(fieldValues.size());
+  for (const auto& fieldValue : fieldValues) {
+    fields.push_back(fieldValue.first);
+  }
+
+  std::lock_guard<std::mutex> guard(locks_.get(key));
+  std::vector<bool> existing;
+  rocksdb::Status status = getExisting(key, fields, &existing);
+  if (!status.ok()) return status;
+
+  rocksdb::WriteBatch writeBatch;
+  std::unordered_set<std::string> addedFields;
+  for (size_t i = 0; i < fieldValues.size(); i++) {
+    writeBatch.Put(columnFamily_, encodeFieldKey(key, fieldValues[i].first), fieldValues[i].second);
+    if (!existing[i]) addedFields.insert(fieldValues[i].first);
+  }
+  status = databaseManager_->db()->Write(rocksdb::WriteOptions(), &writeBatch);
+  if (status.ok()) *added = addedFields.size();
+  return status;
+}
+
+rocksdb::Status HashEngine::get(const std::string& key, const std::string& field, std::string* value) {
+  return databaseManager_->db()->Get(rocksdb::ReadOptions(), columnFamily_, encodeFieldKey(key, field), value);
+}
+
+std::vector<rocksdb::Status> HashEngine::multiGet(const std::string& key, const std::vector<std::string>& fields,
+                                                  std::vector<std::string>* values) {
+  std::vector<std::string> fieldKeys;
+  fieldKeys.reserve(fields.size());
+  for (const auto& field : fields) {
+    fieldKeys.push_back(encodeFieldKey(key, field));
+  }
+  std::vector<rocksdb::Slice> keySlices(fieldKeys.begin(), fieldKeys.end());
+  std::vector<rocksdb::ColumnFamilyHandle*> columnFamilies(fields.size(), columnFamily_);
+  return databaseManager_->db()->MultiGet(rocksdb::ReadOptions(), columnFamilies, keySlices, values);
+}
+
+rocksdb::Status HashEngine::getAll(const std::string& key, FieldValues* fieldValues) {
+  const std::string prefix = encodePrefix(key);
+  const std::string upperBound = prefixSuccessor(prefix);
+  rocksdb::Slice upperBoundSlice(upperBound);
+  rocksdb::ReadOptions readOptions;
+  readOptions.prefix_same_as_start = true;
+  if (!upperBound.empty()) readOptions.iterate_upper_bound = &upperBoundSlice;
+
+  std::unique_ptr<rocksdb::Iterator> it(databaseManager_->db()->NewIterator(readOptions, columnFamily_));
+  for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+    rocksdb::Slice field = it->key();
+    field.remove_prefix(prefix.size());
+    fieldValues->emplace_back(field.ToString(), it->value().ToString());
+  }
+  return it->status();
+}
+
+rocksdb::Status HashEngine::del(const std::string& key, const std::vector<std::string>& fields, int64_t* removed) {
+  if (!removed) {
+    rocksdb::WriteBatch writeBatch;
+    for (const auto& field : fields) {
+      writeBatch.Delete(columnFamily_, encodeFieldKey(key, field));
+    }
+    std::lock_guard<std::mutex> guard(locks_.get(key));
+    return databaseManager_->db()->Write(rocksdb::WriteOptions(), &writeBatch);
+  }
+
+  std::lock_guard<std::mutex> guard(locks_.get(key));
+  std::vector<bool> existing;
+  rocksdb::Status status = getExisting(key, fields, &existing);
+  if (!status.ok()) return status;
+
+  rocksdb::WriteBatch writeBatch;
+  std::unordered_set<std::string> removedFields;
+  for (size_t i = 0; i < fields.size(); i++) {
+    if (!existing[i] || !removedFields.insert(fields[i]).second) continue;
+    writeBatch.Delete(columnFamily_, encodeFieldKey(key, fields[i]));
+  }
+  if (removedFields.empty()) {
+    *removed = 0;
+    return rocksdb::Status::OK();
+  }
+  status = databaseManager_->db()->Write(rocksdb::WriteOptions(), &writeBatch);
+  if (status.ok()) *removed = removedFields.size();
+  return status;
+}
+
+rocksdb::Status HashEngine::getExisting(const std::string& key, const std::vector<std::string>& fields,
+                                        std::vector<bool>* existing) {
+  std::vector<std::string> values;
+  std::vector<rocksdb::Status> statuses = multiGet(key, fields, &values);
+  existing->reserve(statuses.size());
+  for (const auto& status : statuses) {
+    if (!status.ok() && !status.IsNotFound()) return status;
+    existing->push_back(status.ok());
+  }
+  return rocksdb::Status::OK();
+}
+
+}  // namespace infra
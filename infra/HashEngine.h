@@ -0,0 +1,80 @@
+#ifndef INFRA_HASHENGINE_H_
+#define INFRA_HASHENGINE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "infra/StripedLocks.h"
+#include "pipeline/DatabaseManager.h"
+#include "rocksdb/db.h"
+#include "rocksdb/options.h"
+#include "rocksdb/slice_transform.h"
+#include "rocksdb/status.h"
+
+namespace infra {
+
+// A RocksDB-backed hash engine, which stores every field of a hash under its own key instead of serializing the whole
+// hash into one value, so setting or deleting a field is one small write. The fields of a hash share a prefix, which
+// the column family uses as its prefix extractor: bloom filters skip files without the hash, and reading a whole hash
+// is a prefix scan bounded to that hash.
+//
+// Writes to the same hash are serialized in the engine so that counts of added and removed fields are exact.
+class HashEngine {
+ public:
+  using FieldValues = std::vector<std::pair<std::string, std::string>>;
+
+  // Name for the column family storing hashes. Use static method instead of a variable to ensure initialization
+  // ordering when referenced in a global variable context.
+  static const std::string& columnFamilyName() {
+    static std::string name = "hashes";
+    return name;
+  }
+
+  // Optimize the RocksDB column family used for hashes, with prefix bloom filters over the hash keys
+  static void optimizeColumnFamily(int defaultBlockCacheSizeMb, rocksdb::ColumnFamilyOptions* options);
+
+  // Prefix extractor mapping a field key to the prefix of its hash, see encodePrefix
+  static const rocksdb::SliceTransform* newPrefixExtractor();
+
+  // The hash key, length-prefixed as in KeyEncoding.h
+  static std::string encodePrefix(const std::string& key);
+  // Fields follow the prefix as is
+  static std::string encodeFieldKey(const std::string& key, const std::string& field);
+
+  HashEngine(std::shared_ptr<pipeline::DatabaseManager> databaseManager, rocksdb::ColumnFamilyHandle* columnFamily)
+      : databaseManager_(databaseManager), columnFamily_(columnFamily) {}
+
+  // Set fields in one write, where later values win for repeated fields. The number of fields which did not exist
+  // before is set in added, which takes a MultiGet of the fields first. Pass nullptr to write without it.
+  rocksdb::Status set(const std::string& key, const FieldValues& fieldValues, int64_t* added);
+
+  // Value of one field. Return NotFound if either the hash or the field does not exist.
+  rocksdb::Status get(const std::string& key, const std::string& field, std::string* value);
+
+  // Values of several fields in one MultiGet, with one status per field like rocksdb::DB::MultiGet
+  std::vector<rocksdb::Status> multiGet(const std::string& key, const std::vector<std::string>& fields,
+                                        std::vector<std::string>* values);
+
+  // All fields and values of a hash in field order, which is empty for hashes that do not exist
+  rocksdb::Status getAll(const std::string& key, FieldValues* fieldValues);
+
+  // Delete fields, setting the number of fields which existed in removed. Like for set, counting takes a MultiGet of
+  // the fields, which is skipped when removed is nullptr.
+  rocksdb::Status del(const std::string& key, const std::vector<std::string>& fields, int64_t* removed);
+
+ private:
+  // Look up which of the given fields exist, as of the time of the call
+  rocksdb::Status getExisting(const std::string& key, const std::vector<std::string>& fields,
+                              std::vector<bool>* existing);
+
+  std::shared_ptr<pipeline::DatabaseManager> databaseManager_;
+  rocksdb::ColumnFamilyHandle* columnFamily_;
+  StripedLocks locks_;
+};
+
+}  // namespace infra
+
+#endif  // INFRA_HASHENGINE_H_
@@ -0,0 +1,110 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "infra/HashEngine.h"
+#include "rocksdb/slice.h"
+#include "rocksdb/slice_transform.h"
+#include "rocksdb/status.h"
+#include "stesting/TestWithRocksDb.h"
+
+namespace infra {
+
+class HashEngineTest : public stesting::TestWithRocksDb {
+ protected:
+  HashEngineTest()
+      : stesting::TestWithRocksDb({ HashEngine::columnFamilyName() },
+                                  { { HashEngine::columnFamilyName(), &HashEngine::optimizeColumnFamily } }) {}
+
+  HashEngine::FieldValues getAll(HashEngine* engine, const std::string& key) {
+    HashEngine::FieldValues fieldValues;
+    EXPECT_TRUE(engine->getAll(key, &fieldValues).ok());
+    return fieldValues;
+  }
+};
+
+TEST_F(HashEngineTest, PrefixExtractor) {
+  std::unique_ptr<const rocksdb::SliceTransform> extractor(HashEngine::newPrefixExtractor());
+  const std::string fieldKey = HashEngine::encodeFieldKey("abc", "field");
+  EXPECT_EQ(std::string("\x00\x00\x00\x03" "abcfield", 12), fieldKey);
+  EXPECT_TRUE(extractor->InDomain(fieldKey));
+  EXPECT_EQ(HashEngine::encodePrefix("abc"), extractor->Transform(fieldKey).ToString());
+  EXPECT_TRUE(extractor->InDomain(HashEngine::encodeFieldKey("", "")));
+  // keys too short for their length are out of domain
+  EXPECT_FALSE(extractor->InDomain(rocksdb::Slice("\x00\x00", 2)));
+  EXPECT_FALSE(extractor->InDomain(rocksdb::Slice("\x00\x00\x00\x05" "abc", 7)));
+}
+
+TEST_F(HashEngineTest, SetAndGet) {
+  HashEngine engine(databaseManager(), columnFamily(HashEngine::columnFamilyName()));
+  int64_t added;
+  ASSERT_TRUE(engine.set("user", {{"name", "alice"}, {"age", "30"}}, &added).ok());
+  EXPECT_EQ(2, added);
+  // repeated fields count once, and the last value wins
+  ASSERT_TRUE(engine.set("user", {{"age", "31"}, {"city", "x"}, {"city", "paris"}}, &added).ok());
+  EXPECT_EQ(1, added);
+
+  std::string value;
+  ASSERT_TRUE(engine.get("user", "age", &value).ok());
+  EXPECT_EQ("31", value);
+  ASSERT_TRUE(engine.get("user", "city", &value).ok());
+  EXPECT_EQ("paris", value);
+  EXPECT_TRUE(engine.get("user", "missing", &value).IsNotFound());
+  EXPECT_TRUE(engine.get("missing", "name", &value).IsNotFound());
+
+  std::vector<std::string> values;
+  std::vector<rocksdb::Status> statuses = engine.multiGet("user", {"name", "missing", "city"}, &values);
+  ASSERT_EQ(3, statuses.size());
+  EXPECT_TRUE(statuses[0].ok());
+  EXPECT_EQ("alice", values[0]);
+  EXPECT_TRUE(statuses[1].IsNotFound());
+  EXPECT_TRUE(statuses[2].ok());
+  EXPECT_EQ("paris", values[2]);
+}
+
+TEST_F(HashEngineTest, GetAll) {
+  HashEngine engine(databaseManager(), columnFamily(HashEngine::columnFamilyName()));
+  int64_t added;
+  ASSERT_TRUE(engine.set("user", {{"b", "2"}, {"a", "1"}}, &added).ok());
+  // hashes whose key extends the other one stay separate
+  ASSERT_TRUE(engine.set("user2", {{"c", "3"}}, &added).ok());
+  ASSERT_TRUE(engine.set("use", {{"rd", "4"}}, &added).ok());
+
+  EXPECT_EQ(HashEngine::FieldValues({{"a", "1"}, {"b", "2"}}), getAll(&engine, "user"));
+  EXPECT_EQ(HashEngine::FieldValues({{"c", "3"}}), getAll(&engine, "user2"));
+  EXPECT_EQ(HashEngine::FieldValues({{"rd", "4"}}), getAll(&engine, "use"));
+  EXPECT_TRUE(getAll(&engine, "missing").empty());
+}
+
+TEST_F(HashEngineTest, Delete) {
+  HashEngine engine(databaseManager(), columnFamily(HashEngine::columnFamilyName()));
+  int64_t added;
+  ASSERT_TRUE(engine.set("user", {{"a", "1"}, {"b", "2"}, {"c", "3"}}, &added).ok());
+
+  int64_t removed;
+  ASSERT_TRUE(engine.del("user", {"a", "a", "missing"}, &removed).ok());
+  EXPECT_EQ(1, removed);
+  EXPECT_EQ(HashEngine::FieldValues({{"b", "2"}, {"c", "3"}}), getAll(&engine, "user"));
+
+  ASSERT_TRUE(engine.del("user", {"b", "c"}, &removed).ok());
+  EXPECT_EQ(2, removed);
+  ASSERT_TRUE(engine.del("user", {"b"}, &removed).ok());
+  EXPECT_EQ(0, removed);
+  EXPECT_EQ(0, totalKeyCount(columnFamily(HashEngine::columnFamilyName())));
+}
+
+TEST_F(HashEngineTest, WithoutCounts) {
+  HashEngine engine(databaseManager(), columnFamily(HashEngine::columnFamilyName()));
+  ASSERT_TRUE(engine.set("user", {{"a", "1"}, {"b", "2"}, {"a", "3"}}, nullptr).ok());
+  EXPECT_EQ(HashEngine::FieldValues({{"a", "3"}, {"b", "2"}}), getAll(&engine, "user"));
+
+  ASSERT_TRUE(engine.del("user", {"a", "missing"}, nullptr).ok());
+  EXPECT_EQ(HashEngine::FieldValues({{"b", "2"}}), getAll(&engine, "user"));
+  // counts stay exact around uncounted writes
+  int64_t added;
+  ASSERT_TRUE(engine.set("user", {{"a", "4"}, {"b", "5"}}, &added).ok());
+  EXPECT_EQ(1, added);
+}
+
+}  // namespace infra
@@ -0,0 +1,47 @@
+#ifndef INFRA_KEYENCODING_H_
+#define INFRA_KEYENCODING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace infra {
+
+// Helpers for RocksDB keys whose byte order has to follow the order of what they encode
+
+// Size of the length in front of a length-prefixed key
+constexpr size_t kKeyLengthSize = sizeof(uint32_t);
+
+// Append the lowest bytes of value, most significant first, so that encoded values sort like the numbers
+inline void appendBigEndian(uint64_t value, size_t bytes, std::string* out) {
+  for (size_t i = bytes; i > 0; i--) {
+    out->push_back(static_cast<char>((value >> (8 * (i - 1))) & 0xff));
+  }
+}
+
+inline uint64_t readBigEndian(const char* data, size_t bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < bytes; i++) {
+    value = (value << 8) | static_cast<uint8_t>(data[i]);
+  }
+  return value;
+}
+
+// Append the length of key followed by key itself, so that no length-prefixed key is a prefix of another
+inline void appendLengthPrefixed(const std::string& key, std::string* out) {
+  appendBigEndian(key.size(), kKeyLengthSize, out);
+  out->append(key);
+}
+
+// Smallest key greater than every key starting with prefix, or empty if there is none
+inline std::string prefixSuccessor(std::string prefix) {
+  while (!prefix.empty() && static_cast<uint8_t>(prefix.back()) == 0xff) {
+    prefix.pop_back();
+  }
+  if (!prefix.empty()) prefix.back() = static_cast<char>(static_cast<uint8_t>(prefix.back()) + 1);
+  return prefix;
+}
+
+}  // namespace infra
+
+#endif  // INFRA_KEYENCODING_H_
@@ -0,0 +1,41 @@
+#include "infra/KeyEncoding.h"
+
+#include <cstdint>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace infra {
+
+TEST(KeyEncodingTest, BigEndian) {
+  std::string encoded;
+  appendBigEndian(0x0102, 4, &encoded);
+  EXPECT_EQ(std::string("\x00\x00\x01\x02", 4), encoded);
+  EXPECT_EQ(0x0102u, readBigEndian(encoded.data(), 4));
+
+  // byte order follows numeric order
+  std::string smaller;
+  std::string larger;
+  appendBigEndian(255, 8, &smaller);
+  appendBigEndian(256, 8, &larger);
+  EXPECT_LT(smaller, larger);
+  EXPECT_EQ(UINT64_MAX, readBigEndian(std::string(8, '\xff').data(), 8));
+}
+
+TEST(KeyEncodingTest, LengthPrefixed) {
+  std::string a;
+  appendLengthPrefixed("a", &a);
+  EXPECT_EQ(std::string("\x00\x00\x00\x01" "a", 5), a);
+  std::string ab;
+  appendLengthPrefixed("ab", &ab);
+  EXPECT_NE(0, ab.compare(0, a.size(), a));
+}
+
+TEST(KeyEncodingTest, PrefixSuccessor) {
+  EXPECT_EQ("ac", prefixSuccessor("ab"));
+  EXPECT_EQ("b", prefixSuccessor(std::string("a\xff\xff")));
+  EXPECT_EQ("", prefixSuccessor(std::string("\xff\xff")));
+  EXPECT_EQ("", prefixSuccessor(""));
+}
+
+}  // namespace infra
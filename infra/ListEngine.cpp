@@ -0,0 +1,210 @@
+#include "infra/ListEngine.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "glog/logging.h"
+#include "infra/KeyEncoding.h"
+#include "rocksdb/db.h"
+#include "rocksdb/iterator.h"
+#include "rocksdb/options.h"
+#include "rocksdb/slice.h"
+#include "rocksdb/status.h"
+#include "rocksdb/write_batch.h"
+
+namespace infra {
+
+namespace {
+
+constexpr size_t kMetadataSize = 16;
+
+// Flipping the sign bit makes negative sequence numbers sort before positive ones
+void appendSequence(int64_t sequence, std::string* out) {
+  appendBigEndian(static_cast<uint64_t>(sequence) ^ (1ULL << 63), sizeof(sequence), out);
+}
+
+int64_t readSequence(const char* data) {
+  return static_cast<int64_t>(readBigEndian(data, sizeof(int64_t)) ^ (1ULL << 63));
+}
+
+// Release the snapshot along with the read options using it
+class SnapshotGuard {
+ public:
+  explicit SnapshotGuard(rocksdb::DB* db) : db_(db), snapshot_(db->GetSnapshot()) {}
+  ~SnapshotGuard() { db_->ReleaseSnapshot(snapshot_); }
+
+  const rocksdb::Snapshot* get() const { return snapshot_; }
+
+ private:
+  rocksdb::DB* db_;
+  const rocksdb::Snapshot* snapshot_;
+};
+
+}  // namespace
+
+std::string ListEngine::encodeMetadataKey(const std::string& key) {
+  std::string metadataKey;
+  metadataKey.reserve(kKeyLengthSize + key.size() + sizeof(int64_t));
+  appendLengthPrefixed(key, &metadataKey);
+  return metadataKey;
+}
+
+std::string ListEngine::encodeElementKey(const std::string& key, int64_t sequence) {
+  std::string elementKey = encodeMetadataKey(key);
+  appendSequence(sequence, &elementKey);
+  return elementKey;
+}
+
+bool ListEngine::normalizeRange(int64_t length, int64_t start, int64_t stop, int64_t* first, int64_t* last) {
+  if (start < 0) start = std::max(start + length, 0L);
+  if (stop < 0) stop += length;
+  stop = std::min(stop, length - 1);
+  if (start > stop) return false;
+  *first = start;
+  *last = stop;
+  return true;
+}
+
+rocksdb::Status ListEngine::push(const std::string& key, End end, const std::vector<std::string>& values,
+                                 int64_t* length) {
+  const std::string metadataKey = encodeMetadataKey(key);
+  std::lock_guard<std::mutex> guard(locks_.get(key));
+  Metadata metadata;
+  rocksdb::Status status = getMetadata(rocksdb::ReadOptions(), metadataKey, &metadata);
+  if (!status.ok() && !status.IsNotFound()) return status;
+
+  rocksdb::WriteBatch writeBatch;
+  for (const auto& value : values) {
+    int64_t sequence = end == End::kLeft ? --metadata.head : metadata.tail++;
+    writeBatch.Put(columnFamily_, encodeElementKey(key, sequence), value);
+  }
+  putMetadata(metadataKey, metadata, &writeBatch);
+  status = databaseManager_->db()->Write(rocksdb::WriteOptions(), &writeBatch);
+  if (status.ok()) *length = metadata.length();
+  return status;
+}
+
+rocksdb::Status ListEngine::pop(const std::string& key, End end, std::string* value) {
+  const std::string metadataKey = encodeMetadataKey(key);
+  std::lock_guard<std::mutex> guard(locks_.get(key));
+  Metadata metadata;
+  rocksdb::Status status = getMetadata(rocksdb::ReadOptions(), metadataKey, &metadata);
+  if (!status.ok()) return status;
+
+  int64_t sequence = end == End::kLeft ? metadata.head++ : --metadata.tail;
+  const std::string elementKey = encodeElementKey(key, sequence);
+  status = databaseManager_->db()->Get(rocksdb::ReadOptions(), columnFamily_, elementKey, value);
+  if (!status.ok()) {
+    LOG(ERROR) << "Reading element " << sequence << " of list " << key << " failed: " << status.ToString();
+    return status.IsNotFound() ? rocksdb::Status::Corruption("List element is missing") : status;
+  }
+
+  rocksdb::WriteBatch writeBatch;
+  writeBatch.Delete(columnFamily_, elementKey);
+  putMetadata(metadataKey, metadata, &writeBatch);
+  return databaseManager_->db()->Write(rocksdb::WriteOptions(), &writeBatch);
+}
+
+rocksdb::Status ListEngine::length(const std::string& key, int64_t* length) {
+  Metadata metadata;
+  rocksdb::Status status = getMetadata(rocksdb::ReadOptions(), encodeMetadataKey(key), &metadata);
+  if (!status.ok() && !status.IsNotFound()) return status;
+  *length = metadata.length();
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status ListEngine::range(const std::string& key, int64_t start, int64_t stop,
+                                  std::vector<std::string>* values) {
+  rocksdb::DB* db = databaseManager_->db();
+  SnapshotGuard snapshot(db);
+  rocksdb::ReadOptions readOptions;
+  readOptions.snapshot = snapshot.get();
+  Metadata metadata;
+  rocksdb::Status status = getMetadata(readOptions, encodeMetadataKey(key), &metadata);
+  if (status.IsNotFound()) return rocksdb::Status::OK();
+  if (!status.ok()) return status;
+
+  int64_t first;
+  int64_t last;
+  if (!normalizeRange(metadata.length(), start, stop, &first, &last)) return rocksdb::Status::OK();
+
+  const std::string upperBound = encodeElementKey(key, metadata.head + last + 1);
+  rocksdb::Slice upperBoundSlice(upperBound);
+  readOptions.iterate_upper_bound = &upperBoundSlice;
+  std::unique_ptr<rocksdb::Iterator> it(db->NewIterator(readOptions, columnFamily_));
+  values->reserve(values->size() + last - first + 1);
+  for (it->Seek(encodeElementKey(key, metadata.head + first)); it->Valid(); it->Next()) {
+    values->push_back(it->value().ToString());
+  }
+  return it->status();
+}
+
+rocksdb::Status ListEngine::trim(const std::string& key, int64_t start, int64_t stop) {
+  const std::string metadataKey = encodeMetadataKey(key);
+  std::lock_guard<std::mutex> guard(locks_.get(key));
+  Metadata metadata;
+  rocksdb::Status status = getMetadata(rocksdb::ReadOptions(), metadataKey, &metadata);
+  if (status.IsNotFound()) return rocksdb::Status::OK();
+  if (!status.ok()) return status;
+
+  rocksdb::WriteBatch writeBatch;
+  int64_t first;
+  int64_t last;
+  if (!normalizeRange(metadata.length(), start, stop, &first, &last)) {
+    deleteElements(key, metadata.head, metadata.tail, &writeBatch);
+    writeBatch.Delete(columnFamily_, metadataKey);
+  } else {
+    Metadata trimmed;
+    trimmed.head = metadata.head + first;
+    trimmed.tail = metadata.head + last + 1;
+    if (trimmed.head == metadata.head && trimmed.tail == metadata.tail) return rocksdb::Status::OK();
+    deleteElements(key, metadata.head, trimmed.head, &writeBatch);
+    deleteElements(key, trimmed.tail, metadata.tail, &writeBatch);
+    putMetadata(metadataKey, trimmed, &writeBatch);
+  }
+  return databaseManager_->db()->Write(rocksdb::WriteOptions(), &writeBatch);
+}
+
+rocksdb::Status ListEngine::getMetadata(const rocksdb::ReadOptions& readOptions, const std::string& metadataKey,
+                                        Metadata* metadata) {
+  std::string value;
+  rocksdb::Status status = databaseManager_->db()->Get(readOptions, columnFamily_, metadataKey, &value);
+  if (!status.ok()) return status;
+  if (value.size() != kMetadataSize) {
+    return rocksdb::Status::Corruption("List metadata is not 16 bytes long");
+  }
+  metadata->head = readSequence(value.data());
+  metadata->tail = readSequence(value.data() + sizeof(int64_t));
+  return rocksdb::Status::OK();
+}
+
+void ListEngine::putMetadata(const std::string& metadataKey, const Metadata& metadata,
+                             rocksdb::WriteBatch* writeBatch) {
+  // lists are removed once empty, like in redis
+  if (metadata.length() == 0) {
+    writeBatch->Delete(columnFamily_, metadataKey);
+    return;
+  }
+  std::string value;
+  value.reserve(kMetadataSize);
+  appendSequence(metadata.head, &value);
+  appendSequence(metadata.tail, &value);
+  writeBatch->Put(columnFamily_, metadataKey, value);
+}
+
+void ListEngine::deleteElements(const std::string& key, int64_t begin, int64_t end, rocksdb::WriteBatch* writeBatch) {
+  if (end - begin > kMaxPointDeletes) {
+    writeBatch->DeleteRange(columnFamily_, encodeElementKey(key, begin), encodeElementKey(key, end));
+    return;
+  }
+  for (int64_t sequence = begin; sequence < end; sequence++) {
+    writeBatch->Delete(columnFamily_, encodeElementKey(key, sequence));
+  }
+}
+
+constexpr int64_t ListEngine::kMaxPointDeletes;
+
+}  // namespace infra
@@ -0,0 +1,105 @@
+#ifndef INFRA_LISTENGINE_H_
+#define INFRA_LISTENGINE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "infra/StripedLocks.h"
+#include "pipeline/DatabaseManager.h"
+#include "rocksdb/cache.h"
+#include "rocksdb/db.h"
+#include "rocksdb/filter_policy.h"
+#include "rocksdb/options.h"
+#include "rocksdb/status.h"
+#include "rocksdb/table.h"
+
+namespace infra {
+
+// A RocksDB-backed list engine, which stores every element of a list under its own key instead of serializing the
+// whole list into one value. Elements are keyed by a sequence number, and the metadata of each list keeps the sequence
+// numbers of its head and tail, so pushing or popping touches one element and the metadata, and a range is a scan of
+// consecutive keys. Trimming many elements uses range deletes.
+//
+// Writes to the same list are serialized in the engine, while reads see a consistent snapshot of the list.
+class ListEngine {
+ public:
+  enum class End {
+    kLeft,
+    kRight,
+  };
+
+  // Name for the column family storing lists. Use static method instead of a variable to ensure initialization
+  // ordering when referenced in a global variable context.
+  static const std::string& columnFamilyName() {
+    static std::string name = "lists";
+    return name;
+  }
+
+  // Optimize the RocksDB column family used for lists, which needs total order seek over the elements of a list
+  static void optimizeColumnFamily(int defaultBlockCacheSizeMb, rocksdb::ColumnFamilyOptions* options) {
+    rocksdb::BlockBasedTableOptions blockBasedOptions;
+    blockBasedOptions.block_cache = rocksdb::NewLRUCache(static_cast<size_t>(defaultBlockCacheSizeMb * 1024 * 1024));
+    // use bloom filter to reduce disk I/O when looking up metadata
+    blockBasedOptions.filter_policy.reset(rocksdb::NewBloomFilterPolicy(10));
+    options->table_factory.reset(rocksdb::NewBlockBasedTableFactory(blockBasedOptions));
+  }
+
+  // Keys of a list start with the length-prefixed list key, see KeyEncoding.h. Its metadata is stored under this
+  // prefix alone.
+  static std::string encodeMetadataKey(const std::string& key);
+  // Elements follow the prefix with their sequence number, encoded so that byte order is numeric order
+  static std::string encodeElementKey(const std::string& key, int64_t sequence);
+
+  // Convert redis style start and stop indexes, which may be negative to count from the tail, into a range of
+  // [*first, *last] within a list of the given length. Return false if the range is empty.
+  static bool normalizeRange(int64_t length, int64_t start, int64_t stop, int64_t* first, int64_t* last);
+
+  ListEngine(std::shared_ptr<pipeline::DatabaseManager> databaseManager, rocksdb::ColumnFamilyHandle* columnFamily)
+      : databaseManager_(databaseManager), columnFamily_(columnFamily) {}
+
+  // Push values one by one to the given end, so that pushing a, b, c to the left makes c the head. The length of the
+  // list after pushing is set in length.
+  rocksdb::Status push(const std::string& key, End end, const std::vector<std::string>& values, int64_t* length);
+
+  // Remove the element at the given end and set it in value. Return NotFound if the list is empty.
+  rocksdb::Status pop(const std::string& key, End end, std::string* value);
+
+  // Length of a list, which is 0 for lists that do not exist
+  rocksdb::Status length(const std::string& key, int64_t* length);
+
+  // Elements from start to stop inclusive, with the same index semantics as redis LRANGE
+  rocksdb::Status range(const std::string& key, int64_t start, int64_t stop, std::vector<std::string>* values);
+
+  // Keep only the elements from start to stop inclusive, with the same index semantics as redis LTRIM. The list is
+  // removed when the range is empty.
+  rocksdb::Status trim(const std::string& key, int64_t start, int64_t stop);
+
+ private:
+  // Sequence numbers of the first element and past the last one
+  struct Metadata {
+    int64_t head = 0;
+    int64_t tail = 0;
+
+    int64_t length() const { return tail - head; }
+  };
+
+  // Trims removing up to this many elements from an end use point deletes, since every range delete stays in the way of
+  // reads until it is compacted away
+  static constexpr int64_t kMaxPointDeletes = 32;
+
+  rocksdb::Status getMetadata(const rocksdb::ReadOptions& readOptions, const std::string& metadataKey,
+                              Metadata* metadata);
+  void putMetadata(const std::string& metadataKey, const Metadata& metadata, rocksdb::WriteBatch* writeBatch);
+  // Delete the elements with sequence numbers in [begin, end)
+  void deleteElements(const std::string& key, int64_t begin, int64_t end, rocksdb::WriteBatch* writeBatch);
+
+  std::shared_ptr<pipeline::DatabaseManager> databaseManager_;
+  rocksdb::ColumnFamilyHandle* columnFamily_;
+  StripedLocks locks_;
+};
+
+}  // namespace infra
+
+#endif  // INFRA_LISTENGINE_H_
@@ -0,0 +1,122 @@
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "infra/ListEngine.h"
+#include "rocksdb/status.h"
+#include "stesting/TestWithRocksDb.h"
+
+namespace infra {
+
+class ListEngineTest : public stesting::TestWithRocksDb {
+ protected:
+  ListEngineTest() : stesting::TestWithRocksDb({ ListEngine::columnFamilyName() }) {}
+
+  std::vector<std::string> range(ListEngine* engine, const std::string& key, int64_t start, int64_t stop) {
+    std::vector<std::string> values;
+    EXPECT_TRUE(engine->range(key, start, stop, &values).ok());
+    return values;
+  }
+
+  int64_t length(ListEngine* engine, const std::string& key) {
+    int64_t length = -1;
+    EXPECT_TRUE(engine->length(key, &length).ok());
+    return length;
+  }
+};
+
+TEST_F(ListEngineTest, EncodeKeys) {
+  EXPECT_EQ(std::string("\x00\x00\x00\x03" "abc", 7), ListEngine::encodeMetadataKey("abc"));
+  // element keys sort by sequence number, including negative ones
+  EXPECT_LT(ListEngine::encodeElementKey("abc", -2), ListEngine::encodeElementKey("abc", -1));
+  EXPECT_LT(ListEngine::encodeElementKey("abc", -1), ListEngine::encodeElementKey("abc", 0));
+  EXPECT_LT(ListEngine::encodeElementKey("abc", 255), ListEngine::encodeElementKey("abc", 256));
+  // no list key is a prefix of another
+  EXPECT_NE(0, ListEngine::encodeElementKey("abcd", 0).compare(0, 7, ListEngine::encodeMetadataKey("abc")));
+}
+
+TEST_F(ListEngineTest, NormalizeRange) {
+  int64_t first;
+  int64_t last;
+  EXPECT_TRUE(ListEngine::normalizeRange(10, 0, -1, &first, &last));
+  EXPECT_EQ(0, first);
+  EXPECT_EQ(9, last);
+  EXPECT_TRUE(ListEngine::normalizeRange(10, -3, 100, &first, &last));
+  EXPECT_EQ(7, first);
+  EXPECT_EQ(9, last);
+  EXPECT_TRUE(ListEngine::normalizeRange(10, -100, 2, &first, &last));
+  EXPECT_EQ(0, first);
+  EXPECT_EQ(2, last);
+  EXPECT_FALSE(ListEngine::normalizeRange(10, 5, 4, &first, &last));
+  EXPECT_FALSE(ListEngine::normalizeRange(10, 10, 20, &first, &last));
+  EXPECT_FALSE(ListEngine::normalizeRange(0, 0, -1, &first, &last));
+}
+
+TEST_F(ListEngineTest, PushAndPop) {
+  ListEngine engine(databaseManager(), columnFamily(ListEngine::columnFamilyName()));
+  int64_t length;
+  ASSERT_TRUE(engine.push("list", ListEngine::End::kRight, {"b", "c"}, &length).ok());
+  EXPECT_EQ(2, length);
+  ASSERT_TRUE(engine.push("list", ListEngine::End::kLeft, {"a", "z"}, &length).ok());
+  EXPECT_EQ(4, length);
+  EXPECT_EQ(std::vector<std::string>({"z", "a", "b", "c"}), range(&engine, "list", 0, -1));
+
+  std::string value;
+  ASSERT_TRUE(engine.pop("list", ListEngine::End::kLeft, &value).ok());
+  EXPECT_EQ("z", value);
+  ASSERT_TRUE(engine.pop("list", ListEngine::End::kRight, &value).ok());
+  EXPECT_EQ("c", value);
+  EXPECT_EQ(2, this->length(&engine, "list"));
+
+  ASSERT_TRUE(engine.pop("list", ListEngine::End::kRight, &value).ok());
+  ASSERT_TRUE(engine.pop("list", ListEngine::End::kRight, &value).ok());
+  EXPECT_EQ("a", value);
+  EXPECT_TRUE(engine.pop("list", ListEngine::End::kLeft, &value).IsNotFound());
+  EXPECT_EQ(0, this->length(&engine, "list"));
+  // empty lists leave nothing behind
+  EXPECT_EQ(0, totalKeyCount(columnFamily(ListEngine::columnFamilyName())));
+}
+
+TEST_F(ListEngineTest, Range) {
+  ListEngine engine(databaseManager(), columnFamily(ListEngine::columnFamilyName()));
+  int64_t length;
+  ASSERT_TRUE(engine.push("list", ListEngine::End::kRight, {"a", "b", "c", "d", "e"}, &length).ok());
+  // a list whose key extends the other one stays separate
+  ASSERT_TRUE(engine.push("list2", ListEngine::End::kLeft, {"x"}, &length).ok());
+
+  EXPECT_EQ(std::vector<std::string>({"b", "c", "d"}), range(&engine, "list", 1, 3));
+  EXPECT_EQ(std::vector<std::string>({"d", "e"}), range(&engine, "list", -2, 100));
+  EXPECT_TRUE(range(&engine, "list", 3, 1).empty());
+  EXPECT_TRUE(range(&engine, "missing", 0, -1).empty());
+  EXPECT_EQ(std::vector<std::string>({"x"}), range(&engine, "list2", 0, -1));
+}
+
+TEST_F(ListEngineTest, Trim) {
+  ListEngine engine(databaseManager(), columnFamily(ListEngine::columnFamilyName()));
+  std::vector<std::string> values;
+  for (int i = 0; i < 100; i++) {
+    values.push_back(std::to_string(i));
+  }
+  int64_t length;
+  ASSERT_TRUE(engine.push("list", ListEngine::End::kRight, values, &length).ok());
+
+  // range deletes from the head and point deletes from the tail
+  ASSERT_TRUE(engine.trim("list", 50, -3).ok());
+  EXPECT_EQ(48, this->length(&engine, "list"));
+  EXPECT_EQ(std::vector<std::string>({"50", "51"}), range(&engine, "list", 0, 1));
+  EXPECT_EQ(std::vector<std::string>({"96", "97"}), range(&engine, "list", -2, -1));
+
+  std::string value;
+  ASSERT_TRUE(engine.pop("list", ListEngine::End::kLeft, &value).ok());
+  EXPECT_EQ("50", value);
+  ASSERT_TRUE(engine.push("list", ListEngine::End::kRight, {"new"}, &length).ok());
+  EXPECT_EQ(48, length);
+  EXPECT_EQ(std::vector<std::string>({"97", "new"}), range(&engine, "list", -2, -1));
+
+  ASSERT_TRUE(engine.trim("list", 10, 5).ok());
+  EXPECT_EQ(0, this->length(&engine, "list"));
+  EXPECT_TRUE(range(&engine, "list", 0, -1).empty());
+  EXPECT_TRUE(engine.trim("missing", 0, 1).ok());
+}
+
+}  // namespace infra
@@ -27,6 +27,12 @@ class ScheduledTaskProcessor {
     return -1;
   }
 
+  // Whether the queue runs this processor on due tasks in its background thread. Return false when tasks are instead
+  // pulled by external workers through ScheduledTaskQueue::claim, in which case processPendingTasks is never called.
+  virtual bool autoProcessing() const {
+    return true;
+  }
+
   // Defines the maximum batch size the task processor is able to process
   virtual size_t getMaxBatchSize() const {
     return 10000;
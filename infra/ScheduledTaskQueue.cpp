@@ -5,11 +5,15 @@
 #include <algorithm>
 #include <chrono>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "glog/logging.h"
+#include "infra/Tracing.h"
 #include "rocksdb/iterator.h"
 #include "rocksdb/options.h"
 #include "rocksdb/status.h"
@@ -25,6 +29,11 @@ void ScheduledTaskQueue::start() {
   CHECK_EQ(outstandingTaskCount_, 0);
   outstandingTaskCount_ = accurateOutstandingTaskCountSlow();
 
+  if (!processor_->autoProcessing()) {
+    LOG(INFO) << "ScheduledTaskQueue tasks are claimed by external workers";
+    return;
+  }
+
   executionThread_.reset(new std::thread([this]() {
     while (this->run_) {
       // scan up to the next millisecond
@@ -41,12 +50,14 @@ void ScheduledTaskQueue::start() {
 }
 
 size_t ScheduledTaskQueue::batchProcessing(int64_t maxTimestampMs) {
+  // every batch is a unit sampled for tracing
+  Tracing::RequestGuard guard;
   std::vector<ScheduledTask> tasks;
-  size_t count = scanPendingTasks(maxTimestampMs, scanBatchSize_, &tasks);
+  size_t count = TRACE_CALL("ScheduledTaskQueue#scan", scanPendingTasks(maxTimestampMs, scanBatchSize_, &tasks));
   if (count > 0) {
     DLOG(INFO) << "Found " << count << " pending tasks";
     rocksdb::WriteBatch writeBatch;
-    processor_->processPendingTasks(&tasks, &writeBatch);
+    TRACE_CALL("ScheduledTaskQueue#process", processor_->processPendingTasks(&tasks, &writeBatch));
 
     size_t numCompleted = 0;
     for (const auto& task : tasks) {
@@ -55,7 +66,8 @@ size_t ScheduledTaskQueue::batchProcessing(int64_t maxTimestampMs) {
         writeBatch.Delete(columnFamily_, task.key());
       }
     }
-    rocksdb::Status status = databaseManager_->db()->Write(rocksdb::WriteOptions(), &writeBatch);
+    rocksdb::Status status =
+        TRACE_CALL("ScheduledTaskQueue#commit", databaseManager_->db()->Write(rocksdb::WriteOptions(), &writeBatch));
     CHECK(status.ok()) << "Fail to persist results of scheduled task processing: " << status.ToString();
 
     outstandingTaskCount_ -= numCompleted;
@@ -97,6 +109,101 @@ size_t ScheduledTaskQueue::scanPendingTasks(int64_t maxTimestampMs, size_t limit
   return count;
 }
 
+int ScheduledTaskQueue::claim(int64_t nowMs, int64_t leaseMs, size_t limit, std::vector<ScheduledTask>* tasks) {
+  std::lock_guard<std::mutex> guard(leaseMutex_);
+  std::vector<ScheduledTask> dueTasks;
+  if (scanPendingTasks(nowMs + 1, limit, &dueTasks) == 0) return 0;
+
+  rocksdb::WriteBatch writeBatch;
+  std::vector<ScheduledTask> claimedTasks;
+  // Tasks sharing a data key would collide once rescheduled at the same lease timestamp, so leave the later ones to
+  // the next claim. Other keys of the batch then differ in their data key, and only the database has to be checked.
+  std::unordered_set<std::string> dataKeys;
+  for (const auto& task : dueTasks) {
+    if (!dataKeys.insert(task.dataKey()).second) continue;
+    int64_t leaseTimestampMs = nowMs + leaseMs;
+    rocksdb::Status status = findFreeTimestamp(task.dataKey(), task.key(), &leaseTimestampMs);
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to find a lease for scheduled task: " << status.ToString();
+      return -1;
+    }
+    claimedTasks.emplace_back(leaseTimestampMs, task.dataKey(), task.value());
+    writeBatch.Delete(columnFamily_, task.key());
+    writeBatch.Put(columnFamily_, claimedTasks.back().key(), task.value());
+  }
+
+  rocksdb::Status status = databaseManager_->db()->Write(rocksdb::WriteOptions(), &writeBatch);
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to claim scheduled tasks: " << status.ToString();
+    return -1;
+  }
+
+  for (auto& task : claimedTasks) {
+    tasks->push_back(std::move(task));
+  }
+  return claimedTasks.size();
+}
+
+bool ScheduledTaskQueue::ack(int64_t leaseTimestampMs, const std::string& dataKey) {
+  ScheduledTask task(leaseTimestampMs, dataKey, "");
+  std::lock_guard<std::mutex> guard(leaseMutex_);
+  std::string value;
+  rocksdb::Status status = databaseManager_->db()->Get(rocksdb::ReadOptions(), columnFamily_, task.key(), &value);
+  if (!status.ok()) {
+    LOG_IF(ERROR, !status.IsNotFound()) << "Failed to read claimed task: " << status.ToString();
+    return false;
+  }
+
+  status = databaseManager_->db()->Delete(rocksdb::WriteOptions(), columnFamily_, task.key());
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to acknowledge claimed task: " << status.ToString();
+    return false;
+  }
+  outstandingTaskCount_--;
+  return true;
+}
+
+bool ScheduledTaskQueue::extendLease(int64_t leaseTimestampMs, const std::string& dataKey,
+                                     int64_t* newLeaseTimestampMs) {
+  ScheduledTask task(leaseTimestampMs, dataKey, "");
+  std::lock_guard<std::mutex> guard(leaseMutex_);
+  std::string value;
+  rocksdb::Status status = databaseManager_->db()->Get(rocksdb::ReadOptions(), columnFamily_, task.key(), &value);
+  if (!status.ok()) {
+    LOG_IF(ERROR, !status.IsNotFound()) << "Failed to read claimed task: " << status.ToString();
+    return false;
+  }
+  status = findFreeTimestamp(dataKey, task.key(), newLeaseTimestampMs);
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to find a lease for claimed task: " << status.ToString();
+    return false;
+  }
+  if (*newLeaseTimestampMs == leaseTimestampMs) return true;
+
+  ScheduledTask extendedTask(*newLeaseTimestampMs, dataKey, std::move(value));
+  rocksdb::WriteBatch writeBatch;
+  writeBatch.Delete(columnFamily_, task.key());
+  writeBatch.Put(columnFamily_, extendedTask.key(), extendedTask.value());
+  status = databaseManager_->db()->Write(rocksdb::WriteOptions(), &writeBatch);
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to extend lease of claimed task: " << status.ToString();
+    return false;
+  }
+  return true;
+}
+
+rocksdb::Status ScheduledTaskQueue::findFreeTimestamp(const std::string& dataKey, const std::string& ownKey,
+                                                      int64_t* timestampMs) {
+  std::string value;
+  for (;; (*timestampMs)++) {
+    ScheduledTask task(*timestampMs, dataKey, "");
+    if (task.key() == ownKey) return rocksdb::Status::OK();
+    rocksdb::Status status = databaseManager_->db()->Get(rocksdb::ReadOptions(), columnFamily_, task.key(), &value);
+    if (status.IsNotFound()) return rocksdb::Status::OK();
+    if (!status.ok()) return status;
+  }
+}
+
 constexpr int64_t ScheduledTaskQueue::kCheckIntervalMs;
 constexpr size_t ScheduledTaskQueue::kScanBatchSize;
 
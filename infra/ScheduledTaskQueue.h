@@ -5,6 +5,7 @@
 #include <atomic>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <vector>
@@ -71,6 +72,7 @@ class ScheduledTaskQueue {
   }
 
   void destroy() {
+    if (!processor_->autoProcessing()) return;
     CHECK(executionThread_ != nullptr) << "Execution thread has not been created";
 
     stop();
@@ -160,6 +162,21 @@ class ScheduledTaskQueue {
     }
   }
 
+  // Claim up to limit tasks due by nowMs for leaseMs, which are copied into the given task vector. A claimed task is
+  // rescheduled at the end of its lease, so it becomes due again unless the claimer acknowledges it in time. The lease
+  // timestamp, i.e., the scheduled time of a claimed task, identifies the claim in ack and extendLease. It is pushed
+  // past nowMs + leaseMs when a task with the same data key is already scheduled there.
+  // Return the number of tasks claimed or -1 to indicate an error.
+  int claim(int64_t nowMs, int64_t leaseMs, size_t limit, std::vector<ScheduledTask>* tasks);
+
+  // Remove a claimed task. Return false if the lease is no longer held, e.g., because it expired and the task has been
+  // claimed again.
+  bool ack(int64_t leaseTimestampMs, const std::string& dataKey);
+
+  // Move the end of a lease to *newLeaseTimestampMs, which is pushed back like in claim and updated to the new lease
+  // timestamp. Return false if the lease is no longer held.
+  bool extendLease(int64_t leaseTimestampMs, const std::string& dataKey, int64_t* newLeaseTimestampMs);
+
   // Return the outstanding tasks in the database, which may be larger than the actual value.
   // Use accurateOutstandingTaskCountSlow when more accurate counting is needed.
   size_t outstandingTaskCount() const {
@@ -177,12 +194,18 @@ class ScheduledTaskQueue {
   // Batch size limit for each scan
   static constexpr size_t kScanBatchSize = 10000;
 
+  // Move *timestampMs forward to the first millisecond at which no task with dataKey other than the one stored at
+  // ownKey is scheduled, so that rescheduling there does not overwrite another task. Must hold leaseMutex_.
+  rocksdb::Status findFreeTimestamp(const std::string& dataKey, const std::string& ownKey, int64_t* timestampMs);
+
   std::shared_ptr<ScheduledTaskProcessor> processor_;
   std::shared_ptr<pipeline::DatabaseManager> databaseManager_;
   rocksdb::ColumnFamilyHandle* columnFamily_;
   size_t scanBatchSize_;
   bool run_;
   std::atomic_size_t outstandingTaskCount_;
+  // Serialize claims and lease updates, so that a task is never handed to two claimers at once
+  std::mutex leaseMutex_;
   // Background thread that executes tasks at schedule time.
   // TODO(yunjing): consider a multi-threaded design for higher throughput. The idea is to use one thread to pick up
   // pending tasks and then distribute the tasks to a pool of worker threads
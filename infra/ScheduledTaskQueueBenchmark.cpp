@@ -0,0 +1,288 @@
+// Measure how ScheduledTaskQueue holds up with millions of tasks and heavy insert/delete churn, e.g.,
+//   scheduled_task_queue_benchmark --task_count=10000000 --duration_sec=300 --schedule_threads=4
+// The queue is first loaded with task_count tasks, a share of which are already overdue. Then scheduler threads keep
+// adding tasks while the queue processes due tasks as its execution thread does, deleting each completed task.
+// Every processing scan seeks from the beginning of the queue over the tombstones left by completed tasks until they
+// are compacted away, so the report tracks scan latency percentiles next to the tombstones skipped per scan and those
+// still in memtables.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+#include "folly/Format.h"
+#include "folly/init/Init.h"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "infra/ScheduledTask.h"
+#include "infra/ScheduledTaskProcessor.h"
+#include "infra/ScheduledTaskQueue.h"
+#include "pipeline/DatabaseManager.h"
+#include "rocksdb/db.h"
+#include "rocksdb/options.h"
+#include "rocksdb/perf_context.h"
+#include "rocksdb/perf_level.h"
+#include "rocksdb/status.h"
+#include "rocksdb/write_batch.h"
+
+DEFINE_string(db_path, "", "RocksDB path for the benchmark. A temporary directory is used and removed if empty");
+DEFINE_int64(task_count, 1000000, "Number of tasks loaded before the benchmark starts");
+DEFINE_int32(duration_sec, 60, "Duration of concurrent scheduling and processing");
+DEFINE_int32(report_interval_sec, 10, "Interval of progress reports");
+DEFINE_int32(schedule_threads, 2, "Number of threads scheduling new tasks concurrently");
+DEFINE_int32(schedule_batch_size, 100, "Number of tasks scheduled per write batch");
+DEFINE_int32(schedule_rate, 20000, "Tasks scheduled per second by each thread. 0 schedules as fast as possible");
+DEFINE_int32(value_bytes, 100, "Size of the value of each task");
+// Scheduled times follow a mix of overdue tasks, tasks due soon, and tasks due in the far future
+DEFINE_double(overdue_fraction, 0.1, "Fraction of tasks already due when scheduled");
+DEFINE_double(near_fraction, 0.6, "Fraction of tasks due within near_horizon_sec, exponentially distributed");
+DEFINE_int32(near_horizon_sec, 60, "Mean delay of tasks due soon");
+DEFINE_int32(far_horizon_sec, 7 * 24 * 3600, "Delay up to which other tasks are uniformly distributed");
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+int64_t nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+int64_t elapsedUs(Clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+}
+
+// Complete every task, and note when processing starts to tell scanning apart from processing
+class BenchmarkProcessor : public infra::ScheduledTaskProcessor {
+ public:
+  void processPendingTasks(std::vector<infra::ScheduledTask>* tasks, rocksdb::WriteBatch* writeBatch) override {
+    processStart = Clock::now();
+    for (auto& task : *tasks) {
+      task.markCompleted();
+    }
+  }
+
+  int generateTasks(const std::string& opaqueKey, const std::string& opaqueValue, int64_t kafkaOffset,
+                    std::vector<infra::ScheduledTask>* tasks) override {
+    return 0;
+  }
+
+  Clock::time_point processStart;
+};
+
+class TaskGenerator {
+ public:
+  explicit TaskGenerator(int seed) : random_(seed), value_(FLAGS_value_bytes, 'v') {}
+
+  infra::ScheduledTask next(int64_t nowMs, int64_t id) {
+    double choice = uniform_(random_);
+    int64_t timestampMs;
+    if (choice < FLAGS_overdue_fraction) {
+      timestampMs = nowMs - static_cast<int64_t>(uniform_(random_) * FLAGS_near_horizon_sec * 1000);
+    } else if (choice < FLAGS_overdue_fraction + FLAGS_near_fraction) {
+      std::exponential_distribution<double> delaySec(1.0 / FLAGS_near_horizon_sec);
+      timestampMs = nowMs + static_cast<int64_t>(delaySec(random_) * 1000);
+    } else {
+      timestampMs = nowMs + static_cast<int64_t>(uniform_(random_) * FLAGS_far_horizon_sec * 1000);
+    }
+    return infra::ScheduledTask(timestampMs, folly::sformat("task-{:016x}", id), value_);
+  }
+
+ private:
+  std::mt19937_64 random_;
+  std::uniform_real_distribution<double> uniform_{0.0, 1.0};
+  const std::string value_;
+};
+
+// Latencies and counters collected since the last report
+struct Stats {
+  std::mutex mutex;
+  std::vector<int64_t> scanLatenciesUs;
+  std::vector<int64_t> skippedTombstones;
+  std::atomic<uint64_t> scheduled{0};
+  std::atomic<uint64_t> processed{0};
+};
+
+int64_t percentile(const std::vector<int64_t>& sorted, double p) {
+  if (sorted.empty()) return 0;
+  return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+}
+
+void report(const std::string& name, double elapsedSec, Stats* stats, rocksdb::DB* db,
+            rocksdb::ColumnFamilyHandle* columnFamily) {
+  std::vector<int64_t> latenciesUs;
+  std::vector<int64_t> skippedTombstones;
+  {
+    std::lock_guard<std::mutex> guard(stats->mutex);
+    latenciesUs.swap(stats->scanLatenciesUs);
+    skippedTombstones.swap(stats->skippedTombstones);
+  }
+  std::sort(latenciesUs.begin(), latenciesUs.end());
+  std::sort(skippedTombstones.begin(), skippedTombstones.end());
+
+  uint64_t activeDeletes = 0, immutableDeletes = 0, estimatedKeys = 0;
+  db->GetIntProperty(columnFamily, "rocksdb.num-deletes-active-mem-table", &activeDeletes);
+  db->GetIntProperty(columnFamily, "rocksdb.num-deletes-imm-mem-tables", &immutableDeletes);
+  db->GetIntProperty(columnFamily, rocksdb::DB::Properties::kEstimateNumKeys, &estimatedKeys);
+
+  LOG(INFO) << folly::sformat("{}: scheduled {:.0f} tasks/s, processed {:.0f} tasks/s, {} scans", name,
+                              stats->scheduled.exchange(0) / elapsedSec, stats->processed.exchange(0) / elapsedSec,
+                              latenciesUs.size());
+  LOG(INFO) << folly::sformat("{}: scan latency (us) p50={} p90={} p99={} p999={} max={}", name,
+                              percentile(latenciesUs, 0.5), percentile(latenciesUs, 0.9),
+                              percentile(latenciesUs, 0.99), percentile(latenciesUs, 0.999),
+                              latenciesUs.empty() ? 0 : latenciesUs.back());
+  LOG(INFO) << folly::sformat("{}: tombstones skipped per scan p50={} p99={} max={}, memtable tombstones={}, "
+                              "estimated keys={}", name, percentile(skippedTombstones, 0.5),
+                              percentile(skippedTombstones, 0.99),
+                              skippedTombstones.empty() ? 0 : skippedTombstones.back(),
+                              activeDeletes + immutableDeletes, estimatedKeys);
+}
+
+}  // namespace
+
+DECLARE_bool(logtostderr);
+int main(int argc, char** argv) {
+  FLAGS_logtostderr = true;
+  folly::init(&argc, &argv);
+  CHECK_GE(FLAGS_task_count, 0);
+  CHECK_GT(FLAGS_duration_sec, 0);
+  CHECK_GT(FLAGS_report_interval_sec, 0);
+  CHECK_GT(FLAGS_schedule_batch_size, 0);
+  CHECK_GE(FLAGS_overdue_fraction + FLAGS_near_fraction, 0);
+  CHECK_LE(FLAGS_overdue_fraction + FLAGS_near_fraction, 1);
+
+  bool temporary = FLAGS_db_path.empty();
+  std::string dbPath =
+      temporary ? boost::filesystem::unique_path("/tmp/scheduled_task_queue_benchmark.%%%%%%%%").native()
+                : FLAGS_db_path;
+
+  rocksdb::Options options;
+  options.create_if_missing = true;
+  options.create_missing_column_families = true;
+  options.IncreaseParallelism(std::thread::hardware_concurrency());
+  rocksdb::ColumnFamilyOptions taskOptions(options);
+  infra::ScheduledTaskQueue::optimizeColumnFamily(0, &taskOptions);
+  std::vector<rocksdb::ColumnFamilyDescriptor> descriptors = {
+      {rocksdb::kDefaultColumnFamilyName, rocksdb::ColumnFamilyOptions(options)},
+      {pipeline::DatabaseManager::metadataColumnFamilyName(), rocksdb::ColumnFamilyOptions(options)},
+      {infra::ScheduledTaskQueue::columnFamilyName(), taskOptions},
+  };
+  std::vector<rocksdb::ColumnFamilyHandle*> handles;
+  rocksdb::DB* db = nullptr;
+  rocksdb::Status status = rocksdb::DB::Open(options, dbPath, descriptors, &handles, &db);
+  CHECK(status.ok()) << "Opening RocksDB at " << dbPath << " failed: " << status.ToString();
+
+  pipeline::DatabaseManager::ColumnFamilyMap columnFamilyMap;
+  for (size_t i = 0; i < descriptors.size(); i++) {
+    columnFamilyMap[descriptors[i].name] = handles[i];
+  }
+  rocksdb::ColumnFamilyHandle* taskColumnFamily = columnFamilyMap[infra::ScheduledTaskQueue::columnFamilyName()];
+  auto databaseManager = std::make_shared<pipeline::DatabaseManager>(columnFamilyMap, true, db);
+  auto processor = std::make_shared<BenchmarkProcessor>();
+  infra::ScheduledTaskQueue queue(processor, databaseManager, taskColumnFamily);
+
+  // load the initial tasks
+  std::atomic<int64_t> nextTaskId{0};
+  {
+    TaskGenerator generator(0);
+    auto start = Clock::now();
+    int64_t loadStartMs = nowMs();
+    rocksdb::WriteBatch writeBatch;
+    for (int64_t i = 0; i < FLAGS_task_count; i++) {
+      queue.scheduleWithWriteBatch(generator.next(loadStartMs, nextTaskId++), &writeBatch);
+      if (writeBatch.Count() >= 1000 || i == FLAGS_task_count - 1) {
+        CHECK(db->Write(rocksdb::WriteOptions(), &writeBatch).ok());
+        writeBatch.Clear();
+      }
+    }
+    LOG(INFO) << folly::sformat("load: {} tasks at {:.0f} tasks/s", FLAGS_task_count,
+                                FLAGS_task_count / (elapsedUs(start) / 1e6));
+  }
+
+  Stats stats;
+  std::atomic<bool> run{true};
+
+  std::vector<std::thread> schedulers;
+  for (int t = 0; t < FLAGS_schedule_threads; t++) {
+    schedulers.emplace_back([&, t]() {
+      TaskGenerator generator(t + 1);
+      auto start = Clock::now();
+      int64_t count = 0;
+      while (run) {
+        rocksdb::WriteBatch writeBatch;
+        int64_t batchNowMs = nowMs();
+        for (int i = 0; i < FLAGS_schedule_batch_size; i++) {
+          queue.scheduleWithWriteBatch(generator.next(batchNowMs, nextTaskId++), &writeBatch);
+        }
+        CHECK(db->Write(rocksdb::WriteOptions(), &writeBatch).ok());
+        count += FLAGS_schedule_batch_size;
+        stats.scheduled += FLAGS_schedule_batch_size;
+
+        if (FLAGS_schedule_rate > 0) {
+          // pace the thread to the target rate
+          auto due = start + std::chrono::microseconds(count * 1000000 / FLAGS_schedule_rate);
+          std::this_thread::sleep_until(due);
+        }
+      }
+    });
+  }
+
+  // process due tasks the way the execution thread of the queue does, timing each scan
+  std::thread processing([&]() {
+    rocksdb::SetPerfLevel(rocksdb::PerfLevel::kEnableCount);
+    while (run) {
+      int64_t maxTimestampMs = nowMs() + 1;
+      size_t count;
+      do {
+        rocksdb::get_perf_context()->Reset();
+        auto start = Clock::now();
+        processor->processStart = Clock::time_point();
+        count = queue.batchProcessing(maxTimestampMs);
+        // without due tasks, the scan is all there is
+        int64_t scanUs = count > 0
+                             ? std::chrono::duration_cast<std::chrono::microseconds>(processor->processStart - start)
+                                   .count()
+                             : elapsedUs(start);
+        stats.processed += count;
+        std::lock_guard<std::mutex> guard(stats.mutex);
+        stats.scanLatenciesUs.push_back(scanUs);
+        stats.skippedTombstones.push_back(rocksdb::get_perf_context()->internal_delete_skipped_count);
+      } while (run && count > 0);
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  });
+
+  auto begin = Clock::now();
+  auto end = begin + std::chrono::seconds(FLAGS_duration_sec);
+  auto lastReport = begin;
+  while (lastReport < end) {
+    std::this_thread::sleep_until(std::min(lastReport + std::chrono::seconds(FLAGS_report_interval_sec), end));
+    report(folly::sformat("t={}s", elapsedUs(begin) / 1000000), elapsedUs(lastReport) / 1e6, &stats, db,
+           taskColumnFamily);
+    lastReport = Clock::now();
+  }
+
+  run = false;
+  for (auto& scheduler : schedulers) {
+    scheduler.join();
+  }
+  processing.join();
+  LOG(INFO) << folly::sformat("done: {} tasks outstanding", queue.accurateOutstandingTaskCountSlow());
+
+  for (auto handle : handles) {
+    db->DestroyColumnFamilyHandle(handle);
+  }
+  delete db;
+  if (temporary) {
+    boost::filesystem::remove_all(dbPath);
+  }
+  return 0;
+}
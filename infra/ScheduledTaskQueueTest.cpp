@@ -180,4 +180,96 @@ TEST_F(ScheduledTaskQueueTest, BatchProcessing) {
   EXPECT_EQ(0, queue.outstandingTaskCount());
 }
 
+TEST_F(ScheduledTaskQueueTest, ClaimAndAck) {
+  ScheduledTaskQueue queue(std::make_unique<TestScheduledTaskProcessor>(), databaseManager(),
+                           columnFamily("scheduled-tasks"));
+  queue.schedule({ 1000, "job1", "payload1" });
+  queue.schedule({ 2000, "job2", "payload2" });
+  queue.schedule({ 3000, "job3", "payload3" });
+
+  // only due tasks are claimed, up to the limit
+  std::vector<ScheduledTask> tasks;
+  EXPECT_EQ(1, queue.claim(2500, 100, 1, &tasks));
+  ASSERT_EQ(1, tasks.size());
+  EXPECT_EQ(ScheduledTask(2600, "job1", "payload1"), tasks[0]);
+  tasks.clear();
+  EXPECT_EQ(1, queue.claim(2500, 100, 10, &tasks));
+  ASSERT_EQ(1, tasks.size());
+  EXPECT_EQ(ScheduledTask(2600, "job2", "payload2"), tasks[0]);
+
+  // claimed tasks are invisible until their leases expire
+  tasks.clear();
+  EXPECT_EQ(0, queue.claim(2599, 100, 10, &tasks));
+  EXPECT_TRUE(tasks.empty());
+
+  EXPECT_TRUE(queue.ack(2600, "job1"));
+  EXPECT_FALSE(queue.ack(2600, "job1"));
+  EXPECT_EQ(2, queue.outstandingTaskCount());
+
+  // job2 is claimed again after its lease expired, so the stale lease is gone
+  EXPECT_EQ(1, queue.claim(2600, 100, 10, &tasks));
+  EXPECT_EQ(ScheduledTask(2700, "job2", "payload2"), tasks[0]);
+  EXPECT_FALSE(queue.ack(2600, "job2"));
+  EXPECT_TRUE(queue.ack(2700, "job2"));
+  EXPECT_EQ(1, queue.accurateOutstandingTaskCountSlow());
+}
+
+TEST_F(ScheduledTaskQueueTest, ExtendLease) {
+  ScheduledTaskQueue queue(std::make_unique<TestScheduledTaskProcessor>(), databaseManager(),
+                           columnFamily("scheduled-tasks"));
+  queue.schedule({ 1000, "job1", "payload1" });
+
+  std::vector<ScheduledTask> tasks;
+  EXPECT_EQ(1, queue.claim(1000, 100, 10, &tasks));
+  int64_t leaseTimestampMs = 5000;
+  EXPECT_TRUE(queue.extendLease(1100, "job1", &leaseTimestampMs));
+  EXPECT_EQ(5000, leaseTimestampMs);
+  leaseTimestampMs = 6000;
+  EXPECT_FALSE(queue.extendLease(1100, "job1", &leaseTimestampMs));
+
+  // the task is not due at the original lease timestamp anymore
+  tasks.clear();
+  EXPECT_EQ(0, queue.claim(4999, 100, 10, &tasks));
+  EXPECT_EQ(1, queue.claim(5000, 100, 10, &tasks));
+  EXPECT_EQ(ScheduledTask(5100, "job1", "payload1"), tasks[0]);
+}
+
+TEST_F(ScheduledTaskQueueTest, LeaseCollisions) {
+  ScheduledTaskQueue queue(std::make_unique<TestScheduledTaskProcessor>(), databaseManager(),
+                           columnFamily("scheduled-tasks"));
+  queue.schedule({ 1000, "job1", "payload1" });
+  queue.schedule({ 1100, "job1", "payload2" });
+  queue.schedule({ 1101, "job1", "payload3" });
+
+  // the lease moves past the tasks already scheduled at its timestamp instead of overwriting them
+  std::vector<ScheduledTask> tasks;
+  EXPECT_EQ(1, queue.claim(1000, 100, 10, &tasks));
+  EXPECT_EQ(ScheduledTask(1102, "job1", "payload1"), tasks[0]);
+  EXPECT_EQ(3, queue.accurateOutstandingTaskCountSlow());
+
+  // so do extended leases
+  int64_t leaseTimestampMs = 1100;
+  EXPECT_TRUE(queue.extendLease(1102, "job1", &leaseTimestampMs));
+  EXPECT_EQ(1102, leaseTimestampMs);
+  leaseTimestampMs = 1101;
+  EXPECT_TRUE(queue.extendLease(1102, "job1", &leaseTimestampMs));
+  EXPECT_EQ(1102, leaseTimestampMs);
+  leaseTimestampMs = 2000;
+  EXPECT_TRUE(queue.extendLease(1102, "job1", &leaseTimestampMs));
+  EXPECT_EQ(2000, leaseTimestampMs);
+
+  // claims in the same millisecond hand out distinct leases
+  tasks.clear();
+  EXPECT_EQ(1, queue.claim(1101, 100, 10, &tasks));
+  EXPECT_EQ(ScheduledTask(1201, "job1", "payload2"), tasks[0]);
+  EXPECT_EQ(1, queue.claim(1101, 100, 10, &tasks));
+  EXPECT_EQ(ScheduledTask(1202, "job1", "payload3"), tasks[1]);
+  EXPECT_EQ(3, queue.accurateOutstandingTaskCountSlow());
+  EXPECT_EQ(3, queue.outstandingTaskCount());
+  EXPECT_TRUE(queue.ack(1201, "job1"));
+  EXPECT_TRUE(queue.ack(1202, "job1"));
+  EXPECT_TRUE(queue.ack(2000, "job1"));
+  EXPECT_EQ(0, queue.accurateOutstandingTaskCountSlow());
+}
+
 }  // namespace infra
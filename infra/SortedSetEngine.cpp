@@ -0,0 +1,327 @@
+#include "infra/SortedSetEngine.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "glog/logging.h"
+#include "infra/KeyEncoding.h"
+#include "rocksdb/cache.h"
+#include "rocksdb/compaction_filter.h"
+#include "rocksdb/db.h"
+#include "rocksdb/env.h"
+#include "rocksdb/filter_policy.h"
+#include "rocksdb/iterator.h"
+#include "rocksdb/merge_operator.h"
+#include "rocksdb/options.h"
+#include "rocksdb/slice.h"
+#include "rocksdb/status.h"
+#include "rocksdb/table.h"
+#include "rocksdb/write_batch.h"
+
+namespace infra {
+
+namespace {
+
+constexpr size_t kEncodedSize = sizeof(uint64_t);
+constexpr uint64_t kSignBit = 1ULL << 63;
+
+// Tags following the set prefix, in the order the keys of a set sort
+constexpr char kCountTag = '\x00';
+constexpr char kMemberTag = '\x01';
+constexpr char kScoreTag = '\x02';
+
+// The prefix starts with a length of at most 2^32 - 2, so it always has a successor
+std::string encodeTaggedPrefix(const std::string& key, char tag) {
+  std::string prefix;
+  prefix.reserve(kKeyLengthSize + key.size() + 1 + kEncodedSize);
+  appendLengthPrefixed(key, &prefix);
+  prefix.push_back(tag);
+  return prefix;
+}
+
+// Adds up counters written by SortedSetEngine::encodeCount, where a missing counter is 0
+class CountMergeOperator : public rocksdb::AssociativeMergeOperator {
+ public:
+  bool Merge(const rocksdb::Slice& key, const rocksdb::Slice* existingValue, const rocksdb::Slice& value,
+             std::string* newValue, rocksdb::Logger* logger) const override {
+    if (value.size() != kEncodedSize || (existingValue && existingValue->size() != kEncodedSize)) {
+      rocksdb::Error(logger, "Sorted set count is not %zu bytes long", kEncodedSize);
+      return false;
+    }
+    uint64_t count = existingValue ? readBigEndian(existingValue->data(), kEncodedSize) : 0;
+    count += readBigEndian(value.data(), kEncodedSize);
+    newValue->clear();
+    appendBigEndian(count, kEncodedSize, newValue);
+    return true;
+  }
+
+  const char* Name() const override { return "infra.SortedSetEngine.CountMergeOperator"; }
+};
+
+class ZeroCountFilter : public rocksdb::CompactionFilter {
+ public:
+  bool Filter(int level, const rocksdb::Slice& key, const rocksdb::Slice& existingValue, std::string* newValue,
+              bool* valueChanged) const override {
+    if (key.size() < kKeyLengthSize + 1 || key[key.size() - 1] != kCountTag) return false;
+    if (key.size() != kKeyLengthSize + readBigEndian(key.data(), kKeyLengthSize) + 1) return false;
+    return existingValue.size() == kEncodedSize && readBigEndian(existingValue.data(), kEncodedSize) == 0;
+  }
+
+  const char* Name() const override { return "infra.SortedSetEngine.ZeroCountFilter"; }
+};
+
+}  // namespace
+
+void SortedSetEngine::optimizeColumnFamily(int defaultBlockCacheSizeMb, rocksdb::ColumnFamilyOptions* options) {
+  rocksdb::BlockBasedTableOptions blockBasedOptions;
+  blockBasedOptions.block_cache = rocksdb::NewLRUCache(static_cast<size_t>(defaultBlockCacheSizeMb * 1024 * 1024));
+  // use bloom filter to reduce disk I/O when looking up members and counts
+  blockBasedOptions.filter_policy.reset(rocksdb::NewBloomFilterPolicy(10));
+  options->table_factory.reset(rocksdb::NewBlockBasedTableFactory(blockBasedOptions));
+  options->merge_operator.reset(newCountMergeOperator());
+  options->compaction_filter = getZeroCountFilter();
+}
+
+const rocksdb::MergeOperator* SortedSetEngine::newCountMergeOperator() {
+  return new CountMergeOperator();
+}
+
+const rocksdb::CompactionFilter* SortedSetEngine::getZeroCountFilter() {
+  // column family options only keep a raw pointer to the filter
+  static const rocksdb::CompactionFilter* filter = new ZeroCountFilter();
+  return filter;
+}
+
+std::string SortedSetEngine::encodeCountKey(const std::string& key) {
+  return encodeTaggedPrefix(key, kCountTag);
+}
+
+std::string SortedSetEngine::encodeMemberKey(const std::string& key, const std::string& member) {
+  std::string memberKey = encodeTaggedPrefix(key, kMemberTag);
+  memberKey.append(member);
+  return memberKey;
+}
+
+std::string SortedSetEngine::encodeScoreKey(const std::string& key, double score, const std::string& member) {
+  std::string scoreKey = encodeTaggedPrefix(key, kScoreTag);
+  scoreKey.append(encodeScore(score));
+  scoreKey.append(member);
+  return scoreKey;
+}
+
+std::string SortedSetEngine::encodeScore(double score) {
+  DCHECK(score == score) << "NaN is not a valid score";
+  if (score == 0) score = 0.0;
+  uint64_t bits;
+  std::memcpy(&bits, &score, sizeof(bits));
+  // negative numbers sort in reverse order of their bits, and before all positive ones
+  bits = (bits & kSignBit) ? ~bits : bits | kSignBit;
+  std::string encoded;
+  encoded.reserve(kEncodedSize);
+  appendBigEndian(bits, kEncodedSize, &encoded);
+  return encoded;
+}
+
+double SortedSetEngine::decodeScore(const char* data) {
+  uint64_t bits = readBigEndian(data, kEncodedSize);
+  bits = (bits & kSignBit) ? bits & ~kSignBit : ~bits;
+  double score;
+  std::memcpy(&score, &bits, sizeof(score));
+  return score;
+}
+
+std::string SortedSetEngine::encodeCount(int64_t count) {
+  std::string encoded;
+  encoded.reserve(kEncodedSize);
+  appendBigEndian(static_cast<uint64_t>(count), kEncodedSize, &encoded);
+  return encoded;
+}
+
+rocksdb::Status SortedSetEngine::add(const std::string& key, const MemberScores& memberScores, int64_t* added) {
+  std::vector<std::string> members;
+  std::unordered_map<std::string, double> newScores;
+  for (const auto& memberScore : memberScores) {
+    if (newScores.count(memberScore.first) == 0) members.push_back(memberScore.first);
+    newScores[memberScore.first] = memberScore.second;
+  }
+
+  std::lock_guard<std::mutex> guard(locks_.get(key));
+  std::vector<double> oldScores;
+  std::vector<rocksdb::Status> statuses = getScores(key, members, &oldScores);
+
+  rocksdb::WriteBatch writeBatch;
+  int64_t addedCount = 0;
+  for (size_t i = 0; i < members.size(); i++) {
+    double score = newScores[members[i]];
+    if (statuses[i].ok()) {
+      if (oldScores[i] == score) continue;
+      writeBatch.Delete(columnFamily_, encodeScoreKey(key, oldScores[i], members[i]));
+    } else if (statuses[i].IsNotFound()) {
+      addedCount++;
+    } else {
+      return statuses[i];
+    }
+    writeBatch.Put(columnFamily_, encodeMemberKey(key, members[i]), encodeScore(score));
+    writeBatch.Put(columnFamily_, encodeScoreKey(key, score, members[i]), rocksdb::Slice());
+  }
+  if (addedCount > 0) writeBatch.Merge(columnFamily_, encodeCountKey(key), encodeCount(addedCount));
+
+  rocksdb::Status status;
+  if (writeBatch.Count() > 0) status = databaseManager_->db()->Write(rocksdb::WriteOptions(), &writeBatch);
+  if (status.ok()) *added = addedCount;
+  return status;
+}
+
+rocksdb::Status SortedSetEngine::remove(const std::string& key, const std::vector<std::string>& members,
+                                        int64_t* removed) {
+  std::unordered_set<std::string> seen;
+  std::vector<std::string> uniqueMembers;
+  for (const auto& member : members) {
+    if (seen.insert(member).second) uniqueMembers.push_back(member);
+  }
+
+  std::lock_guard<std::mutex> guard(locks_.get(key));
+  std::vector<double> scores;
+  std::vector<rocksdb::Status> statuses = getScores(key, uniqueMembers, &scores);
+
+  rocksdb::WriteBatch writeBatch;
+  int64_t removedCount = 0;
+  for (size_t i = 0; i < uniqueMembers.size(); i++) {
+    if (statuses[i].IsNotFound()) continue;
+    if (!statuses[i].ok()) return statuses[i];
+    writeBatch.Delete(columnFamily_, encodeMemberKey(key, uniqueMembers[i]));
+    writeBatch.Delete(columnFamily_, encodeScoreKey(key, scores[i], uniqueMembers[i]));
+    removedCount++;
+  }
+  if (removedCount == 0) {
+    *removed = 0;
+    return rocksdb::Status::OK();
+  }
+  writeBatch.Merge(columnFamily_, encodeCountKey(key), encodeCount(-removedCount));
+  rocksdb::Status status = databaseManager_->db()->Write(rocksdb::WriteOptions(), &writeBatch);
+  if (status.ok()) *removed = removedCount;
+  return status;
+}
+
+rocksdb::Status SortedSetEngine::cardinality(const std::string& key, int64_t* cardinality) {
+  std::string value;
+  rocksdb::Status status = databaseManager_->db()->Get(rocksdb::ReadOptions(), columnFamily_, encodeCountKey(key),
+                                                       &value);
+  if (status.IsNotFound()) {
+    *cardinality = 0;
+    return rocksdb::Status::OK();
+  }
+  if (!status.ok()) return status;
+  if (value.size() != kEncodedSize) return rocksdb::Status::Corruption("Sorted set count is not 8 bytes long");
+  *cardinality = static_cast<int64_t>(readBigEndian(value.data(), kEncodedSize));
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status SortedSetEngine::rangeByScore(const std::string& key, ScoreBound min, ScoreBound max, int64_t offset,
+                                              int64_t count, MemberScores* memberScores) {
+  if (min.score > max.score || count == 0) return rocksdb::Status::OK();
+
+  const std::string scorePrefix = encodeTaggedPrefix(key, kScoreTag);
+  std::string lowerBound = scorePrefix + encodeScore(min.score);
+  if (min.exclusive) lowerBound = prefixSuccessor(lowerBound);
+  std::string upperBound = scorePrefix + encodeScore(max.score);
+  if (!max.exclusive) upperBound = prefixSuccessor(upperBound);
+
+  rocksdb::Slice upperBoundSlice(upperBound);
+  rocksdb::ReadOptions readOptions;
+  readOptions.iterate_upper_bound = &upperBoundSlice;
+  std::unique_ptr<rocksdb::Iterator> it(databaseManager_->db()->NewIterator(readOptions, columnFamily_));
+  for (it->Seek(lowerBound); it->Valid() && count != 0; it->Next()) {
+    if (offset > 0) {
+      offset--;
+      continue;
+    }
+    rocksdb::Slice scoreKey = it->key();
+    if (scoreKey.size() < scorePrefix.size() + kEncodedSize) {
+      return rocksdb::Status::Corruption("Sorted set score key is too short");
+    }
+    scoreKey.remove_prefix(scorePrefix.size());
+    double score = decodeScore(scoreKey.data());
+    scoreKey.remove_prefix(kEncodedSize);
+    memberScores->emplace_back(scoreKey.ToString(), score);
+    if (count > 0) count--;
+  }
+  return it->status();
+}
+
+rocksdb::Status SortedSetEngine::rank(const std::string& key, const std::string& member, int64_t* rank) {
+  std::string value;
+  rocksdb::Status status = databaseManager_->db()->Get(rocksdb::ReadOptions(), columnFamily_,
+                                                       encodeMemberKey(key, member), &value);
+  if (!status.ok()) return status;
+  if (value.size() != kEncodedSize) return rocksdb::Status::Corruption("Sorted set score is not 8 bytes long");
+
+  const std::string scoreKey = encodeScoreKey(key, decodeScore(value.data()), member);
+  rocksdb::Slice upperBoundSlice(scoreKey);
+  rocksdb::ReadOptions readOptions;
+  readOptions.iterate_upper_bound = &upperBoundSlice;
+  std::unique_ptr<rocksdb::Iterator> it(databaseManager_->db()->NewIterator(readOptions, columnFamily_));
+  int64_t count = 0;
+  for (it->Seek(encodeTaggedPrefix(key, kScoreTag)); it->Valid(); it->Next()) {
+    if (++count > kMaxExactRank) {
+      status = estimateRank(key, scoreKey, rank);
+      if (status.ok()) *rank = std::max(*rank, kMaxExactRank);
+      return status;
+    }
+  }
+  if (it->status().ok()) *rank = count;
+  return it->status();
+}
+
+std::vector<rocksdb::Status> SortedSetEngine::getScores(const std::string& key, const std::vector<std::string>& members,
+                                                        std::vector<double>* scores) {
+  std::vector<std::string> memberKeys;
+  memberKeys.reserve(members.size());
+  for (const auto& member : members) {
+    memberKeys.push_back(encodeMemberKey(key, member));
+  }
+  std::vector<rocksdb::Slice> keySlices(memberKeys.begin(), memberKeys.end());
+  std::vector<rocksdb::ColumnFamilyHandle*> columnFamilies(members.size(), columnFamily_);
+  std::vector<std::string> values;
+  std::vector<rocksdb::Status> statuses =
+      databaseManager_->db()->MultiGet(rocksdb::ReadOptions(), columnFamilies, keySlices, &values);
+
+  scores->assign(members.size(), 0);
+  for (size_t i = 0; i < statuses.size(); i++) {
+    if (!statuses[i].ok()) continue;
+    if (values[i].size() != kEncodedSize) {
+      statuses[i] = rocksdb::Status::Corruption("Sorted set score is not 8 bytes long");
+      continue;
+    }
+    (*scores)[i] = decodeScore(values[i].data());
+  }
+  return statuses;
+}
+
+rocksdb::Status SortedSetEngine::estimateRank(const std::string& key, const std::string& scoreKey, int64_t* rank) {
+  int64_t total;
+  rocksdb::Status status = cardinality(key, &total);
+  if (!status.ok()) return status;
+
+  const std::string scorePrefix = encodeTaggedPrefix(key, kScoreTag);
+  const std::string scoreEnd = prefixSuccessor(scorePrefix);
+  rocksdb::Range ranges[] = {
+      rocksdb::Range(scorePrefix, scoreKey),
+      rocksdb::Range(scorePrefix, scoreEnd),
+  };
+  uint64_t sizes[2];
+  databaseManager_->db()->GetApproximateSizes(columnFamily_, ranges, 2, sizes,
+                                              rocksdb::DB::INCLUDE_FILES | rocksdb::DB::INCLUDE_MEMTABLES);
+  *rank = sizes[1] == 0 ? 0 : static_cast<int64_t>(static_cast<double>(total) * sizes[0] / sizes[1]);
+  return rocksdb::Status::OK();
+}
+
+constexpr int64_t SortedSetEngine::kMaxExactRank;
+}  // namespace infra
@@ -0,0 +1,102 @@
+#ifndef INFRA_SORTEDSETENGINE_H_
+#define INFRA_SORTEDSETENGINE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "infra/StripedLocks.h"
+#include "pipeline/DatabaseManager.h"
+#include "rocksdb/compaction_filter.h"
+#include "rocksdb/db.h"
+#include "rocksdb/merge_operator.h"
+#include "rocksdb/options.h"
+#include "rocksdb/status.h"
+
+namespace infra {
+
+// A RocksDB-backed sorted set engine for leaderboards and time ordered indexes. Every member of a set is stored twice:
+// a member key holding its score for lookups by member, and a key made of the score and the member, encoded so that
+// byte order is score order, for ranges by score. Both are updated in the same write batch. The cardinality of a set is
+// a counter updated with merges, so adding or removing members never reads it.
+//
+// Writes to the same set are serialized in the engine, since they read the previous score of each member.
+class SortedSetEngine {
+ public:
+  using MemberScores = std::vector<std::pair<std::string, double>>;
+
+  // One end of a score range, which excludes the score itself if exclusive is set
+  struct ScoreBound {
+    double score;
+    bool exclusive;
+  };
+
+  // Name for the column family storing sorted sets. Use static method instead of a variable to ensure initialization
+  // ordering when referenced in a global variable context.
+  static const std::string& columnFamilyName() {
+    static std::string name = "sorted-sets";
+    return name;
+  }
+
+  // Optimize the RocksDB column family used for sorted sets, which also sets the merge operator for cardinality
+  // counters and is required for the engine to work
+  static void optimizeColumnFamily(int defaultBlockCacheSizeMb, rocksdb::ColumnFamilyOptions* options);
+
+  // Merge operator adding up the 8 byte counters written by encodeCount
+  static const rocksdb::MergeOperator* newCountMergeOperator();
+  // Compaction filter dropping counters which went back to 0, since a missing counter reads as 0
+  static const rocksdb::CompactionFilter* getZeroCountFilter();
+
+  // Keys of a set start with the length-prefixed set key, see KeyEncoding.h, then a tag telling the cardinality,
+  // member and score keys apart
+  static std::string encodeCountKey(const std::string& key);
+  static std::string encodeMemberKey(const std::string& key, const std::string& member);
+  static std::string encodeScoreKey(const std::string& key, double score, const std::string& member);
+  // Scores as 8 bytes whose byte order is numeric order, where -0.0 is the same as 0.0. NaN is not a valid score.
+  static std::string encodeScore(double score);
+  static double decodeScore(const char* data);
+  static std::string encodeCount(int64_t count);
+
+  SortedSetEngine(std::shared_ptr<pipeline::DatabaseManager> databaseManager,
+                  rocksdb::ColumnFamilyHandle* columnFamily)
+      : databaseManager_(databaseManager), columnFamily_(columnFamily) {}
+
+  // Add members or update their scores in one write, where later scores win for repeated members. The number of
+  // members which were not in the set before is set in added.
+  rocksdb::Status add(const std::string& key, const MemberScores& memberScores, int64_t* added);
+
+  // Remove members, setting the number of members which were in the set in removed
+  rocksdb::Status remove(const std::string& key, const std::vector<std::string>& members, int64_t* removed);
+
+  // Number of members in a set, which is 0 for sets that do not exist
+  rocksdb::Status cardinality(const std::string& key, int64_t* cardinality);
+
+  // Members with scores between min and max in score order, then member order for equal scores. Skip offset members
+  // and return at most count of them, or all of them if count is negative, like ZRANGEBYSCORE with LIMIT.
+  rocksdb::Status rangeByScore(const std::string& key, ScoreBound min, ScoreBound max, int64_t offset, int64_t count,
+                               MemberScores* memberScores);
+
+  // Rank of a member counting from 0 in score order. Ranks up to kMaxExactRank are counted exactly, while larger ones
+  // are estimated from the size on disk of the keys before the member. Return NotFound if the member is not in the set.
+  rocksdb::Status rank(const std::string& key, const std::string& member, int64_t* rank);
+
+  // Ranks above this are estimated instead of scanned
+  static constexpr int64_t kMaxExactRank = 10000;
+
+ private:
+  // Look up the current scores of the given members, with NotFound for members not in the set
+  std::vector<rocksdb::Status> getScores(const std::string& key, const std::vector<std::string>& members,
+                                         std::vector<double>* scores);
+  // Estimate the rank of scoreKey from the size of the score keys before it, relative to the whole set
+  rocksdb::Status estimateRank(const std::string& key, const std::string& scoreKey, int64_t* rank);
+
+  std::shared_ptr<pipeline::DatabaseManager> databaseManager_;
+  rocksdb::ColumnFamilyHandle* columnFamily_;
+  StripedLocks locks_;
+};
+
+}  // namespace infra
+
+#endif  // INFRA_SORTEDSETENGINE_H_
@@ -0,0 +1,114 @@
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "infra/SortedSetEngine.h"
+#include "rocksdb/db.h"
+#include "rocksdb/options.h"
+#include "rocksdb/status.h"
+#include "stesting/TestWithRocksDb.h"
+
+namespace infra {
+
+class SortedSetEngineTest : public stesting::TestWithRocksDb {
+ protected:
+  using ScoreBound = SortedSetEngine::ScoreBound;
+
+  SortedSetEngineTest()
+      : stesting::TestWithRocksDb(
+            { SortedSetEngine::columnFamilyName() },
+            { { SortedSetEngine::columnFamilyName(), &SortedSetEngine::optimizeColumnFamily } }) {}
+
+  SortedSetEngine::MemberScores range(SortedSetEngine* engine, const std::string& key, ScoreBound min, ScoreBound max,
+                                      int64_t offset = 0, int64_t count = -1) {
+    SortedSetEngine::MemberScores memberScores;
+    EXPECT_TRUE(engine->rangeByScore(key, min, max, offset, count, &memberScores).ok());
+    return memberScores;
+  }
+
+  int64_t cardinality(SortedSetEngine* engine, const std::string& key) {
+    int64_t cardinality = -1;
+    EXPECT_TRUE(engine->cardinality(key, &cardinality).ok());
+    return cardinality;
+  }
+
+  static constexpr double kInf = std::numeric_limits<double>::infinity();
+};
+
+TEST_F(SortedSetEngineTest, EncodeScore) {
+  const std::vector<double> scores = { -kInf, -1e300, -2.5, -1, -1e-300, 0, 1e-300, 1, 2.5, 1e300, kInf };
+  for (size_t i = 0; i < scores.size(); i++) {
+    EXPECT_EQ(scores[i], SortedSetEngine::decodeScore(SortedSetEngine::encodeScore(scores[i]).data()));
+    if (i > 0) EXPECT_LT(SortedSetEngine::encodeScore(scores[i - 1]), SortedSetEngine::encodeScore(scores[i]));
+  }
+  EXPECT_EQ(SortedSetEngine::encodeScore(0.0), SortedSetEngine::encodeScore(-0.0));
+  // score keys sort by score before member
+  EXPECT_LT(SortedSetEngine::encodeScoreKey("set", 1, "z"), SortedSetEngine::encodeScoreKey("set", 2, "a"));
+}
+
+TEST_F(SortedSetEngineTest, AddAndRemove) {
+  SortedSetEngine engine(databaseManager(), columnFamily(SortedSetEngine::columnFamilyName()));
+  int64_t added;
+  ASSERT_TRUE(engine.add("set", {{"a", 1}, {"b", 2}}, &added).ok());
+  EXPECT_EQ(2, added);
+  // updating a score replaces its score key, and repeated members count once with the last score
+  ASSERT_TRUE(engine.add("set", {{"a", 3}, {"c", 0}, {"c", 4}}, &added).ok());
+  EXPECT_EQ(1, added);
+  EXPECT_EQ(3, cardinality(&engine, "set"));
+  EXPECT_EQ(SortedSetEngine::MemberScores({{"b", 2}, {"a", 3}, {"c", 4}}),
+            range(&engine, "set", {-kInf, false}, {kInf, false}));
+
+  int64_t removed;
+  ASSERT_TRUE(engine.remove("set", {"a", "a", "missing"}, &removed).ok());
+  EXPECT_EQ(1, removed);
+  EXPECT_EQ(2, cardinality(&engine, "set"));
+  ASSERT_TRUE(engine.remove("set", {"b", "c"}, &removed).ok());
+  EXPECT_EQ(2, removed);
+  EXPECT_EQ(0, cardinality(&engine, "set"));
+  EXPECT_EQ(0, cardinality(&engine, "missing"));
+
+  // the counter going back to 0 is dropped once compaction sees it as a plain value
+  rocksdb::ColumnFamilyHandle* handle = columnFamily(SortedSetEngine::columnFamilyName());
+  ASSERT_TRUE(db()->CompactRange(rocksdb::CompactRangeOptions(), handle, nullptr, nullptr).ok());
+  ASSERT_TRUE(db()->CompactRange(rocksdb::CompactRangeOptions(), handle, nullptr, nullptr).ok());
+  EXPECT_EQ(0, totalKeyCount(handle));
+}
+
+TEST_F(SortedSetEngineTest, RangeByScore) {
+  SortedSetEngine engine(databaseManager(), columnFamily(SortedSetEngine::columnFamilyName()));
+  int64_t added;
+  ASSERT_TRUE(engine.add("set", {{"a", -1}, {"b", 1}, {"c", 1}, {"d", 2}, {"e", 3}}, &added).ok());
+  // sets whose key extends the other one stay separate
+  ASSERT_TRUE(engine.add("set2", {{"x", 1}}, &added).ok());
+
+  EXPECT_EQ(SortedSetEngine::MemberScores({{"b", 1}, {"c", 1}, {"d", 2}}),
+            range(&engine, "set", {1, false}, {2, false}));
+  EXPECT_EQ(SortedSetEngine::MemberScores({{"d", 2}}), range(&engine, "set", {1, true}, {3, true}));
+  EXPECT_EQ(SortedSetEngine::MemberScores({{"a", -1}}), range(&engine, "set", {-kInf, false}, {1, true}));
+  EXPECT_EQ(SortedSetEngine::MemberScores({{"c", 1}, {"d", 2}}),
+            range(&engine, "set", {-kInf, false}, {kInf, false}, 2, 2));
+  EXPECT_TRUE(range(&engine, "set", {3, false}, {1, false}).empty());
+  EXPECT_TRUE(range(&engine, "set", {2, true}, {2, false}).empty());
+  EXPECT_TRUE(range(&engine, "missing", {-kInf, false}, {kInf, false}).empty());
+  EXPECT_EQ(SortedSetEngine::MemberScores({{"x", 1}}), range(&engine, "set2", {-kInf, false}, {kInf, false}));
+}
+
+TEST_F(SortedSetEngineTest, Rank) {
+  SortedSetEngine engine(databaseManager(), columnFamily(SortedSetEngine::columnFamilyName()));
+  int64_t added;
+  ASSERT_TRUE(engine.add("set", {{"c", 3}, {"a", 1}, {"b", 1}}, &added).ok());
+
+  int64_t rank;
+  ASSERT_TRUE(engine.rank("set", "a", &rank).ok());
+  EXPECT_EQ(0, rank);
+  ASSERT_TRUE(engine.rank("set", "b", &rank).ok());
+  EXPECT_EQ(1, rank);
+  ASSERT_TRUE(engine.rank("set", "c", &rank).ok());
+  EXPECT_EQ(2, rank);
+  EXPECT_TRUE(engine.rank("set", "missing", &rank).IsNotFound());
+}
+
+constexpr double SortedSetEngineTest::kInf;
+
+}  // namespace infra
@@ -0,0 +1,102 @@
+#ifndef INFRA_STRIPEDLOCKS_H_
+#define INFRA_STRIPEDLOCKS_H_
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "glog/logging.h"
+
+namespace infra {
+
+// A fixed number of mutexes shared by keys with the same hash, which serializes work per key without a mutex for every
+// key. Unrelated keys may share a stripe, which only costs concurrency.
+class StripedLocks {
+ public:
+  // Holds the stripes of a set of keys until it is destroyed
+  class Guard {
+   public:
+    Guard() : locks_(nullptr) {}
+    Guard(Guard&& other) : locks_(other.locks_), stripes_(std::move(other.stripes_)) { other.locks_ = nullptr; }
+
+    Guard& operator=(Guard&& other) {
+      if (this != &other) {
+        unlock();
+        locks_ = other.locks_;
+        stripes_ = std::move(other.stripes_);
+        other.locks_ = nullptr;
+      }
+      return *this;
+    }
+
+    ~Guard() { unlock(); }
+
+    bool ownsLock() const { return locks_ != nullptr; }
+
+   private:
+    friend class StripedLocks;
+
+    Guard(StripedLocks* locks, std::vector<size_t> stripes) : locks_(locks), stripes_(std::move(stripes)) {}
+
+    void unlock() {
+      if (!locks_) return;
+      for (size_t stripe : stripes_) locks_->locks_[stripe].unlock();
+      locks_ = nullptr;
+    }
+
+    StripedLocks* locks_;
+    std::vector<size_t> stripes_;
+  };
+
+  // Enough for writers of different keys to rarely contend on the same stripe
+  static constexpr size_t kDefaultStripes = 64;
+
+  explicit StripedLocks(size_t stripes = kDefaultStripes) : stripeCount_(stripes), locks_(new std::mutex[stripes]) {
+    CHECK_GT(stripes, 0);
+  }
+
+  std::mutex& get(const std::string& key) { return locks_[stripe(key)]; }
+
+  // Lock the stripes of all keys, waiting for them as long as needed. Stripes are always taken in ascending order, so
+  // guards over overlapping keys cannot deadlock.
+  Guard lock(const std::vector<std::string>& keys) {
+    std::vector<size_t> stripes = stripesOf(keys);
+    for (size_t stripe : stripes) locks_[stripe].lock();
+    return Guard(this, std::move(stripes));
+  }
+
+  // Lock the stripes of all keys only if none of them is held. Return a guard that owns no lock otherwise.
+  Guard tryLock(const std::vector<std::string>& keys) {
+    std::vector<size_t> stripes = stripesOf(keys);
+    for (size_t i = 0; i < stripes.size(); i++) {
+      if (!locks_[stripes[i]].try_lock()) {
+        while (i > 0) locks_[stripes[--i]].unlock();
+        return Guard();
+      }
+    }
+    return Guard(this, std::move(stripes));
+  }
+
+ private:
+  size_t stripe(const std::string& key) const { return std::hash<std::string>()(key) % stripeCount_; }
+
+  std::vector<size_t> stripesOf(const std::vector<std::string>& keys) const {
+    std::vector<size_t> stripes;
+    stripes.reserve(keys.size());
+    for (const auto& key : keys) stripes.push_back(stripe(key));
+    std::sort(stripes.begin(), stripes.end());
+    stripes.erase(std::unique(stripes.begin(), stripes.end()), stripes.end());
+    return stripes;
+  }
+
+  const size_t stripeCount_;
+  std::unique_ptr<std::mutex[]> locks_;
+};
+
+}  // namespace infra
+
+#endif  // INFRA_STRIPEDLOCKS_H_
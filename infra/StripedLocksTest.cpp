@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "infra/StripedLocks.h"
+
+namespace infra {
+
+TEST(StripedLocksTest, TryLock) {
+  StripedLocks locks(16);
+  auto guard = locks.tryLock({"a", "b"});
+  EXPECT_TRUE(guard.ownsLock());
+  // locking a mutex twice in the same thread is undefined, so try from another one
+  auto tryLockElsewhere = [&locks](std::vector<std::string> keys) {
+    bool locked = false;
+    std::thread([&locks, &keys, &locked]() { locked = locks.tryLock(keys).ownsLock(); }).join();
+    return locked;
+  };
+  EXPECT_FALSE(tryLockElsewhere({"b", "c"}));
+
+  StripedLocks::Guard moved(std::move(guard));
+  EXPECT_FALSE(guard.ownsLock());
+  EXPECT_TRUE(moved.ownsLock());
+  EXPECT_FALSE(tryLockElsewhere({"a"}));
+  moved = StripedLocks::Guard();
+  // every stripe is released, including those taken before a failed attempt
+  EXPECT_TRUE(tryLockElsewhere({"a", "b", "c"}));
+}
+
+TEST(StripedLocksTest, DuplicateKeys) {
+  StripedLocks locks(1);
+  // all keys share the single stripe, which is locked once
+  auto guard = locks.lock({"a", "b", "a"});
+  EXPECT_TRUE(guard.ownsLock());
+}
+
+TEST(StripedLocksTest, OverlappingKeys) {
+  StripedLocks locks(8);
+  int64_t counter = 0;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&locks, &counter, t]() {
+      // the same keys in different orders
+      std::vector<std::string> keys{"x", "y", "z"};
+      std::rotate(keys.begin(), keys.begin() + t % 3, keys.end());
+      for (int i = 0; i < 10000; i++) {
+        auto guard = locks.lock(keys);
+        counter++;
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  EXPECT_EQ(40000, counter);
+}
+
+}  // namespace infra
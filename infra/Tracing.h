@@ -0,0 +1,85 @@
+#ifndef INFRA_TRACING_H_
+#define INFRA_TRACING_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "wtf/macros.h"
+
+namespace infra {
+
+// Sampled request tracing on top of the WTF runtime, which is compiled in with `bazel build --define tracing=wtf`
+// (defining WTF_ENABLE) and saved to --trace_file_path at shutdown.
+//
+// A unit of work, e.g., a redis request or a kafka batch, opens a RequestGuard on its thread, which decides whether
+// the work is sampled. Calls wrapped with TRACE_CALL record a WTF scope only within sampled work, so that tracing a
+// fraction of requests in production stays cheap. Work nested in a sampled guard is always sampled.
+class Tracing {
+ public:
+  // Trace one out of every sampleEvery units of work on each thread. 0 disables tracing.
+  static void setSampleEvery(uint32_t sampleEvery) {
+    sampleEveryRef().store(sampleEvery, std::memory_order_relaxed);
+  }
+
+  static uint32_t getSampleEvery() {
+    return sampleEveryRef().load(std::memory_order_relaxed);
+  }
+
+  // Whether the work running on this thread is sampled
+  static bool isSampled() {
+    return sampledRef();
+  }
+
+  class RequestGuard {
+   public:
+    RequestGuard() : previous_(sampledRef()) {
+      sampledRef() = previous_ || sampleNext();
+    }
+
+    ~RequestGuard() {
+      sampledRef() = previous_;
+    }
+
+   private:
+    const bool previous_;
+  };
+
+ private:
+  static std::atomic<uint32_t>& sampleEveryRef() {
+    static std::atomic<uint32_t> sampleEvery(0);
+    return sampleEvery;
+  }
+
+  static bool& sampledRef() {
+    static thread_local bool sampled = false;
+    return sampled;
+  }
+
+  static bool sampleNext() {
+#if defined(WTF_ENABLE)
+    uint32_t sampleEvery = getSampleEvery();
+    if (sampleEvery == 0) return false;
+
+    static thread_local uint32_t count = 0;
+    if (++count < sampleEvery) return false;
+    count = 0;
+    // WTF only records events on threads enabled for it
+    WTF_AUTO_THREAD_ENABLE();
+    return true;
+#else
+    return false;
+#endif  // WTF_ENABLE
+  }
+};
+
+}  // namespace infra
+
+// Evaluate expr, recording it as a WTF scope with the given literal name when the current work is sampled
+#if defined(WTF_ENABLE)
+#define TRACE_CALL(name, expr) \
+  (::infra::Tracing::isSampled() ? [&]() { WTF_SCOPE0(name); return (expr); }() : (expr))
+#else
+#define TRACE_CALL(name, expr) (expr)
+#endif  // WTF_ENABLE
+
+#endif  // INFRA_TRACING_H_
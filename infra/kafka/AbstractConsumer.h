@@ -3,13 +3,16 @@
 
 #include <pthread.h>
 
+#include <algorithm>
 #include <memory>
 #include <chrono>
 #include <string>
 #include <thread>
 
 #include "glog/logging.h"
+#include "infra/Tracing.h"
 #include "infra/kafka/ConsumerHelper.h"
+#include "infra/kafka/ConsumerMetrics.h"
 
 namespace infra {
 namespace kafka {
@@ -24,6 +27,7 @@ class AbstractConsumer {
 
   static constexpr int kDefaultNormalConsumeTimeoutMs = 1000;
   static constexpr int kDefaultLowLatencyConsumeTimeoutMs = 5;
+  static constexpr int64_t kThrottleSliceMicros = 100000;
 
   AbstractConsumer(const std::string& offsetKey, bool lowLatency,
                    std::shared_ptr<infra::kafka::ConsumerHelper> consumerHelper)
@@ -33,7 +37,8 @@ class AbstractConsumer {
         initialized_(false),
         // run_ defaults to true so that client can signal to stop the consumer thread when it's about to start
         run_(true),
-        consumerThread_(nullptr) {}
+        consumerThread_(nullptr),
+        metrics_(nullptr) {}
 
   virtual ~AbstractConsumer() {}
 
@@ -55,11 +60,37 @@ class AbstractConsumer {
       timeoutMs = lowLatency_ ? kDefaultLowLatencyConsumeTimeoutMs : kDefaultNormalConsumeTimeoutMs;
     }
 
+    if (consumerHelper_) {
+      metrics_ = consumerHelper_->getMetrics(offsetKey_);
+    }
+
     // `this` pointer has a longer lifetime than the consumer thread, so it's okay just pass `this` to the thread
     consumerThread_.reset(new std::thread([this, timeoutMs]() {
       while (this->run()) {
-        // process a batch of messages
-        this->processBatch(timeoutMs);
+        // process a batch of messages, which is the unit sampled for tracing
+        infra::Tracing::RequestGuard guard;
+        batchMessages_ = 0;
+        batchBytes_ = 0;
+        batchIdleMicros_ = 0;
+        auto batchStart = std::chrono::steady_clock::now();
+        TRACE_CALL("KafkaConsumer#processBatch", this->processBatch(timeoutMs));
+        if (consumerHelper_) {
+          // replaying consumers wait for their limits, which is not time spent processing
+          int64_t throttleMicros = consumerHelper_->throttle(offsetKey_, batchMessages_);
+          batchIdleMicros_ += throttleMicros;
+          // sleep in slices so that stopping the consumer is not held back
+          while (throttleMicros > 0 && this->run()) {
+            int64_t sliceMicros = throttleMicros < kThrottleSliceMicros ? throttleMicros : kThrottleSliceMicros;
+            std::this_thread::sleep_for(std::chrono::microseconds(sliceMicros));
+            throttleMicros -= sliceMicros;
+          }
+        }
+        if (metrics_) {
+          int64_t batchMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::steady_clock::now() - batchStart).count();
+          metrics_->observeBatch(batchMessages_, batchBytes_, std::max(batchMicros - batchIdleMicros_, 0L),
+                                 batchIdleMicros_);
+        }
       }
     }));
     pthread_setname_np(consumerThread_->native_handle(), "kafka-consumer");
@@ -85,6 +116,10 @@ class AbstractConsumer {
   // Load committed offset from persistent storage.
   virtual int64_t loadCommittedKafkaOffset(void) = 0;
 
+  // Commit the offset of the first message at or after the given timestamp, so that the consumer starts from there
+  // when initialized with RdKafka::Topic::OFFSET_STORED. Called before init. Return false if it cannot be resolved.
+  virtual bool rewindToTimestamp(int64_t timestampMs) = 0;
+
   // Process a batch of messages within the given timeout.
   // Note that we don't define processOne function here as consumers may use different message types
   virtual void processBatch(int timeoutMs) = 0;
@@ -96,6 +131,17 @@ class AbstractConsumer {
   bool initialized() const { return initialized_; }
   void setInitialized() { initialized_ = true; }
 
+  // Metrics of the consumer, or nullptr if not enabled. Subclasses may time their own stages with
+  // ConsumerMetrics::StageTimer, e.g., decoding messages in processOne.
+  ConsumerMetrics::Partition* metrics() const { return metrics_; }
+  // Account for messages and bytes fetched in the current batch
+  void countFetched(size_t messages, size_t bytes) {
+    batchMessages_ += messages;
+    batchBytes_ += bytes;
+  }
+  // Account for time spent in the current batch waiting for messages that have not arrived
+  void countIdleMicros(int64_t micros) { batchIdleMicros_ += micros; }
+
  private:
   const std::string offsetKey_;
   const bool lowLatency_;
@@ -103,6 +149,11 @@ class AbstractConsumer {
   bool initialized_;
   bool run_;
   std::unique_ptr<std::thread> consumerThread_;
+  ConsumerMetrics::Partition* metrics_;
+  // Stats of the batch being processed, only accessed by the consumer thread
+  size_t batchMessages_ = 0;
+  size_t batchBytes_ = 0;
+  int64_t batchIdleMicros_ = 0;
 };
 
 }  // namespace kafka
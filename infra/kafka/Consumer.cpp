@@ -3,6 +3,7 @@
 #include <memory>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "folly/Format.h"
 #include "glog/logging.h"
@@ -69,7 +70,7 @@ void Consumer::init(int64_t initialOffset) {
   }
 
   RdKafka::Metadata* metadataTmp = nullptr;
-  auto errorCode = consumer_->metadata(false /* one topic only */, topic.get(), &metadataTmp, 10000);
+  auto errorCode = consumer_->metadata(false /* one topic only */, topic.get(), &metadataTmp, kMetadataTimeoutMs);
   std::unique_ptr<RdKafka::Metadata> metadata(metadataTmp);
   if (errorCode != RdKafka::ERR_NO_ERROR) {
     LOG(FATAL) << "Getting topic metadata failed: " << RdKafka::err2str(errorCode);
@@ -104,7 +105,48 @@ void Consumer::init(int64_t initialOffset) {
   setInitialized();
 }
 
+bool Consumer::rewindToTimestamp(int64_t timestampMs) {
+  // A short-lived handle is enough for the lookup, since the consumer itself is only created by init
+  std::unique_ptr<RdKafka::Conf> conf(RdKafka::Conf::create(RdKafka::Conf::CONF_GLOBAL));
+  std::string errstr;
+  // timestamp lookups require a 0.10.0.0 kafka broker
+  if (conf->set("metadata.broker.list", brokerList_, errstr) != RdKafka::Conf::CONF_OK ||
+      conf->set("group.id", groupId_, errstr) != RdKafka::Conf::CONF_OK ||
+      conf->set("api.version.request", "true", errstr) != RdKafka::Conf::CONF_OK) {
+    LOG(ERROR) << "Setting Kafka configuration for offset lookup failed: " << errstr;
+    return false;
+  }
+  std::unique_ptr<RdKafka::KafkaConsumer> consumer = createKafkaConsumer(conf.get(), &errstr);
+  if (!consumer) {
+    LOG(ERROR) << "Kafka consumer initialization for offset lookup failed: " << errstr;
+    return false;
+  }
+
+  // The offset of a partition is looked up by setting it to the timestamp
+  std::unique_ptr<RdKafka::TopicPartition> topicPartition(RdKafka::TopicPartition::create(topicStr_, partition_));
+  topicPartition->set_offset(timestampMs);
+  std::vector<RdKafka::TopicPartition*> offsets = { topicPartition.get() };
+  auto errorCode = consumer->offsetsForTimes(offsets, kMetadataTimeoutMs);
+  consumer->close();
+  if (errorCode == RdKafka::ERR_NO_ERROR) {
+    errorCode = topicPartition->err();
+  }
+  if (errorCode != RdKafka::ERR_NO_ERROR) {
+    LOG(ERROR) << "Looking up offset of partition " << partition_ << " of " << topicStr_ << " at " << timestampMs
+               << " failed: " << RdKafka::err2str(errorCode);
+    return false;
+  }
+
+  // -1 is returned when every message is older than the timestamp, which is RdKafka::Topic::OFFSET_END once committed,
+  // so the consumer starts from the end
+  int64_t offset = topicPartition->offset();
+  LOG(WARNING) << "Rewind partition " << partition_ << " of " << topicStr_ << " to offset " << offset << " at "
+               << timestampMs;
+  return consumerHelper_->commitRawOffset(offsetKey_, offset);
+}
+
 constexpr size_t Consumer::kMaxBatchSize;
+constexpr int Consumer::kMetadataTimeoutMs;
 
 }  // namespace kafka
 }  // namespace infra
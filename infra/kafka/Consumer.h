@@ -5,11 +5,13 @@
 #include <memory>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include "glog/logging.h"
 #include "infra/kafka/AbstractConsumer.h"
 #include "infra/kafka/EventCallback.h"
+#include "infra/kafka/MessageFilter.h"
 #include "librdkafka/rdkafkacpp.h"
 
 namespace infra {
@@ -60,6 +62,9 @@ class Consumer : public AbstractConsumer, public EventCallback {
     return consumerHelper()->loadCommittedOffsetFromDb(offsetKey());
   }
 
+  // Resolve the offset with the brokers' time index
+  bool rewindToTimestamp(int64_t timestampMs) override;
+
   // Get updates about kafka stats
   void processStatsEvent(const RdKafka::Event& statsEvent) override {
     // The superclass implementation logs the stats, which becomes too verbose, so ignore it here
@@ -77,9 +82,28 @@ class Consumer : public AbstractConsumer, public EventCallback {
     consumeBatch(timeoutMs, nullptr);
   }
 
+  // Skip messages rejected by the filter without calling processOne. Only set it before the consumer starts.
+  void setMessageFilter(MessageFilter messageFilter) {
+    messageFilter_ = std::move(messageFilter);
+  }
+
+  // Whether to process a message, which is decided on its raw bytes before any decoding. Subclasses may override it
+  // for rules the filter cannot express, and should keep it cheap.
+  virtual bool acceptMessage(const RdKafka::Message& msg) {
+    return messageFilter_.matches(msg);
+  }
+
   // Process one message.
   virtual void processOne(const RdKafka::Message& msg, void* opaque) = 0;
 
+  // Called instead of processOne for messages not accepted. By default the offset past the message is committed at
+  // the end of a batch in which every message was skipped, so that a consumer filtering out most of its topic does
+  // not read the same messages again after a restart. Batches with processed messages are left to the subclass, which
+  // commits its own offset with them. Subclasses committing less often than once per batch should override it.
+  virtual void processSkipped(const RdKafka::Message& msg, void* opaque) {
+    skippedNextOffset_ = msg.offset() + 1;
+  }
+
   // Process one message with an error
   virtual void processError(const RdKafka::Message& msgWithError, void* opaque) {
     switch (msgWithError.err()) {
@@ -101,26 +125,48 @@ class Consumer : public AbstractConsumer, public EventCallback {
   // allow subclasses to override processBatch without exposing the underlying consumer object
   size_t consumeBatch(int timeoutMs, void* opaque) {
     size_t count = 0;
+    size_t processed = 0;
+    skippedNextOffset_ = -1;
     int64_t start = nowMs();
     int remainingMs = timeoutMs;
     while (run() && count < kMaxBatchSize && remainingMs > 0) {
-      std::unique_ptr<RdKafka::Message> msg(consumer_->consume(remainingMs));
+      ConsumerMetrics::StageTimer fetchTimer(metrics(), ConsumerMetrics::Stage::kFetch);
+      std::unique_ptr<RdKafka::Message> msg(TRACE_CALL("KafkaConsumer#fetch", consumer_->consume(remainingMs)));
+      int64_t fetchMicros = fetchTimer.stop();
       if (!msg) {
+        countIdleMicros(fetchMicros);
         break;
       }
       if (msg->err() == RdKafka::ERR_NO_ERROR) {
-        processOne(*msg, opaque);
+        countFetched(1, msg->len());
+        ConsumerMetrics::StageTimer processTimer(metrics(), ConsumerMetrics::Stage::kProcess);
+        if (acceptMessage(*msg)) {
+          TRACE_CALL("KafkaConsumer#processOne", processOne(*msg, opaque));
+          processed++;
+        } else {
+          processSkipped(*msg, opaque);
+          if (metrics()) metrics()->countSkipped();
+        }
         count++;
       } else {
+        // timed out or reached the end of the partition
+        countIdleMicros(fetchMicros);
         processError(*msg, opaque);
         break;
       }
       remainingMs = timeoutMs - (nowMs() - start);
     }
+    if (processed == 0 && skippedNextOffset_ >= 0) {
+      // a failure only means reading the skipped messages again
+      if (!consumerHelper()->commitNextProcessOffset(offsetKey(), skippedNextOffset_)) {
+        LOG(WARNING) << "Committing skipped messages up to offset " << skippedNextOffset_ - 1 << " failed";
+      }
+    }
     return count;
   }
 
   bool commitSync() {
+    ConsumerMetrics::StageTimer timer(metrics(), ConsumerMetrics::Stage::kCommit);
     auto errorCode = consumer_->commitSync();
     if (errorCode != RdKafka::ERR_NO_ERROR) {
       LOG(WARNING) << "Commit offset sync to broker failed: " << RdKafka::err2str(errorCode);
@@ -131,6 +177,7 @@ class Consumer : public AbstractConsumer, public EventCallback {
   }
 
   bool commitAsync() {
+    ConsumerMetrics::StageTimer timer(metrics(), ConsumerMetrics::Stage::kCommit);
     auto errorCode = consumer_->commitAsync();
     if (errorCode != RdKafka::ERR_NO_ERROR) {
       LOG(WARNING) << "Commit offset async to broker failed: " << RdKafka::err2str(errorCode);
@@ -147,6 +194,7 @@ class Consumer : public AbstractConsumer, public EventCallback {
     partition->set_offset(offset);
     offsets.push_back(partition.get());
 
+    ConsumerMetrics::StageTimer timer(metrics(), ConsumerMetrics::Stage::kCommit);
     auto errorCode = consumer_->commitAsync(offsets);
     if (errorCode != RdKafka::ERR_NO_ERROR) {
       LOG(WARNING) << "Commit offset async to broker failed: " << RdKafka::err2str(errorCode);
@@ -168,6 +216,7 @@ class Consumer : public AbstractConsumer, public EventCallback {
 
  private:
   static constexpr size_t kMaxBatchSize = 10000;
+  static constexpr int kMetadataTimeoutMs = 10000;
 
   void setConf(const std::string& name, const std::string& value) {
     std::string errstr;
@@ -185,6 +234,9 @@ class Consumer : public AbstractConsumer, public EventCallback {
   std::shared_ptr<infra::kafka::ConsumerHelper> consumerHelper_;
   std::unique_ptr<RdKafka::Conf> conf_;
   std::unique_ptr<RdKafka::KafkaConsumer> consumer_;
+  MessageFilter messageFilter_;
+  // Offset past the last message skipped by the default processSkipped in the current batch, or -1
+  int64_t skippedNextOffset_ = -1;
 };
 
 }  // namespace kafka
@@ -0,0 +1,51 @@
+#include "infra/kafka/ConsumerGovernor.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace infra {
+namespace kafka {
+
+ConsumerGovernor* ConsumerGovernor::instance() {
+  static ConsumerGovernor* governor = new ConsumerGovernor();
+  return governor;
+}
+
+double ConsumerGovernor::getRelaxFactor(int64_t nowMicros) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (nowMicros < nextAdjustMicros_) return relaxFactor_;
+  nextAdjustMicros_ = nowMicros + kAdjustIntervalMicros;
+
+  int64_t count = latencyCount_.exchange(0);
+  int64_t sumMicros = latencySumMicros_.exchange(0);
+  int64_t targetMicros = latencyTargetMicros_;
+  if (targetMicros > 0 && (count == 0 || sumMicros / count <= targetMicros)) {
+    relaxFactor_ = std::min(relaxFactor_ * 2, kMaxRelaxFactor);
+  } else {
+    relaxFactor_ = std::max(relaxFactor_ / 2, 1.0);
+  }
+  return relaxFactor_;
+}
+
+void ConsumerThrottle::accountWrite(size_t bytes, int64_t nowMicros) {
+  advance(&nextWriteMicros_, bytes, config_.maxWriteBytesPerSec, nowMicros);
+}
+
+int64_t ConsumerThrottle::accountMessages(size_t messages, int64_t nowMicros) {
+  advance(&nextMessageMicros_, messages, config_.maxMessagesPerSec, nowMicros);
+  return std::max(std::max(nextMessageMicros_, nextWriteMicros_) - nowMicros, 0L);
+}
+
+void ConsumerThrottle::advance(int64_t* nextMicros, double amount, double maxPerSec, int64_t nowMicros) {
+  if (maxPerSec <= 0) return;
+  double rate = maxPerSec * governor_->getRelaxFactor(nowMicros);
+  *nextMicros = std::max(*nextMicros, nowMicros - kMaxBurstMicros) + static_cast<int64_t>(amount * 1e6 / rate);
+}
+
+constexpr double ConsumerGovernor::kMaxRelaxFactor;
+constexpr int64_t ConsumerGovernor::kAdjustIntervalMicros;
+constexpr uint32_t ConsumerGovernor::kSampleEvery;
+constexpr int64_t ConsumerThrottle::kMaxBurstMicros;
+
+}  // namespace kafka
+}  // namespace infra
@@ -0,0 +1,100 @@
+#ifndef INFRA_KAFKA_CONSUMERGOVERNOR_H_
+#define INFRA_KAFKA_CONSUMERGOVERNOR_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+namespace infra {
+namespace kafka {
+
+// Limits of a consumer while it replays, i.e., while it lags behind the high watermark by more than lagThreshold
+// messages, e.g., after being rewound to the beginning of its topic on a serving node
+struct ConsumerThrottleConfig {
+  // 0 disables throttling
+  int64_t lagThreshold = 0;
+  // 0 means unlimited
+  double maxMessagesPerSec = 0;
+  double maxWriteBytesPerSec = 0;
+};
+
+// ConsumerGovernor arbitrates between replaying consumers and live serving traffic. Foreground requests are sampled to
+// track their latency, and the limits of replaying consumers are scaled up while it stays on target, so that replays
+// run as fast as the node can afford and back off as soon as clients notice.
+class ConsumerGovernor {
+ public:
+  // Limits are relaxed up to this many times
+  static constexpr double kMaxRelaxFactor = 64;
+  // How often the relax factor is adjusted
+  static constexpr int64_t kAdjustIntervalMicros = 1000000;
+  // Foreground requests timed on each thread
+  static constexpr uint32_t kSampleEvery = 64;
+
+  // Process-wide governor, which never relaxes limits until a latency target is set
+  static ConsumerGovernor* instance();
+
+  // Foreground requests slower than this on average are considered unhealthy. 0 disables relaxing limits.
+  void setLatencyTargetMicros(int64_t micros) { latencyTargetMicros_ = micros; }
+  int64_t getLatencyTargetMicros() const { return latencyTargetMicros_; }
+
+  // Whether to time the current foreground request on this thread. It is cheap enough to call for every request.
+  bool sampleNext() {
+    if (latencyTargetMicros_.load(std::memory_order_relaxed) == 0) return false;
+    static thread_local uint32_t count = 0;
+    if (++count < kSampleEvery) return false;
+    count = 0;
+    return true;
+  }
+
+  void observeLatency(int64_t micros) {
+    latencySumMicros_.fetch_add(micros, std::memory_order_relaxed);
+    latencyCount_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Multiplier of the limits of replaying consumers, from 1 to kMaxRelaxFactor. It doubles after every interval in
+  // which foreground latency was on target, or without foreground traffic, and halves after every other interval.
+  double getRelaxFactor(int64_t nowMicros);
+
+ private:
+  std::atomic<int64_t> latencyTargetMicros_{0};
+  std::atomic<int64_t> latencySumMicros_{0};
+  std::atomic<int64_t> latencyCount_{0};
+  std::mutex mutex_;
+  int64_t nextAdjustMicros_ = 0;
+  double relaxFactor_ = 1;
+};
+
+// ConsumerThrottle paces a replaying consumer to the limits in its config, scaled by the relax factor of the governor.
+// It is only used by the consumer thread.
+class ConsumerThrottle {
+ public:
+  // Unused time is banked up to this long, so that a consumer may burst after waiting for messages
+  static constexpr int64_t kMaxBurstMicros = 1000000;
+
+  ConsumerThrottle(const ConsumerThrottleConfig& config, ConsumerGovernor* governor)
+      : config_(config), governor_(governor) {}
+
+  const ConsumerThrottleConfig& config() const { return config_; }
+
+  bool isReplaying(int64_t lag) const { return config_.lagThreshold > 0 && lag > config_.lagThreshold; }
+
+  // Account for bytes written to RocksDB
+  void accountWrite(size_t bytes, int64_t nowMicros);
+
+  // Account for processed messages and return how long to wait before processing more, in microseconds
+  int64_t accountMessages(size_t messages, int64_t nowMicros);
+
+ private:
+  // Advance the time at which the given limit allows more work, which is kept within kMaxBurstMicros of now
+  void advance(int64_t* nextMicros, double amount, double maxPerSec, int64_t nowMicros);
+
+  const ConsumerThrottleConfig config_;
+  ConsumerGovernor* governor_;
+  int64_t nextMessageMicros_ = 0;
+  int64_t nextWriteMicros_ = 0;
+};
+
+}  // namespace kafka
+}  // namespace infra
+
+#endif  // INFRA_KAFKA_CONSUMERGOVERNOR_H_
@@ -0,0 +1,103 @@
+#include "gtest/gtest.h"
+#include "infra/kafka/ConsumerGovernor.h"
+
+namespace infra {
+namespace kafka {
+
+TEST(ConsumerGovernor, NoRelaxWithoutTarget) {
+  ConsumerGovernor governor;
+  EXPECT_FALSE(governor.sampleNext());
+  EXPECT_EQ(1, governor.getRelaxFactor(0));
+  EXPECT_EQ(1, governor.getRelaxFactor(ConsumerGovernor::kAdjustIntervalMicros));
+}
+
+TEST(ConsumerGovernor, RelaxWhileHealthy) {
+  ConsumerGovernor governor;
+  governor.setLatencyTargetMicros(1000);
+  int64_t now = 0;
+  // no foreground traffic counts as healthy
+  EXPECT_EQ(2, governor.getRelaxFactor(now));
+  // the factor only changes once per interval
+  governor.observeLatency(5000);
+  EXPECT_EQ(2, governor.getRelaxFactor(now + 1));
+
+  now += ConsumerGovernor::kAdjustIntervalMicros;
+  EXPECT_EQ(1, governor.getRelaxFactor(now));
+
+  for (int i = 0; i < 10; i++) {
+    now += ConsumerGovernor::kAdjustIntervalMicros;
+    governor.observeLatency(500);
+    governor.observeLatency(1500);
+    governor.getRelaxFactor(now);
+  }
+  EXPECT_EQ(ConsumerGovernor::kMaxRelaxFactor, governor.getRelaxFactor(now));
+
+  now += ConsumerGovernor::kAdjustIntervalMicros;
+  governor.observeLatency(2000);
+  EXPECT_EQ(ConsumerGovernor::kMaxRelaxFactor / 2, governor.getRelaxFactor(now));
+}
+
+TEST(ConsumerGovernor, SampleEvery) {
+  ConsumerGovernor governor;
+  governor.setLatencyTargetMicros(1000);
+  int sampled = 0;
+  for (uint32_t i = 0; i < ConsumerGovernor::kSampleEvery * 10; i++) {
+    sampled += governor.sampleNext();
+  }
+  EXPECT_EQ(10, sampled);
+}
+
+TEST(ConsumerThrottle, IsReplaying) {
+  ConsumerGovernor governor;
+  ConsumerThrottleConfig config;
+  EXPECT_FALSE(ConsumerThrottle(config, &governor).isReplaying(1000000));
+
+  config.lagThreshold = 100;
+  ConsumerThrottle throttle(config, &governor);
+  EXPECT_FALSE(throttle.isReplaying(100));
+  EXPECT_TRUE(throttle.isReplaying(101));
+}
+
+TEST(ConsumerThrottle, LimitMessages) {
+  ConsumerGovernor governor;
+  ConsumerThrottleConfig config;
+  config.lagThreshold = 100;
+  config.maxMessagesPerSec = 1000;
+  ConsumerThrottle throttle(config, &governor);
+
+  int64_t now = 10 * ConsumerThrottle::kMaxBurstMicros;
+  // a burst of up to a second is allowed after idling
+  EXPECT_EQ(0, throttle.accountMessages(1000, now));
+  EXPECT_EQ(500000, throttle.accountMessages(500, now));
+  EXPECT_EQ(0, throttle.accountMessages(0, now + 500000));
+  EXPECT_EQ(1000, throttle.accountMessages(1, now + 500000));
+}
+
+TEST(ConsumerThrottle, LimitWriteBytes) {
+  ConsumerGovernor governor;
+  ConsumerThrottleConfig config;
+  config.lagThreshold = 100;
+  config.maxWriteBytesPerSec = 1000000;
+  ConsumerThrottle throttle(config, &governor);
+
+  int64_t now = 10 * ConsumerThrottle::kMaxBurstMicros;
+  throttle.accountWrite(3000000, now);
+  // unlimited messages still wait for the write limit
+  EXPECT_EQ(2000000, throttle.accountMessages(10000, now));
+}
+
+TEST(ConsumerThrottle, RelaxedLimits) {
+  ConsumerGovernor governor;
+  governor.setLatencyTargetMicros(1000);
+  ConsumerThrottleConfig config;
+  config.lagThreshold = 100;
+  config.maxMessagesPerSec = 1000;
+  ConsumerThrottle throttle(config, &governor);
+
+  int64_t now = 10 * ConsumerThrottle::kMaxBurstMicros;
+  // limits double without foreground traffic
+  EXPECT_EQ(500000, throttle.accountMessages(3000, now));
+}
+
+}  // namespace kafka
+}  // namespace infra
@@ -6,8 +6,11 @@
 #include "folly/Conv.h"
 #include "folly/dynamic.h"
 #include "folly/json.h"
+#include "infra/Tracing.h"
+#include "infra/kafka/ConsumerGovernor.h"
 #include "librdkafka/rdkafkacpp.h"
 #include "rocksdb/db.h"
+#include "rocksdb/options.h"
 #include "rocksdb/slice.h"
 #include "rocksdb/status.h"
 #include "rocksdb/write_batch.h"
@@ -19,18 +22,33 @@ namespace kafka {
 bool ConsumerHelper::commitRawOffsetValueWithWriteBatch(const std::string& offsetKey, const std::string& encodedOffset,
                                                         rocksdb::WriteBatchBase* writeBatch) {
   rocksdb::Status status;
+  ConsumerMetrics::StageTimer timer(getMetrics(offsetKey),
+                                    writeBatch ? ConsumerMetrics::Stage::kWrite : ConsumerMetrics::Stage::kCommit);
+  rocksdb::WriteOptions writeOptions;
+  ConsumerThrottle* throttle = getReplayThrottle(offsetKey);
+  // Writes of replaying consumers are stalled first when compaction falls behind, rather than those of clients
+  writeOptions.low_pri = throttle != nullptr;
   if (writeBatch) {
     writeBatch->Put(smyteMetadataCfHandle_, offsetKey, encodedOffset);
-    status = db_->Write(rocksdb::WriteOptions(), writeBatch->GetWriteBatch());
+    if (throttle) {
+      throttle->accountWrite(writeBatch->GetWriteBatch()->GetDataSize(), nowMicros());
+    }
+    status = TRACE_CALL("KafkaConsumer#commit", db_->Write(writeOptions, writeBatch->GetWriteBatch()));
   } else {
-    status = db_->Put(rocksdb::WriteOptions(), smyteMetadataCfHandle_, offsetKey, encodedOffset);
+    status = db_->Put(writeOptions, smyteMetadataCfHandle_, offsetKey, encodedOffset);
   }
 
+  timer.stop();
+
   if (!status.ok()) {
     LOG(ERROR) << "Persisting WriteBatch failed: " << status.ToString();
     return false;
   }
 
+  if (writeBatch && writeBatchCommittedCallback_) {
+    writeBatchCommittedCallback_(writeBatch->GetWriteBatch());
+  }
+
   return true;
 }
 
@@ -2,6 +2,8 @@
 #define INFRA_KAFKA_CONSUMERHELPER_H_
 
 #include <algorithm>
+#include <chrono>
+#include <functional>
 #include <map>
 #include <memory>
 #include <stdexcept>
@@ -12,6 +14,8 @@
 #include "folly/Conv.h"
 #include "folly/Format.h"
 #include "folly/Range.h"
+#include "infra/kafka/ConsumerGovernor.h"
+#include "infra/kafka/ConsumerMetrics.h"
 #include "rocksdb/db.h"
 #include "rocksdb/write_batch.h"
 #include "rocksdb/write_batch_base.h"
@@ -78,6 +82,45 @@ class ConsumerHelper {
         // consider consumers lagging at start up time until they prove otherwise
         isLagging_(true) {}
 
+  // Called after a write batch is committed together with an offset, e.g., to publish the keys it updated
+  using WriteBatchCommittedCallback = std::function<void(rocksdb::WriteBatch* writeBatch)>;
+
+  // Only set it during initialization, before consumers start committing
+  void setWriteBatchCommittedCallback(WriteBatchCommittedCallback callback) {
+    writeBatchCommittedCallback_ = std::move(callback);
+  }
+
+  // Export metrics of the consumers. Only set it during initialization, before topic partitions are linked.
+  void setMetrics(std::shared_ptr<ConsumerMetrics> metrics) {
+    CHECK(topicPartitions_.empty()) << "Consumer metrics must be set before linking topic partitions";
+    metrics_ = metrics;
+  }
+
+  // Throttle the consumer for the given key while it replays. Only set it during initialization, after linking its
+  // topic partition.
+  void setThrottle(const std::string& offsetKey, const ConsumerThrottleConfig& config) {
+    CHECK(topicPartitions_.find(offsetKey) != topicPartitions_.end()) << "Topic partition is not linked";
+    throttles_[offsetKey].reset(new ConsumerThrottle(config, ConsumerGovernor::instance()));
+  }
+
+  // Whether the consumer for the given key is throttled because it lags behind
+  bool isReplaying(const std::string& offsetKey) const {
+    return getReplayThrottle(offsetKey) != nullptr;
+  }
+
+  // Account for messages processed by the consumer for the given key and return how long it should wait before
+  // processing more, in microseconds, which is 0 unless it is replaying
+  int64_t throttle(const std::string& offsetKey, size_t messages) {
+    ConsumerThrottle* throttle = getReplayThrottle(offsetKey);
+    return throttle ? throttle->accountMessages(messages, nowMicros()) : 0;
+  }
+
+  // Metrics of the consumer for the given key, or nullptr if metrics are not enabled
+  ConsumerMetrics::Partition* getMetrics(const std::string& offsetKey) const {
+    const auto it = partitionMetrics_.find(offsetKey);
+    return it == partitionMetrics_.end() ? nullptr : it->second;
+  }
+
   // Commit the given kafka offset regardless of its value, i.e., special negative values are allowed
   bool commitRawOffset(const std::string& offsetKey, int64_t kafkaOffset,
                        rocksdb::WriteBatchBase* writeBatch = nullptr) {
@@ -136,6 +179,9 @@ class ConsumerHelper {
     highWatermarkOffsets_[offsetKey] = RdKafka::Topic::OFFSET_INVALID;
     // consider consumers lagging at start up time until they prove otherwise
     lagStatuses[offsetKey] = true;
+    if (metrics_) {
+      partitionMetrics_[offsetKey] = metrics_->addPartition(topic, partition);
+    }
     return offsetKey;
   }
 
@@ -163,6 +209,9 @@ class ConsumerHelper {
       (*ss) << prefix << "last_committed_offset:" << lastCommittedOffset << std::endl;
       (*ss) << prefix << "high_watermark_offset:" << highWatermarkOffset << std::endl;
       (*ss) << prefix << "lag:" << std::max(0L, highWatermarkOffset - lastCommittedOffset) << std::endl;
+      if (throttles_.find(entry.first) != throttles_.end()) {
+        (*ss) << prefix << "replaying:" << isReplaying(entry.first) << std::endl;
+      }
     }
     (*ss) << "is_any_consumer_lagging:" << isLagging() << std::endl;
   }
@@ -183,6 +232,7 @@ class ConsumerHelper {
     const auto it = lastCommittedOffsets_.find(offsetKey);
     CHECK(it != lastCommittedOffsets_.end());
     it->second = offset;
+    updateLagMetric(offsetKey);
     return offset;
   }
 
@@ -190,6 +240,7 @@ class ConsumerHelper {
     const auto it = highWatermarkOffsets_.find(offsetKey);
     CHECK(it != highWatermarkOffsets_.end());
     it->second = offset;
+    updateLagMetric(offsetKey);
     return offset;
   }
 
@@ -236,8 +287,35 @@ class ConsumerHelper {
   bool commitRawOffsetValueWithWriteBatch(const std::string& offsetKey, const std::string& offsetValue,
                                           rocksdb::WriteBatchBase* writeBatch = nullptr);
 
+  static int64_t nowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // The throttle of the consumer for the given key if it is replaying, or nullptr
+  ConsumerThrottle* getReplayThrottle(const std::string& offsetKey) const {
+    const auto it = throttles_.find(offsetKey);
+    if (it == throttles_.end()) return nullptr;
+    int64_t lastCommittedOffset = getLastCommittedOffset(offsetKey);
+    int64_t highWatermarkOffset = getHighWatermarkOffset(offsetKey);
+    // special offsets are negative, e.g., before the first stats arrive
+    if (lastCommittedOffset < 0 || highWatermarkOffset < 0) return nullptr;
+    return it->second->isReplaying(highWatermarkOffset - lastCommittedOffset) ? it->second.get() : nullptr;
+  }
+
   int64_t parseHighWatermarkOffset(const std::string& statsJson, const std::string& topic, int64_t partition);
 
+  void updateLagMetric(const std::string& offsetKey) {
+    ConsumerMetrics::Partition* metrics = getMetrics(offsetKey);
+    if (!metrics) return;
+    int64_t lastCommittedOffset = getLastCommittedOffset(offsetKey);
+    int64_t highWatermarkOffset = getHighWatermarkOffset(offsetKey);
+    // special offsets are negative, e.g., before the first stats arrive
+    if (lastCommittedOffset >= 0 && highWatermarkOffset >= 0) {
+      metrics->setLag(std::max(0L, highWatermarkOffset - lastCommittedOffset));
+    }
+  }
+
   rocksdb::DB* db_;
   rocksdb::ColumnFamilyHandle* smyteMetadataCfHandle_;
 
@@ -250,6 +328,10 @@ class ConsumerHelper {
   std::map<std::string, bool> lagStatuses;
   // true if any consumer is lagging
   bool isLagging_;
+  WriteBatchCommittedCallback writeBatchCommittedCallback_;
+  std::shared_ptr<ConsumerMetrics> metrics_;
+  std::map<std::string, ConsumerMetrics::Partition*> partitionMetrics_;
+  std::map<std::string, std::unique_ptr<ConsumerThrottle>> throttles_;
 };
 
 }  // namespace kafka
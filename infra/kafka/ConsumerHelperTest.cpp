@@ -1,9 +1,16 @@
+#include <chrono>
+#include <cstdint>
 #include <limits>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <utility>
 
 #include "gtest/gtest.h"
 #include "infra/kafka/ConsumerHelper.h"
+#include "infra/kafka/ConsumerMetrics.h"
+#include "prometheus/registry.h"
 #include "rocksdb/db.h"
 #include "rocksdb/write_batch.h"
 #include "stesting/TestWithRocksDb.h"
@@ -12,7 +19,23 @@ namespace infra {
 namespace kafka {
 
 // db() is automatically available using this helper class
-class ConsumerHelperTest : public stesting::TestWithRocksDb {};
+class ConsumerHelperTest : public stesting::TestWithRocksDb {
+ protected:
+  // Count and sum of the samples of a stage, which all belong to the single partition of the tests
+  static std::pair<uint64_t, double> stageSamples(prometheus::Registry* registry, const std::string& stage) {
+    for (const auto& family : registry->Collect()) {
+      if (family.name() != "kafka_consumer_stage_seconds") continue;
+      for (const auto& metric : family.metric()) {
+        for (const auto& label : metric.label()) {
+          if (label.name() == "stage" && label.value() == stage) {
+            return {metric.histogram().sample_count(), metric.histogram().sample_sum()};
+          }
+        }
+      }
+    }
+    return {0, 0};
+  }
+};
 
 TEST_F(ConsumerHelperTest, EncodeDecodeOffset) {
   // offset 475
@@ -173,5 +196,44 @@ TEST_F(ConsumerHelperTest, LagStatus) {
   EXPECT_FALSE(consumerHelper.isLagging());
 }
 
+TEST_F(ConsumerHelperTest, Metrics) {
+  ConsumerHelper consumerHelper(db(), metadataColumnFamily());
+  prometheus::Registry registry;
+  consumerHelper.setMetrics(std::make_shared<ConsumerMetrics>(&registry));
+  const std::string offsetKey = consumerHelper.linkTopicPartition("testTopic", 1, "");
+  ConsumerMetrics::Partition* metrics = consumerHelper.getMetrics(offsetKey);
+  ASSERT_NE(nullptr, metrics);
+  EXPECT_EQ(nullptr, consumerHelper.getMetrics("unknown"));
+
+  // a write made while processing counts as write time only
+  int64_t processMicros = 0;
+  {
+    ConsumerMetrics::StageTimer processTimer(metrics, ConsumerMetrics::Stage::kProcess);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    rocksdb::WriteBatch writeBatch;
+    EXPECT_TRUE(consumerHelper.commitNextProcessOffset(offsetKey, 105, &writeBatch));
+    processMicros = processTimer.stop();
+  }
+  auto process = stageSamples(&registry, "process");
+  auto write = stageSamples(&registry, "write");
+  EXPECT_EQ(1, process.first);
+  EXPECT_EQ(1, write.first);
+  EXPECT_GE(process.second, 0.01);
+  EXPECT_LT(write.second, processMicros / 1e6);
+  EXPECT_NEAR(processMicros / 1e6, process.second + write.second, 1e-9);
+  EXPECT_EQ(0, stageSamples(&registry, "commit").first);
+
+  // commits without a write batch are timed on their own, and lag is updated along with offsets
+  EXPECT_TRUE(consumerHelper.commitNextProcessOffset(offsetKey, 106));
+  EXPECT_EQ(1, stageSamples(&registry, "commit").first);
+  EXPECT_EQ(1, stageSamples(&registry, "process").first);
+  consumerHelper.setHighWatermarkOffset(offsetKey, 110);
+  EXPECT_EQ(106, consumerHelper.getLastCommittedOffset(offsetKey));
+
+  // timers do nothing without metrics
+  ConsumerMetrics::StageTimer timer(nullptr, ConsumerMetrics::Stage::kFetch);
+  EXPECT_EQ(0, timer.stop());
+}
+
 }  // namespace kafka
 }  // namespace infra
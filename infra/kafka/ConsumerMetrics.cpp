@@ -0,0 +1,87 @@
+#include "infra/kafka/ConsumerMetrics.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "folly/Conv.h"
+#include "prometheus/counter_builder.h"
+#include "prometheus/gauge_builder.h"
+#include "prometheus/histogram_builder.h"
+
+namespace infra {
+namespace kafka {
+
+namespace {
+
+constexpr const char* kStageNames[] = {"fetch", "decode", "process", "write", "commit"};
+static_assert(sizeof(kStageNames) / sizeof(kStageNames[0]) == ConsumerMetrics::kNumStages,
+              "Every stage needs a name");
+
+// From 10us to 10s, which covers both a single processOne and a slow download
+const prometheus::Histogram::BucketBoundaries kStageSecondsBuckets = {0.00001, 0.00005, 0.0001, 0.0005, 0.001, 0.005,
+                                                                     0.01,    0.05,    0.1,    0.5,    1,     5, 10};
+// Batches are capped at 10000 messages
+const prometheus::Histogram::BucketBoundaries kBatchMessagesBuckets = {0, 1, 10, 100, 1000, 10000};
+// From 1KB to 64MB
+const prometheus::Histogram::BucketBoundaries kBatchBytesBuckets = {1 << 10, 1 << 12, 1 << 14, 1 << 16, 1 << 18,
+                                                                   1 << 20, 1 << 22, 1 << 24, 1 << 26};
+
+}  // namespace
+
+ConsumerMetrics::Partition::Partition(ConsumerMetrics* metrics, const std::string& topic, int partition) {
+  std::map<std::string, std::string> labels = {{"topic", topic}, {"partition", folly::to<std::string>(partition)}};
+  for (size_t i = 0; i < kNumStages; i++) {
+    std::map<std::string, std::string> stageLabels = labels;
+    stageLabels["stage"] = kStageNames[i];
+    stageSeconds_[i] = &metrics->stageSeconds_.Add(stageLabels, kStageSecondsBuckets);
+  }
+  batchMessages_ = &metrics->batchMessages_.Add(labels, kBatchMessagesBuckets);
+  batchBytes_ = &metrics->batchBytes_.Add(labels, kBatchBytesBuckets);
+  busySeconds_ = &metrics->busySeconds_.Add(labels);
+  idleSeconds_ = &metrics->idleSeconds_.Add(labels);
+  lag_ = &metrics->lag_.Add(labels);
+  skippedMessages_ = &metrics->skippedMessages_.Add(labels);
+}
+
+ConsumerMetrics::ConsumerMetrics(prometheus::Registry* registry)
+    : stageSeconds_(prometheus::BuildHistogram()
+                        .Name("kafka_consumer_stage_seconds")
+                        .Help("Time spent in each stage of kafka consumer loops")
+                        .Register(*registry)),
+      batchMessages_(prometheus::BuildHistogram()
+                         .Name("kafka_consumer_batch_messages")
+                         .Help("Messages consumed per batch")
+                         .Register(*registry)),
+      batchBytes_(prometheus::BuildHistogram()
+                      .Name("kafka_consumer_batch_bytes")
+                      .Help("Bytes fetched per batch")
+                      .Register(*registry)),
+      busySeconds_(prometheus::BuildCounter()
+                       .Name("kafka_consumer_busy_seconds_total")
+                       .Help("Time consumer threads spent working on messages")
+                       .Register(*registry)),
+      idleSeconds_(prometheus::BuildCounter()
+                       .Name("kafka_consumer_idle_seconds_total")
+                       .Help("Time consumer threads spent waiting for messages")
+                       .Register(*registry)),
+      lag_(prometheus::BuildGauge()
+               .Name("kafka_consumer_lag")
+               .Help("Messages between the high watermark and the last committed offset")
+               .Register(*registry)),
+      skippedMessages_(prometheus::BuildCounter()
+                           .Name("kafka_consumer_skipped_messages_total")
+                           .Help("Messages skipped by consumer filters without being processed")
+                           .Register(*registry)) {}
+
+ConsumerMetrics::Partition* ConsumerMetrics::addPartition(const std::string& topic, int partition) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  partitions_.emplace_back(new Partition(this, topic, partition));
+  return partitions_.back().get();
+}
+
+constexpr size_t ConsumerMetrics::kNumStages;
+
+}  // namespace kafka
+}  // namespace infra
@@ -0,0 +1,132 @@
+#ifndef INFRA_KAFKA_CONSUMERMETRICS_H_
+#define INFRA_KAFKA_CONSUMERMETRICS_H_
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "prometheus/counter.h"
+#include "prometheus/family.h"
+#include "prometheus/gauge.h"
+#include "prometheus/histogram.h"
+#include "prometheus/registry.h"
+
+namespace infra {
+namespace kafka {
+
+// Prometheus metrics of kafka consumer loops, labeled by topic and partition, which break the time of a batch down by
+// stage to tell what a lagging consumer is waiting on:
+// - fetch: consuming from the broker, or downloading files for kafka-store consumers
+// - decode: decoding messages, e.g., Avro records of kafka-store files
+// - process: processOne of each message, excluding the writes and commits it makes
+// - write: committing a write batch together with the offset to RocksDB
+// - commit: committing offsets alone, to RocksDB or to the broker
+// Consumer threads are busy, unless waiting for messages that have not arrived yet.
+class ConsumerMetrics {
+ public:
+  enum class Stage {
+    kFetch = 0,
+    kDecode,
+    kProcess,
+    kWrite,
+    kCommit,
+  };
+  static constexpr size_t kNumStages = 5;
+
+  // Metrics of one consumer, i.e., one topic partition
+  class Partition {
+   public:
+    Partition(ConsumerMetrics* metrics, const std::string& topic, int partition);
+
+    void observeStage(Stage stage, int64_t micros) {
+      stageSeconds_[static_cast<size_t>(stage)]->Observe(micros / 1e6);
+    }
+
+    void observeBatch(size_t messages, size_t bytes, int64_t busyMicros, int64_t idleMicros) {
+      batchMessages_->Observe(messages);
+      batchBytes_->Observe(bytes);
+      busySeconds_->Increment(busyMicros / 1e6);
+      idleSeconds_->Increment(idleMicros / 1e6);
+    }
+
+    void setLag(int64_t lag) { lag_->Set(lag); }
+
+    // Count a message skipped by the filter of the consumer
+    void countSkipped() { skippedMessages_->Increment(); }
+
+   private:
+    prometheus::Histogram* stageSeconds_[kNumStages];
+    prometheus::Histogram* batchMessages_;
+    prometheus::Histogram* batchBytes_;
+    prometheus::Counter* busySeconds_;
+    prometheus::Counter* idleSeconds_;
+    prometheus::Gauge* lag_;
+    prometheus::Counter* skippedMessages_;
+  };
+
+  // Time a stage until stopped or destroyed. It does nothing when metrics are not enabled, i.e., partition is nullptr.
+  // Stages are exclusive: the time of a timer started while another one runs on the same thread, e.g., a commit made
+  // by processOne, counts towards its own stage only and is subtracted from the enclosing one.
+  class StageTimer {
+   public:
+    StageTimer(Partition* partition, Stage stage)
+        : partition_(partition), stage_(stage), nestedMicros_(0), parent_(nullptr) {
+      if (partition_) {
+        start_ = std::chrono::steady_clock::now();
+        parent_ = current();
+        current() = this;
+      }
+    }
+
+    ~StageTimer() { stop(); }
+
+    // Record the stage and return its duration in microseconds, including nested stages, or 0 if not timed
+    int64_t stop() {
+      if (!partition_) return 0;
+      int64_t micros =
+          std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_).count();
+      partition_->observeStage(stage_, micros - nestedMicros_);
+      partition_ = nullptr;
+      if (current() == this) current() = parent_;
+      if (parent_) parent_->nestedMicros_ += micros;
+      return micros;
+    }
+
+   private:
+    static StageTimer*& current() {
+      static thread_local StageTimer* timer = nullptr;
+      return timer;
+    }
+
+    Partition* partition_;
+    const Stage stage_;
+    std::chrono::steady_clock::time_point start_;
+    int64_t nestedMicros_;
+    StageTimer* parent_;
+  };
+
+  explicit ConsumerMetrics(prometheus::Registry* registry);
+
+  // Add metrics for a consumer. The returned object lives as long as this one.
+  Partition* addPartition(const std::string& topic, int partition);
+
+ private:
+  prometheus::Family<prometheus::Histogram>& stageSeconds_;
+  prometheus::Family<prometheus::Histogram>& batchMessages_;
+  prometheus::Family<prometheus::Histogram>& batchBytes_;
+  prometheus::Family<prometheus::Counter>& busySeconds_;
+  prometheus::Family<prometheus::Counter>& idleSeconds_;
+  prometheus::Family<prometheus::Gauge>& lag_;
+  prometheus::Family<prometheus::Counter>& skippedMessages_;
+
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<Partition>> partitions_;
+};
+
+}  // namespace kafka
+}  // namespace infra
+
+#endif  // INFRA_KAFKA_CONSUMERMETRICS_H_
@@ -1,13 +1,18 @@
 #include "infra/kafka/ConsumerTest.h"
 
+#include <deque>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "gflags/gflags.h"
 #include "glog/logging.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "infra/kafka/ConsumerHelper.h"
+#include "infra/kafka/MessageFilter.h"
 #include "librdkafka/rdkafkacpp.h"
+#include "stesting/TestWithRocksDb.h"
 
 DECLARE_bool(logtostderr);
 
@@ -25,6 +30,9 @@ class ConsumerTest : public ::testing::Test {
 
 using ::testing::_;
 using ::testing::DoAll;
+using ::testing::Invoke;
+using ::testing::NiceMock;
+using ::testing::Property;
 using ::testing::SetArgPointee;
 using ::testing::Return;
 
@@ -102,5 +110,131 @@ TEST_F(ConsumerTest, ConsumeUsingStoredOffset) {
   consumer.destroy();
 }
 
+// Offsets are rewound into the database, which consumers load on init
+class ConsumerRewindTest : public stesting::TestWithRocksDb {
+ protected:
+  void SetUp() override {
+    stesting::TestWithRocksDb::SetUp();
+    consumerHelper_ = std::make_shared<ConsumerHelper>(db(), metadataColumnFamily());
+    offsetKey_ = consumerHelper_->linkTopicPartition("testTopic", 0, "test");
+  }
+
+  // Rewind a consumer whose broker resolves the timestamp with the given error and offset
+  bool rewind(int64_t timestampMs, RdKafka::ErrorCode errorCode, int64_t offset) {
+    // The topic is only created by init, while the kafka consumer is owned by the lookup, which deletes it
+    std::unique_ptr<MockKafkaTopic> kafkaTopic(new MockKafkaTopic());
+    MockKafkaConsumer* kafkaConsumer = new MockKafkaConsumer();
+    MockConsumer consumer("localhost:9092", "testTopic", 0, kafkaTopic.get(), kafkaConsumer, consumerHelper_,
+                          offsetKey_);
+    EXPECT_CALL(*kafkaConsumer, offsetsForTimes(_, 10000))
+        .WillOnce(Invoke([timestampMs, errorCode, offset](std::vector<RdKafka::TopicPartition*>& offsets, int) {
+          EXPECT_EQ(1, offsets.size());
+          EXPECT_EQ(timestampMs, offsets[0]->offset());
+          offsets[0]->set_offset(offset);
+          return errorCode;
+        }));
+    EXPECT_CALL(*kafkaConsumer, close())
+        .WillOnce(Return(RdKafka::ERR_NO_ERROR));
+    return consumer.rewindToTimestamp(timestampMs);
+  }
+
+  std::shared_ptr<ConsumerHelper> consumerHelper_;
+  std::string offsetKey_;
+};
+
+TEST_F(ConsumerRewindTest, Offset) {
+  EXPECT_TRUE(rewind(1500000000000, RdKafka::ERR_NO_ERROR, 42));
+  EXPECT_EQ(42, consumerHelper_->loadCommittedOffsetFromDb(offsetKey_));
+}
+
+TEST_F(ConsumerRewindTest, PastTheEnd) {
+  // every message is older, so the broker returns -1 and the consumer starts from the end
+  EXPECT_TRUE(rewind(1500000000000, RdKafka::ERR_NO_ERROR, -1));
+  EXPECT_EQ(RdKafka::Topic::OFFSET_END, consumerHelper_->loadCommittedOffsetFromDb(offsetKey_));
+}
+
+TEST_F(ConsumerRewindTest, Failure) {
+  // nothing is committed, so the consumer would start from its previous offset
+  ASSERT_TRUE(consumerHelper_->commitRawOffset(offsetKey_, 7));
+  EXPECT_FALSE(rewind(1500000000000, RdKafka::ERR__TIMED_OUT, 42));
+  EXPECT_EQ(7, consumerHelper_->loadCommittedOffsetFromDb(offsetKey_));
+}
+
+// Consumes the messages queued in pendingMessages from a single partition
+class ConsumeBatchTest : public stesting::TestWithRocksDb {
+ protected:
+  void SetUp() override {
+    stesting::TestWithRocksDb::SetUp();
+    consumerHelper_ = std::make_shared<ConsumerHelper>(db(), metadataColumnFamily());
+    offsetKey_ = consumerHelper_->linkTopicPartition("testTopic", 0, "test");
+    ON_CALL(topicMetadata_, topic()).WillByDefault(Return("testTopic"));
+    ON_CALL(topicMetadata_, partitions()).WillByDefault(Return(&partitions_));
+  }
+
+  // The returned consumer owns the kafka consumer, which deletes the messages once consumed
+  MockKafkaConsumer* newKafkaConsumer() {
+    auto* kafkaConsumer = new NiceMock<MockKafkaConsumer>();
+    ON_CALL(*kafkaConsumer, metadata(_, _, _, _))
+        .WillByDefault(Invoke([this](bool allTopics, const RdKafka::Topic* topic, RdKafka::Metadata** metadata, int) {
+          // init deletes the metadata once verified
+          auto* kafkaMetadata = new NiceMock<MockKafkaMetadata>();
+          ON_CALL(*kafkaMetadata, topics()).WillByDefault(Return(&topics_));
+          *metadata = kafkaMetadata;
+          return RdKafka::ERR_NO_ERROR;
+        }));
+    ON_CALL(*kafkaConsumer, assign(_)).WillByDefault(Return(RdKafka::ERR_NO_ERROR));
+    ON_CALL(*kafkaConsumer, consume(_)).WillByDefault(Invoke([this](int timeoutMs) -> RdKafka::Message* {
+      if (pendingMessages_.empty()) return new TestMessage(RdKafka::ERR__PARTITION_EOF, -1, "", "");
+      RdKafka::Message* msg = pendingMessages_.front();
+      pendingMessages_.pop_front();
+      return msg;
+    }));
+    return kafkaConsumer;
+  }
+
+  void queue(int64_t offset, const std::string& key) {
+    pendingMessages_.push_back(new TestMessage(RdKafka::ERR_NO_ERROR, offset, key, "payload"));
+  }
+
+  std::shared_ptr<ConsumerHelper> consumerHelper_;
+  std::string offsetKey_;
+
+ private:
+  // A topic with a single partition
+  NiceMock<MockPartitionMetadata> partitionMetadata_;
+  RdKafka::TopicMetadata::PartitionMetadataVector partitions_{&partitionMetadata_};
+  NiceMock<MockKafkaTopicMetadata> topicMetadata_;
+  RdKafka::Metadata::TopicMetadataVector topics_{&topicMetadata_};
+  std::deque<RdKafka::Message*> pendingMessages_;
+};
+
+TEST_F(ConsumeBatchTest, SkippedMessages) {
+  MockConsumer consumer("localhost:9092", "testTopic", 0, new NiceMock<MockKafkaTopic>(), newKafkaConsumer(),
+                        consumerHelper_, offsetKey_);
+  consumer.setMessageFilter(MessageFilter({"keep"}, ""));
+  consumer.init(RdKafka::Topic::OFFSET_BEGINNING);
+  // skipped messages never reach processOne
+  EXPECT_CALL(consumer, processOne(_, _))
+      .Times(0);
+  EXPECT_CALL(consumer, processOne(Property(&RdKafka::Message::offset, 2), _))
+      .Times(1);
+
+  // a batch of skipped messages moves the committed offset past them
+  queue(0, "skip0");
+  queue(1, "skip1");
+  consumer.processBatch(1000);
+  EXPECT_EQ(2, consumerHelper_->loadCommittedOffsetFromDb(offsetKey_));
+
+  // a batch with a processed message is committed by the subclass with its own offset
+  queue(2, "keep2");
+  queue(3, "skip3");
+  consumer.processBatch(1000);
+  EXPECT_EQ(2, consumerHelper_->loadCommittedOffsetFromDb(offsetKey_));
+
+  queue(4, "skip4");
+  consumer.processBatch(1000);
+  EXPECT_EQ(5, consumerHelper_->loadCommittedOffsetFromDb(offsetKey_));
+}
+
 }  // namespace kafka
 }  // namespace infra
@@ -3,6 +3,7 @@
 
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "gmock/gmock.h"
@@ -42,6 +43,42 @@ class MockPartitionMetadata : public RdKafka::PartitionMetadata {
   MOCK_CONST_METHOD0(isrs, const std::vector<int32_t>*());
 };
 
+class MockKafkaMessage : public RdKafka::Message {
+ public:
+  MOCK_CONST_METHOD0(errstr, std::string());
+  MOCK_CONST_METHOD0(err, RdKafka::ErrorCode());
+  MOCK_CONST_METHOD0(topic, RdKafka::Topic*());
+  MOCK_CONST_METHOD0(topic_name, std::string());
+  MOCK_CONST_METHOD0(partition, int32_t());
+  MOCK_CONST_METHOD0(payload, void*());
+  MOCK_CONST_METHOD0(len, size_t());
+  MOCK_CONST_METHOD0(key, const std::string*());
+  MOCK_CONST_METHOD0(key_pointer, const void*());
+  MOCK_CONST_METHOD0(key_len, size_t());
+  MOCK_CONST_METHOD0(offset, int64_t());
+  MOCK_CONST_METHOD0(timestamp, RdKafka::MessageTimestamp());
+  MOCK_CONST_METHOD0(msg_opaque, void*());
+};
+
+// A message returned by the mock kafka consumer, which deletes it once consumed
+class TestMessage : public ::testing::NiceMock<MockKafkaMessage> {
+ public:
+  TestMessage(RdKafka::ErrorCode err, int64_t offset, std::string key, std::string payload)
+      : key_(std::move(key)), payload_(std::move(payload)) {
+    ON_CALL(*this, err()).WillByDefault(::testing::Return(err));
+    ON_CALL(*this, offset()).WillByDefault(::testing::Return(offset));
+    ON_CALL(*this, key()).WillByDefault(::testing::Return(&key_));
+    ON_CALL(*this, key_pointer()).WillByDefault(::testing::Return(key_.data()));
+    ON_CALL(*this, key_len()).WillByDefault(::testing::Return(key_.size()));
+    ON_CALL(*this, payload()).WillByDefault(::testing::Return(static_cast<void*>(&payload_[0])));
+    ON_CALL(*this, len()).WillByDefault(::testing::Return(payload_.size()));
+  }
+
+ private:
+  const std::string key_;
+  std::string payload_;
+};
+
 class MockKafkaConsumer : public RdKafka::KafkaConsumer {
  public:
   MOCK_CONST_METHOD0(name, const std::string());
@@ -79,9 +116,10 @@ class MockKafkaConsumer : public RdKafka::KafkaConsumer {
 class MockConsumer : public Consumer {
  public:
   MockConsumer(std::string brokerList, std::string topicStr, int partition, MockKafkaTopic* kafkaTopic,
-               MockKafkaConsumer* kafkaConsumer)
-      : infra::kafka::Consumer(brokerList, topicStr, partition, "infra-kafka-consumer-test", "test-key", false,
-                               nullptr),
+               MockKafkaConsumer* kafkaConsumer, std::shared_ptr<ConsumerHelper> consumerHelper = nullptr,
+               const std::string& offsetKey = "test-key")
+      : infra::kafka::Consumer(brokerList, topicStr, partition, "infra-kafka-consumer-test", offsetKey, false,
+                               consumerHelper),
         kafkaTopic_(kafkaTopic),
         kafkaConsumer_(kafkaConsumer) {}
 
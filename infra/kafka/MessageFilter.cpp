@@ -0,0 +1,27 @@
+#include "infra/kafka/MessageFilter.h"
+
+#include <cstring>
+#include <string>
+
+namespace infra {
+namespace kafka {
+
+namespace {
+
+bool hasPrefix(const void* data, size_t len, const std::string& prefix) {
+  return prefix.empty() || (len >= prefix.size() && memcmp(data, prefix.data(), prefix.size()) == 0);
+}
+
+}  // namespace
+
+bool MessageFilter::matches(const void* key, size_t keyLen, const void* payload, size_t len) const {
+  if (!hasPrefix(payload, len, payloadPrefix_)) return false;
+  if (keyPrefixes_.empty()) return true;
+  for (const auto& keyPrefix : keyPrefixes_) {
+    if (hasPrefix(key, keyLen, keyPrefix)) return true;
+  }
+  return false;
+}
+
+}  // namespace kafka
+}  // namespace infra
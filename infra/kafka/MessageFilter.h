@@ -0,0 +1,40 @@
+#ifndef INFRA_KAFKA_MESSAGEFILTER_H_
+#define INFRA_KAFKA_MESSAGEFILTER_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "librdkafka/rdkafkacpp.h"
+
+namespace infra {
+namespace kafka {
+
+// MessageFilter tells from the raw bytes of a kafka message whether a consumer cares about it, so that messages it
+// would discard are skipped before being decoded in processOne. A message matches when its key starts with any of the
+// key prefixes and its payload starts with the payload prefix. Empty rules match every message.
+class MessageFilter {
+ public:
+  MessageFilter() {}
+
+  MessageFilter(std::vector<std::string> keyPrefixes, std::string payloadPrefix)
+      : keyPrefixes_(std::move(keyPrefixes)), payloadPrefix_(std::move(payloadPrefix)) {}
+
+  bool empty() const { return keyPrefixes_.empty() && payloadPrefix_.empty(); }
+
+  bool matches(const void* key, size_t keyLen, const void* payload, size_t len) const;
+
+  // It reads the key in place, since RdKafka::Message::key copies it into a string
+  bool matches(const RdKafka::Message& msg) const {
+    return matches(msg.key_pointer(), msg.key_len(), msg.payload(), msg.len());
+  }
+
+ private:
+  std::vector<std::string> keyPrefixes_;
+  std::string payloadPrefix_;
+};
+
+}  // namespace kafka
+}  // namespace infra
+
+#endif  // INFRA_KAFKA_MESSAGEFILTER_H_
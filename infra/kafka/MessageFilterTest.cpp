@@ -0,0 +1,51 @@
+#include <string>
+
+#include "gtest/gtest.h"
+#include "infra/kafka/MessageFilter.h"
+
+namespace infra {
+namespace kafka {
+
+namespace {
+
+bool matches(const MessageFilter& filter, const std::string& key, const std::string& payload) {
+  return filter.matches(key.data(), key.size(), payload.data(), payload.size());
+}
+
+}  // namespace
+
+TEST(MessageFilter, Empty) {
+  MessageFilter filter;
+  EXPECT_TRUE(filter.empty());
+  EXPECT_TRUE(matches(filter, "", ""));
+  EXPECT_TRUE(filter.matches(nullptr, 0, nullptr, 0));
+  EXPECT_TRUE(matches(filter, "user:1", "payload"));
+}
+
+TEST(MessageFilter, KeyPrefixes) {
+  MessageFilter filter({"user:", "ip:"}, "");
+  EXPECT_FALSE(filter.empty());
+  EXPECT_TRUE(matches(filter, "user:1", "payload"));
+  EXPECT_TRUE(matches(filter, "ip:10.0.0.1", ""));
+  EXPECT_FALSE(matches(filter, "email:a@b.c", "payload"));
+  EXPECT_FALSE(matches(filter, "user", "payload"));
+  // messages without a key never match a key prefix
+  EXPECT_FALSE(filter.matches(nullptr, 0, "payload", 7));
+}
+
+TEST(MessageFilter, PayloadPrefix) {
+  MessageFilter filter({}, std::string("\x00\x00\x00\x00\x2a", 5));
+  EXPECT_TRUE(matches(filter, "", std::string("\x00\x00\x00\x00\x2a\x02", 6)));
+  EXPECT_FALSE(matches(filter, "", std::string("\x00\x00\x00\x00\x2b\x02", 6)));
+  EXPECT_FALSE(matches(filter, "", std::string("\x00\x00", 2)));
+}
+
+TEST(MessageFilter, KeyAndPayloadPrefixes) {
+  MessageFilter filter({"user:"}, "{");
+  EXPECT_TRUE(matches(filter, "user:1", "{}"));
+  EXPECT_FALSE(matches(filter, "user:1", "[]"));
+  EXPECT_FALSE(matches(filter, "ip:1", "{}"));
+}
+
+}  // namespace kafka
+}  // namespace infra
@@ -23,7 +23,8 @@ class OffsetManager {
         topicPartitions_(rd_kafka_topic_partition_list_new(1), rd_kafka_topic_partition_list_destroy) {}
 
   ~OffsetManager() {
-    rd_kafka_consumer_close(consumer_.get());
+    // init may have never been called, e.g., when the consumer only rewound its offsets
+    if (consumer_) rd_kafka_consumer_close(consumer_.get());
   }
 
   // Initialize offset manager. Panic on errors/failures.
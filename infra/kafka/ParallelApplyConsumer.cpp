@@ -0,0 +1,218 @@
+#include "infra/kafka/ParallelApplyConsumer.h"
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "glog/logging.h"
+#include "infra/Tracing.h"
+#include "rocksdb/slice.h"
+
+namespace infra {
+namespace kafka {
+
+namespace {
+
+// Copy every record of a write batch to another one
+class WriteBatchAppender : public rocksdb::WriteBatch::Handler {
+ public:
+  WriteBatchAppender(const ParallelApplyConsumer::ColumnFamilyMap& columnFamilies, rocksdb::WriteBatch* target)
+      : columnFamilies_(columnFamilies), target_(target) {}
+
+  rocksdb::Status PutCF(uint32_t columnFamilyId, const rocksdb::Slice& key, const rocksdb::Slice& value) override {
+    rocksdb::ColumnFamilyHandle* columnFamily;
+    if (!getColumnFamily(columnFamilyId, &columnFamily)) return unknownColumnFamily(columnFamilyId);
+    target_->Put(columnFamily, key, value);
+    return rocksdb::Status::OK();
+  }
+
+  rocksdb::Status DeleteCF(uint32_t columnFamilyId, const rocksdb::Slice& key) override {
+    rocksdb::ColumnFamilyHandle* columnFamily;
+    if (!getColumnFamily(columnFamilyId, &columnFamily)) return unknownColumnFamily(columnFamilyId);
+    target_->Delete(columnFamily, key);
+    return rocksdb::Status::OK();
+  }
+
+  rocksdb::Status SingleDeleteCF(uint32_t columnFamilyId, const rocksdb::Slice& key) override {
+    rocksdb::ColumnFamilyHandle* columnFamily;
+    if (!getColumnFamily(columnFamilyId, &columnFamily)) return unknownColumnFamily(columnFamilyId);
+    target_->SingleDelete(columnFamily, key);
+    return rocksdb::Status::OK();
+  }
+
+  rocksdb::Status DeleteRangeCF(uint32_t columnFamilyId, const rocksdb::Slice& beginKey,
+                                const rocksdb::Slice& endKey) override {
+    rocksdb::ColumnFamilyHandle* columnFamily;
+    if (!getColumnFamily(columnFamilyId, &columnFamily)) return unknownColumnFamily(columnFamilyId);
+    target_->DeleteRange(columnFamily, beginKey, endKey);
+    return rocksdb::Status::OK();
+  }
+
+  rocksdb::Status MergeCF(uint32_t columnFamilyId, const rocksdb::Slice& key, const rocksdb::Slice& value) override {
+    rocksdb::ColumnFamilyHandle* columnFamily;
+    if (!getColumnFamily(columnFamilyId, &columnFamily)) return unknownColumnFamily(columnFamilyId);
+    target_->Merge(columnFamily, key, value);
+    return rocksdb::Status::OK();
+  }
+
+  void LogData(const rocksdb::Slice& blob) override { target_->PutLogData(blob); }
+
+ private:
+  // A null handle stands for the default column family in WriteBatch
+  bool getColumnFamily(uint32_t columnFamilyId, rocksdb::ColumnFamilyHandle** columnFamily) const {
+    if (columnFamilyId == 0) {
+      *columnFamily = nullptr;
+      return true;
+    }
+    const auto it = columnFamilies_.find(columnFamilyId);
+    if (it == columnFamilies_.end()) return false;
+    *columnFamily = it->second;
+    return true;
+  }
+
+  static rocksdb::Status unknownColumnFamily(uint32_t columnFamilyId) {
+    return rocksdb::Status::InvalidArgument("Unknown column family ID", std::to_string(columnFamilyId));
+  }
+
+  const ParallelApplyConsumer::ColumnFamilyMap& columnFamilies_;
+  rocksdb::WriteBatch* target_;
+};
+
+ParallelApplyConsumer::ColumnFamilyMap makeColumnFamilyMap(
+    const std::vector<rocksdb::ColumnFamilyHandle*>& columnFamilies) {
+  ParallelApplyConsumer::ColumnFamilyMap columnFamilyMap;
+  for (auto* columnFamily : columnFamilies) {
+    columnFamilyMap[columnFamily->GetID()] = columnFamily;
+  }
+  return columnFamilyMap;
+}
+
+}  // namespace
+
+ParallelApplyConsumer::ParallelApplyConsumer(const std::string& brokerList, const std::string& topicStr, int partition,
+                                             const std::string& groupId, const std::string& offsetKey, bool lowLatency,
+                                             std::shared_ptr<infra::kafka::ConsumerHelper> consumerHelper,
+                                             size_t workerCount,
+                                             const std::vector<rocksdb::ColumnFamilyHandle*>& columnFamilies)
+    : Consumer(brokerList, topicStr, partition, groupId, offsetKey, lowLatency, consumerHelper),
+      columnFamilies_(makeColumnFamilyMap(columnFamilies)),
+      workers_(std::max<size_t>(workerCount, 1)) {
+  for (size_t i = 1; i < workers_.size(); i++) {
+    threads_.emplace_back(&ParallelApplyConsumer::runWorker, this, i);
+    pthread_setname_np(threads_.back().native_handle(), "kafka-apply");
+  }
+}
+
+ParallelApplyConsumer::~ParallelApplyConsumer() {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    stopWorkers_ = true;
+  }
+  workCv_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+rocksdb::Status ParallelApplyConsumer::appendWriteBatch(const rocksdb::WriteBatch& source,
+                                                        const ColumnFamilyMap& columnFamilies,
+                                                        rocksdb::WriteBatch* target) {
+  WriteBatchAppender appender(columnFamilies, target);
+  return source.Iterate(&appender);
+}
+
+size_t ParallelApplyConsumer::getWorkerIndex(const std::string& key, size_t workerCount) {
+  return std::hash<std::string>()(key) % workerCount;
+}
+
+void ParallelApplyConsumer::processBatch(int timeoutMs) {
+  messages_.clear();
+  nextOffset_ = -1;
+  consumeBatch(timeoutMs, nullptr);
+  if (nextOffset_ < 0) return;
+  if (messages_.empty()) {
+    // every message was skipped, which still moves the offset forward
+    CHECK(consumerHelper()->commitNextProcessOffset(offsetKey(), nextOffset_))
+        << "Committing skipped messages up to offset " << nextOffset_ - 1 << " failed";
+    return;
+  }
+
+  ConsumerMetrics::StageTimer processTimer(metrics(), ConsumerMetrics::Stage::kProcess);
+  for (auto& worker : workers_) {
+    worker.messages.clear();
+    worker.writeBatch.Clear();
+  }
+  for (const auto& msg : messages_) {
+    workers_[getWorkerIndex(msg.key, workers_.size())].messages.push_back(&msg);
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    generation_++;
+    pendingWorkers_ = threads_.size();
+  }
+  workCv_.notify_all();
+  TRACE_CALL("KafkaConsumer#applyParallel", applyAll());
+  processTimer.stop();
+
+  // The batches of the other workers are appended to the first one, which is committed with the offset
+  rocksdb::WriteBatch* writeBatch = &workers_[0].writeBatch;
+  for (size_t i = 1; i < workers_.size(); i++) {
+    rocksdb::Status status = appendWriteBatch(workers_[i].writeBatch, columnFamilies_, writeBatch);
+    CHECK(status.ok()) << "Merging write batches of workers failed: " << status.ToString();
+  }
+  CHECK(consumerHelper()->commitNextProcessOffset(offsetKey(), nextOffset_, writeBatch))
+      << "Committing messages up to offset " << nextOffset_ - 1 << " failed";
+}
+
+void ParallelApplyConsumer::processOne(const RdKafka::Message& msg, void* opaque) {
+  BufferedMessage buffered{msg.offset(), extractKey(msg), std::string()};
+  if (msg.len() > 0) {
+    buffered.payload.assign(static_cast<const char*>(msg.payload()), msg.len());
+  }
+  messages_.push_back(std::move(buffered));
+  nextOffset_ = msg.offset() + 1;
+}
+
+void ParallelApplyConsumer::processSkipped(const RdKafka::Message& msg, void* opaque) {
+  nextOffset_ = msg.offset() + 1;
+}
+
+void ParallelApplyConsumer::runWorker(size_t index) {
+  uint64_t generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      workCv_.wait(lock, [this, generation]() { return stopWorkers_ || generation_ != generation; });
+      if (stopWorkers_) return;
+      generation = generation_;
+    }
+    applyMessages(&workers_[index]);
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      pendingWorkers_--;
+    }
+    doneCv_.notify_one();
+  }
+}
+
+void ParallelApplyConsumer::applyAll() {
+  applyMessages(&workers_[0]);
+  std::unique_lock<std::mutex> lock(mutex_);
+  doneCv_.wait(lock, [this]() { return pendingWorkers_ == 0; });
+}
+
+void ParallelApplyConsumer::applyMessages(Worker* worker) {
+  for (const auto* msg : worker->messages) {
+    applyOne(*msg, &worker->writeBatch);
+  }
+}
+
+}  // namespace kafka
+}  // namespace infra
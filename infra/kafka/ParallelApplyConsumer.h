@@ -0,0 +1,102 @@
+#ifndef INFRA_KAFKA_PARALLELAPPLYCONSUMER_H_
+#define INFRA_KAFKA_PARALLELAPPLYCONSUMER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "infra/kafka/Consumer.h"
+#include "librdkafka/rdkafkacpp.h"
+#include "rocksdb/db.h"
+#include "rocksdb/status.h"
+#include "rocksdb/write_batch.h"
+
+namespace infra {
+namespace kafka {
+
+// ParallelApplyConsumer spreads the messages of a single partition over a pool of workers by the hash of their keys,
+// for partitions too hot for one processOne thread. Each worker applies its messages in offset order to its own
+// WriteBatch, so messages with the same key keep their order. Once every worker is done, the batches are written
+// together with the next offset in one atomic write, like a sequential consumer committing its WriteBatch.
+//
+// Subclasses implement applyOne instead of processOne, and may override extractKey.
+class ParallelApplyConsumer : public Consumer {
+ public:
+  // Column families by ID, which is all write batch records refer to
+  using ColumnFamilyMap = std::unordered_map<uint32_t, rocksdb::ColumnFamilyHandle*>;
+
+  // A message copied out of librdkafka, which frees its messages as soon as they are consumed
+  struct BufferedMessage {
+    int64_t offset;
+    std::string key;
+    std::string payload;
+  };
+
+  ParallelApplyConsumer(const std::string& brokerList, const std::string& topicStr, int partition,
+                        const std::string& groupId, const std::string& offsetKey, bool lowLatency,
+                        std::shared_ptr<infra::kafka::ConsumerHelper> consumerHelper, size_t workerCount,
+                        const std::vector<rocksdb::ColumnFamilyHandle*>& columnFamilies = {});
+
+  ~ParallelApplyConsumer() override;
+
+  // Append the records of source to target, in order. Records of column families other than the default one must be
+  // in columnFamilies.
+  static rocksdb::Status appendWriteBatch(const rocksdb::WriteBatch& source, const ColumnFamilyMap& columnFamilies,
+                                          rocksdb::WriteBatch* target);
+
+  // Worker applying the messages of a key
+  static size_t getWorkerIndex(const std::string& key, size_t workerCount);
+
+  void processBatch(int timeoutMs) override;
+
+  // Messages are ordered only among those with the same key, which is the kafka message key by default
+  virtual std::string extractKey(const RdKafka::Message& msg) {
+    return msg.key() ? *msg.key() : std::string();
+  }
+
+  // Apply one message to the write batch of a worker. It is called concurrently for messages of different keys, and
+  // may only write to the default column family and those passed to the constructor.
+  virtual void applyOne(const BufferedMessage& msg, rocksdb::WriteBatch* writeBatch) = 0;
+
+  // Buffer the message for the workers
+  void processOne(const RdKafka::Message& msg, void* opaque) final;
+
+  // Skipped messages are committed along with the batch
+  void processSkipped(const RdKafka::Message& msg, void* opaque) final;
+
+ private:
+  struct Worker {
+    std::vector<const BufferedMessage*> messages;
+    rocksdb::WriteBatch writeBatch;
+  };
+
+  void runWorker(size_t index);
+  // Apply the messages of the first worker and wait for the others
+  void applyAll();
+  void applyMessages(Worker* worker);
+
+  std::vector<BufferedMessage> messages_;
+  // Offset following the last message consumed in the batch, whether buffered or skipped, or -1 if there is none
+  int64_t nextOffset_ = -1;
+  const ColumnFamilyMap columnFamilies_;
+  std::vector<Worker> workers_;
+  // The consumer thread applies the messages of the first worker itself
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable workCv_;
+  std::condition_variable doneCv_;
+  // Incremented for every batch handed to the workers
+  uint64_t generation_ = 0;
+  size_t pendingWorkers_ = 0;
+  bool stopWorkers_ = false;
+};
+
+}  // namespace kafka
+}  // namespace infra
+
+#endif  // INFRA_KAFKA_PARALLELAPPLYCONSUMER_H_
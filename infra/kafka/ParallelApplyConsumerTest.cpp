@@ -0,0 +1,313 @@
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "infra/kafka/ConsumerHelper.h"
+#include "infra/kafka/ConsumerTest.h"
+#include "infra/kafka/MessageFilter.h"
+#include "infra/kafka/ParallelApplyConsumer.h"
+#include "librdkafka/rdkafkacpp.h"
+#include "rocksdb/db.h"
+#include "rocksdb/write_batch.h"
+#include "stesting/TestWithRocksDb.h"
+
+namespace infra {
+namespace kafka {
+
+using ::testing::_;
+using ::testing::Invoke;
+using ::testing::NiceMock;
+using ::testing::Return;
+
+namespace {
+
+// Writes the payload of every message to its key in the given column family, and records the offsets applied to each
+// key in order
+class RecordingConsumer : public ParallelApplyConsumer {
+ public:
+  RecordingConsumer(std::shared_ptr<ConsumerHelper> consumerHelper, const std::string& offsetKey, size_t workerCount,
+                    rocksdb::ColumnFamilyHandle* columnFamily)
+      : ParallelApplyConsumer("localhost:9092", "testTopic", 0, "infra-kafka-consumer-test", offsetKey, false,
+                              consumerHelper, workerCount, {columnFamily}),
+        columnFamily_(columnFamily) {
+    ON_CALL(topicMetadata_, topic()).WillByDefault(Return("testTopic"));
+    ON_CALL(topicMetadata_, partitions()).WillByDefault(Return(&partitions_));
+  }
+
+  void applyOne(const BufferedMessage& msg, rocksdb::WriteBatch* writeBatch) override {
+    if (onApply) onApply(msg);
+    writeBatch->Put(columnFamily_, msg.key, msg.payload);
+    std::lock_guard<std::mutex> guard(mutex_);
+    appliedOffsets_[msg.key].push_back(msg.offset);
+    appliedThreads_[msg.key].insert(std::this_thread::get_id());
+  }
+
+  std::map<std::string, std::vector<int64_t>> appliedOffsets() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return appliedOffsets_;
+  }
+
+  std::map<std::string, std::set<std::thread::id>> appliedThreads() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return appliedThreads_;
+  }
+
+  // Called by workers before applying each message
+  std::function<void(const BufferedMessage& msg)> onApply;
+  // Returned by consume in order, followed by the end of the partition
+  std::deque<RdKafka::Message*> pendingMessages;
+
+ protected:
+  std::unique_ptr<RdKafka::Topic> createKafkaTopic(RdKafka::KafkaConsumer* consumer, const std::string& topicStr,
+                                                   RdKafka::Conf* topicConf, std::string* errstr) override {
+    return std::unique_ptr<RdKafka::Topic>(new NiceMock<MockKafkaTopic>());
+  }
+
+  std::unique_ptr<RdKafka::KafkaConsumer> createKafkaConsumer(RdKafka::Conf* conf, std::string* errstr) override {
+    auto* kafkaConsumer = new NiceMock<MockKafkaConsumer>();
+    ON_CALL(*kafkaConsumer, metadata(_, _, _, _))
+        .WillByDefault(Invoke([this](bool allTopics, const RdKafka::Topic* topic, RdKafka::Metadata** metadata, int) {
+          // init deletes the metadata once verified
+          auto* kafkaMetadata = new NiceMock<MockKafkaMetadata>();
+          ON_CALL(*kafkaMetadata, topics()).WillByDefault(Return(&topics_));
+          *metadata = kafkaMetadata;
+          return RdKafka::ERR_NO_ERROR;
+        }));
+    ON_CALL(*kafkaConsumer, assign(_)).WillByDefault(Return(RdKafka::ERR_NO_ERROR));
+    ON_CALL(*kafkaConsumer, consume(_)).WillByDefault(Invoke([this](int timeoutMs) -> RdKafka::Message* {
+      if (pendingMessages.empty()) return new TestMessage(RdKafka::ERR__PARTITION_EOF, -1, "", "");
+      RdKafka::Message* msg = pendingMessages.front();
+      pendingMessages.pop_front();
+      return msg;
+    }));
+    return std::unique_ptr<RdKafka::KafkaConsumer>(kafkaConsumer);
+  }
+
+ private:
+  // A topic with a single partition
+  NiceMock<MockPartitionMetadata> partitionMetadata_;
+  RdKafka::TopicMetadata::PartitionMetadataVector partitions_{&partitionMetadata_};
+  NiceMock<MockKafkaTopicMetadata> topicMetadata_;
+  RdKafka::Metadata::TopicMetadataVector topics_{&topicMetadata_};
+  rocksdb::ColumnFamilyHandle* columnFamily_;
+  std::mutex mutex_;
+  std::map<std::string, std::vector<int64_t>> appliedOffsets_;
+  std::map<std::string, std::set<std::thread::id>> appliedThreads_;
+};
+
+}  // namespace
+
+class ParallelApplyConsumerTest : public stesting::TestWithRocksDb {
+ protected:
+  ParallelApplyConsumerTest() : stesting::TestWithRocksDb({"parallel"}) {}
+
+  void SetUp() override {
+    stesting::TestWithRocksDb::SetUp();
+    consumerHelper_ = std::make_shared<ConsumerHelper>(db(), metadataColumnFamily());
+    offsetKey_ = consumerHelper_->linkTopicPartition("testTopic", 0, "test");
+  }
+
+  std::unique_ptr<RecordingConsumer> newConsumer(size_t workerCount) {
+    std::unique_ptr<RecordingConsumer> consumer(
+        new RecordingConsumer(consumerHelper_, offsetKey_, workerCount, columnFamily("parallel")));
+    consumer->init(RdKafka::Topic::OFFSET_BEGINNING);
+    return consumer;
+  }
+
+  static RdKafka::Message* message(int64_t offset, const std::string& key, const std::string& payload) {
+    return new TestMessage(RdKafka::ERR_NO_ERROR, offset, key, payload);
+  }
+
+  // Offset committed to the database, or -1 if there is none
+  int64_t committedOffset() {
+    std::string value;
+    rocksdb::Status status = db()->Get(rocksdb::ReadOptions(), metadataColumnFamily(), offsetKey_, &value);
+    return status.ok() ? ConsumerHelper::decodeOffset(value) : -1;
+  }
+
+  std::string get(const std::string& key) {
+    std::string value;
+    rocksdb::Status status = db()->Get(rocksdb::ReadOptions(), columnFamily("parallel"), key, &value);
+    return status.ok() ? value : "";
+  }
+
+  std::shared_ptr<ConsumerHelper> consumerHelper_;
+  std::string offsetKey_;
+};
+
+TEST_F(ParallelApplyConsumerTest, AppendWriteBatch) {
+  ParallelApplyConsumer::ColumnFamilyMap columnFamilies{{metadataColumnFamily()->GetID(), metadataColumnFamily()}};
+  rocksdb::WriteBatch writeBatch;
+  writeBatch.Put("a", "1");
+  writeBatch.Put("b", "1");
+  writeBatch.Put("c", "1");
+  writeBatch.Put("d", "1");
+  rocksdb::WriteBatch source;
+  source.Put(metadataColumnFamily(), "offset", "3");
+  source.Delete("b");
+  source.SingleDelete("c");
+  source.DeleteRange("d", "e");
+
+  ASSERT_TRUE(ParallelApplyConsumer::appendWriteBatch(source, columnFamilies, &writeBatch).ok());
+  EXPECT_EQ(8, writeBatch.Count());
+  commitWriteBatch(&writeBatch);
+
+  std::string value;
+  ASSERT_TRUE(db()->Get(rocksdb::ReadOptions(), "a", &value).ok());
+  EXPECT_EQ("1", value);
+  // records keep their order
+  EXPECT_TRUE(db()->Get(rocksdb::ReadOptions(), "b", &value).IsNotFound());
+  EXPECT_TRUE(db()->Get(rocksdb::ReadOptions(), "c", &value).IsNotFound());
+  EXPECT_TRUE(db()->Get(rocksdb::ReadOptions(), "d", &value).IsNotFound());
+  ASSERT_TRUE(db()->Get(rocksdb::ReadOptions(), metadataColumnFamily(), "offset", &value).ok());
+  EXPECT_EQ("3", value);
+
+  // merges are copied too, though the column families here have no merge operator to commit them
+  rocksdb::WriteBatch merges;
+  merges.Merge("a", "1");
+  rocksdb::WriteBatch target;
+  ASSERT_TRUE(ParallelApplyConsumer::appendWriteBatch(merges, columnFamilies, &target).ok());
+  EXPECT_EQ(1, target.Count());
+
+  // records of unknown column families are rejected rather than written to the default one
+  EXPECT_TRUE(ParallelApplyConsumer::appendWriteBatch(source, {}, &target).IsInvalidArgument());
+}
+
+TEST_F(ParallelApplyConsumerTest, ProcessBatch) {
+  auto consumer = newConsumer(4);
+  for (int i = 0; i < 20; i++) {
+    consumer->pendingMessages.push_back(message(100 + i, "key" + std::to_string(i), "value" + std::to_string(i)));
+  }
+  consumer->processBatch(1000);
+  EXPECT_EQ(120, committedOffset());
+  for (int i = 0; i < 20; i++) {
+    EXPECT_EQ("value" + std::to_string(i), get("key" + std::to_string(i)));
+  }
+
+  // an empty batch commits nothing
+  consumer->processBatch(1000);
+  EXPECT_EQ(120, committedOffset());
+}
+
+TEST_F(ParallelApplyConsumerTest, PerKeyOrder) {
+  auto consumer = newConsumer(4);
+  // interleave the messages of a few keys, one of which is slow to apply
+  for (int i = 0; i < 300; i++) {
+    consumer->pendingMessages.push_back(message(i, "key" + std::to_string(i % 3), std::to_string(i)));
+  }
+  consumer->onApply = [](const ParallelApplyConsumer::BufferedMessage& msg) {
+    if (msg.key == "key0") std::this_thread::sleep_for(std::chrono::microseconds(100));
+  };
+  consumer->processBatch(1000);
+
+  auto appliedOffsets = consumer->appliedOffsets();
+  auto appliedThreads = consumer->appliedThreads();
+  ASSERT_EQ(3, appliedOffsets.size());
+  for (int k = 0; k < 3; k++) {
+    std::string key = "key" + std::to_string(k);
+    const auto& offsets = appliedOffsets[key];
+    ASSERT_EQ(100, offsets.size());
+    for (int i = 0; i < 100; i++) {
+      EXPECT_EQ(i * 3 + k, offsets[i]);
+    }
+    EXPECT_EQ(1, appliedThreads[key].size());
+    // the last message of the key wins, whichever worker's batch comes first
+    EXPECT_EQ(std::to_string(297 + k), get(key));
+  }
+  EXPECT_EQ(300, committedOffset());
+}
+
+TEST_F(ParallelApplyConsumerTest, CommitAfterAllWorkers) {
+  auto consumer = newConsumer(4);
+  std::mutex mutex;
+  std::vector<int64_t> committedWhileApplying;
+  consumer->onApply = [this, &mutex, &committedWhileApplying](const ParallelApplyConsumer::BufferedMessage& msg) {
+    // keep some workers busy long after the others are done
+    if (msg.key.back() == '0') std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    int64_t offset = committedOffset();
+    std::lock_guard<std::mutex> guard(mutex);
+    committedWhileApplying.push_back(offset);
+  };
+
+  int64_t offset = 0;
+  for (int batch = 0; batch < 5; batch++) {
+    committedWhileApplying.clear();
+    for (int i = 0; i < 40; i++) {
+      consumer->pendingMessages.push_back(message(offset++, "key" + std::to_string(i), std::to_string(batch)));
+    }
+    consumer->processBatch(1000);
+
+    // no worker sees the batch committed, and every worker's writes are committed with the offset
+    ASSERT_EQ(40, committedWhileApplying.size());
+    for (int64_t committed : committedWhileApplying) {
+      EXPECT_EQ(batch == 0 ? -1 : offset - 40, committed);
+    }
+    EXPECT_EQ(offset, committedOffset());
+    for (int i = 0; i < 40; i++) {
+      EXPECT_EQ(std::to_string(batch), get("key" + std::to_string(i)));
+    }
+  }
+}
+
+TEST_F(ParallelApplyConsumerTest, IdleWorkers) {
+  // every batch wakes all workers, including those with no messages, which must still report back
+  auto consumer = newConsumer(8);
+  for (int batch = 0; batch < 50; batch++) {
+    consumer->pendingMessages.push_back(message(batch, "key", std::to_string(batch)));
+    consumer->processBatch(1000);
+    ASSERT_EQ(batch + 1, committedOffset());
+  }
+  auto appliedOffsets = consumer->appliedOffsets();
+  // each message is applied once, by the same worker
+  EXPECT_EQ(50, appliedOffsets["key"].size());
+  EXPECT_EQ(1, consumer->appliedThreads()["key"].size());
+  EXPECT_EQ("49", get("key"));
+}
+
+TEST_F(ParallelApplyConsumerTest, SkippedMessages) {
+  auto consumer = newConsumer(2);
+  consumer->setMessageFilter(MessageFilter({"keep"}, ""));
+  consumer->pendingMessages.push_back(message(0, "skip0", "0"));
+  consumer->pendingMessages.push_back(message(1, "skip1", "1"));
+  consumer->processBatch(1000);
+  // skipped messages still move the offset forward
+  EXPECT_EQ(2, committedOffset());
+  EXPECT_TRUE(consumer->appliedOffsets().empty());
+
+  consumer->pendingMessages.push_back(message(2, "keep2", "2"));
+  consumer->pendingMessages.push_back(message(3, "skip3", "3"));
+  consumer->processBatch(1000);
+  EXPECT_EQ(4, committedOffset());
+  EXPECT_EQ("2", get("keep2"));
+  EXPECT_EQ("", get("skip3"));
+}
+
+TEST_F(ParallelApplyConsumerTest, WorkerIndex) {
+  for (size_t workerCount : {1, 4, 7}) {
+    std::vector<bool> used(workerCount, false);
+    for (int i = 0; i < 100; i++) {
+      std::string key = "key" + std::to_string(i);
+      size_t index = ParallelApplyConsumer::getWorkerIndex(key, workerCount);
+      ASSERT_LT(index, workerCount);
+      // the same key always goes to the same worker
+      EXPECT_EQ(index, ParallelApplyConsumer::getWorkerIndex(key, workerCount));
+      used[index] = true;
+    }
+    for (bool workerUsed : used) {
+      EXPECT_TRUE(workerUsed);
+    }
+  }
+}
+
+}  // namespace kafka
+}  // namespace infra
@@ -1,7 +1,9 @@
 #include "infra/kafka/Producer.h"
 
+#include <chrono>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "glog/logging.h"
 #include "infra/kafka/EventCallback.h"
@@ -10,6 +12,13 @@
 namespace infra {
 namespace kafka {
 
+namespace {
+
+// How long to serve delivery reports for when the send queue is full, before retrying
+constexpr int kQueueFullPollMs = 10;
+
+}  // namespace
+
 void Producer::initialize() {
   setConf("metadata.broker.list", brokerList_);
   // disable verbose logging
@@ -78,5 +87,64 @@ void Producer::initialize() {
   LOG(INFO) << "Kafka producer initialized: " << producer_->name();
 }
 
+size_t Producer::produceBatchAsync(const std::vector<BatchMessage>& messages, int partition,
+                                   std::vector<RdKafka::ErrorCode>* errors, int queueFullTimeoutMs) {
+  errors->assign(messages.size(), RdKafka::ERR_NO_ERROR);
+  size_t enqueued = 0;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(queueFullTimeoutMs);
+  for (size_t i = 0; i < messages.size(); i++) {
+    const auto& message = messages[i];
+    RdKafka::ErrorCode errorCode;
+    while ((errorCode = produceAsync(message.payload, message.len, partition, message.key, message.msgOpaque)) ==
+           RdKafka::ERR__QUEUE_FULL) {
+      if (std::chrono::steady_clock::now() >= deadline) break;
+      // Delivery reports release the space of acknowledged messages
+      producer_->poll(kQueueFullPollMs);
+    }
+    if (errorCode == RdKafka::ERR__QUEUE_FULL) {
+      // Give up on the rest of the batch rather than waiting for each message in turn
+      for (size_t j = i; j < messages.size(); j++) {
+        (*errors)[j] = RdKafka::ERR__QUEUE_FULL;
+      }
+      break;
+    }
+    (*errors)[i] = errorCode;
+    if (errorCode == RdKafka::ERR_NO_ERROR) {
+      enqueued++;
+      // The timeout applies to a lack of progress, not to the whole batch
+      deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(queueFullTimeoutMs);
+    }
+  }
+  // Serve the delivery reports of earlier batches without blocking
+  producer_->poll(0);
+  return enqueued;
+}
+
+void Producer::produceBatchFatalOnError(const std::vector<std::string>& msgs, int partition) {
+  std::vector<BatchMessage> pending;
+  pending.reserve(msgs.size());
+  for (const auto& msg : msgs) {
+    pending.push_back(BatchMessage{msg.data(), msg.size()});
+  }
+
+  std::vector<RdKafka::ErrorCode> errors;
+  while (!pending.empty()) {
+    produceBatchAsync(pending, partition, &errors);
+    std::vector<BatchMessage> retries;
+    for (size_t i = 0; i < pending.size(); i++) {
+      if (errors[i] == RdKafka::ERR__QUEUE_FULL) {
+        retries.push_back(pending[i]);
+      } else if (errors[i] != RdKafka::ERR_NO_ERROR) {
+        LOG(FATAL) << "Error producing kafka message: " << RdKafka::err2str(errors[i]);
+      }
+    }
+    if (!retries.empty()) {
+      LOG(WARNING) << "Producing kafka messages too fast. " << retries.size() << " of " << pending.size()
+                   << " messages are waiting for the send queue";
+    }
+    pending.swap(retries);
+  }
+}
+
 }  // namespace kafka
 }  // namespace infra
@@ -7,6 +7,7 @@
 #include <thread>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "glog/logging.h"
 #include "infra/kafka/EventCallback.h"
@@ -42,6 +43,14 @@ class Producer : public RdKafka::PartitionerCb, public RdKafka::DeliveryReportCb
     std::unordered_map<std::string, std::string> topicConfigs;
   };
 
+  // One message of a batch, with the same semantics as the arguments of produceAsync
+  struct BatchMessage {
+    const void* payload;
+    size_t len;
+    const std::string* key = nullptr;
+    void* msgOpaque = nullptr;
+  };
+
   Producer(const std::string& brokerList, const std::string& topicStr, Config config)
       : brokerList_(brokerList),
         topicStr_(topicStr),
@@ -124,6 +133,31 @@ class Producer : public RdKafka::PartitionerCb, public RdKafka::DeliveryReportCb
     produceAsyncFatalOnError(msg, partition_);
   }
 
+  // produceBatchAsync enqueues many messages for the topic, e.g., for a fan-out. `errors` is resized to hold the
+  // result of each message, and the number of enqueued messages is returned.
+  // Messages are copied and enqueued one at a time like produceAsync, since the C++ API of librdkafka 0.9 has no batch
+  // call. What differs from produceAsyncFatalOnError is a full send queue: delivery reports are served to free it up
+  // and only the messages not yet enqueued are retried, rather than sleeping for a second. Those still not enqueued
+  // after `queueFullTimeoutMs` without progress are left with ERR__QUEUE_FULL, so the caller may retry them later. Any
+  // other error only fails the message concerned.
+  size_t produceBatchAsync(const std::vector<BatchMessage>& messages, int partition,
+                           std::vector<RdKafka::ErrorCode>* errors, int queueFullTimeoutMs = 1000);
+
+  // An overloaded produceBatchAsync function that uses the pre-configured partition
+  size_t produceBatchAsync(const std::vector<BatchMessage>& messages, std::vector<RdKafka::ErrorCode>* errors,
+                           int queueFullTimeoutMs = 1000) {
+    return produceBatchAsync(messages, partition_, errors, queueFullTimeoutMs);
+  }
+
+  // The batch counterpart of produceAsyncFatalOnError, which waits for queue space as long as it takes and calls
+  // LOG(FATAL) on any other error
+  void produceBatchFatalOnError(const std::vector<std::string>& msgs, int partition);
+
+  // An overloaded produceBatchFatalOnError function that uses the pre-configured partition
+  void produceBatchFatalOnError(const std::vector<std::string>& msgs) {
+    produceBatchFatalOnError(msgs, partition_);
+  }
+
   // Wait for the all the outstanding messages and sent/ack'd by brokers.
   // NOTE that using produceAsync + waitForAck is not equivalent to a sync API since the library's send queue
   // introduces delays to batch messages before sending, which implies additional delays when the intention is to send
@@ -147,6 +181,18 @@ class Producer : public RdKafka::PartitionerCb, public RdKafka::DeliveryReportCb
     return partition_ >= 0 && partition_ != RdKafka::Topic::PARTITION_UA;
   }
 
+ protected:
+  // Use the given kafka producer and topic, e.g., mocks in tests, instead of connecting to the brokers
+  Producer(std::unique_ptr<RdKafka::Producer> producer, std::unique_ptr<RdKafka::Topic> topic, Config config)
+      : partition_(config.partition),
+        partitioner_(config.partitioner),
+        useCompression_(config.useCompression),
+        lowLatency_(config.lowLatency),
+        topicConfigs_(std::move(config.topicConfigs)),
+        deliveryHandler_(config.deliveryHandler),
+        producer_(std::move(producer)),
+        topic_(std::move(topic)) {}
+
  private:
   void initialize();
 
@@ -0,0 +1,159 @@
+#include "infra/kafka/Producer.h"
+
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "librdkafka/rdkafkacpp.h"
+
+namespace infra {
+namespace kafka {
+
+using ::testing::_;
+using ::testing::Args;
+using ::testing::InSequence;
+using ::testing::IsNull;
+using ::testing::NiceMock;
+using ::testing::Return;
+
+// Matches the payload and length arguments of produce
+MATCHER_P(PayloadIs, msg, "") {
+  return std::string(static_cast<const char*>(std::get<0>(arg)), std::get<1>(arg)) == msg;
+}
+
+class MockKafkaProducer : public RdKafka::Producer {
+ public:
+  MOCK_CONST_METHOD0(name, const std::string());
+  MOCK_CONST_METHOD0(memberid, const std::string());
+  MOCK_METHOD1(poll, int(int));
+  MOCK_METHOD0(outq_len, int());
+  MOCK_METHOD4(metadata, RdKafka::ErrorCode(bool, const RdKafka::Topic*, RdKafka::Metadata**, int timeout_ms));
+  MOCK_METHOD1(pause, RdKafka::ErrorCode(std::vector<RdKafka::TopicPartition*>&));
+  MOCK_METHOD1(resume, RdKafka::ErrorCode(std::vector<RdKafka::TopicPartition*>&));
+  MOCK_METHOD5(query_watermark_offsets, RdKafka::ErrorCode(const std::string&, int32_t, int64_t*, int64_t*, int));
+  MOCK_METHOD4(get_watermark_offsets, RdKafka::ErrorCode(const std::string&, int32_t, int64_t*, int64_t*));
+  MOCK_METHOD2(offsetsForTimes, RdKafka::ErrorCode(std::vector<RdKafka::TopicPartition*>&, int));
+  MOCK_METHOD1(get_partition_queue, RdKafka::Queue*(const RdKafka::TopicPartition*));
+  MOCK_METHOD1(set_log_queue, RdKafka::ErrorCode(RdKafka::Queue*));
+  MOCK_METHOD7(produce, RdKafka::ErrorCode(RdKafka::Topic*, int32_t, int, void*, size_t, const std::string*, void*));
+  MOCK_METHOD8(produce,
+               RdKafka::ErrorCode(RdKafka::Topic*, int32_t, int, void*, size_t, const void*, size_t, void*));
+  MOCK_METHOD9(produce, RdKafka::ErrorCode(const std::string, int32_t, int, void*, size_t, const void*, size_t,
+                                           int64_t, void*));
+  MOCK_METHOD5(produce, RdKafka::ErrorCode(RdKafka::Topic*, int32_t, const std::vector<char>*,
+                                           const std::vector<char>*, void*));
+  MOCK_METHOD1(flush, RdKafka::ErrorCode(int));
+};
+
+// A producer enqueuing to the mock instead of the brokers
+class MockedProducer : public Producer {
+ public:
+  explicit MockedProducer(MockKafkaProducer* kafkaProducer)
+      : Producer(std::unique_ptr<RdKafka::Producer>(kafkaProducer), nullptr, Config()) {}
+};
+
+class ProducerTest : public ::testing::Test {
+ protected:
+  ProducerTest() : kafkaProducer_(new NiceMock<MockKafkaProducer>()), producer_(kafkaProducer_) {}
+
+  // Expect the message to be produced to the partition once, with the given result
+  void expectProduce(const std::string& msg, int partition, RdKafka::ErrorCode errorCode) {
+    EXPECT_CALL(*kafkaProducer_, produce(_, partition, RdKafka::Producer::RK_MSG_COPY, _, _, IsNull(), _))
+        .With(Args<3, 4>(PayloadIs(msg)))
+        .WillOnce(Return(errorCode))
+        .RetiresOnSaturation();
+  }
+
+  static std::vector<Producer::BatchMessage> batch(const std::vector<std::string>& msgs) {
+    std::vector<Producer::BatchMessage> messages;
+    for (const auto& msg : msgs) {
+      messages.push_back(Producer::BatchMessage{msg.data(), msg.size()});
+    }
+    return messages;
+  }
+
+  // Owned by producer_
+  NiceMock<MockKafkaProducer>* kafkaProducer_;
+  MockedProducer producer_;
+};
+
+TEST_F(ProducerTest, ProduceBatch) {
+  std::vector<std::string> msgs{"a", "bb", "ccc"};
+  {
+    InSequence sequence;
+    expectProduce("a", 2, RdKafka::ERR_NO_ERROR);
+    // an error only fails its own message
+    expectProduce("bb", 2, RdKafka::ERR_MSG_SIZE_TOO_LARGE);
+    expectProduce("ccc", 2, RdKafka::ERR_NO_ERROR);
+  }
+  std::vector<RdKafka::ErrorCode> errors;
+  EXPECT_EQ(2, producer_.produceBatchAsync(batch(msgs), 2, &errors));
+  EXPECT_EQ(std::vector<RdKafka::ErrorCode>(
+                {RdKafka::ERR_NO_ERROR, RdKafka::ERR_MSG_SIZE_TOO_LARGE, RdKafka::ERR_NO_ERROR}),
+            errors);
+
+  EXPECT_EQ(0, producer_.produceBatchAsync({}, 2, &errors));
+  EXPECT_TRUE(errors.empty());
+}
+
+TEST_F(ProducerTest, QueueFull) {
+  std::vector<std::string> msgs{"a", "b"};
+  {
+    InSequence sequence;
+    expectProduce("a", 0, RdKafka::ERR__QUEUE_FULL);
+    // delivery reports are served before retrying the same message
+    EXPECT_CALL(*kafkaProducer_, poll(_)).WillOnce(Return(1));
+    expectProduce("a", 0, RdKafka::ERR_NO_ERROR);
+    expectProduce("b", 0, RdKafka::ERR_NO_ERROR);
+    EXPECT_CALL(*kafkaProducer_, poll(0)).WillOnce(Return(0));
+  }
+  std::vector<RdKafka::ErrorCode> errors;
+  EXPECT_EQ(2, producer_.produceBatchAsync(batch(msgs), 0, &errors));
+  EXPECT_EQ(std::vector<RdKafka::ErrorCode>({RdKafka::ERR_NO_ERROR, RdKafka::ERR_NO_ERROR}), errors);
+}
+
+TEST_F(ProducerTest, QueueFullTimeout) {
+  std::vector<std::string> msgs{"a", "b", "c"};
+  expectProduce("a", 0, RdKafka::ERR_NO_ERROR);
+  // the queue stays full from the second message on, which gives up on the rest of the batch without trying it
+  EXPECT_CALL(*kafkaProducer_, produce(_, 0, _, _, _, _, _))
+      .With(Args<3, 4>(PayloadIs("b")))
+      .WillRepeatedly(Return(RdKafka::ERR__QUEUE_FULL));
+  EXPECT_CALL(*kafkaProducer_, produce(_, 0, _, _, _, _, _))
+      .With(Args<3, 4>(PayloadIs("c")))
+      .Times(0);
+
+  std::vector<RdKafka::ErrorCode> errors;
+  EXPECT_EQ(1, producer_.produceBatchAsync(batch(msgs), 0, &errors, 50));
+  EXPECT_EQ(std::vector<RdKafka::ErrorCode>(
+                {RdKafka::ERR_NO_ERROR, RdKafka::ERR__QUEUE_FULL, RdKafka::ERR__QUEUE_FULL}),
+            errors);
+}
+
+TEST_F(ProducerTest, ProduceBatchFatalOnError) {
+  std::vector<std::string> msgs{"a", "b"};
+  {
+    InSequence sequence;
+    expectProduce("a", 1, RdKafka::ERR_NO_ERROR);
+    // each message is only produced again while the queue is full
+    expectProduce("b", 1, RdKafka::ERR__QUEUE_FULL);
+    expectProduce("b", 1, RdKafka::ERR_NO_ERROR);
+  }
+  producer_.produceBatchFatalOnError(msgs, 1);
+}
+
+TEST_F(ProducerTest, ProduceBatchFatalOnErrorDies) {
+  std::vector<std::string> msgs{"a"};
+  EXPECT_DEATH(
+      {
+        expectProduce("a", 1, RdKafka::ERR_MSG_SIZE_TOO_LARGE);
+        producer_.produceBatchFatalOnError(msgs, 1);
+      },
+      "Error producing kafka message");
+}
+
+}  // namespace kafka
+}  // namespace infra
@@ -3,12 +3,15 @@
 #include <algorithm>
 #include <chrono>
 #include <memory>
+#include <string>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include "boost/filesystem.hpp"
 #include "folly/Format.h"
 #include "glog/logging.h"
+#include "infra/Tracing.h"
 #include "infra/kafka/store/KafkaStoreMessageRecord.hh"
 #include "librdkafka/rdkafkacpp.h"
 #include "platform/gcloud/GoogleCloudStorage.h"
@@ -19,20 +22,25 @@ namespace store {
 
 using google_storage_api::Object;
 
-int64_t Consumer::downloadObjectAndValidate(int64_t fileOffset, const std::string& downloadPath, Object* object) {
-  std::string objectName = getObjectName(objectNamePrefix_, topic_, partition_, fileOffset);
-  LOG(INFO) << "Downloading object " << objectName << " in " << bucketName_;
-  googleapis::util::Status status = gcs_->downloadObject(bucketName_, objectName, downloadPath, object);
-  if (!status.ok()) {
-    LOG(ERROR) << status.ToString();
-    return -1;
-  }
-  if (!object->has_metadata()) {
+namespace {
+
+// A kafka store file found by listing a partition
+struct StoreFile {
+  int64_t fileOffset;
+  int64_t count;
+  // Creation time rounded up to the next second, since it is truncated to seconds
+  int64_t createdMs;
+};
+
+}  // namespace
+
+int64_t Consumer::getRecordCount(const Object& object) {
+  if (!object.has_metadata()) {
     LOG(ERROR) << "Object has no metadata";
     return -1;
   }
   std::string countValue;
-  if (!object->get_metadata().get("count", &countValue)) {
+  if (!object.get_metadata().get("count", &countValue)) {
     LOG(ERROR) << "Object has not `count` metadata";
     return -1;
   }
@@ -47,11 +55,91 @@ int64_t Consumer::downloadObjectAndValidate(int64_t fileOffset, const std::strin
     LOG(ERROR) << "Invalid count: " << count;
     return -1;
   }
+  return count;
+}
+
+int64_t Consumer::downloadObjectAndValidate(int64_t fileOffset, const std::string& downloadPath, Object* object) {
+  std::string objectName = getObjectName(objectNamePrefix_, topic_, partition_, fileOffset);
+  LOG(INFO) << "Downloading object " << objectName << " in " << bucketName_;
+  googleapis::util::Status status = gcs_->downloadObject(bucketName_, objectName, downloadPath, object);
+  if (!status.ok()) {
+    LOG(ERROR) << status.ToString();
+    return -1;
+  }
+  int64_t count = getRecordCount(*object);
+  if (count <= 0) return -1;
 
   LOG(INFO) << "Downloaded object " << objectName << " in " << bucketName_ << " with " << count << " records";
   return count;
 }
 
+bool Consumer::rewindToTimestamp(int64_t timestampMs) {
+  const std::string prefix = getPartitionPrefix(objectNamePrefix_, topic_, partition_);
+  std::vector<StoreFile> files;
+  bool valid = true;
+  googleapis::util::Status status = gcs_->listObjects(bucketName_, prefix, [&](const Object& object) {
+    const auto name = object.get_name();
+    int64_t fileOffset = -1;
+    try {
+      fileOffset = folly::to<int64_t>(folly::StringPiece(name.data() + prefix.size(), name.size() - prefix.size()));
+    } catch (folly::ConversionError&) {
+      LOG(WARNING) << "Ignoring object that is not a kafka store file: " << std::string(name.data(), name.size());
+      return;
+    }
+    int64_t count = getRecordCount(object);
+    if (count <= 0) {
+      valid = false;
+      return;
+    }
+    files.push_back({fileOffset, count, (object.get_time_created().ToEpochTime() + 1) * 1000});
+  });
+  if (!status.ok()) {
+    LOG(ERROR) << "Listing kafka store files of partition " << partition_ << " of " << topic_
+               << " failed: " << status.ToString();
+    return false;
+  }
+  if (!valid) return false;
+  if (files.empty()) {
+    LOG(ERROR) << "No kafka store files for partition " << partition_ << " of " << topic_;
+    return false;
+  }
+
+  std::sort(files.begin(), files.end(),
+            [](const StoreFile& a, const StoreFile& b) { return a.fileOffset < b.fileOffset; });
+  auto fileIt = std::partition_point(files.begin(), files.end(),
+                                     [timestampMs](const StoreFile& file) { return file.createdMs <= timestampMs; });
+  if (fileIt == files.end()) {
+    // every file is older, so start from the next one
+    int64_t endOffset = files.back().fileOffset + files.back().count;
+    LOG(WARNING) << "Rewind partition " << partition_ << " of " << topic_ << " to the end at offset " << endOffset
+                 << ", since every kafka store file was created before " << timestampMs;
+    return consumerHelper()->commitRawKafkaAndFileOffset(offsetKey(), endOffset, endOffset);
+  }
+  int64_t fileOffset = fileIt->fileOffset;
+
+  std::string path;
+  int64_t recordCount = downloadFile(fileOffset, false, &path);
+  if (recordCount < 0) return false;
+  int64_t kafkaOffset = fileOffset;
+  {
+    avro::DataFileReader<KafkaStoreMessage> reader(path.data());
+    KafkaStoreMessage msg;
+    while (kafkaOffset < fileOffset + recordCount && reader.read(msg) && msg.timestamp < timestampMs) {
+      kafkaOffset++;
+    }
+    reader.close();
+  }
+  boost::filesystem::remove(path);
+  if (kafkaOffset == fileOffset + recordCount) {
+    // every message in the file is older, so start from the next file
+    fileOffset = kafkaOffset;
+  }
+
+  LOG(WARNING) << "Rewind partition " << partition_ << " of " << topic_ << " to offset " << kafkaOffset
+               << " in file " << fileOffset << " at " << timestampMs;
+  return consumerHelper()->commitRawKafkaAndFileOffset(offsetKey(), kafkaOffset, fileOffset);
+}
+
 void Consumer::init(int64_t initialOffset) {
   offsetManager_.init();
 
@@ -103,9 +191,14 @@ size_t Consumer::consumeBatch(int timeoutMs, void* opaque) {
   if (!currentDataReader_) {
     CHECK_EQ(nextKafkaOffset_, nextFileOffset_)
         << "Kafka offset and file offset must match when starting a new file";
-    int64_t recordCount = downloadFile(nextFileOffset_, true, &currentFilePath_);
+    ConsumerMetrics::StageTimer fetchTimer(metrics(), ConsumerMetrics::Stage::kFetch);
+    int64_t recordCount = TRACE_CALL("KafkaConsumer#fetch", downloadFile(nextFileOffset_, true, &currentFilePath_));
+    fetchTimer.stop();
     if (!run()) return 0;
     CHECK_GT(recordCount, 0);
+    if (metrics()) {
+      countFetched(0, boost::filesystem::file_size(currentFilePath_));
+    }
     currentDataReader_.reset(new avro::DataFileReader<KafkaStoreMessage>(currentFilePath_.data()));
     currentFileOffset_ = nextFileOffset_;
     nextFileOffset_ += recordCount;
@@ -117,8 +210,14 @@ size_t Consumer::consumeBatch(int timeoutMs, void* opaque) {
   int remainingMs = timeoutMs;
   while (run() && count < kMaxBatchSize && remainingMs > 0) {
     KafkaStoreMessage msg;
-    if (currentDataReader_->read(msg)) {
-      processOne(nextKafkaOffset_, msg, opaque);
+    ConsumerMetrics::StageTimer decodeTimer(metrics(), ConsumerMetrics::Stage::kDecode);
+    bool decoded = TRACE_CALL("KafkaConsumer#decode", currentDataReader_->read(msg));
+    decodeTimer.stop();
+    if (decoded) {
+      countFetched(1, 0);
+      ConsumerMetrics::StageTimer processTimer(metrics(), ConsumerMetrics::Stage::kProcess);
+      TRACE_CALL("KafkaConsumer#processOne", processOne(nextKafkaOffset_, msg, opaque));
+      processTimer.stop();
       count++;
       nextKafkaOffset_++;
 
@@ -26,10 +26,17 @@ namespace store {
 // Consumer for kafka-store
 class Consumer : public infra::kafka::AbstractConsumer {
  public:
+  // Prefix of the names of all objects of a partition
+  static std::string getPartitionPrefix(const std::string& objectNamePrefix, const std::string& topic,
+                                        int partition) {
+    // partition has up to 6 digits
+    return folly::sformat("{}{}/{:06d}/", objectNamePrefix, topic, partition);
+  }
+
   static std::string getObjectName(const std::string& objectNamePrefix, const std::string& topic, int partition,
                                    int64_t fileOffset) {
-    // partition has up to 6 digits and offset has up to 20
-    return folly::sformat("{}{}/{:06d}/{:020d}", objectNamePrefix, topic, partition, fileOffset);
+    // offset has up to 20 digits, so names sort by offset
+    return folly::sformat("{}{:020d}", getPartitionPrefix(objectNamePrefix, topic, partition), fileOffset);
   }
 
   // Technically, a kafka-store consumer does not depend on kafka cluster since it reads kafka messages directly from
@@ -84,6 +91,13 @@ class Consumer : public infra::kafka::AbstractConsumer {
     return consumerHelper()->loadCommittedKafkaAndFileOffsetsFromDb(offsetKey(), kafkaOffset, fileOffset);
   }
 
+  // Kafka store files are chained by offset, i.e., each file starts where the previous one ends, and each file is
+  // created after its last message. So creation times grow with offsets, and the first file created at or after the
+  // timestamp is the first one that may hold messages at or after it. It is found by binary search over a listing of
+  // the partition, then scanned for the exact offset. When every file is older, the consumer starts from the file
+  // following the last one, once it is uploaded.
+  bool rewindToTimestamp(int64_t timestampMs) override;
+
   int64_t loadCommittedKafkaOffset(void) override {
     int64_t kafkaOffset = RdKafka::Topic::OFFSET_INVALID;
     if (loadCommittedKafkaAndFileOffsets(&kafkaOffset, nullptr)) {
@@ -135,6 +149,9 @@ class Consumer : public infra::kafka::AbstractConsumer {
   static constexpr size_t kMaxBatchSize = 10000;
   static constexpr char kDownloadPathTemplate[] = "/tmp/kafka-store.%%%%%%%%";
 
+  // Record count in the metadata of an object, or -1 if it is missing or invalid
+  static int64_t getRecordCount(const google_storage_api::Object& object);
+
   // Download the target object specified by the file offset and fill the metadata object.
   // Return the number of records in the object or -1 on failure
   int64_t downloadObjectAndValidate(int64_t fileOffset, const std::string& downloadPath,
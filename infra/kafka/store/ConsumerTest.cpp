@@ -1,14 +1,175 @@
+#include <ctime>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#include "avro/Compiler.hh"
+#include "avro/DataFile.hh"
+#include "avro/ValidSchema.hh"
+#pragma GCC diagnostic pop
+#include "googleapis/client/util/date_time.h"
+#include "googleapis/client/util/status.h"
 #include "gtest/gtest.h"
+#include "infra/kafka/ConsumerHelper.h"
 #include "infra/kafka/store/Consumer.h"
+#include "platform/gcloud/GoogleCloudStorage.h"
+#include "stesting/TestWithRocksDb.h"
 
 namespace infra {
 namespace kafka {
 namespace store {
 
+namespace {
+
+constexpr char kSchema[] =
+    "{\"type\": \"record\", \"name\": \"KafkaStoreMessage\", \"fields\": ["
+    "{\"name\": \"timestamp\", \"type\": \"long\"},"
+    "{\"name\": \"key\", \"type\": [\"null\", \"bytes\"]},"
+    "{\"name\": \"value\", \"type\": [\"null\", \"bytes\"]}]}";
+
+// Serves kafka store files from memory
+class FakeGoogleCloudStorage : public platform::gcloud::GoogleCloudStorage {
+ public:
+  // Add a file created at createdSec holding messages with the given timestamps
+  void addFile(const std::string& name, int64_t createdSec, std::vector<int64_t> timestamps) {
+    files_[name] = {createdSec, std::move(timestamps)};
+  }
+
+  googleapis::util::Status getObject(const std::string& bucketName, const std::string& objectName,
+                                     google_storage_api::Object* object) override {
+    const auto it = files_.find(objectName);
+    if (it == files_.end()) return googleapis::client::StatusUnknown("No such object: " + objectName);
+    fillObject(it->first, it->second, object);
+    return googleapis::client::StatusOk();
+  }
+
+  googleapis::util::Status downloadObject(const std::string& bucketName, const std::string& objectName,
+                                          const std::string& downloadPath,
+                                          google_storage_api::Object* object) override {
+    googleapis::util::Status status = getObject(bucketName, objectName, object);
+    if (!status.ok()) return status;
+    avro::DataFileWriter<KafkaStoreMessage> writer(downloadPath.c_str(), avro::compileJsonSchemaFromString(kSchema));
+    for (int64_t timestamp : files_[objectName].timestamps) {
+      KafkaStoreMessage msg;
+      msg.timestamp = timestamp;
+      writer.write(msg);
+    }
+    writer.close();
+    return googleapis::client::StatusOk();
+  }
+
+  googleapis::util::Status listObjects(
+      const std::string& bucketName, const std::string& prefix,
+      const std::function<void(const google_storage_api::Object& object)>& callback) override {
+    listings++;
+    if (failListing) return googleapis::client::StatusUnknown("Listing failed");
+    for (const auto& entry : files_) {
+      if (entry.first.compare(0, prefix.size(), prefix) != 0) continue;
+      std::unique_ptr<google_storage_api::Object> object(google_storage_api::Object::New());
+      fillObject(entry.first, entry.second, object.get());
+      callback(*object);
+    }
+    return googleapis::client::StatusOk();
+  }
+
+  bool failListing = false;
+  int listings = 0;
+
+ private:
+  struct File {
+    int64_t createdSec;
+    std::vector<int64_t> timestamps;
+  };
+
+  static void fillObject(const std::string& name, const File& file, google_storage_api::Object* object) {
+    object->set_name(name);
+    object->set_time_created(googleapis::client::DateTime(static_cast<time_t>(file.createdSec)));
+    object->mutable_metadata().put("count", std::to_string(file.timestamps.size()));
+  }
+
+  std::map<std::string, File> files_;
+};
+
+class NoopConsumer : public Consumer {
+ public:
+  NoopConsumer(std::shared_ptr<ConsumerHelper> consumerHelper, const std::string& offsetKey,
+               std::shared_ptr<platform::gcloud::GoogleCloudStorage> gcs)
+      : Consumer("localhost:9092", "bucket", "abc/", "counters", 3, "infra-kafka-store-consumer-test", offsetKey,
+                 consumerHelper, gcs) {}
+
+  void processOne(int64_t offset, const KafkaStoreMessage& msg, void* opaque) override {}
+};
+
+}  // namespace
+
 TEST(Consumer, GetObjectName) {
+  EXPECT_EQ("abc/counters/000003/", Consumer::getPartitionPrefix("abc/", "counters", 3));
   EXPECT_EQ("abc/counters/000003/00000000000000012345", Consumer::getObjectName("abc/", "counters", 3, 12345));
 }
 
+class ConsumerRewindTest : public stesting::TestWithRocksDb {
+ protected:
+  void SetUp() override {
+    stesting::TestWithRocksDb::SetUp();
+    consumerHelper_ = std::make_shared<ConsumerHelper>(db(), metadataColumnFamily());
+    offsetKey_ = consumerHelper_->linkTopicPartition("counters", 3, "test");
+    gcs_ = std::make_shared<FakeGoogleCloudStorage>();
+    // each file is created a second after its last message, and creation times are truncated to seconds
+    gcs_->addFile(Consumer::getObjectName("abc/", "counters", 3, 0), 4, {1000, 2000, 3000});
+    gcs_->addFile(Consumer::getObjectName("abc/", "counters", 3, 3), 8, {5000, 6000, 7000});
+    gcs_->addFile(Consumer::getObjectName("abc/", "counters", 3, 6), 11, {9000, 10000});
+    // neither another partition nor a stray object is part of the chain
+    gcs_->addFile(Consumer::getObjectName("abc/", "counters", 4, 0), 1, {500});
+    gcs_->addFile("abc/counters/000003/README", 1, {500});
+  }
+
+  // Rewind to the timestamp and return the committed kafka and file offsets
+  std::pair<int64_t, int64_t> rewind(int64_t timestampMs) {
+    NoopConsumer consumer(consumerHelper_, offsetKey_, gcs_);
+    EXPECT_TRUE(consumer.rewindToTimestamp(timestampMs));
+    std::pair<int64_t, int64_t> offsets(-1, -1);
+    EXPECT_TRUE(consumerHelper_->loadCommittedKafkaAndFileOffsetsFromDb(offsetKey_, &offsets.first, &offsets.second));
+    return offsets;
+  }
+
+  std::shared_ptr<ConsumerHelper> consumerHelper_;
+  std::string offsetKey_;
+  std::shared_ptr<FakeGoogleCloudStorage> gcs_;
+};
+
+TEST_F(ConsumerRewindTest, Offset) {
+  // the first message at or after the timestamp, in the first file created after it
+  EXPECT_EQ(std::make_pair<int64_t, int64_t>(4, 3), rewind(6000));
+  EXPECT_EQ(std::make_pair<int64_t, int64_t>(4, 3), rewind(5500));
+  EXPECT_EQ(std::make_pair<int64_t, int64_t>(0, 0), rewind(0));
+  // every message of the first file created after the timestamp is older, so start from the next file
+  EXPECT_EQ(std::make_pair<int64_t, int64_t>(3, 3), rewind(4500));
+  // all of it takes a single listing per rewind
+  EXPECT_EQ(4, gcs_->listings);
+}
+
+TEST_F(ConsumerRewindTest, PastTheEnd) {
+  // every file is older, so start from the next one once it is uploaded
+  EXPECT_EQ(std::make_pair<int64_t, int64_t>(8, 8), rewind(20000));
+}
+
+TEST_F(ConsumerRewindTest, Failure) {
+  // nothing is committed, so the consumer would start from its previous offsets
+  ASSERT_TRUE(consumerHelper_->commitRawKafkaAndFileOffset(offsetKey_, 7, 6));
+  gcs_->failListing = true;
+  NoopConsumer consumer(consumerHelper_, offsetKey_, gcs_);
+  EXPECT_FALSE(consumer.rewindToTimestamp(6000));
+  int64_t kafkaOffset = -1;
+  int64_t fileOffset = -1;
+  ASSERT_TRUE(consumerHelper_->loadCommittedKafkaAndFileOffsetsFromDb(offsetKey_, &kafkaOffset, &fileOffset));
+  EXPECT_EQ(7, kafkaOffset);
+  EXPECT_EQ(6, fileOffset);
+}
+
 }  // namespace store
 }  // namespace kafka
 }  // namespace infra
@@ -0,0 +1,46 @@
+#include <memory>
+#include <vector>
+
+#include "glog/logging.h"
+#include "infra/ScheduledTask.h"
+#include "infra/ScheduledTaskProcessor.h"
+#include "infra/ScheduledTaskQueue.h"
+#include "jobqueue/JobQueueRedisHandler.h"
+#include "pipeline/RedisHandler.h"
+#include "pipeline/RedisPipelineBootstrap.h"
+#include "rocksdb/write_batch.h"
+
+namespace jobqueue {
+
+// Jobs are claimed by external workers, so the queue never processes them by itself
+class ExternalJobProcessor : public infra::ScheduledTaskProcessor {
+ public:
+  void processPendingTasks(std::vector<infra::ScheduledTask>* tasks, rocksdb::WriteBatch* writeBatch) override {
+    LOG(FATAL) << "Jobs are processed by external workers";
+  }
+
+  bool autoProcessing() const override {
+    return false;
+  }
+};
+
+static std::shared_ptr<pipeline::RedisHandler> createJobQueueRedisHandler(
+    pipeline::RedisPipelineBootstrap* bootstrap) {
+  return std::make_shared<JobQueueRedisHandler>(
+      bootstrap->getDatabaseManager(), bootstrap->getScheduledTaskQueue(infra::ScheduledTaskQueue::columnFamilyName()));
+}
+
+static pipeline::RedisPipelineBootstrap::Config createConfig() {
+  pipeline::RedisPipelineBootstrap::Config config(&createJobQueueRedisHandler);
+  config.scheduledTaskProcessorFactoryMap[infra::ScheduledTaskQueue::columnFamilyName()] =
+      [](pipeline::RedisPipelineBootstrap* bootstrap) -> std::shared_ptr<infra::ScheduledTaskProcessor> {
+    return std::make_shared<ExternalJobProcessor>();
+  };
+  config.rocksDbCfConfiguratorMap[infra::ScheduledTaskQueue::columnFamilyName()] =
+      &infra::ScheduledTaskQueue::optimizeColumnFamily;
+  return config;
+}
+
+static auto redisPipelineBootstrap = pipeline::RedisPipelineBootstrap::create(createConfig());
+
+}  // namespace jobqueue
@@ -0,0 +1,75 @@
+#include "jobqueue/JobQueueRedisHandler.h"
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "infra/ScheduledTask.h"
+
+namespace jobqueue {
+
+void JobQueueRedisHandler::appendToInfoOutput(std::stringstream* ss) {
+  RedisHandler::appendToInfoOutput(ss);
+  (*ss) << std::endl << "# JobQueue" << std::endl;
+  (*ss) << "outstanding_jobs:" << queue_->outstandingTaskCount() << std::endl;
+}
+
+codec::RedisValue JobQueueRedisHandler::jobAddCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  int64_t dueMs;
+  if (!parseMs(cmd[1], &dueMs)) return errorInvalidInteger();
+  if (cmd[2].empty()) return errorEmptyId();
+
+  if (!queue_->schedule(infra::ScheduledTask(dueMs, cmd[2], cmd.size() > 3 ? cmd[3] : ""))) {
+    return internalServerError();
+  }
+  return simpleStringOk();
+}
+
+codec::RedisValue JobQueueRedisHandler::jobClaimCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  int64_t count;
+  int64_t leaseMs;
+  if (!parseInt(cmd[1], &count) || count <= 0 || !parseMs(cmd[2], &leaseMs)) return errorInvalidInteger();
+
+  std::vector<infra::ScheduledTask> tasks;
+  if (queue_->claim(nowMs(), leaseMs, std::min(count, kMaxClaimCount), &tasks) < 0) {
+    return internalServerError();
+  }
+
+  std::vector<codec::RedisValue> jobs;
+  jobs.reserve(tasks.size());
+  for (const auto& task : tasks) {
+    std::vector<codec::RedisValue> job;
+    job.emplace_back(codec::RedisValue::Type::kBulkString, std::string(task.dataKey()));
+    job.emplace_back(codec::RedisValue::Type::kBulkString, std::string(task.value()));
+    job.emplace_back(task.scheduledTimeMs());
+    jobs.emplace_back(std::move(job));
+  }
+  return codec::RedisValue(std::move(jobs));
+}
+
+codec::RedisValue JobQueueRedisHandler::jobAckCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  int64_t leaseTimestampMs;
+  if (!parseMs(cmd[1], &leaseTimestampMs)) return errorInvalidInteger();
+  if (cmd[2].empty()) return errorEmptyId();
+
+  return codec::RedisValue(queue_->ack(leaseTimestampMs, cmd[2]) ? 1 : 0);
+}
+
+codec::RedisValue JobQueueRedisHandler::jobExtendCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  int64_t leaseTimestampMs;
+  int64_t leaseMs;
+  if (!parseMs(cmd[1], &leaseTimestampMs) || !parseMs(cmd[3], &leaseMs)) return errorInvalidInteger();
+  if (cmd[2].empty()) return errorEmptyId();
+
+  int64_t newLeaseTimestampMs = nowMs() + leaseMs;
+  if (!queue_->extendLease(leaseTimestampMs, cmd[2], &newLeaseTimestampMs)) {
+    return codec::RedisValue::nullString();
+  }
+  return codec::RedisValue(newLeaseTimestampMs);
+}
+
+constexpr int64_t JobQueueRedisHandler::kMaxClaimCount;
+
+}  // namespace jobqueue
@@ -0,0 +1,64 @@
+#ifndef JOBQUEUE_JOBQUEUEREDISHANDLER_H_
+#define JOBQUEUE_JOBQUEUEREDISHANDLER_H_
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "codec/RedisValue.h"
+#include "infra/ScheduledTaskQueue.h"
+#include "pipeline/DatabaseManager.h"
+#include "pipeline/RedisHandler.h"
+
+namespace jobqueue {
+
+// A redis handler exposing a ScheduledTaskQueue to external workers as a delayed-job queue:
+//   JOBADD due_ms id [payload]       Schedule a job, replacing any job with the same id and due time.
+//   JOBCLAIM count lease_ms          Claim up to count due jobs for lease_ms. Reply with [id, payload, lease] triples.
+//   JOBACK lease id                  Complete a claimed job. Reply 1, or 0 if the lease has been lost.
+//   JOBEXTEND lease id lease_ms      Extend a lease by lease_ms from now. Reply with the new lease or null if lost.
+// Jobs not acknowledged before their lease expires become due again, so processing is at least once.
+class JobQueueRedisHandler : public pipeline::RedisHandler {
+ public:
+  // Upper bound of jobs handed out by a single claim
+  static constexpr int64_t kMaxClaimCount = 1000;
+
+  JobQueueRedisHandler(std::shared_ptr<pipeline::DatabaseManager> databaseManager,
+                       std::shared_ptr<infra::ScheduledTaskQueue> queue)
+      : RedisHandler(databaseManager), queue_(queue) {}
+
+  const CommandHandlerTable& getCommandHandlerTable() const override {
+    static const CommandHandlerTable commandHandlerTable(mergeWithDefaultCommandHandlerTable({
+        {"jobadd", {static_cast<CommandHandlerFunc>(&JobQueueRedisHandler::jobAddCommand), 2, 3}},
+        {"jobclaim", {static_cast<CommandHandlerFunc>(&JobQueueRedisHandler::jobClaimCommand), 2, 2}},
+        {"joback", {static_cast<CommandHandlerFunc>(&JobQueueRedisHandler::jobAckCommand), 2, 2}},
+        {"jobextend", {static_cast<CommandHandlerFunc>(&JobQueueRedisHandler::jobExtendCommand), 3, 3}},
+    }));
+    return commandHandlerTable;
+  }
+
+ protected:
+  void appendToInfoOutput(std::stringstream* ss) override;
+
+ private:
+  static codec::RedisValue errorEmptyId() {
+    return { codec::RedisValue::Type::kError, "Job id must not be empty" };
+  }
+
+  // Parse a timestamp or duration, neither of which can be negative
+  static bool parseMs(const std::string& value, int64_t* ms) {
+    return parseInt(value, ms) && *ms >= 0;
+  }
+
+  codec::RedisValue jobAddCommand(const std::vector<std::string>& cmd, Context* ctx);
+  codec::RedisValue jobClaimCommand(const std::vector<std::string>& cmd, Context* ctx);
+  codec::RedisValue jobAckCommand(const std::vector<std::string>& cmd, Context* ctx);
+  codec::RedisValue jobExtendCommand(const std::vector<std::string>& cmd, Context* ctx);
+
+  std::shared_ptr<infra::ScheduledTaskQueue> queue_;
+};
+
+}  // namespace jobqueue
+
+#endif  // JOBQUEUE_JOBQUEUEREDISHANDLER_H_
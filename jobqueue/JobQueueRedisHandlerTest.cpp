@@ -0,0 +1,159 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/algorithm/string/case_conv.hpp"
+#include "codec/RedisValue.h"
+#include "folly/futures/Future.h"
+#include "gtest/gtest.h"
+#include "infra/ScheduledTask.h"
+#include "infra/ScheduledTaskProcessor.h"
+#include "infra/ScheduledTaskQueue.h"
+#include "jobqueue/JobQueueRedisHandler.h"
+#include "rocksdb/write_batch.h"
+#include "stesting/TestWithRocksDb.h"
+
+namespace jobqueue {
+
+class ExternalJobProcessor : public infra::ScheduledTaskProcessor {
+ public:
+  void processPendingTasks(std::vector<infra::ScheduledTask>* tasks, rocksdb::WriteBatch* writeBatch) override {
+    FAIL() << "Jobs are processed by external workers";
+  }
+
+  bool autoProcessing() const override {
+    return false;
+  }
+};
+
+// Replies are kept instead of being written to a connection
+class TestJobQueueRedisHandler : public JobQueueRedisHandler {
+ public:
+  using JobQueueRedisHandler::JobQueueRedisHandler;
+
+  folly::Future<folly::Unit> write(Context* ctx, codec::RedisMessage msg) override {
+    replies.push_back(std::move(msg.val));
+    return folly::makeFuture();
+  }
+
+  // Run a command and return its reply
+  codec::RedisValue run(const std::vector<std::string>& cmd) {
+    replies.clear();
+    EXPECT_TRUE(handleCommand(0, boost::to_lower_copy(cmd[0]), cmd, nullptr));
+    EXPECT_EQ(1, replies.size());
+    return replies.empty() ? codec::RedisValue() : replies.back();
+  }
+
+  std::vector<codec::RedisValue> replies;
+};
+
+class JobQueueRedisHandlerTest : public stesting::TestWithRocksDb {
+ protected:
+  JobQueueRedisHandlerTest() : stesting::TestWithRocksDb({ infra::ScheduledTaskQueue::columnFamilyName() }) {}
+
+  void SetUp() override {
+    stesting::TestWithRocksDb::SetUp();
+    queue_ = std::make_shared<infra::ScheduledTaskQueue>(std::make_shared<ExternalJobProcessor>(), databaseManager(),
+                                                         columnFamily(infra::ScheduledTaskQueue::columnFamilyName()));
+    queue_->start();
+    handler_.reset(new TestJobQueueRedisHandler(databaseManager(), queue_));
+  }
+
+  static codec::RedisValue ok() {
+    return codec::RedisValue(codec::RedisValue::Type::kSimpleString, "OK");
+  }
+
+  // Claim jobs and return the leases by job id, checking the payloads
+  std::vector<std::pair<std::string, int64_t>> claim(const std::string& count, const std::string& leaseMs,
+                                                     const std::vector<std::string>& payloads) {
+    codec::RedisValue reply = handler_->run({"jobclaim", count, leaseMs});
+    std::vector<std::pair<std::string, int64_t>> leases;
+    EXPECT_EQ(codec::RedisValue::Type::kArray, reply.type());
+    if (reply.type() != codec::RedisValue::Type::kArray) return leases;
+    EXPECT_EQ(payloads.size(), reply.array().size());
+    for (size_t i = 0; i < reply.array().size() && i < payloads.size(); i++) {
+      const auto& job = reply.array()[i].array();
+      EXPECT_EQ(3, job.size());
+      EXPECT_EQ(payloads[i], job[1].bulkString());
+      leases.emplace_back(job[0].bulkString(), job[2].integer());
+    }
+    return leases;
+  }
+
+  std::shared_ptr<infra::ScheduledTaskQueue> queue_;
+  std::unique_ptr<TestJobQueueRedisHandler> handler_;
+};
+
+TEST_F(JobQueueRedisHandlerTest, ClaimAndAck) {
+  int64_t startMs = nowMs();
+  EXPECT_EQ(ok(), handler_->run({"jobadd", "1000", "job1", "payload1"}));
+  EXPECT_EQ(ok(), handler_->run({"jobadd", "2000", "job2", "payload2"}));
+  EXPECT_EQ(ok(), handler_->run({"jobadd", std::to_string(startMs + 3600000), "job3", "payload3"}));
+
+  // only due jobs are claimed, up to count
+  auto leases = claim("1", "60000", {"payload1"});
+  ASSERT_EQ(1, leases.size());
+  EXPECT_EQ("job1", leases[0].first);
+  EXPECT_GE(leases[0].second, startMs + 60000);
+  auto moreLeases = claim("10", "60000", {"payload2"});
+  ASSERT_EQ(1, moreLeases.size());
+  EXPECT_EQ("job2", moreLeases[0].first);
+
+  // claimed jobs are not handed out again while leased
+  claim("10", "60000", {});
+
+  EXPECT_EQ(codec::RedisValue(1), handler_->run({"joback", std::to_string(leases[0].second), "job1"}));
+  EXPECT_EQ(codec::RedisValue(0), handler_->run({"joback", std::to_string(leases[0].second), "job1"}));
+  // a lease identifies a single job
+  EXPECT_EQ(codec::RedisValue(0), handler_->run({"joback", std::to_string(moreLeases[0].second), "job3"}));
+  EXPECT_EQ(2, queue_->accurateOutstandingTaskCountSlow());
+}
+
+TEST_F(JobQueueRedisHandlerTest, ExpiredLease) {
+  EXPECT_EQ(ok(), handler_->run({"jobadd", "1000", "job1", "payload1"}));
+  auto leases = claim("10", "0", {"payload1"});
+  ASSERT_EQ(1, leases.size());
+
+  // a job whose lease expired is due again, and only the new lease can acknowledge it
+  auto newLeases = claim("10", "60000", {"payload1"});
+  ASSERT_EQ(1, newLeases.size());
+  EXPECT_NE(leases[0].second, newLeases[0].second);
+  EXPECT_EQ(codec::RedisValue(0), handler_->run({"joback", std::to_string(leases[0].second), "job1"}));
+  EXPECT_EQ(codec::RedisValue(1), handler_->run({"joback", std::to_string(newLeases[0].second), "job1"}));
+  EXPECT_EQ(0, queue_->accurateOutstandingTaskCountSlow());
+}
+
+TEST_F(JobQueueRedisHandlerTest, Extend) {
+  EXPECT_EQ(ok(), handler_->run({"jobadd", "1000", "job1", "payload1"}));
+  auto leases = claim("10", "0", {"payload1"});
+  ASSERT_EQ(1, leases.size());
+  std::string lease = std::to_string(leases[0].second);
+
+  int64_t startMs = nowMs();
+  codec::RedisValue extended = handler_->run({"jobextend", lease, "job1", "60000"});
+  ASSERT_EQ(codec::RedisValue::Type::kInteger, extended.type());
+  EXPECT_GE(extended.integer(), startMs + 60000);
+  // the old lease is gone, and the job is not due before the new one expires
+  EXPECT_EQ(codec::RedisValue::nullString(), handler_->run({"jobextend", lease, "job1", "60000"}));
+  EXPECT_EQ(codec::RedisValue(0), handler_->run({"joback", lease, "job1"}));
+  claim("10", "60000", {});
+
+  EXPECT_EQ(codec::RedisValue(1), handler_->run({"joback", std::to_string(extended.integer()), "job1"}));
+  EXPECT_EQ(0, queue_->accurateOutstandingTaskCountSlow());
+}
+
+TEST_F(JobQueueRedisHandlerTest, InvalidArguments) {
+  EXPECT_EQ(codec::RedisValue::Type::kError, handler_->run({"jobadd", "-1", "job1"}).type());
+  EXPECT_EQ(codec::RedisValue::Type::kError, handler_->run({"jobadd", "1000", ""}).type());
+  EXPECT_EQ(codec::RedisValue::Type::kError, handler_->run({"jobclaim", "0", "60000"}).type());
+  EXPECT_EQ(codec::RedisValue::Type::kError, handler_->run({"jobclaim", "1", "x"}).type());
+  EXPECT_EQ(codec::RedisValue::Type::kError, handler_->run({"joback", "x", "job1"}).type());
+  EXPECT_EQ(codec::RedisValue::Type::kError, handler_->run({"joback", "1000", ""}).type());
+  EXPECT_EQ(codec::RedisValue::Type::kError, handler_->run({"jobextend", "1000", "job1", "-1"}).type());
+  EXPECT_EQ(codec::RedisValue::Type::kError, handler_->run({"jobextend", "1000", "job1"}).type());
+  EXPECT_EQ(0, queue_->accurateOutstandingTaskCountSlow());
+}
+
+}  // namespace jobqueue
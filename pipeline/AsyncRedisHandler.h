@@ -20,6 +20,10 @@ class AsyncRedisHandler : public RedisHandler {
 
   explicit AsyncRedisHandler(std::shared_ptr<DatabaseManager> databaseManager) : RedisHandler(databaseManager) {}
 
+  bool isControlCommand(const std::string& cmdNameLower) const override {
+    return isControlCommandInTable(getAsyncCommandHandlerTable(), cmdNameLower);
+  }
+
   // Allows the resulting redis pipeline to support async operations
   bool allowAsyncCommandHandler() const override {
     return true;
@@ -36,7 +40,8 @@ class AsyncRedisHandler : public RedisHandler {
       return true;
     }
 
-    processCommandHandlerResult(key, (this->*(handlerEntry->second.handlerFunc))(key, cmd, ctx), ctx);
+    processCommandHandlerResult(
+        key, TRACE_CALL("RedisHandler#execute", (this->*(handlerEntry->second.handlerFunc))(key, cmd, ctx)), ctx);
     return true;
   }
 
@@ -65,7 +70,8 @@ class AsyncRedisHandler : public RedisHandler {
     for (const auto& handlerEntry : baseCommandHandlerTable()) {
       baseTable.insert(
           {handlerEntry.first,
-           {&AsyncRedisHandler::handleSyncCommand, handlerEntry.second.minArgs, handlerEntry.second.maxArgs}});
+           {&AsyncRedisHandler::handleSyncCommand, handlerEntry.second.minArgs, handlerEntry.second.maxArgs,
+            handlerEntry.second.control}});
     }
 
     baseTable.insert(newTable.begin(), newTable.end());
@@ -0,0 +1,255 @@
+#include "pipeline/BlockCacheWarmer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "folly/Conv.h"
+#include "folly/FileUtil.h"
+#include "folly/String.h"
+#include "glog/logging.h"
+#include "prometheus/gauge_builder.h"
+#include "rocksdb/cache.h"
+#include "rocksdb/options.h"
+#include "rocksdb/table.h"
+
+namespace pipeline {
+
+namespace {
+
+// Pace and report progress in chunks, so that neither happens for every key
+constexpr uint64_t kChunkBytes = 1 << 20;
+
+// The block cache of a column family, or nullptr if it does not use one
+rocksdb::Cache* getBlockCache(rocksdb::DB* db, rocksdb::ColumnFamilyHandle* columnFamily) {
+  rocksdb::Options options = db->GetOptions(columnFamily);
+  if (strcmp(options.table_factory->Name(), "BlockBasedTable") != 0) return nullptr;
+  auto tableOptions = static_cast<rocksdb::BlockBasedTableOptions*>(options.table_factory->GetOptions());
+  if (tableOptions->no_block_cache) return nullptr;
+  return tableOptions->block_cache.get();
+}
+
+}  // namespace
+
+BlockCacheWarmer* BlockCacheWarmer::instance() {
+  static BlockCacheWarmer* warmer = new BlockCacheWarmer();
+  return warmer;
+}
+
+std::vector<BlockCacheWarmer::Range> BlockCacheWarmer::planRanges(const rocksdb::ColumnFamilyMetaData& metaData,
+                                                                  uint64_t* budgetBytes) {
+  std::vector<const rocksdb::SstFileMetaData*> files;
+  for (const auto& level : metaData.levels) {
+    std::vector<const rocksdb::SstFileMetaData*> levelFiles;
+    for (const auto& file : level.files) {
+      levelFiles.push_back(&file);
+    }
+    std::sort(levelFiles.begin(), levelFiles.end(),
+              [](const auto* a, const auto* b) { return a->largest_seqno > b->largest_seqno; });
+    files.insert(files.end(), levelFiles.begin(), levelFiles.end());
+  }
+
+  std::vector<Range> ranges;
+  for (const auto* file : files) {
+    if (*budgetBytes == 0) break;
+    ranges.push_back(Range{metaData.name, file->smallestkey, file->largestkey, file->size});
+    *budgetBytes -= std::min(*budgetBytes, file->size);
+  }
+
+  std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.start < b.start; });
+  std::vector<Range> merged;
+  for (auto& range : ranges) {
+    if (!merged.empty() && range.start <= merged.back().end) {
+      merged.back().end = std::max(merged.back().end, range.end);
+      merged.back().bytes += range.bytes;
+    } else {
+      merged.push_back(std::move(range));
+    }
+  }
+  return merged;
+}
+
+std::string BlockCacheWarmer::serializeRanges(const std::vector<Range>& ranges) {
+  std::stringstream ss;
+  for (const auto& range : ranges) {
+    ss << range.columnFamily << '\t' << folly::hexlify(range.start) << '\t' << folly::hexlify(range.end) << '\t'
+       << range.bytes << '\n';
+  }
+  return ss.str();
+}
+
+bool BlockCacheWarmer::parseRanges(const std::string& data, std::vector<Range>* ranges) {
+  std::vector<folly::StringPiece> lines;
+  folly::split('\n', data, lines, true);
+  for (const auto& line : lines) {
+    std::vector<folly::StringPiece> fields;
+    folly::split('\t', line, fields);
+    if (fields.size() != 4) return false;
+    Range range;
+    range.columnFamily = fields[0].str();
+    if (!folly::unhexlify(fields[1], range.start) || !folly::unhexlify(fields[2], range.end)) return false;
+    auto bytes = folly::tryTo<uint64_t>(fields[3]);
+    if (!bytes.hasValue()) return false;
+    range.bytes = bytes.value();
+    ranges->push_back(std::move(range));
+  }
+  return true;
+}
+
+bool BlockCacheWarmer::saveRanges(rocksdb::DB* db, const DatabaseManager::ColumnFamilyMap& columnFamilyMap,
+                                  const std::string& path) {
+  // Column families may share a block cache, in which case they also share its capacity
+  std::unordered_map<rocksdb::Cache*, uint64_t> budgets;
+  std::vector<Range> ranges;
+  for (const auto& entry : columnFamilyMap) {
+    rocksdb::Cache* cache = getBlockCache(db, entry.second);
+    if (!cache) continue;
+
+    auto budgetIt = budgets.emplace(cache, cache->GetCapacity()).first;
+    rocksdb::ColumnFamilyMetaData metaData;
+    db->GetColumnFamilyMetaData(entry.second, &metaData);
+    std::vector<Range> columnFamilyRanges = planRanges(metaData, &budgetIt->second);
+    ranges.insert(ranges.end(), columnFamilyRanges.begin(), columnFamilyRanges.end());
+  }
+
+  if (!folly::writeFile(serializeRanges(ranges), path.c_str())) {
+    PLOG(ERROR) << "Saving block cache warm-up ranges to " << path << " failed";
+    return false;
+  }
+  LOG(INFO) << "Saved " << ranges.size() << " block cache warm-up ranges to " << path;
+  return true;
+}
+
+void BlockCacheWarmer::exportMetrics(prometheus::Registry* registry) {
+  progress_ = &prometheus::BuildGauge()
+                   .Name("block_cache_warmup_progress")
+                   .Help("Share of the saved block cache ranges loaded since startup")
+                   .Register(*registry)
+                   .Add({});
+  updateProgress();
+}
+
+void BlockCacheWarmer::start(rocksdb::DB* db, const DatabaseManager::ColumnFamilyMap& columnFamilyMap,
+                             const std::string& path, int64_t bytesPerSecond, int64_t timeoutMs) {
+  CHECK(!thread_) << "Block cache warmer is already started";
+  std::string data;
+  if (!folly::readFile(path.c_str(), data)) {
+    LOG(INFO) << "No block cache warm-up ranges at " << path;
+    return;
+  }
+  std::vector<Range> ranges;
+  if (!parseRanges(data, &ranges)) {
+    LOG(ERROR) << "Ignoring malformed block cache warm-up ranges at " << path;
+    return;
+  }
+
+  uint64_t plannedBytes = 0;
+  for (const auto& range : ranges) {
+    plannedBytes += range.bytes;
+  }
+  plannedBytes_ = plannedBytes;
+  warmedBytes_ = 0;
+  scannedBytes_ = 0;
+  updateProgress();
+  if (ranges.empty()) return;
+
+  warm_ = false;
+  LOG(INFO) << "Warming block cache with " << ranges.size() << " ranges of "
+            << folly::prettyPrint(plannedBytes, folly::PRETTY_BYTES);
+  thread_.reset(new std::thread(&BlockCacheWarmer::run, this, db, columnFamilyMap, std::move(ranges), bytesPerSecond,
+                                timeoutMs));
+}
+
+void BlockCacheWarmer::stop() {
+  if (!thread_) return;
+  stopping_ = true;
+  thread_->join();
+  thread_.reset();
+}
+
+void BlockCacheWarmer::run(rocksdb::DB* db, const DatabaseManager::ColumnFamilyMap& columnFamilyMap,
+                           std::vector<Range> ranges, int64_t bytesPerSecond, int64_t timeoutMs) {
+  auto startTime = std::chrono::steady_clock::now();
+  auto deadline = startTime + std::chrono::milliseconds(timeoutMs);
+  uint64_t scannedBytes = 0;
+  uint64_t chunkBytes = 0;
+  bool timedOut = false;
+  // Capacity left in each block cache, which column families may share
+  std::unordered_map<rocksdb::Cache*, uint64_t> cacheBudgets;
+
+  rocksdb::ReadOptions readOptions;
+  // Point lookup optimized column families use hash indexes, which cannot iterate in order otherwise
+  readOptions.total_order_seek = true;
+  for (const auto& range : ranges) {
+    auto columnFamilyIt = columnFamilyMap.find(range.columnFamily);
+    rocksdb::Cache* cache =
+        columnFamilyIt == columnFamilyMap.end() ? nullptr : getBlockCache(db, columnFamilyIt->second);
+    uint64_t rangeBytes = 0;
+    if (cache) {
+      auto budgetIt = cacheBudgets.emplace(cache, cache->GetCapacity()).first;
+      // Scanned sizes are uncompressed like cached blocks, while the estimate is compressed, so this stops early
+      // rather than late
+      uint64_t budgetBytes = std::min(range.bytes, budgetIt->second);
+      uint64_t rangeScannedBytes = 0;
+      std::unique_ptr<rocksdb::Iterator> it(db->NewIterator(readOptions, columnFamilyIt->second));
+      for (it->Seek(range.start); rangeScannedBytes < budgetBytes && it->Valid() && it->key().compare(range.end) <= 0;
+           it->Next()) {
+        uint64_t bytes = it->key().size() + it->value().size();
+        scannedBytes += bytes;
+        rangeScannedBytes += bytes;
+        chunkBytes += bytes;
+        if (chunkBytes < kChunkBytes) continue;
+
+        // Scanned sizes are uncompressed, so progress within a range is capped at its estimated size
+        uint64_t progressBytes = std::min(chunkBytes, range.bytes - std::min(rangeBytes, range.bytes));
+        rangeBytes += progressBytes;
+        warmedBytes_ += progressBytes;
+        chunkBytes = 0;
+        updateProgress();
+
+        if (stopping_) break;
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+          timedOut = true;
+          break;
+        }
+        if (bytesPerSecond > 0) {
+          auto due = startTime + std::chrono::microseconds(scannedBytes * 1000000 / bytesPerSecond);
+          std::this_thread::sleep_until(std::min(due, deadline));
+        }
+      }
+      budgetIt->second -= std::min(budgetIt->second, rangeScannedBytes);
+      if (!it->status().ok()) {
+        LOG(ERROR) << "Warming block cache of " << range.columnFamily << " failed: " << it->status().ToString();
+      }
+    }
+    if (stopping_ || timedOut) break;
+    warmedBytes_ += range.bytes - std::min(rangeBytes, range.bytes);
+    updateProgress();
+  }
+
+  auto elapsedMs =
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+  if (timedOut) {
+    LOG(WARNING) << "Block cache warm-up timed out after " << elapsedMs << "ms";
+  } else if (!stopping_) {
+    LOG(INFO) << "Block cache warm-up scanned " << folly::prettyPrint(scannedBytes, folly::PRETTY_BYTES) << " in "
+              << elapsedMs << "ms";
+  }
+  scannedBytes_ = scannedBytes;
+  warm_ = true;
+}
+
+void BlockCacheWarmer::updateProgress() {
+  if (!progress_) return;
+  uint64_t plannedBytes = plannedBytes_;
+  progress_->Set(plannedBytes == 0 ? 1 : std::min(1.0, static_cast<double>(warmedBytes_) / plannedBytes));
+}
+
+}  // namespace pipeline
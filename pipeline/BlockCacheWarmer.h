@@ -0,0 +1,85 @@
+#ifndef PIPELINE_BLOCKCACHEWARMER_H_
+#define PIPELINE_BLOCKCACHEWARMER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pipeline/DatabaseManager.h"
+#include "prometheus/gauge.h"
+#include "prometheus/registry.h"
+#include "rocksdb/db.h"
+#include "rocksdb/metadata.h"
+
+namespace pipeline {
+
+// BlockCacheWarmer refills the block cache after a restart, so that reads do not have to warm it one miss at a time.
+// RocksDB cannot enumerate the blocks in its cache, so on graceful shutdown we persist the key ranges of the newest
+// SST files of each column family, up to the capacity of its block cache, as a stand-in for the hot blocks. On startup
+// those ranges are scanned in a background thread at a bounded rate, which loads their data blocks into the cache.
+class BlockCacheWarmer {
+ public:
+  struct Range {
+    std::string columnFamily;
+    std::string start;
+    // Inclusive
+    std::string end;
+    // Estimated from the sizes of the SST files
+    uint64_t bytes;
+  };
+
+  // Process-wide warmer, which is warm unless started
+  static BlockCacheWarmer* instance();
+
+  // Pick the key ranges of the newest files in a column family until their total size reaches budgetBytes, which is
+  // reduced accordingly. Level 0 comes first, then each level by descending sequence number. Overlapping ranges are
+  // merged so that no block is read twice.
+  static std::vector<Range> planRanges(const rocksdb::ColumnFamilyMetaData& metaData, uint64_t* budgetBytes);
+
+  // One range per line, with hex encoded keys
+  static std::string serializeRanges(const std::vector<Range>& ranges);
+  static bool parseRanges(const std::string& data, std::vector<Range>* ranges);
+
+  // Plan ranges for every column family within the capacity of its block cache and write them to path
+  static bool saveRanges(rocksdb::DB* db, const DatabaseManager::ColumnFamilyMap& columnFamilyMap,
+                         const std::string& path);
+
+  // Export warm-up progress from 0 to 1
+  void exportMetrics(prometheus::Registry* registry);
+
+  // Load ranges from path and scan them in the background at no more than bytesPerSecond. Warming gives up after
+  // timeoutMs, so that a slow disk cannot hold back readiness forever. A missing file leaves the warmer warm.
+  // Each range is scanned up to its estimated size, and the ranges of a block cache up to its current capacity, since
+  // reading more would only evict blocks loaded earlier.
+  void start(rocksdb::DB* db, const DatabaseManager::ColumnFamilyMap& columnFamilyMap, const std::string& path,
+             int64_t bytesPerSecond, int64_t timeoutMs);
+
+  // Interrupt warming if still in progress. It must be called before RocksDB is closed.
+  void stop();
+
+  bool isWarm() const { return warm_; }
+  uint64_t getWarmedBytes() const { return warmedBytes_; }
+  uint64_t getPlannedBytes() const { return plannedBytes_; }
+  // Keys and values read by the last warm-up, which is final once warm
+  uint64_t getScannedBytes() const { return scannedBytes_; }
+
+ private:
+  void run(rocksdb::DB* db, const DatabaseManager::ColumnFamilyMap& columnFamilyMap, std::vector<Range> ranges,
+           int64_t bytesPerSecond, int64_t timeoutMs);
+  void updateProgress();
+
+  std::atomic<bool> warm_{true};
+  std::atomic<bool> stopping_{false};
+  std::atomic<uint64_t> warmedBytes_{0};
+  std::atomic<uint64_t> plannedBytes_{0};
+  std::atomic<uint64_t> scannedBytes_{0};
+  std::unique_ptr<std::thread> thread_;
+  prometheus::Gauge* progress_ = nullptr;
+};
+
+}  // namespace pipeline
+
+#endif  // PIPELINE_BLOCKCACHEWARMER_H_
@@ -0,0 +1,154 @@
+#include <chrono>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+#include "folly/FileUtil.h"
+#include "gtest/gtest.h"
+#include "pipeline/BlockCacheWarmer.h"
+#include "pipeline/DatabaseManager.h"
+#include "rocksdb/cache.h"
+#include "rocksdb/metadata.h"
+#include "rocksdb/options.h"
+#include "rocksdb/table.h"
+#include "stesting/TestWithRocksDb.h"
+
+namespace pipeline {
+
+namespace {
+
+rocksdb::SstFileMetaData file(const std::string& smallest, const std::string& largest, uint64_t size,
+                              uint64_t largestSeqno) {
+  rocksdb::SstFileMetaData metaData;
+  metaData.smallestkey = smallest;
+  metaData.largestkey = largest;
+  metaData.size = size;
+  metaData.largest_seqno = largestSeqno;
+  return metaData;
+}
+
+constexpr size_t kBlockCacheBytes = 256 << 10;
+constexpr size_t kValueBytes = 1 << 10;
+
+void configureSmallBlockCache(int defaultBlockCacheSizeMb, rocksdb::ColumnFamilyOptions* options) {
+  rocksdb::BlockBasedTableOptions tableOptions;
+  tableOptions.block_cache = rocksdb::NewLRUCache(kBlockCacheBytes);
+  options->table_factory.reset(rocksdb::NewBlockBasedTableFactory(tableOptions));
+}
+
+}  // namespace
+
+class BlockCacheWarmerTest : public stesting::TestWithRocksDb {
+ protected:
+  BlockCacheWarmerTest() : stesting::TestWithRocksDb({}, {{"default", &configureSmallBlockCache}}) {}
+
+  void SetUp() override {
+    stesting::TestWithRocksDb::SetUp();
+    path_ = boost::filesystem::unique_path("block_cache_warmer_test.%%%%%%%%").native();
+  }
+
+  void TearDown() override {
+    boost::filesystem::remove(path_);
+    stesting::TestWithRocksDb::TearDown();
+  }
+
+  // Scan the given ranges of the default column family and return the bytes read
+  uint64_t warm(const std::vector<BlockCacheWarmer::Range>& ranges) {
+    CHECK(folly::writeFile(BlockCacheWarmer::serializeRanges(ranges), path_.c_str()));
+    BlockCacheWarmer warmer;
+    warmer.start(db(), {{"default", columnFamily("default")}}, path_, 0, 60000);
+    while (!warmer.isWarm()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    warmer.stop();
+    return warmer.getScannedBytes();
+  }
+
+  std::string path_;
+};
+
+TEST(BlockCacheWarmer, PlanNewestFilesFirst) {
+  rocksdb::ColumnFamilyMetaData metaData;
+  metaData.name = "cf";
+  metaData.levels.emplace_back(0, 100, std::vector<rocksdb::SstFileMetaData>{file("m", "p", 100, 50)});
+  metaData.levels.emplace_back(
+      1, 300, std::vector<rocksdb::SstFileMetaData>{file("a", "c", 100, 10), file("d", "f", 100, 30),
+                                                    file("x", "z", 100, 20)});
+
+  uint64_t budget = 250;
+  auto ranges = BlockCacheWarmer::planRanges(metaData, &budget);
+  EXPECT_EQ(0, budget);
+  // level 0, then level 1 by descending sequence number, ordered by key
+  ASSERT_EQ(3, ranges.size());
+  EXPECT_EQ("d", ranges[0].start);
+  EXPECT_EQ("f", ranges[0].end);
+  EXPECT_EQ("m", ranges[1].start);
+  EXPECT_EQ("x", ranges[2].start);
+  EXPECT_EQ("cf", ranges[2].columnFamily);
+  EXPECT_EQ(100, ranges[2].bytes);
+
+  // nothing is left for column families sharing the cache
+  EXPECT_TRUE(BlockCacheWarmer::planRanges(metaData, &budget).empty());
+}
+
+TEST(BlockCacheWarmer, PlanMergesOverlappingRanges) {
+  rocksdb::ColumnFamilyMetaData metaData;
+  metaData.name = "cf";
+  metaData.levels.emplace_back(
+      0, 200, std::vector<rocksdb::SstFileMetaData>{file("a", "k", 100, 2), file("c", "p", 100, 1)});
+  metaData.levels.emplace_back(1, 100, std::vector<rocksdb::SstFileMetaData>{file("p", "t", 100, 0)});
+
+  uint64_t budget = 1000;
+  auto ranges = BlockCacheWarmer::planRanges(metaData, &budget);
+  EXPECT_EQ(700, budget);
+  ASSERT_EQ(1, ranges.size());
+  EXPECT_EQ("a", ranges[0].start);
+  EXPECT_EQ("t", ranges[0].end);
+  EXPECT_EQ(300, ranges[0].bytes);
+}
+
+TEST(BlockCacheWarmer, SerializeAndParse) {
+  std::vector<BlockCacheWarmer::Range> ranges = {{"default", std::string("\0\t\n", 3), "zz", 1 << 20},
+                                                 {"cf-1", "", "\xff", 0}};
+  std::vector<BlockCacheWarmer::Range> parsed;
+  ASSERT_TRUE(BlockCacheWarmer::parseRanges(BlockCacheWarmer::serializeRanges(ranges), &parsed));
+  ASSERT_EQ(2, parsed.size());
+  for (size_t i = 0; i < ranges.size(); i++) {
+    EXPECT_EQ(ranges[i].columnFamily, parsed[i].columnFamily);
+    EXPECT_EQ(ranges[i].start, parsed[i].start);
+    EXPECT_EQ(ranges[i].end, parsed[i].end);
+    EXPECT_EQ(ranges[i].bytes, parsed[i].bytes);
+  }
+
+  parsed.clear();
+  EXPECT_TRUE(BlockCacheWarmer::parseRanges("", &parsed));
+  EXPECT_TRUE(parsed.empty());
+  EXPECT_FALSE(BlockCacheWarmer::parseRanges("default\t61\n", &parsed));
+  EXPECT_FALSE(BlockCacheWarmer::parseRanges("default\tzz\t61\t1\n", &parsed));
+  EXPECT_FALSE(BlockCacheWarmer::parseRanges("default\t61\t62\tmany\n", &parsed));
+}
+
+TEST_F(BlockCacheWarmerTest, ScanIsBounded) {
+  // about 1MB under each of a..z
+  for (char prefix = 'a'; prefix <= 'z'; prefix++) {
+    for (int i = 0; i < 1000; i++) {
+      ASSERT_TRUE(db()->Put(rocksdb::WriteOptions(), prefix + std::to_string(1000 + i), std::string(kValueBytes, 'v'))
+                      .ok());
+    }
+  }
+  ASSERT_TRUE(db()->Flush(rocksdb::FlushOptions()).ok());
+
+  // a range stops at its estimated size, give or take the last key read
+  uint64_t scanned = warm({{"default", "a", "b", 100 << 10}});
+  EXPECT_GE(scanned, 100 << 10);
+  EXPECT_LT(scanned, (100 << 10) + 2 * kValueBytes);
+
+  // and the ranges of a block cache stop at its capacity, however large they are
+  scanned = warm({{"default", "c", "m", 10 << 20}, {"default", "n", "z", 10 << 20}});
+  EXPECT_GE(scanned, kBlockCacheBytes);
+  EXPECT_LT(scanned, kBlockCacheBytes + 2 * kValueBytes);
+}
+
+}  // namespace pipeline
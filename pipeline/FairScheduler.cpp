@@ -0,0 +1,190 @@
+#include "pipeline/FairScheduler.h"
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "boost/algorithm/string/case_conv.hpp"
+#include "folly/io/async/EventBaseLocal.h"
+#include "glog/logging.h"
+#include "infra/Tracing.h"
+#include "wangle/channel/AsyncSocketHandler.h"
+
+namespace pipeline {
+
+FairScheduler* FairScheduler::get(folly::EventBase* evb, const FairSchedulerConfig& config) {
+  // Destroyed together with the event base
+  static folly::EventBaseLocal<FairScheduler> schedulers;
+  return &schedulers.getOrCreate(*evb, evb, config);
+}
+
+void FairScheduler::schedule(FairSchedulingHandler* handler, bool control) {
+  if (handler->scheduled_) return;
+  handler->scheduled_ = true;
+  (control ? priorityLane_ : normalLane_).push_back(handler);
+  if (!isLoopCallbackScheduled()) {
+    evb_->runInLoop(this);
+  }
+}
+
+void FairScheduler::unschedule(FairSchedulingHandler* handler) {
+  if (!handler->scheduled_) return;
+  handler->scheduled_ = false;
+  priorityLane_.erase(std::remove(priorityLane_.begin(), priorityLane_.end(), handler), priorityLane_.end());
+  normalLane_.erase(std::remove(normalLane_.begin(), normalLane_.end(), handler), normalLane_.end());
+}
+
+void FairScheduler::runLoopCallback() noexcept {
+  // Control commands are cheap, so they are not charged against the budget
+  while (!priorityLane_.empty()) {
+    FairSchedulingHandler* handler = priorityLane_.front();
+    priorityLane_.pop_front();
+    handler->scheduled_ = false;
+    handler->runQueued(std::numeric_limits<size_t>::max(), true);
+  }
+
+  size_t budget = config_.commandsPerTurn;
+  while (budget > 0 && !normalLane_.empty()) {
+    FairSchedulingHandler* handler = normalLane_.front();
+    normalLane_.pop_front();
+    handler->scheduled_ = false;
+    budget -= handler->runQueued(std::min(budget, config_.commandsPerConnection), false);
+  }
+
+  if (!priorityLane_.empty() || !normalLane_.empty()) {
+    // Continue in the next iteration, after the event base has had a chance to read from other sockets
+    evb_->runInLoop(this);
+  }
+}
+
+FairSchedulingHandler::~FairSchedulingHandler() {
+  scheduler_->unschedule(this);
+}
+
+void FairSchedulingHandler::read(Context* ctx, codec::RedisMessage msg) {
+  if (!queue_) {
+    if (isControl(msg)) {
+      // Nothing to wait for on this connection
+      ctx->fireRead(std::move(msg));
+      return;
+    }
+    queue_.reset(new std::deque<codec::RedisMessage>());
+  }
+
+  queue_->push_back(std::move(msg));
+  if (!waiting_) {
+    scheduler_->schedule(this, queue_->size() == 1 && isControl(queue_->front()));
+  }
+  if (queue_->size() >= scheduler_->config().maxQueuedCommands) {
+    pauseReading(ctx);
+  }
+}
+
+void FairSchedulingHandler::readEOF(Context* ctx) {
+  if (queue_) {
+    eofPending_ = true;
+  } else {
+    ctx->fireReadEOF();
+  }
+}
+
+void FairSchedulingHandler::readException(Context* ctx, folly::exception_wrapper e) {
+  clearQueue();
+  ctx->fireReadException(std::move(e));
+}
+
+folly::Future<folly::Unit> FairSchedulingHandler::close(Context* ctx) {
+  // Commands queued on a closing connection have nobody to reply to
+  clearQueue();
+  return ctx->fireClose();
+}
+
+size_t FairSchedulingHandler::runQueued(size_t maxCommands, bool controlOnly) {
+  Context* ctx = getContext();
+  // A command may close the connection, so keep the pipeline alive until this turn ends
+  auto pipeline = ctx->getPipelineShared();
+  size_t count = 0;
+  while (queue_ && !queue_->empty() && count < maxCommands) {
+    if (controlOnly && !isControl(queue_->front())) break;
+    codec::RedisMessage msg = std::move(queue_->front());
+    queue_->pop_front();
+    count++;
+    // The command runs outside the read of the decoder that sampled it, so it is sampled on its own
+    infra::Tracing::RequestGuard guard;
+    RedisHandler::DeferralScope scope;
+    ctx->fireRead(std::move(msg));
+    if (scope.deferred) {
+      // Nothing was replied, so the command runs again before the rest of the queue. The queue is gone if the
+      // connection closed in the meantime.
+      if (queue_) {
+        queue_->push_front(std::move(*scope.deferred));
+        retryLater(ctx);
+      }
+      return count;
+    }
+  }
+
+  if (queue_ && !queue_->empty()) {
+    scheduler_->schedule(this, isControl(queue_->front()));
+    if (paused_ && queue_->size() <= scheduler_->config().maxQueuedCommands / 2) {
+      resumeReading(ctx);
+    }
+    return count;
+  }
+
+  queue_.reset();
+  if (paused_) resumeReading(ctx);
+  if (eofPending_) {
+    eofPending_ = false;
+    ctx->fireReadEOF();
+  }
+  return count;
+}
+
+bool FairSchedulingHandler::isControl(const codec::RedisMessage& msg) const {
+  if (msg.val.type() != codec::RedisValue::Type::kBulkStringArray || msg.val.bulkStringArray().empty()) return false;
+  return redisHandler_->isControlCommand(boost::to_lower_copy(msg.val.bulkStringArray().front()));
+}
+
+void FairSchedulingHandler::clearQueue() {
+  queue_.reset();
+  eofPending_ = false;
+  scheduler_->unschedule(this);
+}
+
+void FairSchedulingHandler::retryLater(Context* ctx) {
+  waiting_ = true;
+  // The connection may be gone by then
+  std::weak_ptr<wangle::PipelineBase> pipeline = ctx->getPipelineShared();
+  scheduler_->eventBase()->runAfterDelay(
+      [this, pipeline]() {
+        auto alive = pipeline.lock();
+        if (!alive) return;
+        waiting_ = false;
+        if (queue_ && !queue_->empty()) {
+          scheduler_->schedule(this, isControl(queue_->front()));
+        }
+      },
+      kRetryDelayMs);
+}
+
+void FairSchedulingHandler::pauseReading(Context* ctx) {
+  auto socketHandler = ctx->getPipeline()->getHandler<wangle::AsyncSocketHandler>();
+  if (paused_ || !socketHandler) return;
+  socketHandler->detachReadCallback();
+  paused_ = true;
+}
+
+void FairSchedulingHandler::resumeReading(Context* ctx) {
+  auto socketHandler = ctx->getPipeline()->getHandler<wangle::AsyncSocketHandler>();
+  if (!paused_ || !socketHandler) return;
+  socketHandler->attachReadCallback();
+  paused_ = false;
+}
+
+constexpr int FairSchedulingHandler::kRetryDelayMs;
+
+}  // namespace pipeline
@@ -0,0 +1,106 @@
+#ifndef PIPELINE_FAIRSCHEDULER_H_
+#define PIPELINE_FAIRSCHEDULER_H_
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+
+#include "codec/RedisMessage.h"
+#include "folly/io/async/EventBase.h"
+#include "pipeline/RedisHandler.h"
+#include "wangle/channel/Handler.h"
+
+namespace pipeline {
+
+struct FairSchedulerConfig {
+  // Commands executed across all connections of an event base in a single loop iteration. 0 disables scheduling, in
+  // which case commands run as soon as they are decoded.
+  size_t commandsPerTurn = 0;
+  // Commands a connection executes before yielding to the next connection in the same turn
+  size_t commandsPerConnection = 16;
+  // Reading from a connection pauses while it has this many commands queued
+  size_t maxQueuedCommands = 1024;
+};
+
+class FairSchedulingHandler;
+
+// FairScheduler runs the commands queued by all connections of an event base in round-robin order. Each loop
+// iteration executes at most commandsPerTurn commands, so a client pipelining thousands of expensive commands cannot
+// keep an I/O thread from reading other sockets. Connections whose next command is a control command are served from
+// a priority lane ahead of everyone else, which keeps the latency of health checks bounded under load.
+class FairScheduler : private folly::EventBase::LoopCallback {
+ public:
+  FairScheduler(folly::EventBase* evb, const FairSchedulerConfig& config) : evb_(evb), config_(config) {}
+
+  // The scheduler shared by all connections of the given event base. Must be called in its thread.
+  static FairScheduler* get(folly::EventBase* evb, const FairSchedulerConfig& config);
+
+  const FairSchedulerConfig& config() const { return config_; }
+  folly::EventBase* eventBase() const { return evb_; }
+
+  // Queue the connection for its next turn. No-op if it is already queued.
+  void schedule(FairSchedulingHandler* handler, bool control);
+  void unschedule(FairSchedulingHandler* handler);
+
+ private:
+  void runLoopCallback() noexcept override;
+
+  folly::EventBase* evb_;
+  const FairSchedulerConfig config_;
+  std::deque<FairSchedulingHandler*> priorityLane_;
+  std::deque<FairSchedulingHandler*> normalLane_;
+};
+
+// A per-connection handler placed right before the RedisHandler, which queues incoming commands until the scheduler
+// gives the connection a turn. Commands of a single connection always run in the order they arrive. A command that
+// defers itself, see RedisHandler::DeferralScope, stays at the head of the queue and the connection retries it after
+// kRetryDelayMs, while other connections keep their turns.
+class FairSchedulingHandler : public wangle::HandlerAdapter<codec::RedisMessage> {
+ public:
+  FairSchedulingHandler(FairScheduler* scheduler, std::shared_ptr<RedisHandler> redisHandler)
+      : scheduler_(scheduler),
+        redisHandler_(std::move(redisHandler)),
+        queue_(),
+        scheduled_(false),
+        paused_(false),
+        eofPending_(false),
+        waiting_(false) {}
+
+  ~FairSchedulingHandler();
+
+  void read(Context* ctx, codec::RedisMessage msg) override;
+  // EOF is delivered after all queued commands have run, as if they were executed upon arrival
+  void readEOF(Context* ctx) override;
+  void readException(Context* ctx, folly::exception_wrapper e) override;
+  folly::Future<folly::Unit> close(Context* ctx) override;
+
+ private:
+  friend class FairScheduler;
+
+  static constexpr int kRetryDelayMs = 1;
+
+  // Run up to maxCommands queued commands, stopping at the first non-control command if controlOnly is set. The
+  // connection is scheduled again if commands remain. Return the number of commands executed.
+  size_t runQueued(size_t maxCommands, bool controlOnly);
+
+  bool isControl(const codec::RedisMessage& msg) const;
+  void clearQueue();
+  // Schedule the connection again once the deferred command at the head of the queue is due
+  void retryLater(Context* ctx);
+  void pauseReading(Context* ctx);
+  void resumeReading(Context* ctx);
+
+  FairScheduler* scheduler_;
+  std::shared_ptr<RedisHandler> redisHandler_;
+  // Allocated on demand, so idle connections do not hold it
+  std::unique_ptr<std::deque<codec::RedisMessage>> queue_;
+  bool scheduled_;
+  bool paused_;
+  bool eofPending_;
+  // Set while waiting to retry a deferred command
+  bool waiting_;
+};
+
+}  // namespace pipeline
+
+#endif  // PIPELINE_FAIRSCHEDULER_H_
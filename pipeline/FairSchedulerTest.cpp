@@ -0,0 +1,214 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "codec/RedisMessage.h"
+#include "folly/io/async/EventBase.h"
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+#include "infra/Tracing.h"
+#include "pipeline/FairScheduler.h"
+#include "pipeline/RedisHandler.h"
+#include "wangle/channel/Handler.h"
+#include "wangle/channel/Pipeline.h"
+
+namespace pipeline {
+
+using TestPipeline = wangle::Pipeline<codec::RedisMessage, codec::RedisMessage>;
+
+// Record the commands executed by all connections as "<connection>:<command>", where HEALTH is a control command,
+// LOCKED defers itself while *busy is set and SAMPLED records whether it runs in sampled work
+class RecordingRedisHandler : public RedisHandler {
+ public:
+  RecordingRedisHandler(std::string name, std::vector<std::string>* log, const bool* busy)
+      : RedisHandler(nullptr), name_(std::move(name)), log_(log), busy_(busy) {}
+
+  const CommandHandlerTable& getCommandHandlerTable() const override {
+    static const CommandHandlerTable commandHandlerTable(mergeWithDefaultCommandHandlerTable({
+        {"get", {static_cast<CommandHandlerFunc>(&RecordingRedisHandler::recordCommand), 1, 1}},
+        {"health", {static_cast<CommandHandlerFunc>(&RecordingRedisHandler::recordCommand), 0, 0, true}},
+        {"locked", {static_cast<CommandHandlerFunc>(&RecordingRedisHandler::lockedCommand), 0, 0}},
+        {"sampled", {static_cast<CommandHandlerFunc>(&RecordingRedisHandler::sampledCommand), 0, 0}},
+    }));
+    return commandHandlerTable;
+  }
+
+  // A deferred command replies later, when it runs again
+  bool allowAsyncCommandHandler() const override { return true; }
+
+ private:
+  codec::RedisValue recordCommand(const std::vector<std::string>& cmd, Context* ctx) {
+    log_->push_back(name_ + ":" + cmd[0]);
+    return simpleStringOk();
+  }
+
+  codec::RedisValue lockedCommand(const std::vector<std::string>& cmd, Context* ctx) {
+    if (*busy_) {
+      CHECK(deferCommand(0, cmd));
+      return codec::RedisValue::asyncResult();
+    }
+    return recordCommand(cmd, ctx);
+  }
+
+  codec::RedisValue sampledCommand(const std::vector<std::string>& cmd, Context* ctx) {
+    log_->push_back(name_ + ":" + cmd[0] + "=" + (infra::Tracing::isSampled() ? "true" : "false"));
+    return simpleStringOk();
+  }
+
+  const std::string name_;
+  std::vector<std::string>* log_;
+  const bool* busy_;
+};
+
+// Terminate writes and closes at the front of the pipeline
+class SinkHandler : public wangle::OutboundHandler<codec::RedisMessage> {
+ public:
+  explicit SinkHandler(bool* closed) : closed_(closed) {}
+
+  folly::Future<folly::Unit> write(Context* ctx, codec::RedisMessage msg) override {
+    return folly::makeFuture();
+  }
+
+  folly::Future<folly::Unit> close(Context* ctx) override {
+    *closed_ = true;
+    return folly::makeFuture();
+  }
+
+ private:
+  bool* closed_;
+};
+
+class FairSchedulerTest : public ::testing::Test {
+ protected:
+  TestPipeline::Ptr createConnection(FairScheduler* scheduler, const std::string& name, bool* closed = nullptr) {
+    auto handler = std::make_shared<RecordingRedisHandler>(name, &log_, &busy_);
+    auto pipeline = TestPipeline::create();
+    pipeline->addBack(SinkHandler(closed ? closed : &ignoredClosed_));
+    pipeline->addBack(FairSchedulingHandler(scheduler, handler));
+    pipeline->addBack(handler);
+    pipeline->finalize();
+    return pipeline;
+  }
+
+  static void sendCommands(TestPipeline* pipeline, const std::string& cmdName, int count) {
+    for (int i = 0; i < count; i++) {
+      std::vector<std::string> cmd{cmdName};
+      if (cmdName == "get") cmd.push_back(std::to_string(i));
+      pipeline->read(codec::RedisMessage(codec::RedisValue(std::move(cmd))));
+    }
+  }
+
+  FairScheduler* createScheduler(size_t commandsPerTurn, size_t commandsPerConnection) {
+    FairSchedulerConfig config;
+    config.commandsPerTurn = commandsPerTurn;
+    config.commandsPerConnection = commandsPerConnection;
+    scheduler_.reset(new FairScheduler(&evb_, config));
+    return scheduler_.get();
+  }
+
+  folly::EventBase evb_;
+  std::unique_ptr<FairScheduler> scheduler_;
+  std::vector<std::string> log_;
+  bool ignoredClosed_ = false;
+  bool busy_ = false;
+};
+
+TEST_F(FairSchedulerTest, RoundRobin) {
+  auto scheduler = createScheduler(4, 2);
+  auto a = createConnection(scheduler, "a");
+  auto b = createConnection(scheduler, "b");
+  sendCommands(a.get(), "get", 6);
+  sendCommands(b.get(), "get", 6);
+  // commands wait for their turn
+  EXPECT_TRUE(log_.empty());
+
+  evb_.loopOnce();
+  EXPECT_EQ(std::vector<std::string>({"a:get", "a:get", "b:get", "b:get"}), log_);
+  evb_.loopOnce();
+  EXPECT_EQ(8, log_.size());
+  evb_.loop();
+  EXPECT_EQ(12, log_.size());
+}
+
+TEST_F(FairSchedulerTest, ControlCommandRunsImmediately) {
+  auto scheduler = createScheduler(4, 2);
+  auto a = createConnection(scheduler, "a");
+  auto b = createConnection(scheduler, "b");
+  sendCommands(a.get(), "get", 100);
+  sendCommands(b.get(), "health", 1);
+  EXPECT_EQ(std::vector<std::string>({"b:health"}), log_);
+  evb_.loop();
+  EXPECT_EQ(101, log_.size());
+}
+
+TEST_F(FairSchedulerTest, PriorityLane) {
+  auto scheduler = createScheduler(1, 1);
+  auto a = createConnection(scheduler, "a");
+  auto c = createConnection(scheduler, "c");
+  sendCommands(a.get(), "get", 5);
+  // the health check has to wait for the get before it on the same connection, but not for the other connection
+  sendCommands(c.get(), "get", 1);
+  sendCommands(c.get(), "health", 1);
+
+  evb_.loopOnce();
+  evb_.loopOnce();
+  evb_.loopOnce();
+  EXPECT_EQ(std::vector<std::string>({"a:get", "c:get", "c:health", "a:get"}), log_);
+}
+
+TEST_F(FairSchedulerTest, EofAfterQueuedCommands) {
+  auto scheduler = createScheduler(4, 2);
+  bool closed = false;
+  auto a = createConnection(scheduler, "a", &closed);
+  sendCommands(a.get(), "get", 3);
+  a->readEOF();
+  EXPECT_FALSE(closed);
+
+  evb_.loop();
+  EXPECT_EQ(3, log_.size());
+  EXPECT_TRUE(closed);
+}
+
+TEST_F(FairSchedulerTest, DeferredCommand) {
+  auto scheduler = createScheduler(4, 2);
+  auto a = createConnection(scheduler, "a");
+  auto b = createConnection(scheduler, "b");
+  busy_ = true;
+  sendCommands(a.get(), "locked", 1);
+  sendCommands(a.get(), "get", 1);
+  sendCommands(b.get(), "get", 2);
+
+  // the deferred command holds back its own connection only
+  evb_.loopOnce();
+  EXPECT_EQ(std::vector<std::string>({"b:get", "b:get"}), log_);
+  sendCommands(a.get(), "get", 1);
+  evb_.loopOnce();
+  EXPECT_EQ(2, log_.size());
+
+  busy_ = false;
+  evb_.loop();
+  EXPECT_EQ(std::vector<std::string>({"b:get", "b:get", "a:locked", "a:get", "a:get"}), log_);
+}
+
+TEST_F(FairSchedulerTest, ScheduledCommandsAreSampled) {
+  auto scheduler = createScheduler(4, 2);
+  auto a = createConnection(scheduler, "a");
+  uint32_t sampleEvery = infra::Tracing::getSampleEvery();
+  infra::Tracing::setSampleEvery(1);
+  sendCommands(a.get(), "get", 1);
+  sendCommands(a.get(), "sampled", 1);
+  evb_.loop();
+  infra::Tracing::setSampleEvery(sampleEvery);
+
+  // commands run in a later loop iteration, outside the read that decoded them, and still get sampled
+#if defined(WTF_ENABLE)
+  EXPECT_EQ(std::vector<std::string>({"a:get", "a:sampled=true"}), log_);
+#else
+  EXPECT_EQ(std::vector<std::string>({"a:get", "a:sampled=false"}), log_);
+#endif  // WTF_ENABLE
+  EXPECT_FALSE(infra::Tracing::isSampled());
+}
+
+}  // namespace pipeline
@@ -0,0 +1,155 @@
+#include "pipeline/HotKeyTracker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "prometheus/gauge_builder.h"
+
+namespace pipeline {
+
+namespace {
+
+constexpr int64_t kMetricsUpdateIntervalMs = 1000;
+
+int64_t steadyNowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+void SpaceSavingSketch::add(const std::string& key, uint64_t weight) {
+  total_ += weight;
+  auto it = counters_.find(key);
+  if (it != counters_.end()) {
+    it->second.count += weight;
+    return;
+  }
+  if (counters_.size() < capacity_) {
+    counters_.emplace(key, Counter{weight, 0});
+    return;
+  }
+
+  // A linear scan is fine for a few hundred counters, since only sampled keys get here
+  auto minIt = std::min_element(counters_.begin(), counters_.end(), [](const auto& a, const auto& b) {
+    return a.second.count < b.second.count;
+  });
+  uint64_t evictedCount = minIt->second.count;
+  counters_.erase(minIt);
+  counters_.emplace(key, Counter{evictedCount + weight, evictedCount});
+}
+
+void SpaceSavingSketch::merge(const SpaceSavingSketch& other) {
+  uint64_t thisMinCount = minCount();
+  uint64_t otherMinCount = other.minCount();
+  for (auto& entry : counters_) {
+    if (other.counters_.count(entry.first) == 0) {
+      entry.second.count += otherMinCount;
+      entry.second.error += otherMinCount;
+    }
+  }
+  for (const auto& entry : other.counters_) {
+    auto it = counters_.find(entry.first);
+    if (it == counters_.end()) {
+      counters_.emplace(entry.first,
+                        Counter{entry.second.count + thisMinCount, entry.second.error + thisMinCount});
+    } else {
+      it->second.count += entry.second.count;
+      it->second.error += entry.second.error;
+    }
+  }
+  total_ += other.total_;
+}
+
+std::vector<SpaceSavingSketch::Entry> SpaceSavingSketch::top(size_t count) const {
+  std::vector<Entry> entries;
+  entries.reserve(counters_.size());
+  for (const auto& entry : counters_) {
+    entries.push_back(Entry{entry.first, entry.second.count, entry.second.error});
+  }
+  count = std::min(count, entries.size());
+  std::partial_sort(entries.begin(), entries.begin() + count, entries.end(), [](const Entry& a, const Entry& b) {
+    return a.count != b.count ? a.count > b.count : a.key < b.key;
+  });
+  entries.resize(count);
+  return entries;
+}
+
+uint64_t SpaceSavingSketch::minCount() const {
+  // Untracked keys have never been seen until the sketch is full
+  if (counters_.size() < capacity_) return 0;
+  uint64_t count = UINT64_MAX;
+  for (const auto& entry : counters_) {
+    count = std::min(count, entry.second.count);
+  }
+  return count;
+}
+
+HotKeyTracker* HotKeyTracker::instance() {
+  static HotKeyTracker* tracker = new HotKeyTracker();
+  return tracker;
+}
+
+void HotKeyTracker::exportMetrics(prometheus::Registry* registry) {
+  hottestKeyShare_ = &prometheus::BuildGauge()
+                          .Name("hot_key_share")
+                          .Help("Share of sampled requests going to the hottest key")
+                          .Register(*registry)
+                          .Add({});
+}
+
+void HotKeyTracker::add(const std::string& key) {
+  uint64_t weight = std::max(getSampleEvery(), 1U);
+  LocalSketch* local = localSketches_.get();
+  {
+    std::lock_guard<std::mutex> guard(local->mutex);
+    local->sketch.add(key, weight);
+  }
+
+  if (hottestKeyShare_) {
+    int64_t nowMs = steadyNowMs();
+    int64_t nextUpdateMs = nextMetricsUpdateMs_;
+    // Only one of the threads sampling at the time pays for merging
+    if (nowMs >= nextUpdateMs &&
+        nextMetricsUpdateMs_.compare_exchange_strong(nextUpdateMs, nowMs + kMetricsUpdateIntervalMs)) {
+      updateMetrics();
+    }
+  }
+}
+
+std::vector<SpaceSavingSketch::Entry> HotKeyTracker::top(size_t count) {
+  return merge().top(count);
+}
+
+void HotKeyTracker::reset() {
+  for (auto& local : localSketches_.accessAllThreads()) {
+    std::lock_guard<std::mutex> guard(local.mutex);
+    local.sketch.clear();
+  }
+}
+
+SpaceSavingSketch HotKeyTracker::merge() {
+  SpaceSavingSketch merged(kCapacity);
+  for (auto& local : localSketches_.accessAllThreads()) {
+    std::lock_guard<std::mutex> guard(local.mutex);
+    merged.merge(local.sketch);
+  }
+  return merged;
+}
+
+void HotKeyTracker::updateMetrics() {
+  SpaceSavingSketch merged = merge();
+  std::vector<SpaceSavingSketch::Entry> hottest = merged.top(1);
+  if (hottest.empty() || merged.total() == 0) {
+    hottestKeyShare_->Set(0);
+  } else {
+    hottestKeyShare_->Set(static_cast<double>(hottest.front().count) / merged.total());
+  }
+}
+
+constexpr size_t HotKeyTracker::kCapacity;
+
+}  // namespace pipeline
@@ -0,0 +1,119 @@
+#ifndef PIPELINE_HOTKEYTRACKER_H_
+#define PIPELINE_HOTKEYTRACKER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "folly/ThreadLocal.h"
+#include "prometheus/gauge.h"
+#include "prometheus/registry.h"
+
+namespace pipeline {
+
+// Approximate top-K of a key stream using the space-saving algorithm, which keeps at most capacity counters. A key
+// that is not tracked replaces the one with the lowest count and inherits that count as its error, so a count
+// overestimates its key by at most the error, and every key seen more than total / capacity times is tracked.
+class SpaceSavingSketch {
+ public:
+  struct Entry {
+    std::string key;
+    uint64_t count;
+    uint64_t error;
+  };
+
+  explicit SpaceSavingSketch(size_t capacity) : capacity_(capacity) {}
+
+  // Count a key weight times, e.g., a sample standing for that many requests
+  void add(const std::string& key, uint64_t weight = 1);
+
+  // Fold another sketch in, summing the counts of keys tracked by both. A key missing from a full sketch may have been
+  // seen up to its lowest count, which is added to its error.
+  void merge(const SpaceSavingSketch& other);
+
+  // Entries ordered by descending count
+  std::vector<Entry> top(size_t count) const;
+
+  void clear() {
+    counters_.clear();
+    total_ = 0;
+  }
+
+  uint64_t total() const { return total_; }
+  size_t size() const { return counters_.size(); }
+
+ private:
+  struct Counter {
+    uint64_t count;
+    uint64_t error;
+  };
+
+  uint64_t minCount() const;
+
+  const size_t capacity_;
+  std::unordered_map<std::string, Counter> counters_;
+  uint64_t total_ = 0;
+};
+
+// HotKeyTracker samples the keys of requests into a space-saving sketch per I/O thread, so that skew shows up as data
+// rather than as CPU graphs. Sketches are only merged on demand, e.g., for the HOTKEYS command, or to export the share
+// of the hottest key as a Prometheus gauge. There is no background thread: the gauge is refreshed inline by the first
+// I/O thread sampling a key after a second has passed since the last refresh.
+// Each sample counts as many requests as the sampling rate it was taken at, so estimates stay right when the rate
+// changes while keys are tracked.
+class HotKeyTracker {
+ public:
+  // Counters kept per thread. Keys taking more than 1/kCapacity of sampled requests are never missed.
+  static constexpr size_t kCapacity = 256;
+
+  // Process-wide tracker, which is disabled until a sampling rate is set
+  static HotKeyTracker* instance();
+
+  // Sample one out of every sampleEvery requests on each thread. 0 disables sampling.
+  void setSampleEvery(uint32_t sampleEvery) { sampleEvery_ = sampleEvery; }
+  uint32_t getSampleEvery() const { return sampleEvery_; }
+
+  // Export the share of sampled requests going to the hottest key
+  void exportMetrics(prometheus::Registry* registry);
+
+  // Whether the current request on this thread is sampled. It is cheap enough to call for every request.
+  bool sampleNext() {
+    uint32_t sampleEvery = sampleEvery_.load(std::memory_order_relaxed);
+    if (sampleEvery == 0) return false;
+    static thread_local uint32_t count = 0;
+    if (++count < sampleEvery) return false;
+    count = 0;
+    return true;
+  }
+
+  // Count a sampled key in the sketch of the current thread, weighted by the current sampling rate
+  void add(const std::string& key);
+
+  // Hottest keys across threads, with counts in requests
+  std::vector<SpaceSavingSketch::Entry> top(size_t count);
+
+  void reset();
+
+ private:
+  struct LocalSketch {
+    // Only contended when sketches are merged
+    std::mutex mutex;
+    SpaceSavingSketch sketch{kCapacity};
+  };
+  struct LocalSketchTag {};
+
+  SpaceSavingSketch merge();
+  void updateMetrics();
+
+  folly::ThreadLocal<LocalSketch, LocalSketchTag> localSketches_;
+  std::atomic<uint32_t> sampleEvery_{0};
+  prometheus::Gauge* hottestKeyShare_ = nullptr;
+  std::atomic<int64_t> nextMetricsUpdateMs_{0};
+};
+
+}  // namespace pipeline
+
+#endif  // PIPELINE_HOTKEYTRACKER_H_
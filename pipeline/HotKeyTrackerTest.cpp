@@ -0,0 +1,128 @@
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "pipeline/HotKeyTracker.h"
+
+namespace pipeline {
+
+TEST(SpaceSavingSketch, ExactUnderCapacity) {
+  SpaceSavingSketch sketch(4);
+  for (const auto& key : {"a", "b", "a", "c", "a", "b"}) {
+    sketch.add(key);
+  }
+  auto top = sketch.top(2);
+  ASSERT_EQ(2, top.size());
+  EXPECT_EQ("a", top[0].key);
+  EXPECT_EQ(3, top[0].count);
+  EXPECT_EQ(0, top[0].error);
+  EXPECT_EQ("b", top[1].key);
+  EXPECT_EQ(2, top[1].count);
+  EXPECT_EQ(6, sketch.total());
+}
+
+TEST(SpaceSavingSketch, Weights) {
+  SpaceSavingSketch sketch(2);
+  sketch.add("a", 10);
+  sketch.add("b", 3);
+  sketch.add("c", 5);
+  auto top = sketch.top(2);
+  ASSERT_EQ(2, top.size());
+  EXPECT_EQ("a", top[0].key);
+  EXPECT_EQ(10, top[0].count);
+  // c replaced b and inherited its count as error
+  EXPECT_EQ("c", top[1].key);
+  EXPECT_EQ(8, top[1].count);
+  EXPECT_EQ(3, top[1].error);
+  EXPECT_EQ(18, sketch.total());
+}
+
+TEST(SpaceSavingSketch, HeavyHitterSurvivesEviction) {
+  SpaceSavingSketch sketch(8);
+  for (int i = 0; i < 1000; i++) {
+    sketch.add("hot");
+    sketch.add("cold" + std::to_string(i));
+  }
+  EXPECT_EQ(8, sketch.size());
+  auto top = sketch.top(1);
+  ASSERT_EQ(1, top.size());
+  EXPECT_EQ("hot", top[0].key);
+  // counts only overestimate, by at most the error
+  EXPECT_GE(top[0].count, 1000);
+  EXPECT_LE(top[0].count - top[0].error, 1000);
+}
+
+TEST(SpaceSavingSketch, Merge) {
+  SpaceSavingSketch a(4);
+  SpaceSavingSketch b(4);
+  a.add("x");
+  a.add("x");
+  a.add("y");
+  b.add("x");
+  b.add("z");
+  a.merge(b);
+  auto top = a.top(3);
+  ASSERT_EQ(3, top.size());
+  EXPECT_EQ("x", top[0].key);
+  EXPECT_EQ(3, top[0].count);
+  EXPECT_EQ(5, a.total());
+
+  a.clear();
+  EXPECT_EQ(0, a.size());
+  EXPECT_EQ(0, a.total());
+}
+
+TEST(HotKeyTracker, MergesThreads) {
+  HotKeyTracker* tracker = HotKeyTracker::instance();
+  tracker->setSampleEvery(1);
+  tracker->reset();
+
+  // sketches go away with their threads, so keep the threads alive until the sketches are merged
+  std::atomic<int> finished(0);
+  std::atomic<bool> merged(false);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([tracker, t, &finished, &merged]() {
+      for (int i = 0; i < 100; i++) {
+        if (tracker->sampleNext()) tracker->add("shared");
+        if (tracker->sampleNext()) tracker->add("thread" + std::to_string(t));
+      }
+      finished++;
+      while (!merged) {
+        std::this_thread::yield();
+      }
+    });
+  }
+  while (finished < 4) {
+    std::this_thread::yield();
+  }
+
+  auto top = tracker->top(1);
+  // samples taken at the old rate keep their weight, while new ones count for the new rate
+  tracker->setSampleEvery(10);
+  auto topAfterRateChange = tracker->top(1);
+  tracker->add("shared");
+  auto weightedTop = tracker->top(1);
+  tracker->reset();
+  auto topAfterReset = tracker->top(1);
+  merged = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(1, top.size());
+  EXPECT_EQ("shared", top[0].key);
+  EXPECT_EQ(400, top[0].count);
+  ASSERT_EQ(1, topAfterRateChange.size());
+  EXPECT_EQ(400, topAfterRateChange[0].count);
+  ASSERT_EQ(1, weightedTop.size());
+  EXPECT_EQ(410, weightedTop[0].count);
+  EXPECT_TRUE(topAfterReset.empty());
+
+  tracker->setSampleEvery(0);
+  EXPECT_FALSE(tracker->sampleNext());
+}
+
+}  // namespace pipeline
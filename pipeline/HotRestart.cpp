@@ -0,0 +1,262 @@
+#include "pipeline/HotRestart.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "glog/logging.h"
+
+namespace pipeline {
+
+namespace {
+
+sockaddr_un controlSocketAddress(const std::string& path) {
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  CHECK_LT(path.size(), sizeof(address.sun_path)) << "Control socket path is too long: " << path;
+  memcpy(address.sun_path, path.data(), path.size());
+  return address;
+}
+
+int64_t nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace
+
+HotRestart::~HotRestart() {
+  stop();
+  int peerFd = peerFd_.exchange(-1);
+  if (peerFd >= 0) close(peerFd);
+}
+
+void HotRestart::sendFds(int sock, const std::vector<int>& fds) {
+  CHECK(!fds.empty() && fds.size() <= kMaxFds) << "Invalid number of fds to send: " << fds.size();
+  uint32_t count = fds.size();
+  iovec iov;
+  iov.iov_base = &count;
+  iov.iov_len = sizeof(count);
+
+  std::vector<char> control(CMSG_SPACE(sizeof(int) * fds.size()), 0);
+  msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.data();
+  msg.msg_controllen = control.size();
+
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+  memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+
+  ssize_t sent = sendmsg(sock, &msg, MSG_NOSIGNAL);
+  if (sent != sizeof(count)) {
+    throw std::runtime_error(std::string("Sending fds failed: ") + strerror(errno));
+  }
+}
+
+std::vector<int> HotRestart::receiveFds(int sock) {
+  uint32_t count = 0;
+  iovec iov;
+  iov.iov_base = &count;
+  iov.iov_len = sizeof(count);
+
+  std::vector<char> control(CMSG_SPACE(sizeof(int) * kMaxFds), 0);
+  msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.data();
+  msg.msg_controllen = control.size();
+
+  ssize_t received = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+  if (received != sizeof(count)) {
+    throw std::runtime_error(std::string("Receiving fds failed: ") + (received < 0 ? strerror(errno) : "short read"));
+  }
+  if (msg.msg_flags & MSG_CTRUNC) {
+    throw std::runtime_error("Receiving fds failed: control message truncated");
+  }
+
+  std::vector<int> fds;
+  for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+    size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    const int* data = reinterpret_cast<const int*>(CMSG_DATA(cmsg));
+    fds.insert(fds.end(), data, data + n);
+  }
+  if (fds.size() != count) {
+    for (int fd : fds) close(fd);
+    throw std::runtime_error("Receiving fds failed: expected " + std::to_string(count) + " fds but got " +
+                             std::to_string(fds.size()));
+  }
+  return fds;
+}
+
+std::vector<int> HotRestart::takeover(int timeoutMs) {
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  PCHECK(fd >= 0) << "Creating hot restart control socket failed";
+  sockaddr_un address = controlSocketAddress(controlSocketPath_);
+  if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+    // Nothing to take over from, e.g., the first deploy on a host
+    PLOG(WARNING) << "No running process to take over from at " << controlSocketPath_;
+    close(fd);
+    return {};
+  }
+
+  timeval timeout = {timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+  PCHECK(setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0);
+  PCHECK(setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) == 0);
+
+  char request = kTakeoverRequest;
+  PCHECK(send(fd, &request, 1, MSG_NOSIGNAL) == 1) << "Sending takeover request failed";
+  std::vector<int> fds;
+  try {
+    fds = receiveFds(fd);
+  } catch (const std::exception& e) {
+    LOG(FATAL) << "Taking over listening sockets from " << controlSocketPath_ << " failed: " << e.what();
+  }
+
+  // The old process may take a long time to drain, so wait for database handover without a timeout
+  timeout = {0, 0};
+  PCHECK(setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0);
+  peerFd_ = fd;
+  LOG(INFO) << "Took over " << fds.size() << " listening sockets from " << controlSocketPath_;
+  return fds;
+}
+
+int64_t HotRestart::waitForDatabaseClosed() {
+  int fd = peerFd_.exchange(-1);
+  CHECK_GE(fd, 0) << "Must take over sockets before waiting for the database";
+  int64_t startMs = nowMs();
+  char notification;
+  ssize_t n;
+  do {
+    n = recv(fd, &notification, 1, 0);
+  } while (n < 0 && errno == EINTR);
+  if (n == 1) {
+    CHECK_EQ(notification, kDatabaseClosed) << "Unexpected hot restart notification";
+  } else {
+    // The old process closes the connection when it exits, which releases the database lock as well
+    LOG(WARNING) << "Previous process exited without notifying database handover";
+  }
+  close(fd);
+  int64_t waitedMs = nowMs() - startMs;
+  LOG(INFO) << "Previous process released the database after " << waitedMs << "ms";
+  return waitedMs;
+}
+
+void HotRestart::listenForTakeover(std::function<std::vector<int>()> getListeningFds, std::function<void()> drain) {
+  CHECK(!run_) << "Already listening for takeover requests";
+  // A control socket file left behind by the previous process must be replaced. Only remove it when it is actually a
+  // socket so that a misconfigured path never deletes a regular file.
+  struct stat buf;
+  if (lstat(controlSocketPath_.c_str(), &buf) == 0) {
+    CHECK(S_ISSOCK(buf.st_mode)) << "Control socket path exists and is not a socket: " << controlSocketPath_;
+    PCHECK(unlink(controlSocketPath_.c_str()) == 0) << "Removing stale control socket failed";
+  }
+
+  listenFd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  PCHECK(listenFd_ >= 0) << "Creating hot restart control socket failed";
+  sockaddr_un address = controlSocketAddress(controlSocketPath_);
+  PCHECK(bind(listenFd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0)
+      << "Binding hot restart control socket failed: " << controlSocketPath_;
+  PCHECK(listen(listenFd_, 1) == 0);
+  LOG(INFO) << "Listening for hot restart takeover on " << controlSocketPath_;
+
+  run_ = true;
+  listenThread_ = std::thread([this, getListeningFds, drain]() {
+    while (run_) {
+      pollfd pfd = {listenFd_, POLLIN, 0};
+      int ready = poll(&pfd, 1, kPollIntervalMs);
+      if (ready <= 0) continue;
+      int fd = accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+      if (fd < 0) {
+        PLOG(ERROR) << "Accepting hot restart connection failed";
+        continue;
+      }
+      if (!handleTakeover(fd, getListeningFds)) {
+        close(fd);
+        continue;
+      }
+
+      // The new process owns the listening sockets now, so stop accepting further takeover requests
+      peerFd_ = fd;
+      run_ = false;
+      int64_t startMs = nowMs();
+      drain();
+      LOG(INFO) << "Drained in-flight requests for hot restart in " << (nowMs() - startMs) << "ms";
+    }
+  });
+}
+
+bool HotRestart::handleTakeover(int fd, const std::function<std::vector<int>()>& getListeningFds) {
+  timeval timeout = {1, 0};
+  PCHECK(setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0);
+  char request;
+  if (recv(fd, &request, 1, 0) != 1 || request != kTakeoverRequest) {
+    LOG(ERROR) << "Invalid hot restart takeover request";
+    return false;
+  }
+
+  std::vector<int> fds = getListeningFds();
+  if (fds.empty()) {
+    LOG(ERROR) << "No listening sockets to hand over";
+    return false;
+  }
+  try {
+    sendFds(fd, fds);
+  } catch (const std::exception& e) {
+    LOG(ERROR) << e.what();
+    return false;
+  }
+  LOG(INFO) << "Handed over " << fds.size() << " listening sockets for hot restart";
+  return true;
+}
+
+void HotRestart::notifyDatabaseClosed() {
+  int fd = peerFd_.exchange(-1);
+  if (fd < 0) return;
+  char notification = kDatabaseClosed;
+  if (send(fd, &notification, 1, MSG_NOSIGNAL) != 1) {
+    PLOG(ERROR) << "Notifying database handover failed";
+  }
+  close(fd);
+  LOG(INFO) << "Handed over the database for hot restart";
+}
+
+void HotRestart::stop() {
+  run_ = false;
+  if (listenThread_.joinable()) {
+    if (listenThread_.get_id() == std::this_thread::get_id()) {
+      // stop may be triggered by drain on the listening thread itself
+      listenThread_.detach();
+    } else {
+      listenThread_.join();
+    }
+  }
+  if (listenFd_ >= 0) {
+    close(listenFd_);
+    listenFd_ = -1;
+  }
+}
+
+constexpr int HotRestart::kMaxFds;
+constexpr int HotRestart::kPollIntervalMs;
+constexpr char HotRestart::kTakeoverRequest;
+constexpr char HotRestart::kDatabaseClosed;
+
+}  // namespace pipeline
@@ -0,0 +1,69 @@
+#ifndef PIPELINE_HOTRESTART_H_
+#define PIPELINE_HOTRESTART_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace pipeline {
+
+// HotRestart hands the listening sockets of a running server over to its replacement through a unix domain control
+// socket, so that clients never see connection refusal during a deploy. The handover goes as follows:
+//   1. The new process connects to the control socket and receives all listening socket fds via SCM_RIGHTS.
+//   2. The old process stops its server, draining in-flight requests. New connections queue up in the accept backlog
+//      shared by both processes in the meantime.
+//   3. The old process stops its optional components, closes RocksDB, and notifies the new process, which then opens
+//      RocksDB and starts accepting on the inherited sockets.
+class HotRestart {
+ public:
+  explicit HotRestart(std::string controlSocketPath)
+      : controlSocketPath_(std::move(controlSocketPath)), listenFd_(-1), peerFd_(-1), run_(false) {}
+
+  ~HotRestart();
+
+  // Called by the new process. Receive listening sockets from the process listening on the control socket. Return an
+  // empty vector if no process is listening, in which case the caller should bind its own sockets.
+  std::vector<int> takeover(int timeoutMs);
+
+  // Called by the new process after a successful takeover. Block until the old process has closed its database or
+  // exited. Return the time waited in milliseconds.
+  int64_t waitForDatabaseClosed();
+
+  // Called by the old process. Start a thread waiting for a takeover request on the control socket. Upon request,
+  // getListeningFds is called to collect the sockets to hand over, and drain is called once they are sent.
+  void listenForTakeover(std::function<std::vector<int>()> getListeningFds, std::function<void()> drain);
+
+  // Called by the old process after its database is closed. No-op if no takeover has happened.
+  void notifyDatabaseClosed();
+
+  // Stop waiting for takeover requests. It blocks until the listening thread exits.
+  void stop();
+
+  // Exposed for testing
+  static void sendFds(int sock, const std::vector<int>& fds);
+  static std::vector<int> receiveFds(int sock);
+
+ private:
+  static constexpr int kMaxFds = 64;
+  static constexpr int kPollIntervalMs = 200;
+  static constexpr char kTakeoverRequest = 'T';
+  static constexpr char kDatabaseClosed = 'C';
+
+  // Serve a single takeover request on the accepted connection. Return whether the takeover succeeded.
+  bool handleTakeover(int fd, const std::function<std::vector<int>()>& getListeningFds);
+
+  const std::string controlSocketPath_;
+  int listenFd_;
+  // Connection to the process on the other side of a takeover
+  std::atomic<int> peerFd_;
+  std::atomic<bool> run_;
+  std::thread listenThread_;
+};
+
+}  // namespace pipeline
+
+#endif  // PIPELINE_HOTRESTART_H_
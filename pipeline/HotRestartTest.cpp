@@ -0,0 +1,85 @@
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "pipeline/HotRestart.h"
+
+namespace pipeline {
+
+// Write a byte through writeFd and check that it arrives at readFd
+static void expectConnected(int writeFd, int readFd) {
+  char c = 'x';
+  ASSERT_EQ(1, write(writeFd, &c, 1));
+  c = 0;
+  ASSERT_EQ(1, read(readFd, &c, 1));
+  EXPECT_EQ('x', c);
+}
+
+static std::string controlSocketPath() {
+  return "/tmp/hot-restart-test-" + std::to_string(getpid()) + ".sock";
+}
+
+TEST(HotRestartTest, SendReceiveFds) {
+  int sockets[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+  int pipe1[2], pipe2[2];
+  ASSERT_EQ(0, pipe(pipe1));
+  ASSERT_EQ(0, pipe(pipe2));
+
+  HotRestart::sendFds(sockets[0], {pipe1[1], pipe2[1]});
+  std::vector<int> fds = HotRestart::receiveFds(sockets[1]);
+  ASSERT_EQ(2, fds.size());
+  // received fds are new descriptors referring to the same pipes
+  EXPECT_NE(pipe1[1], fds[0]);
+  expectConnected(fds[0], pipe1[0]);
+  expectConnected(fds[1], pipe2[0]);
+
+  for (int fd : {sockets[0], sockets[1], pipe1[0], pipe1[1], pipe2[0], pipe2[1], fds[0], fds[1]}) close(fd);
+}
+
+TEST(HotRestartTest, TakeoverWithoutRunningProcess) {
+  HotRestart hotRestart(controlSocketPath());
+  EXPECT_TRUE(hotRestart.takeover(1000).empty());
+}
+
+TEST(HotRestartTest, Takeover) {
+  int listeningPipe[2];
+  ASSERT_EQ(0, pipe(listeningPipe));
+  std::atomic<bool> drained(false);
+
+  HotRestart oldProcess(controlSocketPath());
+  oldProcess.listenForTakeover([&listeningPipe]() { return std::vector<int>{listeningPipe[1]}; },
+                               [&drained]() { drained = true; });
+
+  HotRestart newProcess(controlSocketPath());
+  std::vector<int> fds = newProcess.takeover(1000);
+  ASSERT_EQ(1, fds.size());
+  expectConnected(fds[0], listeningPipe[0]);
+
+  while (!drained) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  std::thread notifier([&oldProcess]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    oldProcess.notifyDatabaseClosed();
+  });
+  EXPECT_GE(newProcess.waitForDatabaseClosed(), 0);
+  notifier.join();
+
+  // the new process can serve further takeovers from the same control socket path
+  oldProcess.stop();
+  newProcess.listenForTakeover([&fds]() { return fds; }, []() {});
+  HotRestart nextProcess(controlSocketPath());
+  EXPECT_EQ(1, nextProcess.takeover(1000).size());
+
+  for (int fd : {listeningPipe[0], listeningPipe[1], fds[0]}) close(fd);
+  unlink(controlSocketPath().c_str());
+}
+
+}  // namespace pipeline
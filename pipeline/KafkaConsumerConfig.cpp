@@ -2,7 +2,9 @@
 
 #include <string>
 #include <utility>
+#include <vector>
 
+#include "folly/String.h"
 #include "folly/dynamic.h"
 #include "glog/logging.h"
 #include "librdkafka/rdkafkacpp.h"
@@ -31,6 +33,13 @@ KafkaConsumerConfig KafkaConsumerConfig::createFromJson(const folly::dynamic& co
   }
   CHECK(!(consumeFromBeginningOneOff && initialOffsetOneOff >= 0))
       << "Cannot defined both consume_from_beginning_one_off and initial_offset_one_off";
+  int64_t initialTimestampMsOneOff = -1;
+  if (config.get_ptr("initial_timestamp_ms_one_off")) {
+    initialTimestampMsOneOff = config["initial_timestamp_ms_one_off"].getInt();
+    CHECK_GE(initialTimestampMsOneOff, 0) << "initial_timestamp_ms_one_off must not be negative";
+  }
+  CHECK(!(initialTimestampMsOneOff >= 0 && (consumeFromBeginningOneOff || initialOffsetOneOff >= 0)))
+      << "Cannot defined initial_timestamp_ms_one_off with consume_from_beginning_one_off or initial_offset_one_off";
 
   // optional configs for kafka store consumers
   std::string objectStoreBucketName = "";
@@ -48,9 +57,42 @@ KafkaConsumerConfig KafkaConsumerConfig::createFromJson(const folly::dynamic& co
     lowLatency = config["low_latency"].getBool();
   }
 
+  // optional configs to keep replaying consumers from hurting client traffic
+  int64_t replayLagThreshold = 0;
+  if (config.get_ptr("replay_lag_threshold")) {
+    replayLagThreshold = config["replay_lag_threshold"].getInt();
+    CHECK_GE(replayLagThreshold, 0) << "replay_lag_threshold must not be negative";
+  }
+  double replayMaxMessagesPerSec = 0;
+  if (config.get_ptr("replay_max_messages_per_sec")) {
+    replayMaxMessagesPerSec = config["replay_max_messages_per_sec"].asDouble();
+    CHECK_GE(replayMaxMessagesPerSec, 0) << "replay_max_messages_per_sec must not be negative";
+  }
+  double replayMaxWriteBytesPerSec = 0;
+  if (config.get_ptr("replay_max_write_bytes_per_sec")) {
+    replayMaxWriteBytesPerSec = config["replay_max_write_bytes_per_sec"].asDouble();
+    CHECK_GE(replayMaxWriteBytesPerSec, 0) << "replay_max_write_bytes_per_sec must not be negative";
+  }
+
+  // optional configs to skip messages before they are decoded
+  std::vector<std::string> filterKeyPrefixes;
+  if (config.get_ptr("filter_key_prefixes")) {
+    for (const auto& keyPrefix : config["filter_key_prefixes"]) {
+      filterKeyPrefixes.push_back(keyPrefix.getString());
+    }
+  }
+  std::string filterPayloadPrefix;
+  if (config.get_ptr("filter_payload_prefix_hex")) {
+    // payloads are mostly binary, e.g., starting with the magic byte and schema id of their encoding
+    CHECK(folly::unhexlify(config["filter_payload_prefix_hex"].getString(), filterPayloadPrefix))
+        << "filter_payload_prefix_hex must be a hex string";
+  }
+
   return KafkaConsumerConfig(std::move(consumerName), std::move(topic), partition, std::move(groupId),
                              std::move(offsetKeySuffix), consumeFromBeginningOneOff, initialOffsetOneOff,
-                             objectStoreBucketName, objectStoreObjectNamePrefix, lowLatency);
+                             initialTimestampMsOneOff, objectStoreBucketName, objectStoreObjectNamePrefix, lowLatency,
+                             replayLagThreshold, replayMaxMessagesPerSec, replayMaxWriteBytesPerSec,
+                             std::move(filterKeyPrefixes), std::move(filterPayloadPrefix));
 }
 
 }  // namespace pipeline
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "folly/dynamic.h"
 
@@ -15,7 +16,10 @@ class KafkaConsumerConfig {
 
   KafkaConsumerConfig(std::string _consumerName, std::string _topic, int _partition, std::string _groupId,
                       std::string _offsetKeySuffix, bool _consumeFromBeginningOneoff, int64_t _initialOffsetOneoff,
-                      std::string _objectStoreBucketName, std::string _objectStoreObjectNamePrefix, bool _lowLatency)
+                      int64_t _initialTimestampMsOneOff, std::string _objectStoreBucketName,
+                      std::string _objectStoreObjectNamePrefix, bool _lowLatency, int64_t _replayLagThreshold,
+                      double _replayMaxMessagesPerSec, double _replayMaxWriteBytesPerSec,
+                      std::vector<std::string> _filterKeyPrefixes, std::string _filterPayloadPrefix)
       : consumerName(std::move(_consumerName)),
         topic(std::move(_topic)),
         partition(_partition),
@@ -23,9 +27,15 @@ class KafkaConsumerConfig {
         offsetKeySuffix(std::move(_offsetKeySuffix)),
         consumeFromBeginningOneOff(_consumeFromBeginningOneoff),
         initialOffsetOneOff(_initialOffsetOneoff),
+        initialTimestampMsOneOff(_initialTimestampMsOneOff),
         objectStoreBucketName(_objectStoreBucketName),
         objectStoreObjectNamePrefix(_objectStoreObjectNamePrefix),
-        lowLatency(_lowLatency) {}
+        lowLatency(_lowLatency),
+        replayLagThreshold(_replayLagThreshold),
+        replayMaxMessagesPerSec(_replayMaxMessagesPerSec),
+        replayMaxWriteBytesPerSec(_replayMaxWriteBytesPerSec),
+        filterKeyPrefixes(std::move(_filterKeyPrefixes)),
+        filterPayloadPrefix(std::move(_filterPayloadPrefix)) {}
 
   const std::string consumerName;
   const std::string topic;
@@ -34,9 +44,20 @@ class KafkaConsumerConfig {
   const std::string offsetKeySuffix;
   const bool consumeFromBeginningOneOff;
   const int64_t initialOffsetOneOff;
+  // Negative when not specified
+  const int64_t initialTimestampMsOneOff;
   const std::string objectStoreBucketName;
   const std::string objectStoreObjectNamePrefix;
   const bool lowLatency;
+  // The consumer is throttled while it lags behind by more than replayLagThreshold messages. 0 disables throttling.
+  const int64_t replayLagThreshold;
+  // Limits while replaying, where 0 means unlimited
+  const double replayMaxMessagesPerSec;
+  const double replayMaxWriteBytesPerSec;
+  // Only messages with a key starting with any of the prefixes, if there are any, and a payload starting with the
+  // payload prefix are processed
+  const std::vector<std::string> filterKeyPrefixes;
+  const std::string filterPayloadPrefix;
 };
 
 }  // namespace pipeline
@@ -1,5 +1,8 @@
 #include "pipeline/KafkaConsumerConfig.h"
 
+#include <string>
+#include <vector>
+
 #include "folly/dynamic.h"
 #include "gtest/gtest.h"
 #include "librdkafka/rdkafkacpp.h"
@@ -16,9 +19,15 @@ TEST(KafkaConsumerConfig, CreateFromJsonDefaultOptionalFields) {
   EXPECT_TRUE(config.offsetKeySuffix.empty());
   EXPECT_FALSE(config.consumeFromBeginningOneOff);
   EXPECT_TRUE(RdKafka::Topic::OFFSET_INVALID == config.initialOffsetOneOff);
+  EXPECT_GT(0, config.initialTimestampMsOneOff);
   EXPECT_TRUE(config.objectStoreBucketName.empty());
   EXPECT_TRUE(config.objectStoreObjectNamePrefix.empty());
   EXPECT_FALSE(config.lowLatency);
+  EXPECT_EQ(0, config.replayLagThreshold);
+  EXPECT_EQ(0, config.replayMaxMessagesPerSec);
+  EXPECT_EQ(0, config.replayMaxWriteBytesPerSec);
+  EXPECT_TRUE(config.filterKeyPrefixes.empty());
+  EXPECT_TRUE(config.filterPayloadPrefix.empty());
 }
 
 TEST(KafkaConsumerConfig, CreateFromJsonConflictingOffsets) {
@@ -34,6 +43,29 @@ TEST(KafkaConsumerConfig, CreateFromJsonConflictingOffsets) {
     "Check failed.*Cannot defined both consume_from_beginning_one_off and initial_offset_one_off");
 }
 
+TEST(KafkaConsumerConfig, CreateFromJsonConflictingTimestamp) {
+  EXPECT_DEATH(KafkaConsumerConfig::createFromJson(
+    folly::dynamic::object
+      ("consumer_name", "TestConsumer")
+      ("topic", "abc")
+      ("partition", 1)
+      ("group_id", "test")
+      ("initial_offset_one_off", 123)
+      ("initial_timestamp_ms_one_off", 1500000000000)),
+    "Check failed.*Cannot defined initial_timestamp_ms_one_off");
+}
+
+TEST(KafkaConsumerConfig, CreateFromJsonTimestamp) {
+  auto config = KafkaConsumerConfig::createFromJson(folly::dynamic::object
+      ("consumer_name", "TestConsumer")
+      ("topic", "abc")
+      ("partition", 1)
+      ("group_id", "test")
+      ("initial_timestamp_ms_one_off", 1500000000000));
+  EXPECT_EQ(1500000000000L, config.initialTimestampMsOneOff);
+  EXPECT_TRUE(RdKafka::Topic::OFFSET_INVALID == config.initialOffsetOneOff);
+}
+
 TEST(KafkaConsumerConfig, CreateFromJsonOptionalFields) {
   auto config = KafkaConsumerConfig::createFromJson(folly::dynamic::object
       ("consumer_name", "TestConsumer")
@@ -53,4 +85,46 @@ TEST(KafkaConsumerConfig, CreateFromJsonOptionalFields) {
   EXPECT_TRUE(config.lowLatency);
 }
 
+TEST(KafkaConsumerConfig, CreateFromJsonReplayLimits) {
+  auto config = KafkaConsumerConfig::createFromJson(folly::dynamic::object
+      ("consumer_name", "TestConsumer")
+      ("topic", "abc")
+      ("partition", 1)
+      ("group_id", "test")
+      ("replay_lag_threshold", 100000)
+      ("replay_max_messages_per_sec", 5000)
+      ("replay_max_write_bytes_per_sec", 2.5e6));
+  EXPECT_EQ(100000L, config.replayLagThreshold);
+  EXPECT_EQ(5000, config.replayMaxMessagesPerSec);
+  EXPECT_EQ(2.5e6, config.replayMaxWriteBytesPerSec);
+
+  EXPECT_DEATH(KafkaConsumerConfig::createFromJson(folly::dynamic::object
+      ("consumer_name", "TestConsumer")
+      ("topic", "abc")
+      ("partition", 1)
+      ("group_id", "test")
+      ("replay_lag_threshold", -1)),
+    "Check failed.*replay_lag_threshold must not be negative");
+}
+
+TEST(KafkaConsumerConfig, CreateFromJsonFilter) {
+  auto config = KafkaConsumerConfig::createFromJson(folly::dynamic::object
+      ("consumer_name", "TestConsumer")
+      ("topic", "abc")
+      ("partition", 1)
+      ("group_id", "test")
+      ("filter_key_prefixes", folly::dynamic::array("user:", "ip:"))
+      ("filter_payload_prefix_hex", "000000002a"));
+  EXPECT_EQ(std::vector<std::string>({"user:", "ip:"}), config.filterKeyPrefixes);
+  EXPECT_EQ(std::string("\x00\x00\x00\x00\x2a", 5), config.filterPayloadPrefix);
+
+  EXPECT_DEATH(KafkaConsumerConfig::createFromJson(folly::dynamic::object
+      ("consumer_name", "TestConsumer")
+      ("topic", "abc")
+      ("partition", 1)
+      ("group_id", "test")
+      ("filter_payload_prefix_hex", "xyz")),
+    "Check failed.*filter_payload_prefix_hex must be a hex string");
+}
+
 }  // namespace pipeline
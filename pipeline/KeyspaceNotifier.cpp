@@ -0,0 +1,233 @@
+#include "pipeline/KeyspaceNotifier.h"
+
+#include <fnmatch.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "glog/logging.h"
+#include "rocksdb/slice.h"
+#include "rocksdb/status.h"
+
+namespace pipeline {
+
+namespace {
+
+// Publish an event for every key updated by a write batch
+class KeyspaceEventPublisher : public rocksdb::WriteBatch::Handler {
+ public:
+  KeyspaceEventPublisher(KeyspaceNotifier* notifier, const std::unordered_set<uint32_t>& ignoredColumnFamilyIds)
+      : notifier_(notifier), ignoredColumnFamilyIds_(ignoredColumnFamilyIds) {}
+
+  rocksdb::Status PutCF(uint32_t columnFamilyId, const rocksdb::Slice& key, const rocksdb::Slice& value) override {
+    publish(columnFamilyId, key, "set");
+    return rocksdb::Status::OK();
+  }
+
+  rocksdb::Status DeleteCF(uint32_t columnFamilyId, const rocksdb::Slice& key) override {
+    publish(columnFamilyId, key, "del");
+    return rocksdb::Status::OK();
+  }
+
+  rocksdb::Status SingleDeleteCF(uint32_t columnFamilyId, const rocksdb::Slice& key) override {
+    publish(columnFamilyId, key, "del");
+    return rocksdb::Status::OK();
+  }
+
+  rocksdb::Status MergeCF(uint32_t columnFamilyId, const rocksdb::Slice& key, const rocksdb::Slice& value) override {
+    publish(columnFamilyId, key, "merge");
+    return rocksdb::Status::OK();
+  }
+
+  // Range deletions do not name individual keys, so there is nothing to publish
+  rocksdb::Status DeleteRangeCF(uint32_t columnFamilyId, const rocksdb::Slice& beginKey,
+                                const rocksdb::Slice& endKey) override {
+    return rocksdb::Status::OK();
+  }
+
+  void LogData(const rocksdb::Slice& blob) override {}
+
+ private:
+  void publish(uint32_t columnFamilyId, const rocksdb::Slice& key, const std::string& event) {
+    if (ignoredColumnFamilyIds_.count(columnFamilyId) == 0) {
+      notifier_->publish(columnFamilyId, key.ToString(), event);
+    }
+  }
+
+  KeyspaceNotifier* notifier_;
+  const std::unordered_set<uint32_t>& ignoredColumnFamilyIds_;
+};
+
+}  // namespace
+
+KeyspaceNotifier* KeyspaceNotifier::instance() {
+  // Never destroyed, so that connections closing during shutdown can still unsubscribe
+  static KeyspaceNotifier* notifier = new KeyspaceNotifier();
+  return notifier;
+}
+
+size_t KeyspaceNotifier::subscribe(Context* ctx, folly::EventBase* evb, const std::string& channel) {
+  folly::SharedMutex::WriteHolder guard(mutex_);
+  auto& subscriber = subscribers_[ctx];
+  if (!subscriber) {
+    subscriber = std::make_shared<Subscriber>(ctx, evb);
+    subscriberCount_++;
+  }
+  if (subscriber->channels.insert(channel).second) {
+    channelSubscribers_[channel].push_back(subscriber);
+  }
+  return subscriber->channels.size() + subscriber->patterns.size();
+}
+
+size_t KeyspaceNotifier::psubscribe(Context* ctx, folly::EventBase* evb, const std::string& pattern) {
+  folly::SharedMutex::WriteHolder guard(mutex_);
+  auto& subscriber = subscribers_[ctx];
+  if (!subscriber) {
+    subscriber = std::make_shared<Subscriber>(ctx, evb);
+    subscriberCount_++;
+  }
+  if (subscriber->patterns.empty()) {
+    patternSubscribers_.push_back(subscriber);
+  }
+  subscriber->patterns.insert(pattern);
+  return subscriber->channels.size() + subscriber->patterns.size();
+}
+
+size_t KeyspaceNotifier::unsubscribe(Context* ctx, const std::string& channel) {
+  folly::SharedMutex::WriteHolder guard(mutex_);
+  auto it = subscribers_.find(ctx);
+  if (it == subscribers_.end()) return 0;
+
+  std::shared_ptr<Subscriber> subscriber = it->second;
+  if (subscriber->channels.erase(channel) > 0) {
+    removeChannel(subscriber, channel);
+  }
+  return removeIfIdle(subscriber);
+}
+
+size_t KeyspaceNotifier::punsubscribe(Context* ctx, const std::string& pattern) {
+  folly::SharedMutex::WriteHolder guard(mutex_);
+  auto it = subscribers_.find(ctx);
+  if (it == subscribers_.end()) return 0;
+
+  std::shared_ptr<Subscriber> subscriber = it->second;
+  if (subscriber->patterns.erase(pattern) > 0 && subscriber->patterns.empty()) {
+    patternSubscribers_.erase(std::remove(patternSubscribers_.begin(), patternSubscribers_.end(), subscriber),
+                              patternSubscribers_.end());
+  }
+  return removeIfIdle(subscriber);
+}
+
+void KeyspaceNotifier::unsubscribeAll(Context* ctx) {
+  // Every connection calls it on close, most of which never subscribed
+  if (!hasSubscribers()) return;
+
+  folly::SharedMutex::WriteHolder guard(mutex_);
+  auto it = subscribers_.find(ctx);
+  if (it == subscribers_.end()) return;
+
+  std::shared_ptr<Subscriber> subscriber = it->second;
+  for (const auto& channel : subscriber->channels) {
+    removeChannel(subscriber, channel);
+  }
+  subscriber->channels.clear();
+  if (!subscriber->patterns.empty()) {
+    subscriber->patterns.clear();
+    patternSubscribers_.erase(std::remove(patternSubscribers_.begin(), patternSubscribers_.end(), subscriber),
+                              patternSubscribers_.end());
+  }
+  removeIfIdle(subscriber);
+}
+
+std::vector<std::string> KeyspaceNotifier::getChannels(Context* ctx) const {
+  folly::SharedMutex::ReadHolder guard(mutex_);
+  auto it = subscribers_.find(ctx);
+  if (it == subscribers_.end()) return {};
+  return std::vector<std::string>(it->second->channels.begin(), it->second->channels.end());
+}
+
+std::vector<std::string> KeyspaceNotifier::getPatterns(Context* ctx) const {
+  folly::SharedMutex::ReadHolder guard(mutex_);
+  auto it = subscribers_.find(ctx);
+  if (it == subscribers_.end()) return {};
+  return std::vector<std::string>(it->second->patterns.begin(), it->second->patterns.end());
+}
+
+void KeyspaceNotifier::publish(uint32_t columnFamilyId, const std::string& key, const std::string& event) {
+  if (!hasSubscribers()) return;
+
+  std::string channel = keyspaceChannel(columnFamilyId, key);
+  folly::SharedMutex::ReadHolder guard(mutex_);
+  auto it = channelSubscribers_.find(channel);
+  if (it != channelSubscribers_.end()) {
+    for (const auto& subscriber : it->second) {
+      deliver(subscriber, {"message", channel, event});
+    }
+  }
+
+  for (const auto& subscriber : patternSubscribers_) {
+    for (const auto& pattern : subscriber->patterns) {
+      // NOTE: fnmatch stops at the first null byte of binary keys, which still allows matching on key prefixes
+      if (fnmatch(pattern.c_str(), channel.c_str(), 0) == 0) {
+        deliver(subscriber, {"pmessage", pattern, channel, event});
+      }
+    }
+  }
+}
+
+void KeyspaceNotifier::publishWriteBatch(rocksdb::WriteBatch* writeBatch) {
+  if (!hasSubscribers() || writeBatch->Count() == 0) return;
+
+  KeyspaceEventPublisher publisher(this, ignoredColumnFamilyIds_);
+  rocksdb::Status status = writeBatch->Iterate(&publisher);
+  if (!status.ok()) {
+    LOG(ERROR) << "Publishing keyspace events of write batch failed: " << status.ToString();
+  }
+}
+
+size_t KeyspaceNotifier::removeIfIdle(const std::shared_ptr<Subscriber>& subscriber) {
+  size_t count = subscriber->channels.size() + subscriber->patterns.size();
+  if (count == 0) {
+    // Messages already in flight are discarded, even if the connection subscribes again before they arrive
+    subscriber->active = false;
+    subscribers_.erase(subscriber->ctx);
+    subscriberCount_--;
+  }
+  return count;
+}
+
+void KeyspaceNotifier::removeChannel(const std::shared_ptr<Subscriber>& subscriber, const std::string& channel) {
+  auto it = channelSubscribers_.find(channel);
+  if (it == channelSubscribers_.end()) return;
+  it->second.erase(std::remove(it->second.begin(), it->second.end(), subscriber), it->second.end());
+  if (it->second.empty()) {
+    channelSubscribers_.erase(it);
+  }
+}
+
+void KeyspaceNotifier::deliver(const std::shared_ptr<Subscriber>& subscriber, std::vector<std::string>&& message) {
+  if (subscriber->pendingMessages++ >= maxPendingMessages_) {
+    subscriber->pendingMessages--;
+    droppedMessageCount_++;
+    return;
+  }
+
+  subscriber->evb->runInEventBaseThread([subscriber, message = std::move(message)]() mutable {
+    auto pipeline = subscriber->pipeline.lock();
+    if (!subscriber->active || !pipeline) {
+      subscriber->pendingMessages--;
+      return;
+    }
+    // use -1 as the key because messages do not correspond to any request. The message stays pending until the
+    // socket has written it, so that the limit bounds the write buffer of the socket as well.
+    subscriber->ctx->fireWrite(codec::RedisMessage(-1, codec::RedisValue(std::move(message))))
+        .ensure([subscriber]() { subscriber->pendingMessages--; });
+  });
+}
+
+constexpr size_t KeyspaceNotifier::kDefaultMaxPendingMessages;
+
+}  // namespace pipeline
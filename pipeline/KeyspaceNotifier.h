@@ -0,0 +1,103 @@
+#ifndef PIPELINE_KEYSPACENOTIFIER_H_
+#define PIPELINE_KEYSPACENOTIFIER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "codec/RedisMessage.h"
+#include "folly/SharedMutex.h"
+#include "folly/io/async/EventBase.h"
+#include "rocksdb/write_batch.h"
+#include "wangle/channel/Handler.h"
+
+namespace pipeline {
+
+// KeyspaceNotifier publishes key change events to connections subscribed with SUBSCRIBE or PSUBSCRIBE, so that clients
+// can wait for changes instead of polling keys. As in redis, an event is published to the channel
+// "__keyspace@<db>__:<key>" with the event name, e.g., set or del, as the message, and patterns use glob-style
+// matching. The id of the column family takes the place of the database number, so the same key in different column
+// families maps to different channels, and the default column family keeps redis' "__keyspace@0__:<key>".
+// Messages are written on the event base of each subscriber. Every subscriber has a bounded number of messages which
+// are not written to its socket yet, beyond which messages are dropped and counted, so a slow client can neither
+// block writers nor grow memory.
+class KeyspaceNotifier {
+ public:
+  using Context = wangle::HandlerAdapter<codec::RedisMessage>::Context;
+
+  static constexpr size_t kDefaultMaxPendingMessages = 1024;
+
+  // Process-wide notifier shared by all connections and writers
+  static KeyspaceNotifier* instance();
+
+  static std::string keyspaceChannel(uint32_t columnFamilyId, const std::string& key) {
+    return "__keyspace@" + std::to_string(columnFamilyId) + "__:" + key;
+  }
+
+  void setMaxPendingMessages(size_t maxPendingMessages) { maxPendingMessages_ = maxPendingMessages; }
+
+  // Skip the column family when publishing write batches, e.g., for offsets and other metadata.
+  // Only call it during initialization, before any write batch is published.
+  void ignoreColumnFamily(uint32_t columnFamilyId) { ignoredColumnFamilyIds_.insert(columnFamilyId); }
+
+  // Subscription changes return the number of channels and patterns the connection is subscribed to afterwards.
+  // Messages are written to the context on the given event base, which has to be the one running the connection.
+  size_t subscribe(Context* ctx, folly::EventBase* evb, const std::string& channel);
+  size_t psubscribe(Context* ctx, folly::EventBase* evb, const std::string& pattern);
+  size_t unsubscribe(Context* ctx, const std::string& channel);
+  size_t punsubscribe(Context* ctx, const std::string& pattern);
+  void unsubscribeAll(Context* ctx);
+
+  std::vector<std::string> getChannels(Context* ctx) const;
+  std::vector<std::string> getPatterns(Context* ctx) const;
+
+  // Publish an event of the key to subscribers of its keyspace channel and the matching patterns
+  void publish(uint32_t columnFamilyId, const std::string& key, const std::string& event);
+  // Publish set, del, and merge events for the keys updated by a committed write batch
+  void publishWriteBatch(rocksdb::WriteBatch* writeBatch);
+
+  bool hasSubscribers() const { return subscriberCount_ > 0; }
+  size_t getSubscriberCount() const { return subscriberCount_; }
+  uint64_t getDroppedMessageCount() const { return droppedMessageCount_; }
+
+ private:
+  struct Subscriber {
+    Subscriber(Context* _ctx, folly::EventBase* _evb) : ctx(_ctx), evb(_evb), pipeline(_ctx->getPipelineShared()) {}
+
+    Context* ctx;
+    folly::EventBase* evb;
+    // Messages still in flight when the connection goes away are discarded
+    std::weak_ptr<wangle::PipelineBase> pipeline;
+    std::set<std::string> channels;
+    std::set<std::string> patterns;
+    // Messages handed over to the event base whose write to the socket has not completed yet
+    std::atomic<size_t> pendingMessages{0};
+    // Only accessed in the thread of the event base. Cleared once the connection unsubscribes from everything.
+    bool active = true;
+  };
+
+  size_t removeIfIdle(const std::shared_ptr<Subscriber>& subscriber);
+  void removeChannel(const std::shared_ptr<Subscriber>& subscriber, const std::string& channel);
+  void deliver(const std::shared_ptr<Subscriber>& subscriber, std::vector<std::string>&& message);
+
+  mutable folly::SharedMutex mutex_;
+  std::unordered_map<Context*, std::shared_ptr<Subscriber>> subscribers_;
+  std::unordered_map<std::string, std::vector<std::shared_ptr<Subscriber>>> channelSubscribers_;
+  // Subscribers with at least one pattern, each of which is matched against every published channel
+  std::vector<std::shared_ptr<Subscriber>> patternSubscribers_;
+
+  std::unordered_set<uint32_t> ignoredColumnFamilyIds_;
+  std::atomic<size_t> maxPendingMessages_{kDefaultMaxPendingMessages};
+  // Checked before taking the lock, so that writes are cheap when nobody listens
+  std::atomic<size_t> subscriberCount_{0};
+  std::atomic<uint64_t> droppedMessageCount_{0};
+};
+
+}  // namespace pipeline
+
+#endif  // PIPELINE_KEYSPACENOTIFIER_H_
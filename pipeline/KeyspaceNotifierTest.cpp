@@ -0,0 +1,184 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "codec/RedisMessage.h"
+#include "folly/futures/Future.h"
+#include "folly/futures/Promise.h"
+#include "folly/io/async/EventBase.h"
+#include "gtest/gtest.h"
+#include "pipeline/KeyspaceNotifier.h"
+#include "rocksdb/write_batch.h"
+#include "wangle/channel/Handler.h"
+#include "wangle/channel/Pipeline.h"
+
+namespace pipeline {
+
+using TestPipeline = wangle::Pipeline<codec::RedisMessage, codec::RedisMessage>;
+
+// Record the messages written to the connection. Writes complete at once, unless unfinishedWrites is set to collect
+// them instead, like a socket whose buffer is full.
+class RecordingHandler : public wangle::OutboundHandler<codec::RedisMessage> {
+ public:
+  RecordingHandler(std::vector<codec::RedisValue>* written,
+                   std::vector<folly::Promise<folly::Unit>>** unfinishedWrites)
+      : written_(written), unfinishedWrites_(unfinishedWrites) {}
+
+  folly::Future<folly::Unit> write(Context* ctx, codec::RedisMessage msg) override {
+    EXPECT_EQ(-1, msg.key);
+    written_->push_back(std::move(msg.val));
+    if (!*unfinishedWrites_) return folly::makeFuture();
+    (*unfinishedWrites_)->emplace_back();
+    return (*unfinishedWrites_)->back().getFuture();
+  }
+
+ private:
+  std::vector<codec::RedisValue>* written_;
+  std::vector<folly::Promise<folly::Unit>>** unfinishedWrites_;
+};
+
+// Stand-in for the redis handler, whose context subscribes
+class SubscriberHandler : public wangle::HandlerAdapter<codec::RedisMessage> {};
+
+class KeyspaceNotifierTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    pipeline_ = TestPipeline::create();
+    pipeline_->addBack(RecordingHandler(&written_, &unfinishedWrites_));
+    pipeline_->addBack(SubscriberHandler());
+    pipeline_->finalize();
+    ctx_ = pipeline_->getContext<SubscriberHandler>();
+  }
+
+  void TearDown() override {
+    notifier()->unsubscribeAll(ctx_);
+    notifier()->setMaxPendingMessages(KeyspaceNotifier::kDefaultMaxPendingMessages);
+  }
+
+  static KeyspaceNotifier* notifier() { return KeyspaceNotifier::instance(); }
+
+  folly::EventBase evb_;
+  TestPipeline::Ptr pipeline_;
+  KeyspaceNotifier::Context* ctx_ = nullptr;
+  std::vector<codec::RedisValue> written_;
+  std::vector<folly::Promise<folly::Unit>>* unfinishedWrites_ = nullptr;
+};
+
+TEST_F(KeyspaceNotifierTest, Subscribe) {
+  EXPECT_EQ(1, notifier()->subscribe(ctx_, &evb_, "__keyspace@0__:a"));
+  EXPECT_EQ(2, notifier()->subscribe(ctx_, &evb_, "__keyspace@0__:b"));
+  EXPECT_EQ(2, notifier()->subscribe(ctx_, &evb_, "__keyspace@0__:b"));
+  EXPECT_EQ(1, notifier()->getSubscriberCount());
+
+  notifier()->publish(0, "a", "set");
+  notifier()->publish(0, "c", "set");
+  notifier()->publish(0, "b", "del");
+  // messages are written on the event base
+  EXPECT_TRUE(written_.empty());
+  evb_.loop();
+
+  ASSERT_EQ(2, written_.size());
+  EXPECT_EQ(codec::RedisValue(std::vector<std::string>({"message", "__keyspace@0__:a", "set"})), written_[0]);
+  EXPECT_EQ(codec::RedisValue(std::vector<std::string>({"message", "__keyspace@0__:b", "del"})), written_[1]);
+}
+
+TEST_F(KeyspaceNotifierTest, PatternSubscribe) {
+  EXPECT_EQ(1, notifier()->psubscribe(ctx_, &evb_, "__keyspace@0__:user:*"));
+  notifier()->publish(0, "user:1", "set");
+  notifier()->publish(0, "item:1", "set");
+  evb_.loop();
+
+  ASSERT_EQ(1, written_.size());
+  EXPECT_EQ(codec::RedisValue(std::vector<std::string>({"pmessage", "__keyspace@0__:user:*", "__keyspace@0__:user:1",
+                                                         "set"})),
+            written_[0]);
+  EXPECT_EQ(std::vector<std::string>({"__keyspace@0__:user:*"}), notifier()->getPatterns(ctx_));
+}
+
+TEST_F(KeyspaceNotifierTest, Unsubscribe) {
+  notifier()->subscribe(ctx_, &evb_, "__keyspace@0__:a");
+  notifier()->psubscribe(ctx_, &evb_, "*");
+  notifier()->publish(0, "a", "set");
+  EXPECT_EQ(1, notifier()->unsubscribe(ctx_, "__keyspace@0__:a"));
+  EXPECT_EQ(0, notifier()->punsubscribe(ctx_, "*"));
+  EXPECT_FALSE(notifier()->hasSubscribers());
+
+  // messages in flight are discarded as well
+  notifier()->publish(0, "a", "set");
+  evb_.loop();
+  EXPECT_TRUE(written_.empty());
+}
+
+TEST_F(KeyspaceNotifierTest, BoundedPendingMessages) {
+  notifier()->setMaxPendingMessages(2);
+  notifier()->subscribe(ctx_, &evb_, "__keyspace@0__:a");
+  uint64_t droppedMessages = notifier()->getDroppedMessageCount();
+  for (int i = 0; i < 3; i++) {
+    notifier()->publish(0, "a", "set");
+  }
+  evb_.loop();
+  EXPECT_EQ(2, written_.size());
+  EXPECT_EQ(droppedMessages + 1, notifier()->getDroppedMessageCount());
+
+  // the subscriber catches up once pending messages are written
+  notifier()->publish(0, "a", "set");
+  evb_.loop();
+  EXPECT_EQ(3, written_.size());
+}
+
+TEST_F(KeyspaceNotifierTest, BoundedUnwrittenMessages) {
+  std::vector<folly::Promise<folly::Unit>> unfinishedWrites;
+  unfinishedWrites_ = &unfinishedWrites;
+  notifier()->setMaxPendingMessages(2);
+  notifier()->subscribe(ctx_, &evb_, "__keyspace@0__:a");
+  uint64_t droppedMessages = notifier()->getDroppedMessageCount();
+  notifier()->publish(0, "a", "set");
+  notifier()->publish(0, "a", "set");
+  evb_.loop();
+  EXPECT_EQ(2, written_.size());
+
+  // messages handed to a socket which has not written them yet still count towards the limit
+  notifier()->publish(0, "a", "set");
+  evb_.loop();
+  EXPECT_EQ(2, written_.size());
+  EXPECT_EQ(droppedMessages + 1, notifier()->getDroppedMessageCount());
+
+  for (auto& promise : unfinishedWrites) promise.setValue();
+  notifier()->publish(0, "a", "set");
+  evb_.loop();
+  EXPECT_EQ(3, written_.size());
+  unfinishedWrites.back().setValue();
+}
+
+TEST_F(KeyspaceNotifierTest, ColumnFamilies) {
+  notifier()->subscribe(ctx_, &evb_, "__keyspace@0__:a");
+  notifier()->psubscribe(ctx_, &evb_, "__keyspace@2__:*");
+  notifier()->publish(0, "a", "set");
+  // the same key in another column family is another channel
+  notifier()->publish(1, "a", "set");
+  notifier()->publish(2, "a", "del");
+  evb_.loop();
+
+  ASSERT_EQ(2, written_.size());
+  EXPECT_EQ(codec::RedisValue(std::vector<std::string>({"message", "__keyspace@0__:a", "set"})), written_[0]);
+  EXPECT_EQ(codec::RedisValue(std::vector<std::string>({"pmessage", "__keyspace@2__:*", "__keyspace@2__:a", "del"})),
+            written_[1]);
+  EXPECT_EQ("__keyspace@1__:a", KeyspaceNotifier::keyspaceChannel(1, "a"));
+}
+
+TEST_F(KeyspaceNotifierTest, PublishWriteBatch) {
+  notifier()->psubscribe(ctx_, &evb_, "*");
+  rocksdb::WriteBatch writeBatch;
+  writeBatch.Put("a", "1");
+  writeBatch.Delete("b");
+  writeBatch.Merge("c", "2");
+  notifier()->publishWriteBatch(&writeBatch);
+  evb_.loop();
+
+  ASSERT_EQ(3, written_.size());
+  EXPECT_EQ(codec::RedisValue(std::vector<std::string>({"pmessage", "*", "__keyspace@0__:a", "set"})), written_[0]);
+  EXPECT_EQ(codec::RedisValue(std::vector<std::string>({"pmessage", "*", "__keyspace@0__:b", "del"})), written_[1]);
+  EXPECT_EQ(codec::RedisValue(std::vector<std::string>({"pmessage", "*", "__keyspace@0__:c", "merge"})), written_[2]);
+}
+
+}  // namespace pipeline
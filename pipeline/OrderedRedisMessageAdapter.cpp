@@ -1,17 +1,47 @@
 #include "pipeline/OrderedRedisMessageAdapter.h"
 
+#include <string>
+#include <vector>
+
 namespace pipeline {
 
+size_t OrderedRedisMessageAdapter::valueBytes(const codec::RedisValue& value) {
+  size_t bytes = sizeof(codec::RedisValue);
+  switch (value.type()) {
+    case codec::RedisValue::Type::kSimpleString:
+    case codec::RedisValue::Type::kError:
+    case codec::RedisValue::Type::kBulkString:
+      bytes += value.bulkString().capacity();
+      break;
+    case codec::RedisValue::Type::kArray:
+      for (const auto& element : value.array()) {
+        bytes += valueBytes(element);
+      }
+      break;
+    case codec::RedisValue::Type::kBulkStringArray:
+      for (const auto& element : value.bulkStringArray()) {
+        bytes += sizeof(std::string) + element.capacity();
+      }
+      break;
+    default:
+      break;
+  }
+  return bytes;
+}
+
 folly::Future<folly::Unit> OrderedRedisMessageAdapter::write(Context* ctx, codec::RedisMessage msg) {
   if (msg.key == -1) {
     // this is a special message not corresponds to any request
     return ctx->fireWrite(std::move(msg));
   }
+  // The reply of a request still running when the connection closed
+  if (closed_) return folly::makeFuture();
 
   // Make sure key is valid
+  CHECK(pendingOutputs_);
   size_t index = msg.key - startKey_;
-  CHECK(index >= 0 && index < pendingOutputs_.size());
-  auto& pendingOutput = pendingOutputs_[index];
+  CHECK(index >= 0 && index < pendingOutputs_->size());
+  auto& pendingOutput = (*pendingOutputs_)[index];
   CHECK_EQ(pendingOutput.key, msg.key);
 
   // Make sure val is valid and the specified pending output has not been updated before
@@ -20,17 +50,24 @@ folly::Future<folly::Unit> OrderedRedisMessageAdapter::write(Context* ctx, codec
 
   // Assign the value to corresponding entry but only fire the writes in order
   pendingOutput.val = std::move(msg.val);
+  size_t pendingBytes = valueBytes(pendingOutput.val) - sizeof(codec::RedisValue);
+  addBufferedBytes(pendingBytes);
   auto future = folly::makeFuture();
-  for (auto it = pendingOutputs_.begin(); it != pendingOutputs_.end();) {
-    if (it->val.type() == codec::RedisValue::Type::kAsyncResult) {
+  while (!pendingOutputs_->empty()) {
+    auto& output = pendingOutputs_->front();
+    if (output.val.type() == codec::RedisValue::Type::kAsyncResult) {
       // Encountered a pending output that has not been fulfilled yet, stop writing
       return std::move(future);
     }
-    future = ctx->fireWrite(*it);
-    it = pendingOutputs_.erase(it);
+    int64_t bytes = sizeof(codec::RedisMessage) + valueBytes(output.val) - sizeof(codec::RedisValue);
+    future = ctx->fireWrite(std::move(output));
+    pendingOutputs_->pop_front();
+    addBufferedBytes(-bytes);
     startKey_++;
   }
 
+  // All requests have been answered, release the deque until the connection becomes active again
+  pendingOutputs_.reset();
   return future;
 }
 
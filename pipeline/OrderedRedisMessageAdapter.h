@@ -2,9 +2,12 @@
 #define PIPELINE_ORDEREDREDISMESSAGEADAPTER_H_
 
 #include <deque>
+#include <memory>
 #include <utility>
 
 #include "codec/RedisMessage.h"
+#include "codec/RedisValue.h"
+#include "pipeline/RedisHandler.h"
 #include "wangle/channel/Handler.h"
 
 namespace pipeline {
@@ -12,21 +15,44 @@ namespace pipeline {
 // Generate redis message keys based on their receiving order and write the corresponding output in the same order
 class OrderedRedisMessageAdapter : public wangle::HandlerAdapter<codec::RedisMessage> {
  public:
-  OrderedRedisMessageAdapter() : startKey_(0), pendingOutputs_() {}
+  // Bytes held by a buffered reply, counting the strings it owns
+  static size_t valueBytes(const codec::RedisValue& value);
+
+  OrderedRedisMessageAdapter() : startKey_(0), bufferedBytes_(0), closed_(false) {}
 
   void read(Context* ctx, codec::RedisMessage msg) override {
+    if (closed_) return;
+    // An empty deque still holds a node buffer, so it is only allocated while there are requests in flight
+    if (!pendingOutputs_) pendingOutputs_.reset(new std::deque<codec::RedisMessage>());
     // Current key increases monotonically as client requests arrive
-    msg.key = startKey_ + pendingOutputs_.size();
+    msg.key = startKey_ + pendingOutputs_->size();
     // async result represents requests that have not been fulfilled
-    pendingOutputs_.push_back(codec::RedisMessage(msg.key, codec::RedisValue::asyncResult()));
+    pendingOutputs_->push_back(codec::RedisMessage(msg.key, codec::RedisValue::asyncResult()));
+    addBufferedBytes(sizeof(codec::RedisMessage));
     ctx->fireRead(std::move(msg));
   }
 
   folly::Future<folly::Unit> write(Context* ctx, codec::RedisMessage msg) override;
 
+  // Replies still pending are dropped, and those arriving later are ignored
+  folly::Future<folly::Unit> close(Context* ctx) override {
+    closed_ = true;
+    addBufferedBytes(-bufferedBytes_);
+    pendingOutputs_.reset();
+    return ctx->fireClose();
+  }
+
  private:
+  void addBufferedBytes(int64_t bytes) {
+    bufferedBytes_ += bytes;
+    RedisHandler::addBufferedBytes(bytes);
+  }
+
   int64_t startKey_;
-  std::deque<codec::RedisMessage> pendingOutputs_;
+  std::unique_ptr<std::deque<codec::RedisMessage>> pendingOutputs_;
+  // Bytes of pending outputs of this connection, which are also counted towards RedisHandler::getBufferedBytes
+  int64_t bufferedBytes_;
+  bool closed_;
 };
 
 }  // namespace pipeline
@@ -0,0 +1,86 @@
+#include "pipeline/ReadCoalescer.h"
+
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "folly/ExceptionWrapper.h"
+#include "rocksdb/options.h"
+
+namespace pipeline {
+
+ReadCoalescer* ReadCoalescer::instance() {
+  static ReadCoalescer* coalescer = new ReadCoalescer();
+  return coalescer;
+}
+
+ReadCoalescer::Result ReadCoalescer::load(const std::string& identity, const Loader& loader) {
+  Shard& shard = shards_[std::hash<std::string>()(identity) % kShardCount];
+  std::shared_ptr<folly::SharedPromise<Result>> promise;
+  {
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    auto& entry = shard.inFlight[identity];
+    if (entry) {
+      promise = entry;
+    } else {
+      entry = std::make_shared<folly::SharedPromise<Result>>();
+    }
+  }
+
+  if (promise) {
+    // Another reader is already looking it up
+    coalescedCount_++;
+    return promise->getFuture().get();
+  }
+
+  lookupCount_++;
+  Result result;
+  folly::exception_wrapper exception;
+  try {
+    result = loader();
+  } catch (const std::exception& e) {
+    exception = folly::exception_wrapper(std::current_exception(), e);
+  }
+
+  {
+    // Readers arriving from now on start a new lookup, so they observe writes committed after this one started
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    auto it = shard.inFlight.find(identity);
+    promise = std::move(it->second);
+    shard.inFlight.erase(it);
+  }
+
+  if (exception) {
+    promise->setException(exception);
+    exception.throw_exception();
+  }
+  promise->setValue(result);
+  return result;
+}
+
+rocksdb::Status ReadCoalescer::get(rocksdb::DB* db, rocksdb::ColumnFamilyHandle* columnFamily,
+                                   const rocksdb::Slice& key, std::string* value) {
+  if (!enabled_) {
+    return db->Get(rocksdb::ReadOptions(), columnFamily, key, value);
+  }
+
+  // Column family ids are unique within a database, and a process serves one database
+  std::string identity = std::to_string(columnFamily->GetID());
+  identity.push_back(':');
+  identity.append(key.data(), key.size());
+  Result result = load(identity, [db, columnFamily, &key]() {
+    Result lookup;
+    lookup.status = db->Get(rocksdb::ReadOptions(), columnFamily, key, &lookup.value);
+    return lookup;
+  });
+
+  *value = std::move(result.value);
+  return result.status;
+}
+
+constexpr size_t ReadCoalescer::kShardCount;
+
+}  // namespace pipeline
@@ -0,0 +1,69 @@
+#ifndef PIPELINE_READCOALESCER_H_
+#define PIPELINE_READCOALESCER_H_
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "folly/futures/SharedPromise.h"
+#include "rocksdb/db.h"
+#include "rocksdb/slice.h"
+#include "rocksdb/status.h"
+
+namespace pipeline {
+
+// ReadCoalescer lets concurrent identical reads share a single lookup, e.g., when many connections ask for the same
+// hot key at once after a cache expires. The first reader of a key runs the lookup in its own thread while the others
+// wait for and copy its result. Reads are identified by a caller-defined string, which should cover everything the
+// result depends on, e.g., the command, column family, and key.
+//
+// A coalesced reader may get a value that was read before its own request arrived, though never one older than the
+// start of the lookup in flight. Only use it for reads that tolerate such staleness.
+class ReadCoalescer {
+ public:
+  struct Result {
+    rocksdb::Status status;
+    std::string value;
+  };
+
+  using Loader = std::function<Result()>;
+
+  // Process-wide coalescer, which is disabled until enabled at startup
+  static ReadCoalescer* instance();
+
+  void setEnabled(bool enabled) { enabled_ = enabled; }
+  bool enabled() const { return enabled_; }
+
+  // Run the loader unless an identical read is in flight, in which case wait for its result instead
+  Result load(const std::string& identity, const Loader& loader);
+
+  // Point lookup in a column family, coalesced with identical lookups when enabled
+  rocksdb::Status get(rocksdb::DB* db, rocksdb::ColumnFamilyHandle* columnFamily, const rocksdb::Slice& key,
+                      std::string* value);
+
+  // Lookups performed and reads served by waiting for another lookup
+  uint64_t getLookupCount() const { return lookupCount_; }
+  uint64_t getCoalescedCount() const { return coalescedCount_; }
+
+ private:
+  // Spread in-flight reads over shards to keep lock contention low under many distinct keys
+  static constexpr size_t kShardCount = 64;
+
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<folly::SharedPromise<Result>>> inFlight;
+  };
+
+  std::array<Shard, kShardCount> shards_;
+  std::atomic<bool> enabled_{false};
+  std::atomic<uint64_t> lookupCount_{0};
+  std::atomic<uint64_t> coalescedCount_{0};
+};
+
+}  // namespace pipeline
+
+#endif  // PIPELINE_READCOALESCER_H_
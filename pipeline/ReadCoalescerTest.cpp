@@ -0,0 +1,69 @@
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "pipeline/ReadCoalescer.h"
+#include "rocksdb/status.h"
+
+namespace pipeline {
+
+TEST(ReadCoalescerTest, ConcurrentReadsShareLookup) {
+  constexpr int kReaders = 8;
+  ReadCoalescer coalescer;
+  std::atomic<int> lookups(0);
+  auto loader = [&]() {
+    lookups++;
+    // hold the lookup until every other reader waits for it
+    while (coalescer.getCoalescedCount() < kReaders - 1) {
+      std::this_thread::yield();
+    }
+    return ReadCoalescer::Result{rocksdb::Status::OK(), "value"};
+  };
+
+  std::vector<std::thread> readers;
+  std::atomic<int> matches(0);
+  for (int i = 0; i < kReaders; i++) {
+    readers.emplace_back([&]() {
+      ReadCoalescer::Result result = coalescer.load("key", loader);
+      if (result.status.ok() && result.value == "value") matches++;
+    });
+  }
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  EXPECT_EQ(1, lookups);
+  EXPECT_EQ(kReaders, matches);
+  EXPECT_EQ(1, coalescer.getLookupCount());
+  EXPECT_EQ(kReaders - 1, coalescer.getCoalescedCount());
+}
+
+TEST(ReadCoalescerTest, SequentialReadsLookUpAgain) {
+  ReadCoalescer coalescer;
+  int lookups = 0;
+  auto loader = [&]() {
+    lookups++;
+    return ReadCoalescer::Result{rocksdb::Status::NotFound(), ""};
+  };
+
+  EXPECT_TRUE(coalescer.load("key", loader).status.IsNotFound());
+  EXPECT_TRUE(coalescer.load("key", loader).status.IsNotFound());
+  EXPECT_TRUE(coalescer.load("other", loader).status.IsNotFound());
+  EXPECT_EQ(3, lookups);
+  EXPECT_EQ(0, coalescer.getCoalescedCount());
+}
+
+TEST(ReadCoalescerTest, LoaderException) {
+  ReadCoalescer coalescer;
+  EXPECT_THROW(coalescer.load("key", []() -> ReadCoalescer::Result { throw std::runtime_error("boom"); }),
+               std::runtime_error);
+  // the failed lookup is not left in flight
+  EXPECT_EQ("value", coalescer.load("key", []() {
+    return ReadCoalescer::Result{rocksdb::Status::OK(), "value"};
+  }).value);
+}
+
+}  // namespace pipeline
@@ -3,6 +3,8 @@
 #include <algorithm>
 #include <chrono>
 #include <cstring>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <sstream>
@@ -14,7 +16,12 @@
 #include "folly/Format.h"
 #include "folly/String.h"
 #include "glog/logging.h"
+#include "infra/kafka/ConsumerGovernor.h"
+#include "pipeline/BlockCacheWarmer.h"
 #include "pipeline/BuildVersion.h"
+#include "pipeline/HotKeyTracker.h"
+#include "pipeline/KeyspaceNotifier.h"
+#include "pipeline/ReadCoalescer.h"
 #include "rocksdb/cache.h"
 #include "rocksdb/db.h"
 #include "rocksdb/statistics.h"
@@ -42,16 +49,69 @@ void RedisHandler::read(Context* ctx, codec::RedisMessage req) {
   }
 
   std::string cmdNameLower = boost::to_lower_copy(cmd.front());
-  if (handleCommand(req.key, cmdNameLower, cmd, ctx)) {
+  // the first argument is the key of most commands
+  if (cmd.size() >= 2 && HotKeyTracker::instance()->sampleNext() && !isControlCommand(cmdNameLower)) {
+    HotKeyTracker::instance()->add(cmd[1]);
+  }
+  // sampled latency tells replaying kafka consumers how much I/O they may take from clients
+  infra::kafka::ConsumerGovernor* governor = infra::kafka::ConsumerGovernor::instance();
+  bool timed = governor->sampleNext() && !isControlCommand(cmdNameLower);
+  auto dispatchStart = timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+  if (TRACE_CALL("RedisHandler#dispatch", handleCommand(req.key, cmdNameLower, cmd, ctx))) {
+    // a deferred command is broadcast once it actually runs
+    if (DeferralScope::current_ && DeferralScope::current_->deferred) return;
     broadcastCmd(cmd, ctx);
   } else {
     writeError(req.key, folly::sformat("Unknown command: '{}'", cmdNameLower), ctx);
   }
+  if (timed) {
+    governor->observeLatency(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - dispatchStart).count());
+  }
+}
+
+codec::RedisValue RedisHandler::hotKeysCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  HotKeyTracker* tracker = HotKeyTracker::instance();
+  std::string subcommand = cmd.size() >= 2 ? boost::to_lower_copy(cmd[1]) : "";
+  if (subcommand == "reset") {
+    if (cmd.size() != 2) return errorSyntaxError();
+    tracker->reset();
+    return simpleStringOk();
+  }
+  if (subcommand == "sample") {
+    if (cmd.size() == 2) return codec::RedisValue(static_cast<int64_t>(tracker->getSampleEvery()));
+    int64_t sampleEvery;
+    if (!parseInt(cmd[2], &sampleEvery) || sampleEvery < 0 || sampleEvery > std::numeric_limits<uint32_t>::max()) {
+      return errorInvalidInteger();
+    }
+    tracker->setSampleEvery(static_cast<uint32_t>(sampleEvery));
+    return simpleStringOk();
+  }
+
+  int64_t count = kDefaultHotKeyCount;
+  if (cmd.size() > 2 || (cmd.size() == 2 && (!parseInt(cmd[1], &count) || count <= 0))) {
+    return errorSyntaxError();
+  }
+  if (tracker->getSampleEvery() == 0) {
+    return errorResp("Hot key sampling is disabled. Enable it with HOTKEYS SAMPLE <n>.");
+  }
+
+  // Reply with [key, estimated count, max overestimation] for each key
+  std::vector<codec::RedisValue> result;
+  for (auto& entry : tracker->top(count)) {
+    std::vector<codec::RedisValue> hotKey;
+    hotKey.emplace_back(codec::RedisValue::Type::kBulkString, std::move(entry.key));
+    hotKey.emplace_back(static_cast<int64_t>(entry.count));
+    hotKey.emplace_back(static_cast<int64_t>(entry.error));
+    result.emplace_back(std::move(hotKey));
+  }
+  return codec::RedisValue(std::move(result));
 }
 
 codec::RedisValue RedisHandler::infoCommand(const std::vector<std::string>& cmd, Context* ctx) {
   std::stringstream ss;
   if (cmd.size() >= 2 && cmd[1] == "dbstats") {
+    if (!databaseManager_) return errorNoDatabase();
     for (const auto& entry : databaseManager_->columnFamilyMap()) {
       std::string dbStats;
       db()->GetProperty(entry.second, "rocksdb.stats", &dbStats);
@@ -72,8 +132,43 @@ void RedisHandler::appendToInfoOutput(std::stringstream* ss) {
 
   (*ss) << "# Clients" << std::endl;
   (*ss) << "connected_clients:" << getConnectionCount() << std::endl;
+  size_t footprintBytes = getConnectionFootprintBytes();
+  int64_t bufferedBytes = getBufferedBytes();
+  size_t clientsMemory = footprintBytes * getConnectionCount() + static_cast<size_t>(bufferedBytes);
+  (*ss) << "client_footprint_bytes:" << footprintBytes << std::endl;
+  (*ss) << "client_buffered_bytes:" << bufferedBytes << std::endl;
+  (*ss) << "connected_clients_memory:" << clientsMemory << std::endl;
+  (*ss) << "connected_clients_memory_human:" << (clientsMemory >> 20) << 'M' << std::endl;
+  (*ss) << "pubsub_clients:" << KeyspaceNotifier::instance()->getSubscriberCount() << std::endl;
+  (*ss) << "pubsub_dropped_messages:" << KeyspaceNotifier::instance()->getDroppedMessageCount() << std::endl;
   (*ss) << std::endl;
 
+  if (ReadCoalescer::instance()->enabled()) {
+    (*ss) << "# ReadCoalescer" << std::endl;
+    (*ss) << "read_coalescer_lookups:" << ReadCoalescer::instance()->getLookupCount() << std::endl;
+    (*ss) << "read_coalescer_coalesced_reads:" << ReadCoalescer::instance()->getCoalescedCount() << std::endl;
+    (*ss) << std::endl;
+  }
+
+  if (BlockCacheWarmer::instance()->getPlannedBytes() > 0) {
+    (*ss) << "# BlockCacheWarmer" << std::endl;
+    (*ss) << "block_cache_warmup_done:" << (BlockCacheWarmer::instance()->isWarm() ? 1 : 0) << std::endl;
+    (*ss) << "block_cache_warmup_warmed_bytes:" << BlockCacheWarmer::instance()->getWarmedBytes() << std::endl;
+    (*ss) << "block_cache_warmup_planned_bytes:" << BlockCacheWarmer::instance()->getPlannedBytes() << std::endl;
+    (*ss) << std::endl;
+  }
+
+  if (databaseManager_) {
+    appendRocksDbInfoOutput(ss);
+  }
+
+  if (consumerHelper_) {
+    (*ss) << std::endl << "# Kafka" << std::endl;
+    consumerHelper_->appendStatsInRedisInfoFormat(ss);
+  }
+}
+
+void RedisHandler::appendRocksDbInfoOutput(std::stringstream* ss) {
   (*ss) << "# RocksDB" << std::endl;
 
   uint64_t value;
@@ -134,11 +229,6 @@ void RedisHandler::appendToInfoOutput(std::stringstream* ss) {
   // compaction time histogram
   statistics->histogramData(rocksdb::Histograms::COMPACTION_TIME, &histData);
   outputStatistics("compaction", histData, ss);
-
-  if (consumerHelper_) {
-    (*ss) << std::endl << "# Kafka" << std::endl;
-    consumerHelper_->appendStatsInRedisInfoFormat(ss);
-  }
 }
 
 void RedisHandler::outputStatistics(const std::string& name, const rocksdb::HistogramData& histData,
@@ -168,6 +258,7 @@ codec::RedisValue RedisHandler::monitorCommand(const std::vector<std::string>& c
 }
 
 codec::RedisValue RedisHandler::freezeCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  if (!databaseManager_) return errorNoDatabase();
   std::vector<std::string> fileList;
   if (!databaseManager()->freeze(&fileList)) {
     return internalServerError();
@@ -177,6 +268,7 @@ codec::RedisValue RedisHandler::freezeCommand(const std::vector<std::string>& cm
 }
 
 codec::RedisValue RedisHandler::thawCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  if (!databaseManager_) return errorNoDatabase();
   if (!databaseManager()->thaw()) {
     return internalServerError();
   }
@@ -185,6 +277,7 @@ codec::RedisValue RedisHandler::thawCommand(const std::vector<std::string>& cmd,
 }
 
 codec::RedisValue RedisHandler::compactCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  if (!databaseManager_) return errorNoDatabase();
   int args = cmd.size();
   std::string columnFamilyName = args > 1 ? cmd[1] : rocksdb::kDefaultColumnFamilyName;
   if (args == 3) {
@@ -219,7 +312,76 @@ codec::RedisValue RedisHandler::pingCommand(const std::vector<std::string>& cmd,
   return { codec::RedisValue::Type::kSimpleString, "PONG" };
 }
 
+codec::RedisValue RedisHandler::subscribeCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  folly::EventBase* evb = ctx->getTransport()->getEventBase();
+  return writeSubscriptionReplies("subscribe", std::vector<std::string>(cmd.begin() + 1, cmd.end()),
+                                  [ctx, evb](const std::string& channel) {
+                                    return KeyspaceNotifier::instance()->subscribe(ctx, evb, channel);
+                                  },
+                                  ctx);
+}
+
+codec::RedisValue RedisHandler::psubscribeCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  folly::EventBase* evb = ctx->getTransport()->getEventBase();
+  return writeSubscriptionReplies("psubscribe", std::vector<std::string>(cmd.begin() + 1, cmd.end()),
+                                  [ctx, evb](const std::string& pattern) {
+                                    return KeyspaceNotifier::instance()->psubscribe(ctx, evb, pattern);
+                                  },
+                                  ctx);
+}
+
+codec::RedisValue RedisHandler::unsubscribeCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  // unsubscribe from all channels when none is given
+  std::vector<std::string> channels = cmd.size() > 1 ? std::vector<std::string>(cmd.begin() + 1, cmd.end())
+                                                     : KeyspaceNotifier::instance()->getChannels(ctx);
+  return writeSubscriptionReplies("unsubscribe", channels,
+                                  [ctx](const std::string& channel) {
+                                    return KeyspaceNotifier::instance()->unsubscribe(ctx, channel);
+                                  },
+                                  ctx);
+}
+
+codec::RedisValue RedisHandler::punsubscribeCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  // unsubscribe from all patterns when none is given
+  std::vector<std::string> patterns = cmd.size() > 1 ? std::vector<std::string>(cmd.begin() + 1, cmd.end())
+                                                     : KeyspaceNotifier::instance()->getPatterns(ctx);
+  return writeSubscriptionReplies("punsubscribe", patterns,
+                                  [ctx](const std::string& pattern) {
+                                    return KeyspaceNotifier::instance()->punsubscribe(ctx, pattern);
+                                  },
+                                  ctx);
+}
+
+codec::RedisValue RedisHandler::writeSubscriptionReplies(const std::string& kind, const std::vector<std::string>& names,
+                                                         const std::function<size_t(const std::string&)>& update,
+                                                         Context* ctx) {
+  if (names.empty()) {
+    // nothing to unsubscribe from
+    std::vector<codec::RedisValue> values;
+    values.emplace_back(codec::RedisValue::Type::kBulkString, std::string(kind));
+    values.emplace_back(codec::RedisValue::nullString());
+    values.emplace_back(static_cast<codec::RedisValue::IntType>(0));
+    return codec::RedisValue(std::move(values));
+  }
+
+  codec::RedisValue reply;
+  for (size_t i = 0; i < names.size(); i++) {
+    if (i > 0) {
+      write(ctx, codec::RedisMessage(-1, std::move(reply)));
+    }
+    size_t count = update(names[i]);
+    std::vector<codec::RedisValue> values;
+    values.emplace_back(codec::RedisValue::Type::kBulkString, std::string(kind));
+    values.emplace_back(codec::RedisValue::Type::kBulkString, std::string(names[i]));
+    values.emplace_back(static_cast<codec::RedisValue::IntType>(count));
+    reply = codec::RedisValue(std::move(values));
+  }
+  return reply;
+}
+
 codec::RedisValue RedisHandler::readyCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  // Not ready until the block cache is warm, since reads would be slow
+  if (!BlockCacheWarmer::instance()->isWarm()) return codec::RedisValue(0);
   if (consumerHelper_) {
     // Not ready if lagging
     return codec::RedisValue(consumerHelper_->isLagging() ? 0 : 1);
@@ -241,6 +403,7 @@ codec::RedisValue RedisHandler::selectCommand(const std::vector<std::string>& cm
 }
 
 codec::RedisValue RedisHandler::getMetaCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  if (!databaseManager_) return errorNoDatabase();
   std::string value;
   rocksdb::Status status =
       db()->Get(rocksdb::ReadOptions(), databaseManager()->getMetadataColumnFamily(), cmd[1], &value);
@@ -257,6 +420,7 @@ codec::RedisValue RedisHandler::getMetaCommand(const std::vector<std::string>& c
 }
 
 codec::RedisValue RedisHandler::setMetaCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  if (!databaseManager_) return errorNoDatabase();
   rocksdb::Status status =
       db()->Put(rocksdb::WriteOptions(), databaseManager()->getMetadataColumnFamily(), cmd[1], cmd[2]);
 
@@ -275,6 +439,24 @@ codec::RedisValue RedisHandler::sleepCommand(const std::vector<std::string>& cmd
   return simpleStringOk();
 }
 
+codec::RedisValue RedisHandler::traceCommand(const std::vector<std::string>& cmd, Context* ctx) {
+  if (cmd.size() == 1) {
+    return codec::RedisValue(static_cast<int64_t>(infra::Tracing::getSampleEvery()));
+  }
+
+  int64_t sampleEvery;
+  if (!parseInt(cmd[1], &sampleEvery) || sampleEvery < 0 || sampleEvery > std::numeric_limits<uint32_t>::max()) {
+    return errorInvalidInteger();
+  }
+#if defined(WTF_ENABLE)
+  infra::Tracing::setSampleEvery(static_cast<uint32_t>(sampleEvery));
+  LOG(INFO) << "Tracing one out of every " << sampleEvery << " requests";
+  return simpleStringOk();
+#else
+  return errorResp("Tracing is not compiled in. Build with --define tracing=wtf.");
+#endif  // WTF_ENABLE
+}
+
 codec::RedisValue RedisHandler::waitForCommitCommand(const std::vector<std::string>& cmd, Context* ctx) {
   if (!consumerHelper_) {
     return errorResp("WaitForCommit is not configured. Requires ConsumerHelper.");
@@ -353,9 +535,13 @@ bool RedisHandler::validateArgCount(const std::vector<std::string>& cmd, int min
 }
 
 constexpr char RedisHandler::kWrongNumArgsTemplate[];
+constexpr int64_t RedisHandler::kDefaultHotKeyCount;
 
 std::atomic<size_t> RedisHandler::connectionCount_;
+std::atomic<size_t> RedisHandler::connectionFootprintBytes_;
+std::atomic<int64_t> RedisHandler::bufferedBytes_;
 std::vector<RedisHandler::Context*> RedisHandler::monitors_;
 std::mutex RedisHandler::monitorMutex_;
+thread_local RedisHandler::DeferralScope* RedisHandler::DeferralScope::current_ = nullptr;
 
 }  // namespace pipeline
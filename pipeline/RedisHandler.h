@@ -3,6 +3,7 @@
 
 #include <atomic>
 #include <chrono>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <sstream>
@@ -15,7 +16,10 @@
 #include "folly/Conv.h"
 #include "folly/SocketAddress.h"
 #include "glog/logging.h"
+#include "infra/Tracing.h"
 #include "infra/kafka/ConsumerHelper.h"
+#include "pipeline/KeyspaceNotifier.h"
+#include "pipeline/ReadCoalescer.h"
 #include "rocksdb/db.h"
 #include "rocksdb/statistics.h"
 #include "pipeline/DatabaseManager.h"
@@ -42,6 +46,9 @@ class RedisHandler : public wangle::HandlerAdapter<codec::RedisMessage> {
   static codec::RedisValue simpleStringOk() {
     return { codec::RedisValue::Type::kSimpleString, "OK" };
   }
+  static codec::RedisValue errorNoDatabase() {
+    return { codec::RedisValue::Type::kError, "Command requires RocksDB, which is not enabled" };
+  }
 
   static bool parseInt(const std::string& value, int64_t* intValue) {
     try {
@@ -60,8 +67,31 @@ class RedisHandler : public wangle::HandlerAdapter<codec::RedisMessage> {
   static void connectionOpened() { connectionCount_++; }
   static void connectionClosed() { connectionCount_--; }
   static size_t getConnectionCount() { return connectionCount_; }
+  // Estimated memory held by an idle connection, which is set by the pipeline factory
+  static void setConnectionFootprintBytes(size_t bytes) { connectionFootprintBytes_ = bytes; }
+  static size_t getConnectionFootprintBytes() { return connectionFootprintBytes_; }
+  // Bytes of replies buffered by connections, kept up to date as requests arrive and their replies are written
+  static void addBufferedBytes(int64_t bytes) { bufferedBytes_ += bytes; }
+  static int64_t getBufferedBytes() { return bufferedBytes_; }
+
+  // A scheduler runs commands within a DeferralScope, which lets a command that would otherwise block the I/O thread,
+  // e.g., on keys held by a script in another thread, hand itself back to run again in a later turn
+  class DeferralScope {
+   public:
+    DeferralScope() : previous_(current_) { current_ = this; }
+    ~DeferralScope() { current_ = previous_; }
+
+    // Set if the command asked to run again, in which case it has not replied
+    std::unique_ptr<codec::RedisMessage> deferred;
+
+   private:
+    friend class RedisHandler;
+
+    static thread_local DeferralScope* current_;
+    DeferralScope* previous_;
+  };
 
-  // DatabaseManager is required while ConsumerHelper is optional
+  // DatabaseManager is required unless the pipeline runs without RocksDB, while ConsumerHelper is optional
   RedisHandler(std::shared_ptr<DatabaseManager> databaseManager,
                std::shared_ptr<infra::kafka::ConsumerHelper> consumerHelper)
       : databaseManager_(databaseManager), consumerHelper_(consumerHelper) {}
@@ -81,6 +111,7 @@ class RedisHandler : public wangle::HandlerAdapter<codec::RedisMessage> {
     // use -1 as a special key to indicate that go away message is not specific to any request
     write(ctx, codec::RedisMessage(-1, codec::RedisValue::goAway()));
     removeMonitor(ctx);
+    KeyspaceNotifier::instance()->unsubscribeAll(ctx);
     connectionClosed();
     return ctx->fireClose();
   }
@@ -96,7 +127,8 @@ class RedisHandler : public wangle::HandlerAdapter<codec::RedisMessage> {
     if (handlerEntry == getCommandHandlerTable().end()) return false;
 
     if (verifyCommandHandler(key, cmdNameLower, cmd, handlerEntry->second, ctx)) {
-      processCommandHandlerResult(key, (this->*(handlerEntry->second.handlerFunc))(cmd, ctx), ctx);
+      processCommandHandlerResult(
+          key, TRACE_CALL("RedisHandler#execute", (this->*(handlerEntry->second.handlerFunc))(cmd, ctx)), ctx);
     }
 
     // Verification may have failed, but it is a known command regardless. Return true to ask caller to stop searching.
@@ -110,6 +142,18 @@ class RedisHandler : public wangle::HandlerAdapter<codec::RedisMessage> {
     return false;
   }
 
+  // Whether the command is flagged as control in the command handler table. Handlers overriding handleCommand with
+  // their own tables should override it accordingly.
+  virtual bool isControlCommand(const std::string& cmdNameLower) const {
+    return isControlCommandInTable(getCommandHandlerTable(), cmdNameLower);
+  }
+
+  // Bytes held by this handler instance, which counts towards per-connection memory when handlers are not shared.
+  // Subclasses keeping per-connection state should override it.
+  virtual size_t handlerBytes() const {
+    return sizeof(RedisHandler);
+  }
+
  protected:
   using CommandHandlerFunc = codec::RedisValue (RedisHandler::*)(const std::vector<std::string>& cmd, Context* ctx);
   template <typename FuncType>
@@ -117,8 +161,10 @@ class RedisHandler : public wangle::HandlerAdapter<codec::RedisMessage> {
     FuncType handlerFunc = nullptr;
     int minArgs = 0;
     int maxArgs = 0;
-    CommandHandler(FuncType _handlerFunc, int _minArgs, int _maxArgs)
-        : handlerFunc(_handlerFunc), minArgs(_minArgs), maxArgs(_maxArgs) {}
+    // Control commands, e.g., health checks, are cheap and skip ahead of other connections' queued commands
+    bool control = false;
+    CommandHandler(FuncType _handlerFunc, int _minArgs, int _maxArgs, bool _control = false)
+        : handlerFunc(_handlerFunc), minArgs(_minArgs), maxArgs(_maxArgs), control(_control) {}
   };
   template <typename CommandHandlerFuncType>
   using GenericCommandHandlerTable = std::unordered_map<std::string, CommandHandler<CommandHandlerFuncType>>;
@@ -126,29 +172,43 @@ class RedisHandler : public wangle::HandlerAdapter<codec::RedisMessage> {
   using CommandHandlerTable = GenericCommandHandlerTable<CommandHandlerFunc>;
 
   static constexpr char kWrongNumArgsTemplate[] = "Wrong number of arguments for '{}' command";
+  static constexpr int64_t kDefaultHotKeyCount = 10;
 
   // Merge client provided command handler table with the default one
   static CommandHandlerTable mergeWithDefaultCommandHandlerTable(const CommandHandlerTable& newTable) {
     CommandHandlerTable baseTable({
       // default command handlers
       { "compact", { &RedisHandler::compactCommand, 0, 3 } },
-      { "freeze", { &RedisHandler::freezeCommand, 0, 0 } },
+      { "freeze", { &RedisHandler::freezeCommand, 0, 0, true } },
       { "getmeta", { &RedisHandler::getMetaCommand, 1, 1 } },
-      { "info", { &RedisHandler::infoCommand, 0, 1 } },
+      { "hotkeys", { &RedisHandler::hotKeysCommand, 0, 2, true } },
+      { "info", { &RedisHandler::infoCommand, 0, 1, true } },
       { "monitor", { &RedisHandler::monitorCommand, 0, 0 } },
-      { "ping", { &RedisHandler::pingCommand, 0, 0 } },
-      { "ready", { &RedisHandler::readyCommand, 0, 0 } },
-      { "setready", { &RedisHandler::setReadyCommand, 0, 0 } },
+      { "ping", { &RedisHandler::pingCommand, 0, 0, true } },
+      { "psubscribe", { &RedisHandler::psubscribeCommand, 1, -1 } },
+      { "punsubscribe", { &RedisHandler::punsubscribeCommand, 0, -1 } },
+      { "ready", { &RedisHandler::readyCommand, 0, 0, true } },
+      { "setready", { &RedisHandler::setReadyCommand, 0, 0, true } },
       { "select", { &RedisHandler::selectCommand, 1, 1 } },
       { "setmeta", { &RedisHandler::setMetaCommand, 2, 2 } },
       { "sleep", { &RedisHandler::sleepCommand, 1, 1 } },
-      { "thaw", { &RedisHandler::thawCommand, 0, 0 } },
+      { "subscribe", { &RedisHandler::subscribeCommand, 1, -1 } },
+      { "thaw", { &RedisHandler::thawCommand, 0, 0, true } },
+      { "trace", { &RedisHandler::traceCommand, 0, 1, true } },
+      { "unsubscribe", { &RedisHandler::unsubscribeCommand, 0, -1 } },
       { "waitforcommit", { &RedisHandler::waitForCommitCommand, 4, 4 } },
     });
     baseTable.insert(newTable.begin(), newTable.end());
     return baseTable;
   }
 
+  template <typename CommandHandlerFuncType>
+  static bool isControlCommandInTable(const GenericCommandHandlerTable<CommandHandlerFuncType>& table,
+                                      const std::string& cmdNameLower) {
+    auto handlerEntry = table.find(cmdNameLower);
+    return handlerEntry != table.end() && handlerEntry->second.control;
+  }
+
   static std::string getPeerAddressPortStr(Context* ctx) {
     try {
       folly::SocketAddress peerAddress;
@@ -187,6 +247,22 @@ class RedisHandler : public wangle::HandlerAdapter<codec::RedisMessage> {
   rocksdb::DB* db() const { return databaseManager_->db(); }
   std::shared_ptr<DatabaseManager> databaseManager() const { return databaseManager_; }
 
+  // Point lookup sharing the database read with concurrent identical lookups when read coalescing is enabled.
+  // See ReadCoalescer for the staleness it allows.
+  rocksdb::Status coalescedGet(rocksdb::ColumnFamilyHandle* columnFamily, const rocksdb::Slice& key,
+                               std::string* value) {
+    return TRACE_CALL("RocksDB#get", ReadCoalescer::instance()->get(db(), columnFamily, key, value));
+  }
+
+  // Ask the scheduler to run the command again later instead of waiting in the I/O thread. Return false if the
+  // command does not run within a DeferralScope, in which case it has to complete now.
+  static bool deferCommand(int64_t key, const std::vector<std::string>& cmd) {
+    DeferralScope* scope = DeferralScope::current_;
+    if (!scope) return false;
+    scope->deferred.reset(new codec::RedisMessage(key, codec::RedisValue(std::vector<std::string>(cmd))));
+    return true;
+  }
+
   codec::RedisValue errorResp(std::string&& msg) {
     LOG(ERROR) << "Error sent to client: " << msg;
     return codec::RedisValue(codec::RedisValue::Type::kError, std::move(msg));
@@ -208,22 +284,38 @@ class RedisHandler : public wangle::HandlerAdapter<codec::RedisMessage> {
   static std::vector<Context*> monitors_;
   static std::mutex monitorMutex_;
   static std::atomic<size_t> connectionCount_;
+  static std::atomic<size_t> connectionFootprintBytes_;
+  static std::atomic<int64_t> bufferedBytes_;
 
   codec::RedisValue compactCommand(const std::vector<std::string>& cmd, Context* ctx);
   codec::RedisValue freezeCommand(const std::vector<std::string>& cmd, Context* ctx);
   codec::RedisValue getMetaCommand(const std::vector<std::string>& cmd, Context* ctx);
+  // HOTKEYS [count] | HOTKEYS RESET | HOTKEYS SAMPLE [sampleEvery]
+  codec::RedisValue hotKeysCommand(const std::vector<std::string>& cmd, Context* ctx);
   codec::RedisValue infoCommand(const std::vector<std::string>& cmd, Context* ctx);
   codec::RedisValue monitorCommand(const std::vector<std::string>& cmd, Context* ctx);
   codec::RedisValue pingCommand(const std::vector<std::string>& cmd, Context* ctx);
+  codec::RedisValue psubscribeCommand(const std::vector<std::string>& cmd, Context* ctx);
+  codec::RedisValue punsubscribeCommand(const std::vector<std::string>& cmd, Context* ctx);
   codec::RedisValue readyCommand(const std::vector<std::string>& cmd, Context* ctx);
   codec::RedisValue setReadyCommand(const std::vector<std::string>& cmd, Context* ctx);
   codec::RedisValue selectCommand(const std::vector<std::string>& cmd, Context* ctx);
   codec::RedisValue setMetaCommand(const std::vector<std::string>& cmd, Context* ctx);
   codec::RedisValue sleepCommand(const std::vector<std::string>& cmd, Context* ctx);
+  codec::RedisValue subscribeCommand(const std::vector<std::string>& cmd, Context* ctx);
   codec::RedisValue thawCommand(const std::vector<std::string>& cmd, Context* ctx);
+  // TRACE [sampleEvery]: get or set how often requests and batches are traced, where 0 disables tracing
+  codec::RedisValue traceCommand(const std::vector<std::string>& cmd, Context* ctx);
+  codec::RedisValue unsubscribeCommand(const std::vector<std::string>& cmd, Context* ctx);
   codec::RedisValue waitForCommitCommand(const std::vector<std::string>& cmd, Context* ctx);
 
   void broadcastCmd(const std::vector<std::string>& cmd, Context* ctx);
+  // Reply to each of the channels or patterns in turn as redis does, e.g., ["subscribe", channel, count].
+  // All but the last reply are written right away with key -1, which only keeps them in order with the last one if
+  // no async command of the connection is still pending.
+  codec::RedisValue writeSubscriptionReplies(const std::string& kind, const std::vector<std::string>& names,
+                                             const std::function<size_t(const std::string&)>& update, Context* ctx);
+  void appendRocksDbInfoOutput(std::stringstream* ss);
   void outputStatistics(const std::string& name, const rocksdb::HistogramData& histData, std::stringstream* ss);
   void removeMonitor(Context* ctx);
   void writeToMonitorContext(const std::vector<std::string>& cmd, const std::string& monitorAddr, Context* ctx);
@@ -10,6 +10,11 @@ namespace pipeline {
 class RedisHandlerBuilder {
  public:
   virtual std::shared_ptr<RedisHandler> newHandler() = 0;
+
+  // Whether all connections share the same handler instance, in which case it is not part of per-connection memory
+  virtual bool sharesHandler() const {
+    return false;
+  }
 };
 
 }  // namespace pipeline
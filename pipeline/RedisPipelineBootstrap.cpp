@@ -1,8 +1,11 @@
 #include "pipeline/RedisPipelineBootstrap.h"
 
+#include <dirent.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <csignal>
 #include <memory>
@@ -12,17 +15,28 @@
 
 #include "folly/Conv.h"
 #include "folly/Format.h"
+#include "folly/SocketAddress.h"
+#include "folly/io/async/AsyncServerSocket.h"
 #include "folly/init/Init.h"
 #include "folly/json.h"
 #include "gflags/gflags.h"
 #include "glog/logging.h"
 #include "hiredis/net.h"
 #include "hiredis/hiredis.h"
+#include "infra/Tracing.h"
+#include "infra/kafka/Consumer.h"
+#include "infra/kafka/ConsumerGovernor.h"
 #include "infra/kafka/ConsumerHelper.h"
+#include "infra/kafka/ConsumerMetrics.h"
+#include "infra/kafka/MessageFilter.h"
 #include "infra/kafka/Producer.h"
 #include "infra/ScheduledTaskQueue.h"
 #include "librdkafka/rdkafkacpp.h"
+#include "pipeline/BlockCacheWarmer.h"
+#include "pipeline/HotKeyTracker.h"
 #include "pipeline/KafkaConsumerConfig.h"
+#include "pipeline/KeyspaceNotifier.h"
+#include "pipeline/ReadCoalescer.h"
 #include "rocksdb/db.h"
 #include "rocksdb/options.h"
 #include "rocksdb/statistics.h"
@@ -48,6 +62,21 @@ DEFINE_bool(master_replica, false, "Is this service replica the master replica")
 // socket settings
 DEFINE_int32(connection_idle_timeout_ms, 600000, "Connection idle timeout. 10 minutes by default.");
 
+// fair scheduling settings
+// Bound the commands each I/O thread runs per event loop iteration, round-robin across connections, so that heavily
+// pipelining clients cannot starve others. Control commands like PING and INFO skip ahead. 0 disables scheduling.
+DEFINE_int32(scheduler_commands_per_turn, 0, "Commands run per event loop iteration in each I/O thread");
+DEFINE_int32(scheduler_commands_per_connection, 16, "Commands a connection runs before yielding to the next one");
+DEFINE_int32(scheduler_max_queued_commands, 1024, "Queued commands at which reading from a connection pauses");
+
+// keyspace notification settings
+// Subscribers falling further behind lose notifications instead of buffering them without bound
+DEFINE_int32(keyspace_notification_max_pending, 1024, "Notifications in flight per subscriber before dropping them");
+
+// read coalescing settings
+// Let concurrent identical point lookups through RedisHandler::coalescedGet share one database read
+DEFINE_bool(read_coalescing, false, "Share database reads among concurrent identical lookups");
+
 
 
 // rocksdb settings
@@ -58,10 +87,20 @@ DEFINE_string(rocksdb_db_paths, "", "RocksDB data paths (sizes in MB)");
 
 DEFINE_int32(rocksdb_parallelism, std::thread::hardware_concurrency(), "Parallelism for flush and compaction");
 DEFINE_int32(rocksdb_block_cache_size_mb, 512, "RocksDB block cache size in MB");
+// Startup replays the WAL written since the last flush. Capping its size forces flushes of the column families holding
+// the oldest WAL, which bounds replay time after a crash. Graceful shutdown flushes every column family, so that the
+// next startup has nothing to replay.
+DEFINE_int32(rocksdb_max_total_wal_size_mb, 1024, "WAL size that triggers flushes, bounding replay on startup");
+DEFINE_bool(rocksdb_flush_on_shutdown, true, "Flush all column families in parallel on graceful shutdown");
 DEFINE_bool(rocksdb_create_if_missing_one_off, false, "Create database when missing");
 // Convenience parameter to bootstrap the database without checking version_timestamp_ms
 // NOTE: prefer the `_one_off` version in production
 DEFINE_bool(rocksdb_create_if_missing, false, "Create database when missing without checking version_timestamp_ms");
+// Block cache warm-up: graceful shutdown saves the key ranges of the newest SST files, up to the block cache capacity,
+// to this file, and startup scans them in the background. READY returns 0 until warm-up completes or times out.
+DEFINE_string(block_cache_warmup_file, "", "File to save and load block cache warm-up ranges. Empty disables");
+DEFINE_int64(block_cache_warmup_bytes_per_sec, 64 * 1024 * 1024, "Rate limit for block cache warm-up. 0 is unlimited");
+DEFINE_int64(block_cache_warmup_timeout_ms, 600000, "Give up block cache warm-up after this long");
 // Create column families in groups for virtual sharding, e.g.,
 // {
 //    "node-to-smyte": {
@@ -85,13 +124,33 @@ DEFINE_string(kafka_broker_list, "localhost:9092", "Kafka broker list");
 //     "offset_key_suffix": "day",
 //     "consume_from_beginning_one_off": true,
 //     "initial_offset_one_off": 1234,
+//     "initial_timestamp_ms_one_off": 1500000000000,
 //     "object_store_bucket_name": "kafka",
 //     "object_store_object_name_prefix": "raw/",
-//     "low_latency": true
+//     "low_latency": true,
+//     "replay_lag_threshold": 100000,
+//     "replay_max_messages_per_sec": 5000,
+//     "replay_max_write_bytes_per_sec": 10000000,
+//     "filter_key_prefixes": ["user:", "ip:"],
+//     "filter_payload_prefix_hex": "00"
 //   }
 // ]
 // Note that topic, partition, and group_id are required. The rest are optional. By default, low_latency is disabled.
+// A consumer lagging behind by more than replay_lag_threshold messages is replaying, in which case it is held to the
+// replay limits and its writes are low priority. Limits of 0 are unlimited, and a threshold of 0 disables throttling.
+// Regular consumers only process messages with a key starting with any of filter_key_prefixes, if specified, and a
+// payload starting with the bytes of filter_payload_prefix_hex. The others are skipped before being decoded.
+// At most one of consume_from_beginning_one_off, initial_offset_one_off, and initial_timestamp_ms_one_off applies. The
+// timestamp is resolved to the offset of the first message at or after it, using the brokers' time index for regular
+// consumers, or the creation times of kafka store files.
 DEFINE_string(kafka_consumer_configs, "", "Kafka consumer configurations in JSON format");
+// Consumer initialization blocks on broker metadata requests, or on downloading objects for kafka-store consumers, so
+// it runs in parallel. No consumer loop starts before every consumer is initialized.
+DEFINE_int32(kafka_consumer_init_parallelism, 8, "Kafka consumers initialized in parallel at startup");
+// Replay limits are relaxed up to 64 times while sampled client requests take no longer than this on average, and
+// tightened back when they do. 0 keeps replaying consumers at their configured limits.
+DEFINE_int64(kafka_consumer_replay_latency_target_micros, 0,
+             "Client latency below which replaying kafka consumers may exceed their limits. 0 disables");
 // Example for kafka producer configuration:
 // {
 //   "entityList": {
@@ -106,17 +165,56 @@ DEFINE_string(kafka_producer_configs, "", "Kafka producer configurations in JSON
 
 // server settings
 DEFINE_int32(port, 9049, "Server port");
+// Co-located clients can skip the loopback TCP stack by connecting through a unix domain socket. The socket is served
+// by the same pipeline as the TCP port, so the protocol and commands are identical.
+DEFINE_string(unix_socket_path, "", "Optional unix domain socket path to listen on in addition to the TCP port");
+
+// Hot restart: a new process started with --hot_restart_takeover receives the listening sockets from the process
+// serving --hot_restart_socket_path, and opens RocksDB once the old process has drained and closed it. Every process
+// with --hot_restart_socket_path set serves takeover requests for the next deploy.
+DEFINE_string(hot_restart_socket_path, "", "Unix socket path used to hand over listening sockets on hot restart");
+DEFINE_bool(hot_restart_takeover, false, "Take over listening sockets from the process at hot_restart_socket_path");
+DEFINE_int32(hot_restart_takeover_timeout_ms, 10000, "Timeout for receiving listening sockets on hot restart");
 
 // embedded http server
 DEFINE_int32(http_port, -1, "Embedded http server port. A valid port allows embedded to be included.");
 
 DEFINE_string(trace_file_path, "", "File path for trace output");
+// Hot key detection samples the first argument of commands into a top-K sketch per I/O thread, which is queried with
+// the HOTKEYS command and exported as the hot_key_share gauge. Sampling can be changed at runtime with HOTKEYS SAMPLE.
+DEFINE_int32(hot_key_sample_every, 0, "Sample one out of every N requests per thread for hot keys. 0 disables");
+
+// Tracing requires building with --define tracing=wtf. Sampling can be changed at runtime with the TRACE command.
+DEFINE_int32(trace_sample_every, 0, "Trace one out of every N requests and consumer batches per thread. 0 disables");
 
 // use a static global variable so that signal handlers can reference it
 static std::shared_ptr<pipeline::RedisPipelineBootstrap> redisPipelineBootstrap;
 
 namespace pipeline {
 
+namespace {
+
+int64_t elapsedMs(std::chrono::steady_clock::time_point startTime) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+// Total size of the WAL files in walDir, which RocksDB names with a .log suffix
+uint64_t getWalBytes(const std::string& walDir) {
+  uint64_t bytes = 0;
+  std::unique_ptr<DIR, int (*)(DIR*)> dir(opendir(walDir.c_str()), closedir);
+  if (!dir) return bytes;
+  while (struct dirent* entry = readdir(dir.get())) {
+    folly::StringPiece name(entry->d_name);
+    struct stat buf;
+    if (name.endsWith(".log") && stat(folly::sformat("{}/{}", walDir, name).c_str(), &buf) == 0) {
+      bytes += buf.st_size;
+    }
+  }
+  return bytes;
+}
+
+}  // namespace
+
 bool RedisPipelineBootstrap::canApplyOneOffFlags(int64_t versionTimestampMs) {
   if (versionTimestampMs < 0) {
     // version timestamp is not specified
@@ -155,6 +253,7 @@ bool RedisPipelineBootstrap::canApplyOneOffFlags(int64_t versionTimestampMs) {
 }
 
 void RedisPipelineBootstrap::persistVersionTimestamp(int64_t versionTimestampMs) {
+  if (rocksDb_ == nullptr) return;
   if (canApplyOneOffFlags(versionTimestampMs)) {
     rocksdb::Status s =
         rocksDb_->Put(rocksdb::WriteOptions(), getColumnFamily(DatabaseManager::metadataColumnFamilyName()),
@@ -175,8 +274,13 @@ void RedisPipelineBootstrap::processRocksDbColumnFamilyGroup(const std::string&
 void RedisPipelineBootstrap::initializeRocksDb(const std::string& dbPath, const std::string& dbPaths,
                                                const std::string& cfGroupConfigs,
                                                const std::string& dropCfGroupConfigs, int parallelism,
-                                               int blockCacheSizeMb, bool createIfMissing, bool createIfMissingOneOff,
-                                               int64_t versionTimestampMs) {
+                                               int blockCacheSizeMb, int maxTotalWalSizeMb, bool createIfMissing,
+                                               bool createIfMissingOneOff, int64_t versionTimestampMs) {
+  if (!config_.useRocksDb) {
+    LOG(INFO) << "RocksDB is disabled for this pipeline";
+    return;
+  }
+  auto startTime = std::chrono::steady_clock::now();
   rocksdb::Options options;
   // Optimize RocksDB
   // Common options for all types of workloads
@@ -188,7 +292,7 @@ void RedisPipelineBootstrap::initializeRocksDb(const std::string& dbPath, const
   options.max_bytes_for_level_base = 256 * 1024 * 1024;  // 256MB
   options.soft_pending_compaction_bytes_limit = 64L * 1024 * 1024 * 1024;  // 64GB
   options.hard_pending_compaction_bytes_limit = 256L * 1024 * 1024 * 1024;  // 256GB
-  options.max_total_wal_size = 1024 * 1024 * 1024;  // 1GB
+  options.max_total_wal_size = static_cast<uint64_t>(maxTotalWalSizeMb) * 1024 * 1024;
   options.IncreaseParallelism(parallelism);
   options.OptimizeLevelStyleCompaction();
   options.statistics = rocksdb::CreateDBStatistics();
@@ -287,9 +391,13 @@ void RedisPipelineBootstrap::initializeRocksDb(const std::string& dbPath, const
     }
   }
 
-  // open DB
+  // open DB, which replays whatever WAL was not flushed before the last shutdown
+  uint64_t walBytes = getWalBytes(options.wal_dir.empty() ? dbPath : options.wal_dir);
+  auto openTime = std::chrono::steady_clock::now();
   rocksdb::Status s = rocksdb::DB::Open(options, dbPath, columnFamilyDescriptors, &columnFamilyHandles, &rocksDb_);
   CHECK(s.ok()) << "RocksDB initialization failed: " << s.ToString();
+  LOG(INFO) << "Opened RocksDB in " << elapsedMs(openTime) << "ms, replaying "
+            << folly::prettyPrint(walBytes, folly::PRETTY_BYTES) << " of WAL";
 
   // Create missing column families
   for (const auto& entry : columnFamilyOptionsMap_) {
@@ -345,6 +453,41 @@ void RedisPipelineBootstrap::initializeRocksDb(const std::string& dbPath, const
       });
     }
   }
+  LOG(INFO) << "Initialized RocksDB with " << columnFamilyMap_.size() << " column families in "
+            << elapsedMs(startTime) << "ms";
+}
+
+void RedisPipelineBootstrap::flushRocksDb(int parallelism) {
+  if (rocksDb_ == nullptr) return;
+  auto startTime = std::chrono::steady_clock::now();
+  std::vector<rocksdb::ColumnFamilyHandle*> columnFamilies;
+  for (const auto& entry : columnFamilyMap_) {
+    columnFamilies.push_back(entry.second);
+  }
+
+  // Each flush blocks its thread until the memtable is written, so run as many as there are background flush threads.
+  // Column families are flushed independently, which is consistent since the WAL keeps what any of them has not
+  // flushed until it is flushed.
+  std::atomic<size_t> next(0);
+  std::atomic<int> failures(0);
+  std::vector<std::thread> threads;
+  int threadCount = std::min(std::max(parallelism, 1), static_cast<int>(columnFamilies.size()));
+  for (int i = 0; i < threadCount; i++) {
+    threads.emplace_back([this, &columnFamilies, &next, &failures]() {
+      for (size_t index = next++; index < columnFamilies.size(); index = next++) {
+        rocksdb::Status s = rocksDb_->Flush(rocksdb::FlushOptions(), columnFamilies[index]);
+        if (!s.ok()) {
+          LOG(ERROR) << "Flushing column family " << columnFamilies[index]->GetName() << " failed: " << s.ToString();
+          failures++;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  LOG(INFO) << "Flushed " << columnFamilies.size() - failures << " of " << columnFamilies.size()
+            << " column families in " << elapsedMs(startTime) << "ms";
 }
 
 RedisPipelineBootstrap::RocksDbColumnFamilyGroupConfigMap RedisPipelineBootstrap::parseRocksDbColumnFamilyGroupConfigs(
@@ -396,13 +539,31 @@ void RedisPipelineBootstrap::optimizeBlockedBasedTable() {
   }
 }
 
+void RedisPipelineBootstrap::startBlockCacheWarmer(const std::string& path, int64_t bytesPerSecond,
+                                                   int64_t timeoutMs) {
+  if (rocksDb_ == nullptr || path.empty()) return;
+  BlockCacheWarmer::instance()->exportMetrics(getMetricsRegistry().get());
+  BlockCacheWarmer::instance()->start(rocksDb_, columnFamilyMap_, path, bytesPerSecond, timeoutMs);
+}
+
+void RedisPipelineBootstrap::saveBlockCacheWarmer(const std::string& path) {
+  if (rocksDb_ == nullptr || path.empty()) return;
+  BlockCacheWarmer::instance()->stop();
+  BlockCacheWarmer::saveRanges(rocksDb_, columnFamilyMap_, path);
+}
+
 void RedisPipelineBootstrap::initializeDatabaseManager(bool masterReplica) {
+  if (!config_.useRocksDb) return;
   CHECK_NOTNULL(rocksDb_);
   if (config_.databaseManagerFactory) {
     databaseManager_ = config_.databaseManagerFactory(columnFamilyMap_, masterReplica, rocksDb_, this);
   } else {
     databaseManager_ = std::make_shared<DatabaseManager>(columnFamilyMap_, masterReplica, rocksDb_);
   }
+
+  // Offsets and other metadata are of no interest to keyspace subscribers
+  KeyspaceNotifier::instance()->ignoreColumnFamily(
+      getColumnFamily(DatabaseManager::metadataColumnFamilyName())->GetID());
 }
 
 void RedisPipelineBootstrap::initializeKafkaProducers(const std::string& brokerList,
@@ -434,7 +595,28 @@ void RedisPipelineBootstrap::initializeKafkaProducers(const std::string& brokerL
   }
 }
 
+void RedisPipelineBootstrap::initKafkaConsumers(int parallelism) {
+  if (kafkaConsumers_.empty()) return;
+  auto startTime = std::chrono::steady_clock::now();
+  // A failing consumer terminates the process from its thread, like it would from the main thread
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> threads;
+  int threadCount = std::min(std::max(parallelism, 1), static_cast<int>(kafkaConsumers_.size()));
+  for (int i = 0; i < threadCount; i++) {
+    threads.emplace_back([this, &next]() {
+      for (size_t index = next++; index < kafkaConsumers_.size(); index = next++) {
+        kafkaConsumers_[index]->init(RdKafka::Topic::OFFSET_STORED);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  LOG(INFO) << "Initialized " << kafkaConsumers_.size() << " kafka consumers in " << elapsedMs(startTime) << "ms";
+}
+
 void RedisPipelineBootstrap::initializeScheduledTaskQueues() {
+  if (config_.scheduledTaskProcessorFactoryMap.empty()) return;
   CHECK_NOTNULL(databaseManager_.get());
   for (auto& entry : config_.scheduledTaskProcessorFactoryMap) {
     rocksdb::ColumnFamilyHandle* columnFamily = getColumnFamily(entry.first);
@@ -460,6 +642,10 @@ void RedisPipelineBootstrap::initializeKafkaConsumer(const std::string& brokerLi
 
   kafkaConsumerHelper_ = std::make_shared<infra::kafka::ConsumerHelper>(
       rocksDb_, getColumnFamily(DatabaseManager::metadataColumnFamilyName()));
+  kafkaConsumerHelper_->setWriteBatchCommittedCallback([](rocksdb::WriteBatch* writeBatch) {
+    KeyspaceNotifier::instance()->publishWriteBatch(writeBatch);
+  });
+  kafkaConsumerHelper_->setMetrics(std::make_shared<infra::kafka::ConsumerMetrics>(getMetricsRegistry().get()));
 
   for (const auto& configEntry : configJson) {
     KafkaConsumerConfig config = KafkaConsumerConfig::createFromJson(configEntry);
@@ -468,6 +654,13 @@ void RedisPipelineBootstrap::initializeKafkaConsumer(const std::string& brokerLi
 
     const std::string offsetKey =
         kafkaConsumerHelper_->linkTopicPartition(config.topic, config.partition, config.offsetKeySuffix);
+    if (config.replayLagThreshold > 0) {
+      infra::kafka::ConsumerThrottleConfig throttleConfig;
+      throttleConfig.lagThreshold = config.replayLagThreshold;
+      throttleConfig.maxMessagesPerSec = config.replayMaxMessagesPerSec;
+      throttleConfig.maxWriteBytesPerSec = config.replayMaxWriteBytesPerSec;
+      kafkaConsumerHelper_->setThrottle(offsetKey, throttleConfig);
+    }
     if (config.consumeFromBeginningOneOff) {
       if (canApplyOneOffFlags(versionTimestampMs)) {
         CHECK(config.objectStoreBucketName.empty())
@@ -498,7 +691,24 @@ void RedisPipelineBootstrap::initializeKafkaConsumer(const std::string& brokerLi
 
     LOG(INFO) << "Launching kafka consumer for partition " << config.partition << " of " << config.topic << " as "
               << config.groupId;
-    kafkaConsumers_.push_back(factory(brokerList, config, offsetKey, this));
+    std::shared_ptr<infra::kafka::AbstractConsumer> consumer = factory(brokerList, config, offsetKey, this);
+    if (config.initialTimestampMsOneOff >= 0) {
+      if (canApplyOneOffFlags(versionTimestampMs)) {
+        CHECK(consumer->rewindToTimestamp(config.initialTimestampMsOneOff))
+            << "Failed to rewind partition " << config.partition << " of " << config.topic << " to "
+            << config.initialTimestampMsOneOff;
+      } else {
+        LOG(WARNING) << "Cannot consume from the specified timestamp unless a valid version_timestamp_ms is specified";
+      }
+    }
+    infra::kafka::MessageFilter messageFilter(config.filterKeyPrefixes, config.filterPayloadPrefix);
+    if (!messageFilter.empty()) {
+      // kafka store files are decoded as a whole, so there is nothing to save by filtering their messages early
+      auto kafkaConsumer = std::dynamic_pointer_cast<infra::kafka::Consumer>(consumer);
+      CHECK(kafkaConsumer) << "Only support message filters for regular kafka consumer";
+      kafkaConsumer->setMessageFilter(std::move(messageFilter));
+    }
+    kafkaConsumers_.push_back(std::move(consumer));
   }
 }
 
@@ -506,7 +716,8 @@ void RedisPipelineBootstrap::initializeRegistry() {
   metricsRegistry_ = std::make_shared<prometheus::Registry>();
 }
 
-void RedisPipelineBootstrap::initializeEmbeddedHttpServer(int httpPort, int redisServerPort) {
+void RedisPipelineBootstrap::initializeEmbeddedHttpServer(int httpPort, int redisServerPort,
+                                                          const std::string& redisUnixSocketPath) {
   embeddedHttpServer_ = std::make_shared<EmbeddedHttpServer>(httpPort);
 
   // Enable metrics at /metrics
@@ -515,12 +726,15 @@ void RedisPipelineBootstrap::initializeEmbeddedHttpServer(int httpPort, int redi
 
   // Always install ready handler for health check
   CHECK(embeddedHttpServer_->registerHandler(
-      "/ready", [redisServerPort](std::string* response) {
+      "/ready", [redisServerPort, redisUnixSocketPath](std::string* response) {
         // We check both redis server health and optionally consumer readiness using the customized READY command.
         // Timeout in 5 seconds. Though it is a fast localhost connection, we may get a slow response from a loaded box
         *response = "not ready";
+        // Prefer the unix domain socket when it is enabled, since that is the path used by co-located clients
         auto context = std::unique_ptr<redisContext, void (*)(redisContext*)>(
-            redisConnectWithTimeout("localhost", redisServerPort, {5, 0}), redisFree);
+            redisUnixSocketPath.empty() ? redisConnectWithTimeout("localhost", redisServerPort, {5, 0})
+                                        : redisConnectUnixWithTimeout(redisUnixSocketPath.c_str(), {5, 0}),
+            redisFree);
         if (!context || context->err) {
           if (context) {
             LOG(ERROR) << "Connect to local DB failed: " << context->errstr;
@@ -550,7 +764,8 @@ void RedisPipelineBootstrap::initializeEmbeddedHttpServer(int httpPort, int redi
       }));
 }
 
-void RedisPipelineBootstrap::launchServer(int port, int connectionIdleTimeoutMs) {
+void RedisPipelineBootstrap::launchServer(int port, int connectionIdleTimeoutMs, const std::string& unixSocketPath,
+                                          const FairSchedulerConfig& schedulerConfig) {
   LOG(INFO) << "Launching server on port " << port;
   server_ = new wangle::ServerBootstrap<RedisPipeline>();
   auto socketConfig = wangle::ServerSocketConfig();
@@ -559,17 +774,83 @@ void RedisPipelineBootstrap::launchServer(int port, int connectionIdleTimeoutMs)
   server_->acceptorConfig(socketConfig);
 
   // Check the existence of dependencies based on configuration
-  CHECK_NOTNULL(databaseManager_.get());
+  if (config_.useRocksDb) {
+    CHECK_NOTNULL(databaseManager_.get());
+  }
   CHECK_EQ(config_.scheduledTaskProcessorFactoryMap.size(), scheduledTaskQueueMap_.size());
 
-  server_->childPipeline(std::make_shared<pipeline::RedisPipelineFactory>(std::make_shared<DefaultRedisHandlerBuilder>(
-      config_.redisHandlerFactory, config_.singletonRedisHandler, this)));
+  server_->childPipeline(std::make_shared<pipeline::RedisPipelineFactory>(
+      std::make_shared<DefaultRedisHandlerBuilder>(config_.redisHandlerFactory, config_.singletonRedisHandler, this),
+      schedulerConfig));
 
-  server_->bind(port);
+  if (inheritedListeningFds_.empty()) {
+    server_->bind(port);
+    if (!unixSocketPath.empty()) {
+      bindUnixSocket(unixSocketPath);
+    }
+  } else {
+    for (int fd : inheritedListeningFds_) {
+      bindInheritedSocket(fd);
+    }
+  }
+  if (hotRestart_) {
+    hotRestart_->listenForTakeover([this]() { return getListeningFds(); }, [this]() { stopServer(); });
+  }
   server_->waitForStop();
   LOG(INFO) << "Pipeline server has shutdown gracefully";
 }
 
+void RedisPipelineBootstrap::bindUnixSocket(const std::string& unixSocketPath) {
+  // A socket file left behind by a previous process would make bind fail with EADDRINUSE. Only remove it when it is
+  // actually a socket so that a misconfigured path never deletes a regular file.
+  struct stat buf;
+  if (lstat(unixSocketPath.c_str(), &buf) == 0) {
+    CHECK(S_ISSOCK(buf.st_mode)) << "Unix socket path exists and is not a socket: " << unixSocketPath;
+    PCHECK(unlink(unixSocketPath.c_str()) == 0) << "Removing stale unix socket failed: " << unixSocketPath;
+  }
+
+  LOG(INFO) << "Launching server on unix socket " << unixSocketPath;
+  folly::SocketAddress address;
+  address.setFromPath(unixSocketPath);
+  // Connections accepted here share the acceptor config and child pipeline with the TCP listener
+  server_->bind(address);
+}
+
+void RedisPipelineBootstrap::bindInheritedSocket(int fd) {
+  LOG(INFO) << "Launching server on inherited listening socket " << fd;
+  folly::AsyncServerSocket::UniquePtr socket(new folly::AsyncServerSocket());
+  socket->useExistingSocket(fd);
+  server_->bind(std::move(socket));
+}
+
+std::vector<int> RedisPipelineBootstrap::getListeningFds() {
+  std::vector<int> fds;
+  if (!server_) return fds;
+  for (const auto& socket : server_->getSockets()) {
+    auto serverSocket = std::dynamic_pointer_cast<folly::AsyncServerSocket>(socket);
+    if (!serverSocket) continue;
+    serverSocket->getEventBase()->runImmediatelyOrRunInEventBaseThreadAndWait([&fds, serverSocket]() {
+      for (int fd : serverSocket->getSockets()) {
+        fds.push_back(fd);
+      }
+    });
+  }
+  return fds;
+}
+
+void RedisPipelineBootstrap::initializeHotRestart(const std::string& controlSocketPath, bool takeover,
+                                                  int takeoverTimeoutMs) {
+  CHECK(rocksDb_ == nullptr) << "Hot restart must be initialized before RocksDB";
+  hotRestart_.reset(new HotRestart(controlSocketPath));
+  if (!takeover) return;
+
+  inheritedListeningFds_ = hotRestart_->takeover(takeoverTimeoutMs);
+  if (!inheritedListeningFds_.empty()) {
+    // Connections queue up in the inherited accept backlog while waiting, so clients never see connection refusal
+    hotRestart_->waitForDatabaseClosed();
+  }
+}
+
 std::shared_ptr<RedisPipelineBootstrap> RedisPipelineBootstrap::create(Config config) {
   redisPipelineBootstrap.reset(new RedisPipelineBootstrap(config));
   return redisPipelineBootstrap;
@@ -597,13 +878,19 @@ int main(int argc, char** argv) {
   CHECK_EQ(pipeline::DatabaseManager::defaultColumnFamilyName(), rocksdb::kDefaultColumnFamilyName);
 
   LOG(INFO) << "Initializing RedisPipeline";
+  auto startupTime = std::chrono::steady_clock::now();
   redisPipelineBootstrap->initializeRegistry();
+  if (!FLAGS_hot_restart_socket_path.empty()) {
+    redisPipelineBootstrap->initializeHotRestart(FLAGS_hot_restart_socket_path, FLAGS_hot_restart_takeover,
+                                                 FLAGS_hot_restart_takeover_timeout_ms);
+  }
   redisPipelineBootstrap->initializeRocksDb(FLAGS_rocksdb_db_path, FLAGS_rocksdb_db_paths,
                                             FLAGS_rocksdb_cf_group_configs, FLAGS_rocksdb_drop_cf_group_configs,
                                             FLAGS_rocksdb_parallelism, FLAGS_rocksdb_block_cache_size_mb,
-                                            FLAGS_rocksdb_create_if_missing, FLAGS_rocksdb_create_if_missing_one_off,
-                                            FLAGS_version_timestamp_ms);
-
+                                            FLAGS_rocksdb_max_total_wal_size_mb, FLAGS_rocksdb_create_if_missing,
+                                            FLAGS_rocksdb_create_if_missing_one_off, FLAGS_version_timestamp_ms);
+  redisPipelineBootstrap->startBlockCacheWarmer(FLAGS_block_cache_warmup_file, FLAGS_block_cache_warmup_bytes_per_sec,
+                                                FLAGS_block_cache_warmup_timeout_ms);
 
   // initialize optional components
   // NOTE: order matters here because both the database manager and kafka producers maybe used by other components to
@@ -614,19 +901,39 @@ int main(int argc, char** argv) {
   redisPipelineBootstrap->initializeKafkaConsumer(FLAGS_kafka_broker_list, FLAGS_kafka_consumer_configs,
                                                   FLAGS_version_timestamp_ms);
   if (FLAGS_http_port > 0) {
-    redisPipelineBootstrap->initializeEmbeddedHttpServer(FLAGS_http_port, FLAGS_port);
+    redisPipelineBootstrap->initializeEmbeddedHttpServer(FLAGS_http_port, FLAGS_port, FLAGS_unix_socket_path);
   }
 
-  redisPipelineBootstrap->startOptionalComponents();
+  redisPipelineBootstrap->startOptionalComponents(FLAGS_kafka_consumer_init_parallelism);
 
   redisPipelineBootstrap->persistVersionTimestamp(FLAGS_version_timestamp_ms);
 
   // start the server with all optional components initialized and started
   // NOTE: launchServer method cannot use any one-off flags
-  redisPipelineBootstrap->launchServer(FLAGS_port, FLAGS_connection_idle_timeout_ms);
+  infra::Tracing::setSampleEvery(std::max(FLAGS_trace_sample_every, 0));
+  pipeline::HotKeyTracker::instance()->setSampleEvery(std::max(FLAGS_hot_key_sample_every, 0));
+  pipeline::HotKeyTracker::instance()->exportMetrics(redisPipelineBootstrap->getMetricsRegistry().get());
+  infra::kafka::ConsumerGovernor::instance()->setLatencyTargetMicros(
+      std::max<int64_t>(FLAGS_kafka_consumer_replay_latency_target_micros, 0));
+  pipeline::ReadCoalescer::instance()->setEnabled(FLAGS_read_coalescing);
+  pipeline::KeyspaceNotifier::instance()->setMaxPendingMessages(std::max(FLAGS_keyspace_notification_max_pending, 0));
+  pipeline::FairSchedulerConfig schedulerConfig;
+  schedulerConfig.commandsPerTurn = std::max(FLAGS_scheduler_commands_per_turn, 0);
+  schedulerConfig.commandsPerConnection = std::max(FLAGS_scheduler_commands_per_connection, 1);
+  schedulerConfig.maxQueuedCommands = std::max(FLAGS_scheduler_max_queued_commands, 1);
+  LOG(INFO) << "Initialized RedisPipeline in " << pipeline::elapsedMs(startupTime) << "ms";
+  redisPipelineBootstrap->launchServer(FLAGS_port, FLAGS_connection_idle_timeout_ms, FLAGS_unix_socket_path,
+                                       schedulerConfig);
 
   redisPipelineBootstrap->stopOptionalComponents();
+  if (FLAGS_rocksdb_flush_on_shutdown) {
+    // Consumers and scheduled tasks have stopped, so nothing writes anymore
+    redisPipelineBootstrap->flushRocksDb(FLAGS_rocksdb_parallelism);
+  }
+  // Ranges are planned from SST files, so save them once recent writes are flushed into some
+  redisPipelineBootstrap->saveBlockCacheWarmer(FLAGS_block_cache_warmup_file);
   redisPipelineBootstrap->stopRocksDb();
+  redisPipelineBootstrap->completeHotRestart();
 
   redisPipelineBootstrap.reset();
 
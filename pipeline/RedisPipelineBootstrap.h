@@ -1,6 +1,7 @@
 #ifndef PIPELINE_REDISPIPELINEBOOTSTRAP_H_
 #define PIPELINE_REDISPIPELINEBOOTSTRAP_H_
 
+#include <chrono>
 #include <functional>
 #include <memory>
 #include <string>
@@ -19,6 +20,8 @@
 #include "rocksdb/options.h"
 #include "pipeline/DatabaseManager.h"
 #include "pipeline/EmbeddedHttpServer.h"
+#include "pipeline/FairScheduler.h"
+#include "pipeline/HotRestart.h"
 #include "pipeline/KafkaConsumerConfig.h"
 #include "pipeline/RedisHandler.h"
 #include "pipeline/RedisHandlerBuilder.h"
@@ -83,6 +86,10 @@ class RedisPipelineBootstrap {
       return handler;
     }
 
+    bool sharesHandler() const override {
+      return singletonHandler_;
+    }
+
    private:
     RedisHandlerFactory redisHandlerFactory_;
     bool singletonHandler_;
@@ -121,6 +128,11 @@ class RedisPipelineBootstrap {
     // Most handlers should leave this optional true unless transaction support is need. See counters
     bool singletonRedisHandler = true;
 
+    // Optional
+    // Stateless services such as proxies can run without RocksDB, in which case neither the database manager nor
+    // the components depending on it, e.g., scheduled tasks and kafka consumers, are available
+    bool useRocksDb = true;
+
     Config(RedisHandlerFactory _redisHandlerFactory,
            KafkaConsumerFactoryMap _kafkaConsumerFactoryMap = KafkaConsumerFactoryMap(),
            DatabaseManagerFactory _databaseManagerFactory = nullptr,
@@ -179,16 +191,31 @@ class RedisPipelineBootstrap {
   void initializeRocksDb(const std::string& dbPath, const std::string& dbPaths,
                          const std::string& cfGroupConfigs,
                          const std::string& dropCfGroupConfigs, int parallelism, int blockCacheSizeMb,
-                         bool createIfMissing, bool createIfMissingOneOff, int64_t versionMimestampMs);
+                         int maxTotalWalSizeMb, bool createIfMissing, bool createIfMissingOneOff,
+                         int64_t versionMimestampMs);
+
+  // Flush the memtables of all column families, up to parallelism at a time, so that the next startup does not need
+  // to replay the WAL. Called after all writers have stopped and before stopRocksDb.
+  void flushRocksDb(int parallelism);
 
   void stopRocksDb() {
+    if (rocksDb_ == nullptr) return;
+    auto startTime = std::chrono::steady_clock::now();
     for (auto& entry : columnFamilyMap_) {
       rocksDb_->DestroyColumnFamilyHandle(entry.second);
     }
     delete rocksDb_;
-    LOG(INFO) << "RocksDB has shutdown gracefully";
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+    LOG(INFO) << "RocksDB has shutdown gracefully in " << elapsed.count() << "ms";
   }
 
+  // Warm the block cache in the background from the ranges saved at path by the last graceful shutdown
+  void startBlockCacheWarmer(const std::string& path, int64_t bytesPerSecond, int64_t timeoutMs);
+
+  // Save the ranges to warm on the next startup. Called after flushRocksDb, so that the plan covers the memtables too,
+  // and before stopRocksDb.
+  void saveBlockCacheWarmer(const std::string& path);
+
   // optimize block-based table after all options are initialized
   void optimizeBlockedBasedTable();
 
@@ -200,9 +227,24 @@ class RedisPipelineBootstrap {
   void initializeScheduledTaskQueues();
   void initializeRegistry();
 
-  void initializeEmbeddedHttpServer(int httpPort, int redisServerPort);
+  // The ready probe connects through redisUnixSocketPath when it is not empty, otherwise through redisServerPort
+  void initializeEmbeddedHttpServer(int httpPort, int redisServerPort, const std::string& redisUnixSocketPath = "");
 
-  void startOptionalComponents() {
+  // Enable hot restart through the given control socket. With takeover set, listening sockets are received from the
+  // process serving the control socket, and this method blocks until that process has closed RocksDB. It must be
+  // called before initializeRocksDb.
+  void initializeHotRestart(const std::string& controlSocketPath, bool takeover, int takeoverTimeoutMs);
+
+  // Notify the process taking over that RocksDB is closed. Called after stopRocksDb.
+  void completeHotRestart() {
+    if (hotRestart_) {
+      hotRestart_->stop();
+      hotRestart_->notifyDatabaseClosed();
+    }
+  }
+
+  // Kafka consumers are initialized up to consumerInitParallelism at a time
+  void startOptionalComponents(int consumerInitParallelism = 1) {
     if (databaseManager_) {
       databaseManager_->start();
     }
@@ -213,9 +255,7 @@ class RedisPipelineBootstrap {
     // Initialization may panic on verification failures. Panic before starting any consumer loops reduces the
     // probability of data corruption since no writes can be committed until consumer loops start (if you don't use
     // kafka consumers then the following loops are no-op anyway).
-    for (auto& consumer : kafkaConsumers_) {
-      consumer->init(RdKafka::Topic::OFFSET_STORED);
-    }
+    initKafkaConsumers(consumerInitParallelism);
     for (auto& consumer : kafkaConsumers_) {
       consumer->start();
     }
@@ -248,8 +288,11 @@ class RedisPipelineBootstrap {
     }
   }
 
-  // Create server and block on listening
-  void launchServer(int port, int connectionIdleTimeoutMs);
+  // Create server and block on listening. When unixSocketPath is not empty, the server also listens on the unix domain
+  // socket with the same pipeline. Both are ignored if listening sockets have been taken over through hot restart.
+  // Commands are scheduled fairly across connections when schedulerConfig.commandsPerTurn is positive.
+  void launchServer(int port, int connectionIdleTimeoutMs, const std::string& unixSocketPath = "",
+                    const FairSchedulerConfig& schedulerConfig = FairSchedulerConfig());
 
   // Stop server
   void stopServer() {
@@ -300,6 +343,19 @@ class RedisPipelineBootstrap {
   // Set db_paths from json string
   void setDbPaths(const std::string& json, rocksdb::Options* options);
 
+  // Initialize all kafka consumers from their stored offsets, which mostly waits for brokers or object downloads, in a
+  // bounded number of threads. It returns once every consumer is initialized.
+  void initKafkaConsumers(int parallelism);
+
+  // Bind an additional listener on a unix domain socket, replacing any stale socket file
+  void bindUnixSocket(const std::string& unixSocketPath);
+
+  // Accept connections on a listening socket inherited from the previous process
+  void bindInheritedSocket(int fd);
+
+  // Collect the fds of all listening sockets of the running server
+  std::vector<int> getListeningFds();
+
   // Parse configurations for rocksdb column family groups
   RocksDbColumnFamilyGroupConfigMap parseRocksDbColumnFamilyGroupConfigs(const std::string& configs);
 
@@ -329,6 +385,9 @@ class RedisPipelineBootstrap {
   std::shared_ptr<prometheus::Registry> metricsRegistry_;
   // Embedded http server for health check and metrics
   std::shared_ptr<EmbeddedHttpServer> embeddedHttpServer_;
+  // Hot restart handover and the listening sockets inherited through it
+  std::unique_ptr<HotRestart> hotRestart_;
+  std::vector<int> inheritedListeningFds_;
   // require component
   // NOTE: use raw pointer here to avoid automatic deletion of the pointer.
   // server_->stop(); is sufficient for releasing resources
@@ -8,10 +8,13 @@
 #include "codec/RedisEncoder.h"
 #include "codec/RedisMessage.h"
 #include "folly/io/IOBufQueue.h"
+#include "folly/io/async/AsyncSocket.h"
+#include "pipeline/FairScheduler.h"
 #include "pipeline/OrderedRedisMessageAdapter.h"
 #include "pipeline/RedisHandler.h"
 #include "pipeline/RedisHandlerBuilder.h"
 #include "wangle/channel/AsyncSocketHandler.h"
+#include "wangle/channel/HandlerContext.h"
 #include "wangle/channel/OutputBufferingHandler.h"
 #include "wangle/channel/Pipeline.h"
 
@@ -21,10 +24,12 @@ using RedisPipeline = wangle::Pipeline<folly::IOBufQueue&, codec::RedisMessage>;
 
 class RedisPipelineFactory : public wangle::PipelineFactory<RedisPipeline> {
  public:
-  explicit RedisPipelineFactory(std::shared_ptr<RedisHandlerBuilder> redisHandlerBuilder)
+  explicit RedisPipelineFactory(std::shared_ptr<RedisHandlerBuilder> redisHandlerBuilder,
+                                FairSchedulerConfig schedulerConfig = FairSchedulerConfig())
       : redisDecoder_(std::make_shared<codec::RedisDecoder>()),
         redisEncoder_(std::make_shared<codec::RedisEncoder>()),
-        redisHandlerBuilder_(redisHandlerBuilder) {}
+        redisHandlerBuilder_(redisHandlerBuilder),
+        schedulerConfig_(schedulerConfig) {}
 
   RedisPipeline::Ptr newPipeline(std::shared_ptr<folly::AsyncTransportWrapper> sock) override {
     auto pipeline = RedisPipeline::create();
@@ -33,18 +38,48 @@ class RedisPipelineFactory : public wangle::PipelineFactory<RedisPipeline> {
     pipeline->addBack(redisDecoder_);
     pipeline->addBack(redisEncoder_);
     auto redisHandler = redisHandlerBuilder_->newHandler();
+    // The decoder and encoder are shared, so only their contexts are allocated per connection
+    size_t footprintBytes = sizeof(RedisPipeline) + sizeof(folly::AsyncSocket) +
+                            handlerBytes<wangle::AsyncSocketHandler>() +
+                            handlerBytes<wangle::OutputBufferingHandler>() +
+                            contextBytes<codec::RedisDecoder>() + contextBytes<codec::RedisEncoder>() +
+                            contextBytes<RedisHandler>();
     if (redisHandler->allowAsyncCommandHandler()) {
       pipeline->addBack(std::make_shared<OrderedRedisMessageAdapter>());
+      footprintBytes += handlerBytes<OrderedRedisMessageAdapter>();
     }
+    if (schedulerConfig_.commandsPerTurn > 0) {
+      // Placed after the adapter so that replies keep the order in which requests arrived
+      auto scheduler = FairScheduler::get(sock->getEventBase(), schedulerConfig_);
+      pipeline->addBack(FairSchedulingHandler(scheduler, redisHandler));
+      footprintBytes += handlerBytes<FairSchedulingHandler>();
+    }
+    if (!redisHandlerBuilder_->sharesHandler()) {
+      footprintBytes += redisHandler->handlerBytes();
+    }
+    RedisHandler::setConnectionFootprintBytes(footprintBytes);
     pipeline->addBack(std::move(redisHandler));
     pipeline->finalize();
     return pipeline;
   }
 
  private:
+  // Size of the context wangle allocates for each handler in a pipeline
+  template <typename Handler>
+  static constexpr size_t contextBytes() {
+    return sizeof(typename wangle::ContextType<Handler>::type);
+  }
+
+  // Size of a handler allocated for each connection and its context
+  template <typename Handler>
+  static constexpr size_t handlerBytes() {
+    return sizeof(Handler) + contextBytes<Handler>();
+  }
+
   std::shared_ptr<codec::RedisDecoder> redisDecoder_;
   std::shared_ptr<codec::RedisEncoder> redisEncoder_;
   std::shared_ptr<RedisHandlerBuilder> redisHandlerBuilder_;
+  const FairSchedulerConfig schedulerConfig_;
 };
 
 }  // namespace pipeline
@@ -0,0 +1,485 @@
+#include "pipeline/ScriptEngine.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "boost/algorithm/string/case_conv.hpp"
+#include "folly/Range.h"
+#include "folly/String.h"
+#include "folly/ssl/OpenSSLHash.h"
+#include "glog/logging.h"
+#include "lua/lua.hpp"
+
+namespace pipeline {
+
+namespace {
+
+// Check the time limit every this many instructions
+constexpr int kHookInstructionCount = 100000;
+// Registry field holding the metatable of script environments
+constexpr char kEnvMetatable[] = "env_metatable";
+// Tables nested deeper than this in a return value are rejected rather than converted
+constexpr int kMaxReplyDepth = 64;
+
+struct ScriptCache {
+  std::mutex mutex;
+  // sha1 to script source
+  std::unordered_map<std::string, std::string> scripts;
+  // Bumped on flush, which invalidates scripts compiled in thread states
+  std::atomic<uint64_t> generation{0};
+};
+
+ScriptCache& scriptCache() {
+  static ScriptCache cache;
+  return cache;
+}
+
+struct ThreadLuaState {
+  lua_State* state = nullptr;
+  uint64_t generation = 0;
+
+  ~ThreadLuaState() {
+    if (state) lua_close(state);
+  }
+};
+
+thread_local ThreadLuaState threadLuaState;
+// Only set while a script runs in this thread
+thread_local const ScriptEngine::CommandExecutor* currentExecutor = nullptr;
+thread_local int64_t deadlineMs = 0;
+
+int64_t nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string functionName(const std::string& sha) {
+  return "f_" + sha;
+}
+
+void pushRedisValue(lua_State* state, const codec::RedisValue& value) {
+  switch (value.type()) {
+    case codec::RedisValue::Type::kInteger:
+      lua_pushinteger(state, value.integer());
+      break;
+    case codec::RedisValue::Type::kBulkString:
+      lua_pushlstring(state, value.bulkString().data(), value.bulkString().size());
+      break;
+    case codec::RedisValue::Type::kSimpleString:
+      lua_newtable(state);
+      lua_pushlstring(state, value.simpleString().data(), value.simpleString().size());
+      lua_setfield(state, -2, "ok");
+      break;
+    case codec::RedisValue::Type::kError:
+      lua_newtable(state);
+      lua_pushlstring(state, value.error().data(), value.error().size());
+      lua_setfield(state, -2, "err");
+      break;
+    case codec::RedisValue::Type::kArray:
+      lua_createtable(state, value.array().size(), 0);
+      for (size_t i = 0; i < value.array().size(); i++) {
+        pushRedisValue(state, value.array()[i]);
+        lua_rawseti(state, -2, i + 1);
+      }
+      break;
+    case codec::RedisValue::Type::kBulkStringArray:
+      lua_createtable(state, value.bulkStringArray().size(), 0);
+      for (size_t i = 0; i < value.bulkStringArray().size(); i++) {
+        const std::string& str = value.bulkStringArray()[i];
+        lua_pushlstring(state, str.data(), str.size());
+        lua_rawseti(state, -2, i + 1);
+      }
+      break;
+    case codec::RedisValue::Type::kNullString:
+      lua_pushboolean(state, 0);
+      break;
+    default:
+      lua_newtable(state);
+      lua_pushstring(state, "Unsupported reply type");
+      lua_setfield(state, -2, "err");
+  }
+}
+
+// Convert the value at the top of the stack, nested depth tables deep. Set tooDeep instead of recursing any further,
+// which bounds both the Lua and the C++ stack for cyclic and deeply nested tables.
+codec::RedisValue toRedisValue(lua_State* state, int depth, bool* tooDeep) {
+  switch (lua_type(state, -1)) {
+    case LUA_TNUMBER:
+      // Like redis, floating point numbers are truncated to integers
+      return codec::RedisValue(lua_isinteger(state, -1) ? lua_tointeger(state, -1)
+                                                        : static_cast<int64_t>(lua_tonumber(state, -1)));
+    case LUA_TSTRING: {
+      size_t len = 0;
+      const char* str = lua_tolstring(state, -1, &len);
+      return codec::RedisValue(codec::RedisValue::Type::kBulkString, std::string(str, len));
+    }
+    case LUA_TBOOLEAN:
+      return lua_toboolean(state, -1) ? codec::RedisValue(1) : codec::RedisValue::nullString();
+    case LUA_TTABLE: {
+      // each level holds the table and one element
+      if (depth >= kMaxReplyDepth || !lua_checkstack(state, 2)) {
+        *tooDeep = true;
+        return codec::RedisValue::nullString();
+      }
+      for (const auto& field : {std::make_pair("err", codec::RedisValue::Type::kError),
+                                std::make_pair("ok", codec::RedisValue::Type::kSimpleString)}) {
+        lua_pushstring(state, field.first);
+        lua_rawget(state, -2);
+        if (lua_type(state, -1) == LUA_TSTRING) {
+          codec::RedisValue value(field.second, std::string(lua_tostring(state, -1)));
+          lua_pop(state, 1);
+          return value;
+        }
+        lua_pop(state, 1);
+      }
+      // Like redis, an array ends at its first nil
+      std::vector<codec::RedisValue> values;
+      for (int i = 1;; i++) {
+        lua_rawgeti(state, -1, i);
+        if (lua_isnil(state, -1)) {
+          lua_pop(state, 1);
+          break;
+        }
+        values.push_back(toRedisValue(state, depth + 1, tooDeep));
+        lua_pop(state, 1);
+        if (*tooDeep) return codec::RedisValue::nullString();
+      }
+      return codec::RedisValue(std::move(values));
+    }
+    default:
+      return codec::RedisValue::nullString();
+  }
+}
+
+// Implement redis.call and redis.pcall. Lua errors unwind with longjmp, so no C++ object may be alive when lua_error
+// is called.
+int redisCommand(lua_State* state, bool raiseError) {
+  // e.g., from a finalizer run by the garbage collector outside of any script
+  if (!currentExecutor) {
+    return luaL_error(state, "redis.call is only available while a script runs");
+  }
+  int argc = lua_gettop(state);
+  if (argc == 0) {
+    return luaL_error(state, "Please specify at least one argument for redis.call()");
+  }
+
+  bool failed = false;
+  {
+    std::vector<std::string> cmd;
+    for (int i = 1; i <= argc; i++) {
+      int type = lua_type(state, i);
+      if (type != LUA_TSTRING && type != LUA_TNUMBER) {
+        lua_pushstring(state, "Lua redis() command arguments must be strings or integers");
+        failed = true;
+        break;
+      }
+      size_t len = 0;
+      const char* arg = lua_tolstring(state, i, &len);
+      cmd.emplace_back(arg, len);
+    }
+
+    if (!failed) {
+      codec::RedisValue result;
+      try {
+        result = (*currentExecutor)(std::move(cmd));
+      } catch (const std::exception& e) {
+        result = codec::RedisValue(codec::RedisValue::Type::kError, e.what());
+      }
+      if (raiseError && result.type() == codec::RedisValue::Type::kError) {
+        lua_pushlstring(state, result.error().data(), result.error().size());
+        failed = true;
+      } else {
+        pushRedisValue(state, result);
+      }
+    }
+  }
+
+  if (failed) return lua_error(state);
+  return 1;
+}
+
+int redisCall(lua_State* state) {
+  return redisCommand(state, true);
+}
+
+int redisPCall(lua_State* state) {
+  return redisCommand(state, false);
+}
+
+int redisReply(lua_State* state, const char* field) {
+  luaL_checkstring(state, 1);
+  lua_newtable(state);
+  lua_pushvalue(state, 1);
+  lua_setfield(state, -2, field);
+  return 1;
+}
+
+int redisStatusReply(lua_State* state) {
+  return redisReply(state, "ok");
+}
+
+int redisErrorReply(lua_State* state) {
+  return redisReply(state, "err");
+}
+
+// load restricted to source text, since crafted bytecode can crash the interpreter
+int loadText(lua_State* state) {
+  // chunk, chunkname, mode, and env if given, after the original load
+  int argc = std::max(lua_gettop(state), 3);
+  lua_settop(state, argc);
+  lua_pushliteral(state, "t");
+  lua_replace(state, 3);
+  lua_pushvalue(state, lua_upvalueindex(1));
+  lua_insert(state, 1);
+  lua_call(state, argc, LUA_MULTRET);
+  return lua_gettop(state);
+}
+
+// setmetatable without finalizers. A __gc metamethod may run at any time, even outside of the script that set it,
+// while the tables of a script must not outlive it. Lua only honors __gc if present when the metatable is set.
+int setMetatableWithoutGc(lua_State* state) {
+  if (lua_type(state, 2) == LUA_TTABLE) {
+    lua_pushliteral(state, "__gc");
+    bool hasGc = lua_rawget(state, 2) != LUA_TNIL;
+    lua_pop(state, 1);
+    if (hasGc) return luaL_error(state, "Finalizers are not allowed in scripts");
+  }
+  lua_pushvalue(state, lua_upvalueindex(1));
+  lua_insert(state, 1);
+  lua_call(state, lua_gettop(state) - 1, LUA_MULTRET);
+  return lua_gettop(state);
+}
+
+void timeLimitHook(lua_State* state, lua_Debug* debug) {
+  if (nowMs() > deadlineMs) {
+    luaL_error(state, "Script killed after running for more than %d ms", ScriptEngine::kTimeLimitMs);
+  }
+}
+
+void pushStringArray(lua_State* state, const std::vector<std::string>& values) {
+  lua_createtable(state, values.size(), 0);
+  for (size_t i = 0; i < values.size(); i++) {
+    lua_pushlstring(state, values[i].data(), values[i].size());
+    lua_rawseti(state, -2, i + 1);
+  }
+}
+
+int readOnlyError(lua_State* state) {
+  return luaL_error(state, "Attempt to modify a readonly table");
+}
+
+// Replace the table at the top of the stack with an empty proxy, which reads through to the table and rejects writes
+void replaceWithReadOnlyProxy(lua_State* state) {
+  lua_newtable(state);
+  lua_newtable(state);
+  lua_pushvalue(state, -3);
+  lua_setfield(state, -2, "__index");
+  lua_pushcfunction(state, readOnlyError);
+  lua_setfield(state, -2, "__newindex");
+  // getmetatable returns false, and setmetatable fails
+  lua_pushboolean(state, 0);
+  lua_setfield(state, -2, "__metatable");
+  lua_setmetatable(state, -2);
+  lua_remove(state, -2);
+}
+
+// Hide the globals and libraries shared by all scripts behind read-only proxies. Each run gets its own environment on
+// top of them, see ScriptEngine::run, so nothing a script does outlives it.
+void protectGlobals(lua_State* state) {
+  lua_pushglobaltable(state);
+  for (const char* name : {LUA_TABLIBNAME, LUA_STRLIBNAME, LUA_MATHLIBNAME, "redis"}) {
+    lua_getfield(state, -1, name);
+    replaceWithReadOnlyProxy(state);
+    lua_setfield(state, -2, name);
+  }
+  // rawset bypasses the proxies
+  lua_pushnil(state);
+  lua_setfield(state, -2, "rawset");
+  // the metatable of strings leads to the string library as well
+  lua_pushliteral(state, "");
+  lua_getmetatable(state, -1);
+  lua_pushboolean(state, 0);
+  lua_setfield(state, -2, "__metatable");
+  lua_pop(state, 2);
+
+  replaceWithReadOnlyProxy(state);
+  lua_pushglobaltable(state);
+  lua_pushvalue(state, -2);
+  lua_setfield(state, -2, "_G");
+  lua_pop(state, 1);
+
+  lua_newtable(state);
+  lua_pushvalue(state, -2);
+  lua_setfield(state, -2, "__index");
+  lua_setfield(state, LUA_REGISTRYINDEX, kEnvMetatable);
+  // functions created by load default to the proxy as well
+  lua_rawseti(state, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+}
+
+lua_State* createState() {
+  lua_State* state = luaL_newstate();
+  CHECK_NOTNULL(state);
+  // Scripts have no business with files, processes, or modules
+  for (const auto& lib : {std::make_pair("_G", luaopen_base), std::make_pair(LUA_TABLIBNAME, luaopen_table),
+                          std::make_pair(LUA_STRLIBNAME, luaopen_string),
+                          std::make_pair(LUA_MATHLIBNAME, luaopen_math)}) {
+    luaL_requiref(state, lib.first, lib.second, 1);
+    lua_pop(state, 1);
+  }
+  for (const char* name : {"dofile", "loadfile"}) {
+    lua_pushnil(state);
+    lua_setglobal(state, name);
+  }
+  // Bytecode is neither produced nor accepted, and tables get no finalizers
+  lua_getglobal(state, LUA_STRLIBNAME);
+  lua_pushnil(state);
+  lua_setfield(state, -2, "dump");
+  lua_pop(state, 1);
+  for (const auto& wrapper :
+       {std::make_pair("load", loadText), std::make_pair("setmetatable", setMetatableWithoutGc)}) {
+    lua_getglobal(state, wrapper.first);
+    lua_pushcclosure(state, wrapper.second, 1);
+    lua_setglobal(state, wrapper.first);
+  }
+
+  lua_newtable(state);
+  lua_pushcfunction(state, redisCall);
+  lua_setfield(state, -2, "call");
+  lua_pushcfunction(state, redisPCall);
+  lua_setfield(state, -2, "pcall");
+  lua_pushcfunction(state, redisStatusReply);
+  lua_setfield(state, -2, "status_reply");
+  lua_pushcfunction(state, redisErrorReply);
+  lua_setfield(state, -2, "error_reply");
+  lua_setglobal(state, "redis");
+  protectGlobals(state);
+
+  lua_sethook(state, timeLimitHook, LUA_MASKCOUNT, kHookInstructionCount);
+  return state;
+}
+
+// Compile a script and save it in the registry of the given state. Return an empty string on success and the error
+// message otherwise.
+std::string compile(lua_State* state, const std::string& sha, const std::string& script) {
+  std::string chunkName = "@" + sha;
+  if (luaL_loadbuffer(state, script.data(), script.size(), chunkName.c_str()) != LUA_OK) {
+    std::string error = lua_tostring(state, -1);
+    lua_pop(state, 1);
+    return error;
+  }
+  lua_setfield(state, LUA_REGISTRYINDEX, functionName(sha).c_str());
+  return "";
+}
+
+}  // namespace
+
+std::string ScriptEngine::sha1Hex(const std::string& script) {
+  std::array<uint8_t, 20> digest;
+  folly::ssl::OpenSSLHash::sha1(folly::range(digest), folly::ByteRange(folly::StringPiece(script)));
+  return folly::hexlify(folly::ByteRange(digest.data(), digest.size()));
+}
+
+codec::RedisValue ScriptEngine::load(const std::string& script) {
+  std::string sha = sha1Hex(script);
+  std::string error = compile(threadState(), sha, script);
+  if (!error.empty()) {
+    return codec::RedisValue(codec::RedisValue::Type::kError, "Error compiling script: " + error);
+  }
+  {
+    std::lock_guard<std::mutex> guard(scriptCache().mutex);
+    scriptCache().scripts.emplace(sha, script);
+  }
+  return codec::RedisValue(codec::RedisValue::Type::kBulkString, std::move(sha));
+}
+
+bool ScriptEngine::exists(const std::string& sha) {
+  std::lock_guard<std::mutex> guard(scriptCache().mutex);
+  return scriptCache().scripts.count(boost::to_lower_copy(sha)) > 0;
+}
+
+void ScriptEngine::flush() {
+  std::lock_guard<std::mutex> guard(scriptCache().mutex);
+  scriptCache().scripts.clear();
+  scriptCache().generation++;
+}
+
+codec::RedisValue ScriptEngine::run(const std::string& sha, std::vector<std::string> keys,
+                                    std::vector<std::string> args, const CommandExecutor& executor) {
+  lua_State* state = threadState();
+  std::string sha1 = boost::to_lower_copy(sha);
+  lua_getfield(state, LUA_REGISTRYINDEX, functionName(sha1).c_str());
+  if (lua_isnil(state, -1)) {
+    lua_pop(state, 1);
+    // Cached by another thread
+    std::string script;
+    {
+      std::lock_guard<std::mutex> guard(scriptCache().mutex);
+      auto it = scriptCache().scripts.find(sha1);
+      if (it == scriptCache().scripts.end()) {
+        return codec::RedisValue(codec::RedisValue::Type::kError, "NOSCRIPT No matching script. Please use EVAL.");
+      }
+      script = it->second;
+    }
+    std::string error = compile(state, sha1, script);
+    if (!error.empty()) {
+      return codec::RedisValue(codec::RedisValue::Type::kError, "Error compiling script: " + error);
+    }
+    lua_getfield(state, LUA_REGISTRYINDEX, functionName(sha1).c_str());
+  }
+
+  // A fresh environment, which holds KEYS, ARGV, and whatever globals the script sets, replaces _ENV of the function
+  lua_newtable(state);
+  pushStringArray(state, keys);
+  lua_setfield(state, -2, "KEYS");
+  pushStringArray(state, args);
+  lua_setfield(state, -2, "ARGV");
+  lua_pushvalue(state, -1);
+  lua_setfield(state, -2, "_G");
+  lua_getfield(state, LUA_REGISTRYINDEX, kEnvMetatable);
+  lua_setmetatable(state, -2);
+  if (!lua_setupvalue(state, -2, 1)) lua_pop(state, 1);
+
+  currentExecutor = &executor;
+  deadlineMs = nowMs() + kTimeLimitMs;
+  int status = lua_pcall(state, 0, 1, 0);
+  currentExecutor = nullptr;
+
+  if (status != LUA_OK) {
+    std::string error = lua_tostring(state, -1) ? lua_tostring(state, -1) : "unknown error";
+    lua_pop(state, 1);
+    return codec::RedisValue(codec::RedisValue::Type::kError,
+                             "Error running script (call to " + functionName(sha1) + "): " + error);
+  }
+  bool tooDeep = false;
+  codec::RedisValue result = toRedisValue(state, 0, &tooDeep);
+  lua_pop(state, 1);
+  if (tooDeep) {
+    return codec::RedisValue(codec::RedisValue::Type::kError,
+                             "Error running script (call to " + functionName(sha1) + "): reply is nested too deeply");
+  }
+  return result;
+}
+
+lua_State* ScriptEngine::threadState() {
+  uint64_t generation = scriptCache().generation;
+  if (threadLuaState.state && threadLuaState.generation == generation) {
+    return threadLuaState.state;
+  }
+  if (threadLuaState.state) lua_close(threadLuaState.state);
+  threadLuaState.state = createState();
+  threadLuaState.generation = generation;
+  return threadLuaState.state;
+}
+
+constexpr int ScriptEngine::kTimeLimitMs;
+
+}  // namespace pipeline
@@ -0,0 +1,55 @@
+#ifndef PIPELINE_SCRIPTENGINE_H_
+#define PIPELINE_SCRIPTENGINE_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "codec/RedisValue.h"
+
+struct lua_State;
+
+namespace pipeline {
+
+// ScriptEngine runs Lua scripts for EVAL and EVALSHA with the same conventions as redis:
+//   * Scripts are cached process-wide by the hex sha1 of their source.
+//   * KEYS and ARGV are global tables holding the keys and the rest of the arguments.
+//   * Each run starts from the same globals. Globals set by a script are dropped when it ends, and the libraries
+//     cannot be modified.
+//   * redis.call runs a command and raises an error if the command fails, while redis.pcall returns the error as a
+//     table with an err field. redis.status_reply and redis.error_reply build the corresponding replies.
+//   * Return values convert as follows: numbers to integers, strings to bulk strings, arrays to arrays, {ok=...} to
+//     simple strings, {err=...} to errors, true to 1, and false or nil to null. Tables nested too deeply, including
+//     cyclic ones, are an error.
+// Each thread owns a Lua state, in which scripts are compiled once and reused. Only the base, table, string, and math
+// libraries are available, without bytecode loading, string.dump, or __gc finalizers. Scripts running longer than
+// kTimeLimitMs are aborted.
+class ScriptEngine {
+ public:
+  // Run a command on behalf of a script and return its reply
+  using CommandExecutor = std::function<codec::RedisValue(std::vector<std::string>&& cmd)>;
+
+  static constexpr int kTimeLimitMs = 5000;
+
+  static std::string sha1Hex(const std::string& script);
+
+  // Compile and cache a script. Return its sha1 or an error reply if it does not compile.
+  static codec::RedisValue load(const std::string& script);
+
+  static bool exists(const std::string& sha);
+
+  // Drop all cached scripts
+  static void flush();
+
+  // Run a cached script. Commands issued by the script are sent to the executor in the calling thread.
+  static codec::RedisValue run(const std::string& sha, std::vector<std::string> keys, std::vector<std::string> args,
+                               const CommandExecutor& executor);
+
+ private:
+  // Lua state of the calling thread, which is recreated after the script cache is flushed
+  static lua_State* threadState();
+};
+
+}  // namespace pipeline
+
+#endif  // PIPELINE_SCRIPTENGINE_H_
@@ -0,0 +1,167 @@
+#include <map>
+#include <string>
+#include <vector>
+
+#include "codec/RedisValue.h"
+#include "gtest/gtest.h"
+#include "pipeline/ScriptEngine.h"
+
+namespace pipeline {
+
+class ScriptEngineTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ScriptEngine::flush();
+  }
+
+  // Load and run a script against an in-memory key-value store supporting GET and SET
+  codec::RedisValue eval(const std::string& script, std::vector<std::string> keys = {},
+                         std::vector<std::string> args = {}) {
+    codec::RedisValue sha = ScriptEngine::load(script);
+    if (sha.type() == codec::RedisValue::Type::kError) return sha;
+    return ScriptEngine::run(sha.bulkString(), std::move(keys), std::move(args),
+                             [this](std::vector<std::string>&& cmd) {
+                               executed_.push_back(cmd[0]);
+                               if (cmd[0] == "get" && cmd.size() == 2) {
+                                 auto it = data_.find(cmd[1]);
+                                 if (it == data_.end()) return codec::RedisValue::nullString();
+                                 return codec::RedisValue(codec::RedisValue::Type::kBulkString,
+                                                          std::string(it->second));
+                               }
+                               if (cmd[0] == "set" && cmd.size() == 3) {
+                                 data_[cmd[1]] = cmd[2];
+                                 return codec::RedisValue(codec::RedisValue::Type::kSimpleString, "OK");
+                               }
+                               return codec::RedisValue(codec::RedisValue::Type::kError, "Unknown command");
+                             });
+  }
+
+  std::map<std::string, std::string> data_;
+  std::vector<std::string> executed_;
+};
+
+TEST_F(ScriptEngineTest, Sha1Hex) {
+  EXPECT_EQ("da39a3ee5e6b4b0d3255bfef95601890afd80709", ScriptEngine::sha1Hex(""));
+}
+
+TEST_F(ScriptEngineTest, ReturnValues) {
+  EXPECT_EQ(codec::RedisValue(1), eval("return 1"));
+  EXPECT_EQ(codec::RedisValue(3), eval("return 3.7"));
+  EXPECT_EQ(codec::RedisValue(codec::RedisValue::Type::kBulkString, "a"), eval("return 'a'"));
+  EXPECT_EQ(codec::RedisValue(1), eval("return true"));
+  EXPECT_EQ(codec::RedisValue::nullString(), eval("return false"));
+  EXPECT_EQ(codec::RedisValue(codec::RedisValue::Type::kSimpleString, "FINE"),
+            eval("return redis.status_reply('FINE')"));
+  EXPECT_EQ(codec::RedisValue(codec::RedisValue::Type::kError, "BAD"), eval("return redis.error_reply('BAD')"));
+
+  std::vector<codec::RedisValue> values;
+  values.emplace_back(codec::RedisValue::Type::kBulkString, "k");
+  values.emplace_back(codec::RedisValue::Type::kBulkString, "v");
+  EXPECT_EQ(codec::RedisValue(std::move(values)), eval("return {KEYS[1], ARGV[1], nil, 'ignored'}", {"k"}, {"v"}));
+}
+
+TEST_F(ScriptEngineTest, ReadDecideWrite) {
+  const std::string script =
+      "if redis.call('get', KEYS[1]) then return 0 end\n"
+      "redis.call('set', KEYS[1], ARGV[1])\n"
+      "return 1";
+  EXPECT_EQ(codec::RedisValue(1), eval(script, {"a"}, {"x"}));
+  EXPECT_EQ("x", data_["a"]);
+  EXPECT_EQ(codec::RedisValue(0), eval(script, {"a"}, {"y"}));
+  EXPECT_EQ("x", data_["a"]);
+  EXPECT_EQ(std::vector<std::string>({"get", "set", "get"}), executed_);
+}
+
+TEST_F(ScriptEngineTest, Errors) {
+  EXPECT_EQ(codec::RedisValue::Type::kError, eval("return (").type());
+  EXPECT_EQ(codec::RedisValue::Type::kError, eval("error('boom')").type());
+
+  // redis.call raises errors while redis.pcall returns them
+  auto result = eval("redis.call('foo'); return 1");
+  ASSERT_EQ(codec::RedisValue::Type::kError, result.type());
+  EXPECT_NE(std::string::npos, result.error().find("Unknown command"));
+  EXPECT_EQ(codec::RedisValue(codec::RedisValue::Type::kError, "Unknown command"),
+            eval("return redis.pcall('foo')"));
+
+  EXPECT_EQ(codec::RedisValue::Type::kError, eval("return redis.call({})").type());
+  EXPECT_EQ(codec::RedisValue::Type::kError, eval("return dofile('/etc/passwd')").type());
+}
+
+TEST_F(ScriptEngineTest, Sandbox) {
+  // globals do not outlive the script that sets them
+  EXPECT_EQ(codec::RedisValue(1), eval("counter = (counter or 0) + 1; return counter"));
+  EXPECT_EQ(codec::RedisValue(1), eval("counter = (counter or 0) + 1; return counter"));
+  EXPECT_EQ(codec::RedisValue(1), eval("_G.counter = (_G.counter or 0) + 1; return counter"));
+  EXPECT_EQ(codec::RedisValue::Type::kError, eval("load('counter = 1')()").type());
+  EXPECT_EQ(codec::RedisValue::nullString(), eval("return counter"));
+
+  // neither do changes to the libraries
+  EXPECT_EQ(codec::RedisValue::Type::kError, eval("string.rep = nil").type());
+  EXPECT_EQ(codec::RedisValue::Type::kError, eval("redis.call = function() return 0 end").type());
+  EXPECT_EQ(codec::RedisValue::Type::kError, eval("getmetatable('').__index.rep = nil").type());
+  EXPECT_EQ(codec::RedisValue::Type::kError, eval("rawset(math, 'pi', 3)").type());
+  EXPECT_EQ(codec::RedisValue::Type::kError, eval("setmetatable(table, {})").type());
+  EXPECT_EQ(codec::RedisValue(codec::RedisValue::Type::kBulkString, "aa"), eval("return ('a'):rep(2)"));
+  EXPECT_EQ(codec::RedisValue(codec::RedisValue::Type::kSimpleString, "OK"),
+            eval("return redis.call('set', KEYS[1], 'v')", {"a"}));
+}
+
+TEST_F(ScriptEngineTest, Bytecode) {
+  EXPECT_EQ(codec::RedisValue(1), eval("return string.dump == nil"));
+  // load still compiles source text
+  EXPECT_EQ(codec::RedisValue(2), eval("return load('return 2')()"));
+  auto result = eval("local f, err = load('\\27Lua'); return err");
+  ASSERT_EQ(codec::RedisValue::Type::kBulkString, result.type());
+  EXPECT_NE(std::string::npos, result.bulkString().find("attempt to load a binary chunk"));
+  // even when asking for binary mode
+  result = eval("local f, err = load('\\27Lua', 'chunk', 'b'); return err");
+  ASSERT_EQ(codec::RedisValue::Type::kBulkString, result.type());
+  EXPECT_NE(std::string::npos, result.bulkString().find("attempt to load a binary chunk"));
+}
+
+TEST_F(ScriptEngineTest, Finalizers) {
+  auto result = eval("setmetatable({}, {__gc = function() redis.call('set', 'a', 'b') end}); return 1");
+  ASSERT_EQ(codec::RedisValue::Type::kError, result.type());
+  EXPECT_NE(std::string::npos, result.error().find("Finalizers are not allowed"));
+  EXPECT_EQ(codec::RedisValue(1), eval("return getmetatable(setmetatable({}, {__index = {x = 1}})).__index.x"));
+
+  // closing the state on flush runs no script code
+  ScriptEngine::flush();
+  EXPECT_EQ(codec::RedisValue(1), eval("return 1"));
+  EXPECT_TRUE(data_.empty());
+}
+
+TEST_F(ScriptEngineTest, NestedReplies) {
+  auto result = eval("local t = {} t[1] = t return t");
+  ASSERT_EQ(codec::RedisValue::Type::kError, result.type());
+  EXPECT_NE(std::string::npos, result.error().find("nested too deeply"));
+  result = eval("local t = {} for i = 1, 100000 do t = {t} end return t");
+  ASSERT_EQ(codec::RedisValue::Type::kError, result.type());
+  EXPECT_NE(std::string::npos, result.error().find("nested too deeply"));
+
+  std::vector<codec::RedisValue> inner;
+  inner.emplace_back(1);
+  std::vector<codec::RedisValue> outer;
+  outer.emplace_back(std::move(inner));
+  EXPECT_EQ(codec::RedisValue(std::move(outer)), eval("return {{1}}"));
+}
+
+TEST_F(ScriptEngineTest, Cache) {
+  codec::RedisValue sha = ScriptEngine::load("return 42");
+  ASSERT_EQ(codec::RedisValue::Type::kBulkString, sha.type());
+  EXPECT_EQ(ScriptEngine::sha1Hex("return 42"), sha.bulkString());
+  EXPECT_TRUE(ScriptEngine::exists(sha.bulkString()));
+
+  ScriptEngine::CommandExecutor executor = [](std::vector<std::string>&& cmd) {
+    return codec::RedisValue::nullString();
+  };
+  EXPECT_EQ(codec::RedisValue(42), ScriptEngine::run(sha.bulkString(), {}, {}, executor));
+
+  ScriptEngine::flush();
+  EXPECT_FALSE(ScriptEngine::exists(sha.bulkString()));
+  auto result = ScriptEngine::run(sha.bulkString(), {}, {}, executor);
+  ASSERT_EQ(codec::RedisValue::Type::kError, result.type());
+  EXPECT_EQ(0, result.error().find("NOSCRIPT"));
+}
+
+}  // namespace pipeline
@@ -5,35 +5,84 @@
 #include <utility>
 #include <vector>
 
+#include "boost/algorithm/string/case_conv.hpp"
 #include "codec/RedisValue.h"
+#include "folly/Format.h"
 #include "glog/logging.h"
+#include "pipeline/KeyspaceNotifier.h"
+#include "pipeline/ScriptEngine.h"
+#include "rocksdb/comparator.h"
 #include "rocksdb/options.h"
 #include "rocksdb/status.h"
+#include "rocksdb/utilities/write_batch_with_index.h"
 #include "rocksdb/write_batch.h"
 
 namespace pipeline {
 
+namespace {
+
+// A batch whose writes are visible to the reads of later commands in the same script or transaction
+std::unique_ptr<rocksdb::WriteBatchWithIndex> newIndexedWriteBatch() {
+  return std::unique_ptr<rocksdb::WriteBatchWithIndex>(
+      new rocksdb::WriteBatchWithIndex(rocksdb::BytewiseComparator(), 0, true));
+}
+
+}  // namespace
+
+infra::StripedLocks& TransactionalRedisHandler::keyLocks() {
+  static infra::StripedLocks* locks = new infra::StripedLocks(kKeyLockStripes);
+  return *locks;
+}
+
+bool TransactionalRedisHandler::lockKeys(int64_t key, const std::vector<std::string>& cmd,
+                                         const std::vector<std::string>& keys, infra::StripedLocks::Guard* guard,
+                                         Context* ctx) {
+  *guard = keyLocks().tryLock(keys);
+  if (guard->ownsLock()) return true;
+  if (deferCommand(key, cmd)) return false;
+  // Waiting would stall the I/O thread, and every connection on it, for as long as a script runs. Busy keys are
+  // expected under contention, so the reply is not logged like other errors.
+  write(ctx, codec::RedisMessage(key, {codec::RedisValue::Type::kError, kBusyKeysError}));
+  return false;
+}
+
+bool TransactionalRedisHandler::lockedKey(TransactionalCommandHandlerFunc handlerFunc,
+                                          const std::vector<std::string>& cmd, std::vector<std::string>* keys) {
+  // base commands do not touch data
+  if (handlerFunc == &TransactionalRedisHandler::handleNonTransactionalCommand || cmd.size() < 2) return false;
+  keys->push_back(cmd[1]);
+  return true;
+}
+
 bool TransactionalRedisHandler::handleCommandWithTransactionalHandlerTable(
     int64_t key, const std::string& cmdNameLower, const std::vector<std::string>& cmd,
     const TransactionalCommandHandlerTable& commandHandlerTable, Context* ctx) {
   // first check for MULTI/EXEC to determine transaction state transitions
   if (cmdNameLower == "multi") {
-    if (inTransaction_) {
+    if (inTransaction()) {
       // NOTE: nested MULTI is a error but it won't cancel the transaction
       writeError(key, "MULTI calls cannot be nested", ctx);
     } else {
-      inTransaction_ = true;
+      queuedCommands_.reset(new std::vector<QueuedCommand>());
       write(ctx, codec::RedisMessage(key, simpleStringOk()));
     }
   } else if (cmdNameLower == "exec") {
-    if (inTransaction_) {
+    if (inTransaction()) {
       if (errorEncountered_) {
         writeError(key, "Transaction discarded because of previous errors", ctx);
       } else {
+        std::vector<std::string> keys;
+        for (const auto& queuedCommand : *queuedCommands_) {
+          lockedKey(queuedCommand.first, queuedCommand.second, &keys);
+        }
+        infra::StripedLocks::Guard guard;
+        // a busy EXEC keeps the transaction, for its deferred run or for the client to retry
+        if (!lockKeys(key, cmd, keys, &guard, ctx)) return true;
+
         std::vector<codec::RedisValue> results;
-        rocksdb::WriteBatch writeBatch;
-        for (const auto& cmd : queuedCommands_) {
-          codec::RedisValue result = (this->*(cmd.first))(cmd.second, &writeBatch, ctx);
+        auto writeBatch = newIndexedWriteBatch();
+        for (const auto& cmd : *queuedCommands_) {
+          codec::RedisValue result = (this->*(cmd.first))(cmd.second, writeBatch.get(), ctx);
           if (result.type() == codec::RedisValue::Type::kError) {
             errorEncountered_ = true;
             break;
@@ -44,13 +93,17 @@ bool TransactionalRedisHandler::handleCommandWithTransactionalHandlerTable(
           // NOTE: standard redis protocol does not abort the transaction for runtime errors
           writeError(key, "Transaction discarded because an error was encountered during execution", ctx);
         } else {
-          writeResult(key, codec::RedisValue(std::move(results)), &writeBatch, ctx);
+          writeResult(key, codec::RedisValue(std::move(results)), writeBatch.get(), ctx);
         }
       }
     } else {
       writeError(key, "EXEC without MULTI", ctx);
     }
     resetTransactionState();
+  } else if (cmdNameLower == "eval" || cmdNameLower == "evalsha") {
+    evalCommand(key, cmdNameLower, cmd, commandHandlerTable, ctx);
+  } else if (cmdNameLower == "script") {
+    scriptCommand(key, cmd, ctx);
   } else {
     auto handlerEntry = commandHandlerTable.find(cmdNameLower);
     if (handlerEntry == commandHandlerTable.end()) {
@@ -64,31 +117,126 @@ bool TransactionalRedisHandler::handleCommandWithTransactionalHandlerTable(
       return true;
     }
 
-    if (inTransaction_) {
-      queuedCommands_.emplace_back(std::make_pair(handlerEntry->second.handlerFunc, std::move(cmd)));
+    if (inTransaction()) {
+      queuedCommands_->emplace_back(std::make_pair(handlerEntry->second.handlerFunc, std::move(cmd)));
       write(ctx, codec::RedisMessage(key, {codec::RedisValue::Type::kSimpleString, "QUEUED"}));
     } else {
       // execute it right away when it's not part of the transaction
+      auto handlerFunc = handlerEntry->second.handlerFunc;
+      std::vector<std::string> keys;
+      infra::StripedLocks::Guard guard;
+      if (lockedKey(handlerFunc, cmd, &keys) && !lockKeys(key, cmd, keys, &guard, ctx)) return true;
       rocksdb::WriteBatch writeBatch;
-      writeResult(key, (this->*(handlerEntry->second.handlerFunc))(cmd, &writeBatch, ctx), &writeBatch, ctx);
+      writeResult(key, TRACE_CALL("RedisHandler#execute", (this->*handlerFunc)(cmd, &writeBatch, ctx)), &writeBatch,
+                  ctx);
     }
   }
 
   return true;
 }
 
-void TransactionalRedisHandler::writeResult(int64_t key, codec::RedisValue result, rocksdb::WriteBatch* writeBatch,
-                                            Context* ctx) {
+void TransactionalRedisHandler::evalCommand(int64_t key, const std::string& cmdNameLower,
+                                            const std::vector<std::string>& cmd,
+                                            const TransactionalCommandHandlerTable& commandHandlerTable, Context* ctx) {
+  if (!validateArgCount(cmd, 2, -1)) {
+    errorEncountered_ = inTransaction();
+    writeError(key, folly::sformat(kWrongNumArgsTemplate, cmdNameLower), ctx);
+    return;
+  }
+  if (inTransaction()) {
+    // A script is a transaction by itself
+    errorEncountered_ = true;
+    writeError(key, folly::sformat("{} is not allowed in MULTI", cmdNameLower), ctx);
+    return;
+  }
+  int64_t numKeys = 0;
+  if (!parseInt(cmd[2], &numKeys) || numKeys < 0) {
+    writeError(key, "Number of keys can't be negative or non-integer", ctx);
+    return;
+  }
+  if (numKeys > static_cast<int64_t>(cmd.size()) - 3) {
+    writeError(key, "Number of keys can't be greater than number of args", ctx);
+    return;
+  }
+
+  std::vector<std::string> keys(cmd.begin() + 3, cmd.begin() + 3 + numKeys);
+  std::vector<std::string> args(cmd.begin() + 3 + numKeys, cmd.end());
+  // The script runs alone on its keys from its first read to its commit. Like redis, scripts are expected to touch
+  // only the keys they declare.
+  infra::StripedLocks::Guard guard;
+  if (!lockKeys(key, cmd, keys, &guard, ctx)) return;
+
+  std::string sha;
+  if (cmdNameLower == "eval") {
+    codec::RedisValue loaded = ScriptEngine::load(cmd[1]);
+    if (loaded.type() == codec::RedisValue::Type::kError) {
+      write(ctx, codec::RedisMessage(key, std::move(loaded)));
+      return;
+    }
+    sha = loaded.bulkString();
+  } else {
+    sha = cmd[1];
+  }
+
+  // Commands issued by the script share a single write batch, which is committed only if the script succeeds
+  auto writeBatch = newIndexedWriteBatch();
+  auto executor = [this, &commandHandlerTable, &writeBatch, ctx](std::vector<std::string>&& scriptCmd) {
+    std::string scriptCmdNameLower = boost::to_lower_copy(scriptCmd[0]);
+    auto handlerEntry = commandHandlerTable.find(scriptCmdNameLower);
+    if (handlerEntry == commandHandlerTable.end()) {
+      return codec::RedisValue(codec::RedisValue::Type::kError,
+                               folly::sformat("Unknown command called from script: '{}'", scriptCmdNameLower));
+    }
+    if (!validateArgCount(scriptCmd, handlerEntry->second.minArgs, handlerEntry->second.maxArgs)) {
+      return codec::RedisValue(codec::RedisValue::Type::kError,
+                               folly::sformat(kWrongNumArgsTemplate, scriptCmdNameLower));
+    }
+    return (this->*(handlerEntry->second.handlerFunc))(scriptCmd, writeBatch.get(), ctx);
+  };
+
+  codec::RedisValue result = ScriptEngine::run(sha, std::move(keys), std::move(args), executor);
+  if (result.type() == codec::RedisValue::Type::kError) {
+    write(ctx, codec::RedisMessage(key, std::move(result)));
+  } else {
+    writeResult(key, std::move(result), writeBatch.get(), ctx);
+  }
+}
+
+void TransactionalRedisHandler::scriptCommand(int64_t key, const std::vector<std::string>& cmd, Context* ctx) {
+  std::string subCommand = cmd.size() >= 2 ? boost::to_lower_copy(cmd[1]) : "";
+  if (subCommand == "load" && cmd.size() == 3) {
+    write(ctx, codec::RedisMessage(key, ScriptEngine::load(cmd[2])));
+  } else if (subCommand == "exists" && cmd.size() >= 3) {
+    std::vector<codec::RedisValue> results;
+    for (size_t i = 2; i < cmd.size(); i++) {
+      results.emplace_back(static_cast<codec::RedisValue::IntType>(ScriptEngine::exists(cmd[i]) ? 1 : 0));
+    }
+    write(ctx, codec::RedisMessage(key, codec::RedisValue(std::move(results))));
+  } else if (subCommand == "flush" && cmd.size() == 2) {
+    ScriptEngine::flush();
+    write(ctx, codec::RedisMessage(key, simpleStringOk()));
+  } else {
+    writeError(key, "Unknown SCRIPT subcommand or wrong number of arguments", ctx);
+  }
+}
+
+void TransactionalRedisHandler::writeResult(int64_t key, codec::RedisValue result,
+                                            rocksdb::WriteBatchBase* writeBatchBase, Context* ctx) {
+  rocksdb::WriteBatch* writeBatch = writeBatchBase->GetWriteBatch();
   if (writeBatch->Count() > 0) {
     // commit updates first
-    rocksdb::Status status = db()->Write(rocksdb::WriteOptions(), writeBatch);
+    rocksdb::Status status = TRACE_CALL("RocksDB#write", db()->Write(rocksdb::WriteOptions(), writeBatch));
     if (!status.ok()) {
       writeError(key, folly::sformat("RocksDB error: {}", status.ToString()), ctx);
       return;
     }
+    KeyspaceNotifier::instance()->publishWriteBatch(writeBatch);
   }
   // no updates or updates committed successfully, write the result back
   write(ctx, codec::RedisMessage(key, std::move(result)));
 }
 
+constexpr size_t TransactionalRedisHandler::kKeyLockStripes;
+constexpr const char* TransactionalRedisHandler::kBusyKeysError;
+
 }  // namespace pipeline
@@ -9,17 +9,24 @@
 #include <vector>
 
 #include "boost/algorithm/string/case_conv.hpp"
-#include "rocksdb/write_batch.h"
+#include "infra/StripedLocks.h"
 #include "pipeline/RedisHandler.h"
+#include "rocksdb/utilities/write_batch_with_index.h"
+#include "rocksdb/write_batch_base.h"
 
 namespace pipeline {
 
-// A redis handler that supports transactions
+// A redis handler that supports transactions with MULTI/EXEC, as well as Lua scripts with EVAL/EVALSHA.
+// Commands lock the stripes of their key, cmd[1], while they run, and scripts and transactions lock all of their keys
+// for their whole run, so commands of this handler never interleave with a script or transaction on the same keys.
+// When the keys are busy, a command running in a FairScheduler turn is deferred to a later turn; otherwise it fails
+// with a BUSY error the client can retry. Neither blocks the I/O thread. Writes by the Kafka consumers do not take
+// these locks.
 class TransactionalRedisHandler : public RedisHandler {
  public:
   TransactionalRedisHandler(std::shared_ptr<DatabaseManager> databaseManager,
                             std::shared_ptr<infra::kafka::ConsumerHelper> consumerHelper)
-      : RedisHandler(databaseManager, consumerHelper), inTransaction_(false), errorEncountered_(false) {}
+      : RedisHandler(databaseManager, consumerHelper), errorEncountered_(false) {}
 
   explicit TransactionalRedisHandler(std::shared_ptr<DatabaseManager> databaseManager)
       : TransactionalRedisHandler(databaseManager, nullptr) {}
@@ -30,9 +37,13 @@ class TransactionalRedisHandler : public RedisHandler {
                                                       ctx);
   }
 
+  bool isControlCommand(const std::string& cmdNameLower) const override {
+    return isControlCommandInTable(getTransactionalCommandHandlerTable(), cmdNameLower);
+  }
+
  protected:
   using TransactionalCommandHandlerFunc = codec::RedisValue (TransactionalRedisHandler::*)(
-      const std::vector<std::string>& cmd, rocksdb::WriteBatch* writeBatch, Context* ctx);
+      const std::vector<std::string>& cmd, rocksdb::WriteBatchBase* writeBatch, Context* ctx);
   using TransactionalCommandHandlerTable = GenericCommandHandlerTable<TransactionalCommandHandlerFunc>;
 
   // Command handlers inherited from the base, non-transactional redis handler
@@ -49,7 +60,7 @@ class TransactionalRedisHandler : public RedisHandler {
     for (const auto& handlerEntry : baseCommandHandlerTable()) {
       baseTable.insert({handlerEntry.first,
                         {&TransactionalRedisHandler::handleNonTransactionalCommand, handlerEntry.second.minArgs,
-                         handlerEntry.second.maxArgs}});
+                         handlerEntry.second.maxArgs, handlerEntry.second.control}});
     }
 
     baseTable.insert(newTable.begin(), newTable.end());
@@ -63,29 +74,71 @@ class TransactionalRedisHandler : public RedisHandler {
 
   virtual const TransactionalCommandHandlerTable& getTransactionalCommandHandlerTable() const = 0;
 
-  codec::RedisValue handleNonTransactionalCommand(const std::vector<std::string>& cmd, rocksdb::WriteBatch* writeBatch,
-                                                  Context* ctx) {
+  codec::RedisValue handleNonTransactionalCommand(const std::vector<std::string>& cmd,
+                                                  rocksdb::WriteBatchBase* writeBatch, Context* ctx) {
     auto handlerEntry = baseCommandHandlerTable().find(boost::to_lower_copy(cmd[0]));
     return (this->*(handlerEntry->second.handlerFunc))(cmd, ctx);
   }
 
+  // Read a key as seen by the given write batch. Scripts and transactions run with a WriteBatchWithIndex, so that their
+  // commands read the writes of earlier ones; other batches are not consulted.
+  rocksdb::Status getFromBatchAndDb(rocksdb::WriteBatchBase* writeBatch, rocksdb::ColumnFamilyHandle* columnFamily,
+                                    const rocksdb::Slice& key, std::string* value) {
+    auto indexedBatch = dynamic_cast<rocksdb::WriteBatchWithIndex*>(writeBatch);
+    if (indexedBatch && indexedBatch->GetWriteBatch()->Count() > 0) {
+      return TRACE_CALL("RocksDB#get",
+                        indexedBatch->GetFromBatchAndDB(db(), rocksdb::ReadOptions(), columnFamily, key, value));
+    }
+    return TRACE_CALL("RocksDB#get", db()->Get(rocksdb::ReadOptions(), columnFamily, key, value));
+  }
+
   const CommandHandlerTable& getCommandHandlerTable() const override {
     throw std::logic_error("Not supported by TransactionalCommandHandler");
   }
 
+  size_t handlerBytes() const override {
+    size_t bytes = sizeof(TransactionalRedisHandler);
+    if (queuedCommands_) bytes += sizeof(*queuedCommands_) + queuedCommands_->capacity() * sizeof(QueuedCommand);
+    return bytes;
+  }
+
+  bool inTransaction() const { return queuedCommands_ != nullptr; }
+
   void resetTransactionState() {
-    inTransaction_ = false;
     errorEncountered_ = false;
-    queuedCommands_.clear();
+    queuedCommands_.reset();
   }
 
  private:
-  void writeResult(int64_t key, codec::RedisValue result, rocksdb::WriteBatch* writeBatch, Context* ctx);
+  // Shared by all connections. Stripes are held only while a command, script, or transaction runs.
+  static constexpr size_t kKeyLockStripes = 1024;
+  static constexpr const char* kBusyKeysError = "BUSY Keys are in use by a script or transaction, try again";
+
+  static infra::StripedLocks& keyLocks();
+
+  // EVAL script numkeys [key ...] [arg ...] and EVALSHA sha1 numkeys [key ...] [arg ...]
+  // Scripts call commands from the given command handler table with redis.call and redis.pcall
+  void evalCommand(int64_t key, const std::string& cmdNameLower, const std::vector<std::string>& cmd,
+                   const TransactionalCommandHandlerTable& commandHandlerTable, Context* ctx);
+  // SCRIPT LOAD script, SCRIPT EXISTS sha1 [sha1 ...], and SCRIPT FLUSH
+  void scriptCommand(int64_t key, const std::vector<std::string>& cmd, Context* ctx);
+
+  // Append the key a command locks, if any, and return whether it has one
+  static bool lockedKey(TransactionalCommandHandlerFunc handlerFunc, const std::vector<std::string>& cmd,
+                        std::vector<std::string>* keys);
+  // Lock the stripes of the given keys. Return false if they are busy, in which case the command has been deferred or
+  // answered with kBusyKeysError, and the caller must return without replying.
+  bool lockKeys(int64_t key, const std::vector<std::string>& cmd, const std::vector<std::string>& keys,
+                infra::StripedLocks::Guard* guard, Context* ctx);
+
+  void writeResult(int64_t key, codec::RedisValue result, rocksdb::WriteBatchBase* writeBatch, Context* ctx);
 
-  bool inTransaction_;
-  bool errorEncountered_;
   // each command consists of a pair of TransactionalCommandHandlerFunc and a string vector
-  std::vector<std::pair<TransactionalCommandHandlerFunc, std::vector<std::string>>> queuedCommands_;
+  using QueuedCommand = std::pair<TransactionalCommandHandlerFunc, std::vector<std::string>>;
+
+  bool errorEncountered_;
+  // Only allocated between MULTI and EXEC, so that connections outside a transaction do not pay for it
+  std::unique_ptr<std::vector<QueuedCommand>> queuedCommands_;
 };
 
 }  // namespace pipeline
@@ -0,0 +1,198 @@
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "boost/algorithm/string/case_conv.hpp"
+#include "codec/RedisValue.h"
+#include "folly/futures/Future.h"
+#include "gtest/gtest.h"
+#include "pipeline/DatabaseManager.h"
+#include "pipeline/ScriptEngine.h"
+#include "pipeline/TransactionalRedisHandler.h"
+#include "rocksdb/status.h"
+#include "stesting/TestWithRocksDb.h"
+
+namespace pipeline {
+
+// GET and SET on the default column family, plus BLOCK, which calls onBlock. Replies are kept in replies instead of
+// being written to a connection.
+class KeyValueRedisHandler : public TransactionalRedisHandler {
+ public:
+  explicit KeyValueRedisHandler(std::shared_ptr<DatabaseManager> databaseManager)
+      : TransactionalRedisHandler(databaseManager) {}
+
+  folly::Future<folly::Unit> write(Context* ctx, codec::RedisMessage msg) override {
+    replies.push_back(std::move(msg.val));
+    return folly::makeFuture();
+  }
+
+  // Run a command and return its reply
+  codec::RedisValue run(const std::vector<std::string>& cmd) {
+    replies.clear();
+    EXPECT_TRUE(handleCommand(0, boost::to_lower_copy(cmd[0]), cmd, nullptr));
+    EXPECT_EQ(1, replies.size());
+    return replies.empty() ? codec::RedisValue() : replies.back();
+  }
+
+  std::vector<codec::RedisValue> replies;
+  std::function<void()> onBlock;
+
+ protected:
+  const TransactionalCommandHandlerTable& getTransactionalCommandHandlerTable() const override {
+    static const TransactionalCommandHandlerTable commandHandlerTable(mergeWithDefaultTransactionalCommandHandlerTable({
+        {"block", {static_cast<TransactionalCommandHandlerFunc>(&KeyValueRedisHandler::blockCommand), 0, 0}},
+        {"get", {static_cast<TransactionalCommandHandlerFunc>(&KeyValueRedisHandler::getCommand), 1, 1}},
+        {"set", {static_cast<TransactionalCommandHandlerFunc>(&KeyValueRedisHandler::setCommand), 2, 2}},
+    }));
+    return commandHandlerTable;
+  }
+
+ private:
+  codec::RedisValue blockCommand(const std::vector<std::string>& cmd, rocksdb::WriteBatchBase* writeBatch,
+                                 Context* ctx) {
+    onBlock();
+    return simpleStringOk();
+  }
+
+  codec::RedisValue getCommand(const std::vector<std::string>& cmd, rocksdb::WriteBatchBase* writeBatch,
+                               Context* ctx) {
+    std::string value;
+    rocksdb::Status status = getFromBatchAndDb(writeBatch, db()->DefaultColumnFamily(), cmd[1], &value);
+    if (status.IsNotFound()) return codec::RedisValue::nullString();
+    if (!status.ok()) return errorResp(status.ToString());
+    return codec::RedisValue(codec::RedisValue::Type::kBulkString, std::move(value));
+  }
+
+  codec::RedisValue setCommand(const std::vector<std::string>& cmd, rocksdb::WriteBatchBase* writeBatch,
+                               Context* ctx) {
+    writeBatch->Put(cmd[1], cmd[2]);
+    return simpleStringOk();
+  }
+};
+
+class TransactionalRedisHandlerTest : public stesting::TestWithRocksDb {
+ protected:
+  void SetUp() override {
+    stesting::TestWithRocksDb::SetUp();
+    ScriptEngine::flush();
+  }
+
+  std::string get(const std::string& key) {
+    std::string value;
+    rocksdb::Status status = db()->Get(rocksdb::ReadOptions(), key, &value);
+    return status.ok() ? value : "";
+  }
+
+  static codec::RedisValue bulkString(std::string value) {
+    return codec::RedisValue(codec::RedisValue::Type::kBulkString, std::move(value));
+  }
+};
+
+TEST_F(TransactionalRedisHandlerTest, ScriptReadsItsOwnWrites) {
+  KeyValueRedisHandler handler(databaseManager());
+  const std::string script =
+      "redis.call('set', KEYS[1], ARGV[1])\n"
+      "redis.call('set', KEYS[1], redis.call('get', KEYS[1]) .. ARGV[1])\n"
+      "return redis.call('get', KEYS[1])";
+  EXPECT_EQ(bulkString("xx"), handler.run({"eval", script, "1", "a", "x"}));
+  EXPECT_EQ("xx", get("a"));
+
+  // nothing is committed when the script fails
+  EXPECT_EQ(codec::RedisValue::Type::kError,
+            handler.run({"eval", "redis.call('set', KEYS[1], 'y'); error('boom')", "1", "a"}).type());
+  EXPECT_EQ("xx", get("a"));
+}
+
+TEST_F(TransactionalRedisHandlerTest, TransactionReadsItsOwnWrites) {
+  KeyValueRedisHandler handler(databaseManager());
+  EXPECT_EQ(codec::RedisValue(codec::RedisValue::Type::kSimpleString, "OK"), handler.run({"multi"}));
+  EXPECT_EQ(codec::RedisValue(codec::RedisValue::Type::kSimpleString, "QUEUED"), handler.run({"set", "a", "1"}));
+  EXPECT_EQ(codec::RedisValue(codec::RedisValue::Type::kSimpleString, "QUEUED"), handler.run({"get", "a"}));
+  EXPECT_EQ("", get("a"));
+
+  std::vector<codec::RedisValue> results;
+  results.push_back(codec::RedisValue(codec::RedisValue::Type::kSimpleString, "OK"));
+  results.push_back(bulkString("1"));
+  EXPECT_EQ(codec::RedisValue(std::move(results)), handler.run({"exec"}));
+  EXPECT_EQ("1", get("a"));
+}
+
+TEST_F(TransactionalRedisHandlerTest, ConcurrentScripts) {
+  const std::string script =
+      "local value = tonumber(redis.call('get', KEYS[1]) or '0')\n"
+      "redis.call('set', KEYS[1], tostring(value + 1))\n"
+      "return value + 1";
+  constexpr int kThreads = 4;
+  constexpr int kScriptsPerThread = 200;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([this, &script]() {
+      KeyValueRedisHandler handler(databaseManager());
+      for (int i = 0; i < kScriptsPerThread;) {
+        codec::RedisValue reply = handler.run({"eval", script, "1", "counter"});
+        if (reply.type() == codec::RedisValue::Type::kInteger) {
+          i++;
+        } else {
+          // the key is locked by another thread's script, so try again
+          ASSERT_EQ(codec::RedisValue::Type::kError, reply.type());
+          ASSERT_EQ(0u, reply.error().find("BUSY "));
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  // no increment is lost to an interleaved read
+  EXPECT_EQ(std::to_string(kThreads * kScriptsPerThread), get("counter"));
+}
+
+TEST_F(TransactionalRedisHandlerTest, BusyKeysDeferOrFailCommands) {
+  std::promise<void> blocked;
+  std::promise<void> release;
+  std::shared_future<void> released(release.get_future());
+  KeyValueRedisHandler holder(databaseManager());
+  holder.onBlock = [&blocked, released]() {
+    blocked.set_value();
+    released.wait();
+  };
+  std::thread thread([&holder]() {
+    holder.run({"eval", "redis.call('block'); return redis.call('set', KEYS[1], 'script')", "1", "a"});
+  });
+  blocked.get_future().wait();
+
+  // in a scheduler turn, a command waiting for the script's key hands itself back instead of blocking
+  KeyValueRedisHandler handler(databaseManager());
+  const std::vector<std::string> cmd{"set", "a", "command"};
+  {
+    RedisHandler::DeferralScope scope;
+    EXPECT_TRUE(handler.handleCommand(7, "set", cmd, nullptr));
+    ASSERT_TRUE(scope.deferred != nullptr);
+    EXPECT_EQ(7, scope.deferred->key);
+    EXPECT_EQ(codec::RedisValue(std::vector<std::string>(cmd)), scope.deferred->val);
+    EXPECT_TRUE(handler.replies.empty());
+  }
+
+  // without a scheduler, it fails with an error the client can retry instead of blocking the I/O thread
+  codec::RedisValue busy = handler.run(cmd);
+  ASSERT_EQ(codec::RedisValue::Type::kError, busy.type());
+  EXPECT_EQ(0u, busy.error().find("BUSY "));
+  // a busy EXEC keeps the transaction for the retry
+  KeyValueRedisHandler transaction(databaseManager());
+  EXPECT_EQ(codec::RedisValue(codec::RedisValue::Type::kSimpleString, "OK"), transaction.run({"multi"}));
+  EXPECT_EQ(codec::RedisValue(codec::RedisValue::Type::kSimpleString, "QUEUED"), transaction.run({"get", "a"}));
+  EXPECT_EQ(codec::RedisValue::Type::kError, transaction.run({"exec"}).type());
+
+  release.set_value();
+  thread.join();
+  EXPECT_EQ("script", get("a"));
+  std::vector<codec::RedisValue> results;
+  results.push_back(bulkString("script"));
+  EXPECT_EQ(codec::RedisValue(std::move(results)), transaction.run({"exec"}));
+  EXPECT_EQ(codec::RedisValue(codec::RedisValue::Type::kSimpleString, "OK"), handler.run(cmd));
+  EXPECT_EQ("command", get("a"));
+}
+
+}  // namespace pipeline
@@ -0,0 +1,86 @@
+// Compare request latency of a running RedisPipeline server over loopback TCP and over a unix domain socket.
+// Start the server with both --port and --unix_socket_path, then run e.g.
+//   unix_socket_benchmark --port=9049 --unix_socket_path=/tmp/smyte.sock --pipeline_depth=16
+// Each round trip sends `pipeline_depth` GET commands before reading all replies, and the latency of the whole round
+// trip is recorded.
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "folly/Format.h"
+#include "folly/init/Init.h"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "hiredis/hiredis.h"
+
+DEFINE_string(host, "localhost", "Server host for the TCP benchmark");
+DEFINE_int32(port, 9049, "Server port for the TCP benchmark");
+DEFINE_string(unix_socket_path, "", "Server unix socket path for the UDS benchmark");
+DEFINE_string(key, "benchmark-key", "Key used by the GET commands");
+DEFINE_int32(pipeline_depth, 16, "Number of GET commands sent before reading replies");
+DEFINE_int32(round_trips, 100000, "Number of pipelined round trips to measure");
+DEFINE_int32(warmup_round_trips, 1000, "Number of round trips to run before measuring");
+
+namespace {
+
+using RedisContextPtr = std::unique_ptr<redisContext, void (*)(redisContext*)>;
+
+void pipelinedGets(redisContext* context) {
+  for (int i = 0; i < FLAGS_pipeline_depth; i++) {
+    CHECK_EQ(redisAppendCommand(context, "GET %b", FLAGS_key.data(), FLAGS_key.size()), REDIS_OK);
+  }
+  for (int i = 0; i < FLAGS_pipeline_depth; i++) {
+    void* reply = nullptr;
+    CHECK_EQ(redisGetReply(context, &reply), REDIS_OK) << "Reading reply failed: " << context->errstr;
+    freeReplyObject(reply);
+  }
+}
+
+void runBenchmark(const std::string& name, RedisContextPtr context) {
+  CHECK(context && !context->err) << "Connecting for " << name << " failed: "
+                                  << (context ? context->errstr : "cannot allocate context");
+
+  for (int i = 0; i < FLAGS_warmup_round_trips; i++) {
+    pipelinedGets(context.get());
+  }
+
+  std::vector<int64_t> latenciesUs;
+  latenciesUs.reserve(FLAGS_round_trips);
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < FLAGS_round_trips; i++) {
+    auto start = std::chrono::steady_clock::now();
+    pipelinedGets(context.get());
+    latenciesUs.push_back(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+  }
+  double elapsedSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+  std::sort(latenciesUs.begin(), latenciesUs.end());
+  auto percentile = [&latenciesUs](double p) {
+    return latenciesUs[std::min(latenciesUs.size() - 1, static_cast<size_t>(p * latenciesUs.size()))];
+  };
+  LOG(INFO) << folly::sformat("{}: {:.0f} commands/s, round trip latency (us) p50={} p90={} p99={} p999={} max={}",
+                              name, FLAGS_round_trips * FLAGS_pipeline_depth / elapsedSec, percentile(0.5),
+                              percentile(0.9), percentile(0.99), percentile(0.999), latenciesUs.back());
+}
+
+}  // namespace
+
+DECLARE_bool(logtostderr);
+int main(int argc, char** argv) {
+  FLAGS_logtostderr = true;
+  folly::init(&argc, &argv);
+  CHECK_GT(FLAGS_pipeline_depth, 0);
+  CHECK_GT(FLAGS_round_trips, 0);
+
+  runBenchmark(folly::sformat("tcp {}:{}", FLAGS_host, FLAGS_port),
+               RedisContextPtr(redisConnect(FLAGS_host.c_str(), FLAGS_port), redisFree));
+  if (!FLAGS_unix_socket_path.empty()) {
+    runBenchmark(folly::sformat("uds {}", FLAGS_unix_socket_path),
+                 RedisContextPtr(redisConnectUnix(FLAGS_unix_socket_path.c_str()), redisFree));
+  }
+  return 0;
+}
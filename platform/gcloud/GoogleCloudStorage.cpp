@@ -1,5 +1,6 @@
 #include "platform/gcloud/GoogleCloudStorage.h"
 
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -13,7 +14,9 @@ namespace platform {
 namespace gcloud {
 
 using google_storage_api::Object;
+using google_storage_api::Objects;
 using google_storage_api::ObjectsResource_GetMethod;
+using google_storage_api::ObjectsResource_ListMethod;
 using googleapis::client::DataReader;
 using googleapis::client::HttpRequest;
 using googleapis::util::Status;
@@ -55,6 +58,30 @@ Status GoogleCloudStorage::downloadObject(const std::string& bucketName, const s
   }
 }
 
+Status GoogleCloudStorage::listObjects(const std::string& bucketName, const std::string& prefix,
+                                       const std::function<void(const Object& object)>& callback) {
+  Status status = authenticate();
+  if (!status.ok()) return status;
+
+  const auto& objectsResource = storageService_->get_objects();
+  std::string pageToken;
+  do {
+    auto list =
+        std::unique_ptr<ObjectsResource_ListMethod>(objectsResource.NewListMethod(&credential_, bucketName));
+    list->set_prefix(prefix);
+    if (!pageToken.empty()) list->set_page_token(pageToken);
+    auto objects = std::unique_ptr<Objects>(Objects::New());
+    status = list->ExecuteAndParseResponse(objects.get());
+    if (!status.ok()) return status;
+    for (const Object& object : objects->get_items()) {
+      callback(object);
+    }
+    const auto nextPageToken = objects->get_next_page_token();
+    pageToken.assign(nextPageToken.data(), nextPageToken.size());
+  } while (!pageToken.empty());
+  return googleapis::client::StatusOk();
+}
+
 Status GoogleCloudStorage::authenticate(void) {
   if (!credential_.access_token().empty() &&
       nowSec() + kCredentialExpirationMarginSec < credential_.expiration_timestamp_secs()) {
@@ -2,6 +2,7 @@
 #define PLATFORM_GCLOUD_GOOGLECLOUDSTORAGE_H_
 
 #include <chrono>
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -34,13 +35,19 @@ class GoogleCloudStorage {
     storageService_.reset(new google_storage_api::StorageService(httpConfig_->NewDefaultTransportOrDie()));
   }
 
+  virtual ~GoogleCloudStorage() {}
 
   // Get object metadata from GCS
-  googleapis::util::Status getObject(const std::string& bucketName, const std::string& objectName,
-                                     google_storage_api::Object* object);
+  virtual googleapis::util::Status getObject(const std::string& bucketName, const std::string& objectName,
+                                             google_storage_api::Object* object);
   // Download an object data from GCS to the given destination
-  googleapis::util::Status downloadObject(const std::string& bucketName, const std::string& objectName,
-                                          const std::string& downloadPath, google_storage_api::Object* object);
+  virtual googleapis::util::Status downloadObject(const std::string& bucketName, const std::string& objectName,
+                                                  const std::string& downloadPath, google_storage_api::Object* object);
+  // Call callback with the metadata of every object whose name starts with prefix, in lexicographic order of names.
+  // Objects are listed a page at a time, so one request covers up to a thousand of them.
+  virtual googleapis::util::Status listObjects(
+      const std::string& bucketName, const std::string& prefix,
+      const std::function<void(const google_storage_api::Object& object)>& callback);
 
  private:
   static constexpr int64_t kCredentialExpirationMarginSec = 30;
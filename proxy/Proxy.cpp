@@ -0,0 +1,47 @@
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "client/RedisClient.h"
+#include "folly/dynamic.h"
+#include "folly/json.h"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "pipeline/RedisHandler.h"
+#include "pipeline/RedisPipelineBootstrap.h"
+#include "proxy/ProxyRedisHandler.h"
+#include "proxy/ShardRouter.h"
+
+// Shard map of the upstream nodes. See ShardRouter::createFromJson for the format.
+DEFINE_string(proxy_shard_map, "", "JSON shard map of upstream nodes");
+DEFINE_int32(proxy_connections_per_node, 2, "Pipelined connections from each I/O thread to each upstream node");
+DEFINE_int32(proxy_connect_timeout_ms, 1000, "Timeout in milliseconds for connecting to upstream nodes");
+
+namespace proxy {
+
+static std::shared_ptr<pipeline::RedisHandler> createProxyRedisHandler(pipeline::RedisPipelineBootstrap* bootstrap) {
+  folly::dynamic shardMap = folly::dynamic::object;
+  try {
+    shardMap = folly::parseJson(FLAGS_proxy_shard_map);
+  } catch (const std::exception& e) {
+    LOG(FATAL) << "--proxy_shard_map must be valid JSON: " << e.what();
+  }
+
+  client::RedisClient::Options options;
+  options.poolSize = FLAGS_proxy_connections_per_node;
+  options.connectTimeout = std::chrono::milliseconds(FLAGS_proxy_connect_timeout_ms);
+  auto router = std::make_shared<ShardRouter>(ShardRouter::createFromJson(shardMap));
+  LOG(INFO) << "Proxying " << router->shardCount() << " shards on " << router->nodes().size() << " nodes";
+  return std::make_shared<ProxyRedisHandler>(router, options);
+}
+
+static pipeline::RedisPipelineBootstrap::Config createConfig() {
+  pipeline::RedisPipelineBootstrap::Config config(&createProxyRedisHandler);
+  // The proxy is stateless and all data lives on the upstream nodes
+  config.useRocksDb = false;
+  return config;
+}
+
+static auto redisPipelineBootstrap = pipeline::RedisPipelineBootstrap::create(createConfig());
+
+}  // namespace proxy
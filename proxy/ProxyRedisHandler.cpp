@@ -0,0 +1,214 @@
+#include "proxy/ProxyRedisHandler.h"
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "folly/Format.h"
+#include "folly/futures/Future.h"
+#include "glog/logging.h"
+
+namespace proxy {
+
+ProxyRedisHandler::ProxyRedisHandler(std::shared_ptr<ShardRouter> router, client::RedisClient::Options clientOptions)
+    : AsyncRedisHandler(nullptr),
+      router_(std::move(router)),
+      clientOptions_(clientOptions),
+      nodeAddresses_(),
+      clients_(),
+      forwardedCount_(0),
+      fanOutCount_(0),
+      upstreamErrorCount_(0) {
+  for (const auto& node : router_->nodes()) {
+    folly::SocketAddress address;
+    try {
+      address.setFromHostPort(node.address);
+    } catch (const std::exception& e) {
+      LOG(FATAL) << "Invalid node address " << node.address << ": " << e.what();
+    }
+    nodeAddresses_.push_back(address);
+  }
+}
+
+bool ProxyRedisHandler::handleCommand(int64_t key, const std::string& cmdNameLower,
+                                      const std::vector<std::string>& cmd, Context* ctx) {
+  if (AsyncRedisHandler::handleCommand(key, cmdNameLower, cmd, ctx)) return true;
+  // Commands without arguments have no key to route by
+  if (cmd.size() < 2) return false;
+
+  forward(key, cmd, ctx);
+  return true;
+}
+
+codec::RedisValue ProxyRedisHandler::mgetCommand(int64_t key, const std::vector<std::string>& cmd, Context* ctx) {
+  reply(key, mget(cmd, ctx->getTransport()->getEventBase()), ctx);
+  return codec::RedisValue::asyncResult();
+}
+
+codec::RedisValue ProxyRedisHandler::msetCommand(int64_t key, const std::vector<std::string>& cmd, Context* ctx) {
+  if ((cmd.size() - 1) % 2 != 0) {
+    return codec::RedisValue(codec::RedisValue::Type::kError, folly::sformat(kWrongNumArgsTemplate, "mset"));
+  }
+  reply(key, mset(cmd, ctx->getTransport()->getEventBase()), ctx);
+  return codec::RedisValue::asyncResult();
+}
+
+codec::RedisValue ProxyRedisHandler::sumIntegersCommand(int64_t key, const std::vector<std::string>& cmd,
+                                                        Context* ctx) {
+  reply(key, sumIntegers(cmd, ctx->getTransport()->getEventBase()), ctx);
+  return codec::RedisValue::asyncResult();
+}
+
+folly::Future<codec::RedisValue> ProxyRedisHandler::mget(const std::vector<std::string>& cmd,
+                                                         folly::EventBase* evb) {
+  size_t keyCount = cmd.size() - 1;
+  return fanOut(splitByNode(cmd, 1),
+                [keyCount](const std::vector<SubCommand>& subCommands, std::vector<codec::RedisValue>&& replies) {
+                  std::vector<codec::RedisValue> values(keyCount);
+                  for (size_t i = 0; i < subCommands.size(); i++) {
+                    const auto& positions = subCommands[i].positions;
+                    const auto& reply = replies[i];
+                    if (reply.type() != codec::RedisValue::Type::kArray ||
+                        reply.array().size() != positions.size()) {
+                      return codec::RedisValue(codec::RedisValue::Type::kError,
+                                               "Unexpected MGET reply from upstream");
+                    }
+                    for (size_t j = 0; j < positions.size(); j++) {
+                      values[positions[j]] = reply.array()[j];
+                    }
+                  }
+                  return codec::RedisValue(std::move(values));
+                },
+                evb);
+}
+
+folly::Future<codec::RedisValue> ProxyRedisHandler::mset(const std::vector<std::string>& cmd,
+                                                         folly::EventBase* evb) {
+  // NOTE: unlike a single redis server, MSET across nodes is not atomic. Some keys may be set when others fail.
+  return fanOut(splitByNode(cmd, 2),
+                [](const std::vector<SubCommand>& subCommands, std::vector<codec::RedisValue>&& replies) {
+                  return simpleStringOk();
+                },
+                evb);
+}
+
+folly::Future<codec::RedisValue> ProxyRedisHandler::sumIntegers(const std::vector<std::string>& cmd,
+                                                                folly::EventBase* evb) {
+  return fanOut(splitByNode(cmd, 1),
+                [](const std::vector<SubCommand>& subCommands, std::vector<codec::RedisValue>&& replies) {
+                  codec::RedisValue::IntType sum = 0;
+                  for (const auto& reply : replies) {
+                    if (reply.type() != codec::RedisValue::Type::kInteger) {
+                      return codec::RedisValue(codec::RedisValue::Type::kError,
+                                               "Unexpected integer reply from upstream");
+                    }
+                    sum += reply.integer();
+                  }
+                  return codec::RedisValue(sum);
+                },
+                evb);
+}
+
+std::vector<ProxyRedisHandler::SubCommand> ProxyRedisHandler::splitByNode(const std::vector<std::string>& cmd,
+                                                                          size_t argsPerKey) const {
+  // Sub commands are indexed by node first, and nodes without any key are dropped afterwards
+  std::vector<SubCommand> byNode(router_->nodes().size());
+  for (size_t i = 1, position = 0; i + argsPerKey <= cmd.size(); i += argsPerKey, position++) {
+    SubCommand& subCommand = byNode[router_->getNodeIndex(cmd[i])];
+    if (subCommand.cmd.empty()) {
+      subCommand.cmd.push_back(cmd[0]);
+    }
+    subCommand.cmd.insert(subCommand.cmd.end(), cmd.begin() + i, cmd.begin() + i + argsPerKey);
+    subCommand.positions.push_back(position);
+  }
+
+  std::vector<SubCommand> subCommands;
+  for (size_t i = 0; i < byNode.size(); i++) {
+    if (byNode[i].cmd.empty()) continue;
+    byNode[i].nodeIndex = i;
+    subCommands.push_back(std::move(byNode[i]));
+  }
+  return subCommands;
+}
+
+folly::Future<codec::RedisValue> ProxyRedisHandler::fanOut(std::vector<SubCommand>&& subCommands, MergeFunc merge,
+                                                           folly::EventBase* evb) {
+  fanOutCount_++;
+  std::vector<folly::Future<codec::RedisValue>> futures;
+  futures.reserve(subCommands.size());
+  for (const auto& subCommand : subCommands) {
+    futures.push_back(execute(subCommand.nodeIndex, subCommand.cmd, evb));
+  }
+
+  auto subCommandsPtr = std::make_shared<std::vector<SubCommand>>(std::move(subCommands));
+  return folly::collectAll(futures).then(
+      [this, subCommandsPtr, merge = std::move(merge)](std::vector<folly::Try<codec::RedisValue>>&& results) {
+        std::vector<codec::RedisValue> replies;
+        replies.reserve(results.size());
+        for (auto& result : results) {
+          if (result.hasException()) {
+            upstreamErrorCount_++;
+            return codec::RedisValue(codec::RedisValue::Type::kError,
+                                     folly::sformat("Upstream error: {}", result.exception().what()));
+          }
+          // The first error fails the whole command
+          if (result.value().type() == codec::RedisValue::Type::kError) return std::move(result.value());
+          replies.push_back(std::move(result.value()));
+        }
+        return merge(*subCommandsPtr, std::move(replies));
+      });
+}
+
+void ProxyRedisHandler::reply(int64_t key, folly::Future<codec::RedisValue> future, Context* ctx) {
+  // Holding the pipeline keeps ctx valid even if the client disconnects before the reply is ready
+  future.then([this, key, ctx, pipeline = ctx->getPipelineShared()](codec::RedisValue&& value) {
+    write(ctx, codec::RedisMessage(key, std::move(value)));
+  });
+}
+
+void ProxyRedisHandler::forward(int64_t key, const std::vector<std::string>& cmd, Context* ctx) {
+  forwardedCount_++;
+  execute(router_->getNodeIndex(cmd[1]), cmd, ctx->getTransport()->getEventBase())
+      .then([this, key, ctx, pipeline = ctx->getPipelineShared()](folly::Try<codec::RedisValue>&& result) {
+        if (result.hasException()) {
+          upstreamErrorCount_++;
+          writeError(key, folly::sformat("Upstream error: {}", result.exception().what()), ctx);
+          return;
+        }
+        write(ctx, codec::RedisMessage(key, std::move(result.value())));
+      });
+}
+
+folly::Future<codec::RedisValue> ProxyRedisHandler::execute(size_t nodeIndex, const std::vector<std::string>& cmd,
+                                                            folly::EventBase* evb) {
+  return getClient(nodeIndex, evb)->execute(cmd);
+}
+
+client::RedisClient* ProxyRedisHandler::getClient(size_t nodeIndex, folly::EventBase* evb) {
+  auto& clients = *clients_;
+  if (clients.empty()) {
+    for (const auto& address : nodeAddresses_) {
+      clients.push_back(new client::RedisClient(evb, address, clientOptions_));
+    }
+  }
+  DCHECK_EQ(clients[nodeIndex]->getEventBase(), evb);
+  return clients[nodeIndex];
+}
+
+void ProxyRedisHandler::appendToInfoOutput(std::stringstream* ss) {
+  RedisHandler::appendToInfoOutput(ss);
+
+  (*ss) << "# Proxy" << std::endl;
+  (*ss) << "shard_count:" << router_->shardCount() << std::endl;
+  (*ss) << "node_count:" << router_->nodes().size() << std::endl;
+  for (size_t i = 0; i < router_->nodes().size(); i++) {
+    (*ss) << "node" << i << ":" << router_->nodes()[i].address << std::endl;
+  }
+  (*ss) << "forwarded_commands:" << forwardedCount_ << std::endl;
+  (*ss) << "fan_out_commands:" << fanOutCount_ << std::endl;
+  (*ss) << "upstream_errors:" << upstreamErrorCount_ << std::endl;
+}
+
+}  // namespace proxy
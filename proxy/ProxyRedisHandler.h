@@ -0,0 +1,107 @@
+#ifndef PROXY_PROXYREDISHANDLER_H_
+#define PROXY_PROXYREDISHANDLER_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "client/RedisClient.h"
+#include "codec/RedisValue.h"
+#include "folly/SocketAddress.h"
+#include "folly/ThreadLocal.h"
+#include "folly/futures/Future.h"
+#include "folly/io/async/EventBase.h"
+#include "pipeline/AsyncRedisHandler.h"
+#include "proxy/ShardRouter.h"
+
+namespace proxy {
+
+// A redis handler that serves a virtual-sharded deployment through a single endpoint. Single-key commands are
+// forwarded to the node owning cmd[1]. Multi-key commands are split by owning node, sent to all of them in parallel,
+// and their replies are merged in the order of the original keys.
+//
+// Each I/O thread keeps its own pipelined connections to every node, so requests never hop threads. The handler keeps
+// no per-connection state and is meant to be used as a singleton.
+class ProxyRedisHandler : public pipeline::AsyncRedisHandler {
+ public:
+  ProxyRedisHandler(std::shared_ptr<ShardRouter> router, client::RedisClient::Options clientOptions);
+
+  // Forward commands not in the command handler table using their first argument as the key
+  bool handleCommand(int64_t key, const std::string& cmdNameLower, const std::vector<std::string>& cmd,
+                     Context* ctx) override;
+
+  // Split a multi-key command by owning node, send the parts in parallel and merge their replies. Upstream errors and
+  // failures are turned into error replies, so the returned future never fails.
+  folly::Future<codec::RedisValue> mget(const std::vector<std::string>& cmd, folly::EventBase* evb);
+  folly::Future<codec::RedisValue> mset(const std::vector<std::string>& cmd, folly::EventBase* evb);
+  // DEL and EXISTS, whose replies are the number of matching keys
+  folly::Future<codec::RedisValue> sumIntegers(const std::vector<std::string>& cmd, folly::EventBase* evb);
+
+ protected:
+  const AsyncCommandHandlerTable& getAsyncCommandHandlerTable() const override {
+    static const AsyncCommandHandlerTable asyncCommandHandlerTable(mergeWithDefaultAsyncCommandHandlerTable({
+        {"mget", {static_cast<AsyncCommandHandlerFunc>(&ProxyRedisHandler::mgetCommand), 1, -1}},
+        {"mset", {static_cast<AsyncCommandHandlerFunc>(&ProxyRedisHandler::msetCommand), 2, -1}},
+        {"del", {static_cast<AsyncCommandHandlerFunc>(&ProxyRedisHandler::sumIntegersCommand), 1, -1}},
+        {"exists", {static_cast<AsyncCommandHandlerFunc>(&ProxyRedisHandler::sumIntegersCommand), 1, -1}},
+    }));
+    return asyncCommandHandlerTable;
+  }
+
+  void appendToInfoOutput(std::stringstream* ss) override;
+
+  // Send a command to a node through the client connecting the calling I/O thread to it. Tests override it to fake
+  // the nodes.
+  virtual folly::Future<codec::RedisValue> execute(size_t nodeIndex, const std::vector<std::string>& cmd,
+                                                   folly::EventBase* evb);
+
+ private:
+  // The part of a multi-key command sent to a single node
+  struct SubCommand {
+    size_t nodeIndex;
+    std::vector<std::string> cmd;
+    // Positions of the keys in the original command, counting from 0
+    std::vector<size_t> positions;
+  };
+
+  // Combine the replies of sub commands, which are guaranteed not to be errors, into the reply of the original command
+  using MergeFunc = std::function<codec::RedisValue(const std::vector<SubCommand>&, std::vector<codec::RedisValue>&&)>;
+
+  codec::RedisValue mgetCommand(int64_t key, const std::vector<std::string>& cmd, Context* ctx);
+  codec::RedisValue msetCommand(int64_t key, const std::vector<std::string>& cmd, Context* ctx);
+  codec::RedisValue sumIntegersCommand(int64_t key, const std::vector<std::string>& cmd, Context* ctx);
+
+  // Split the keys of a multi-key command by owning node. Keys start at cmd[1] and each key takes argsPerKey arguments,
+  // e.g., 2 for MSET.
+  std::vector<SubCommand> splitByNode(const std::vector<std::string>& cmd, size_t argsPerKey) const;
+
+  // Send sub commands in parallel and merge their replies
+  folly::Future<codec::RedisValue> fanOut(std::vector<SubCommand>&& subCommands, MergeFunc merge,
+                                          folly::EventBase* evb);
+
+  // Write the reply for the request identified by key once it is ready
+  void reply(int64_t key, folly::Future<codec::RedisValue> future, Context* ctx);
+
+  void forward(int64_t key, const std::vector<std::string>& cmd, Context* ctx);
+
+  // Return the client connecting the calling I/O thread to the given node
+  client::RedisClient* getClient(size_t nodeIndex, folly::EventBase* evb);
+
+  const std::shared_ptr<ShardRouter> router_;
+  const client::RedisClient::Options clientOptions_;
+  std::vector<folly::SocketAddress> nodeAddresses_;
+  // Clients are intentionally leaked at thread exit, since they must be destroyed in their EventBase thread, which
+  // may have stopped by the time thread locals are destroyed.
+  folly::ThreadLocal<std::vector<client::RedisClient*>> clients_;
+
+  std::atomic<int64_t> forwardedCount_;
+  std::atomic<int64_t> fanOutCount_;
+  std::atomic<int64_t> upstreamErrorCount_;
+};
+
+}  // namespace proxy
+
+#endif  // PROXY_PROXYREDISHANDLER_H_
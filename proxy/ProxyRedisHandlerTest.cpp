@@ -0,0 +1,133 @@
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "client/RedisClient.h"
+#include "codec/RedisValue.h"
+#include "folly/futures/Future.h"
+#include "folly/io/async/EventBase.h"
+#include "gtest/gtest.h"
+#include "proxy/ProxyRedisHandler.h"
+#include "proxy/ShardRouter.h"
+
+namespace proxy {
+
+// Nodes answer MGET with "key@node" for each key, DEL with the number of keys and anything else with OK
+class FakeNodesProxyRedisHandler : public ProxyRedisHandler {
+ public:
+  explicit FakeNodesProxyRedisHandler(std::shared_ptr<ShardRouter> router)
+      : ProxyRedisHandler(router, client::RedisClient::Options()), received(router->nodes().size()) {}
+
+  std::vector<std::vector<std::vector<std::string>>> received;
+  int errorNode = -1;
+  int failingNode = -1;
+
+ protected:
+  folly::Future<codec::RedisValue> execute(size_t nodeIndex, const std::vector<std::string>& cmd,
+                                           folly::EventBase* evb) override {
+    received[nodeIndex].push_back(cmd);
+    if (static_cast<int>(nodeIndex) == errorNode) {
+      return folly::makeFuture(codec::RedisValue(codec::RedisValue::Type::kError, "node error"));
+    }
+    if (static_cast<int>(nodeIndex) == failingNode) {
+      return folly::makeFuture<codec::RedisValue>(std::runtime_error("connection refused"));
+    }
+    if (cmd[0] == "mget") {
+      std::vector<codec::RedisValue> values;
+      for (size_t i = 1; i < cmd.size(); i++) {
+        values.emplace_back(codec::RedisValue::Type::kBulkString, cmd[i] + "@" + std::to_string(nodeIndex));
+      }
+      return folly::makeFuture(codec::RedisValue(std::move(values)));
+    }
+    if (cmd[0] == "del") return folly::makeFuture(codec::RedisValue(static_cast<int64_t>(cmd.size() - 1)));
+    return folly::makeFuture(simpleStringOk());
+  }
+};
+
+class ProxyRedisHandlerTest : public ::testing::Test {
+ protected:
+  ProxyRedisHandlerTest()
+      : router_(std::make_shared<ShardRouter>(
+            std::vector<ShardRouter::Node>{ShardRouter::Node("127.0.0.1:9049", 0, 4, 2),
+                                           ShardRouter::Node("127.0.0.1:9050", 1, 4, 2)},
+            0)),
+        handler_(router_) {}
+
+  // Keys spread over both nodes
+  std::vector<std::string> keys() const {
+    std::vector<std::string> keys;
+    for (int i = 0; i < 10; i++) {
+      keys.push_back("key" + std::to_string(i));
+    }
+    return keys;
+  }
+
+  std::shared_ptr<ShardRouter> router_;
+  FakeNodesProxyRedisHandler handler_;
+};
+
+TEST_F(ProxyRedisHandlerTest, SplitArguments) {
+  std::vector<std::string> cmd{"mset"};
+  for (const auto& key : keys()) {
+    cmd.push_back(key);
+    cmd.push_back("value-" + key);
+  }
+  EXPECT_EQ(codec::RedisValue(codec::RedisValue::Type::kSimpleString, "OK"), handler_.mset(cmd, nullptr).get());
+
+  size_t keyCount = 0;
+  for (size_t node = 0; node < handler_.received.size(); node++) {
+    // every node gets one sub command holding its own keys with their values
+    ASSERT_EQ(1, handler_.received[node].size());
+    const auto& subCommand = handler_.received[node][0];
+    EXPECT_EQ("mset", subCommand[0]);
+    ASSERT_EQ(1, subCommand.size() % 2);
+    for (size_t i = 1; i < subCommand.size(); i += 2) {
+      EXPECT_EQ(node, router_->getNodeIndex(subCommand[i]));
+      EXPECT_EQ("value-" + subCommand[i], subCommand[i + 1]);
+      keyCount++;
+    }
+  }
+  EXPECT_EQ(keys().size(), keyCount);
+}
+
+TEST_F(ProxyRedisHandlerTest, ReplyOrder) {
+  std::vector<std::string> cmd{"mget"};
+  for (const auto& key : keys()) {
+    cmd.push_back(key);
+  }
+  codec::RedisValue reply = handler_.mget(cmd, nullptr).get();
+  ASSERT_EQ(codec::RedisValue::Type::kArray, reply.type());
+  ASSERT_EQ(keys().size(), reply.array().size());
+  // values come back in the order of the original keys, whichever node owns them
+  for (size_t i = 0; i < keys().size(); i++) {
+    EXPECT_EQ(keys()[i] + "@" + std::to_string(router_->getNodeIndex(keys()[i])), reply.array()[i].bulkString());
+  }
+  EXPECT_EQ(1, handler_.received[0].size());
+  EXPECT_EQ(1, handler_.received[1].size());
+
+  std::vector<std::string> del{"del"};
+  for (const auto& key : keys()) {
+    del.push_back(key);
+  }
+  EXPECT_EQ(codec::RedisValue(static_cast<int64_t>(keys().size())), handler_.sumIntegers(del, nullptr).get());
+}
+
+TEST_F(ProxyRedisHandlerTest, ShardError) {
+  std::vector<std::string> cmd{"mget"};
+  for (const auto& key : keys()) {
+    cmd.push_back(key);
+  }
+  // an error reply from one node fails the whole command with that error
+  handler_.errorNode = 1;
+  EXPECT_EQ(codec::RedisValue(codec::RedisValue::Type::kError, "node error"), handler_.mget(cmd, nullptr).get());
+
+  // so does a node that cannot be reached
+  handler_.errorNode = -1;
+  handler_.failingNode = 0;
+  codec::RedisValue reply = handler_.mget(cmd, nullptr).get();
+  ASSERT_EQ(codec::RedisValue::Type::kError, reply.type());
+  EXPECT_NE(std::string::npos, reply.error().find("Upstream error"));
+}
+
+}  // namespace proxy
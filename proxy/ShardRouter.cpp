@@ -0,0 +1,52 @@
+#include "proxy/ShardRouter.h"
+
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "folly/dynamic.h"
+#include "glog/logging.h"
+
+namespace proxy {
+
+ShardRouter ShardRouter::createFromJson(const folly::dynamic& config) {
+  uint32_t seed = 0;
+  if (config.get_ptr("seed")) {
+    seed = config["seed"].getInt();
+  }
+
+  std::vector<Node> nodes;
+  for (const auto& node : CHECK_NOTNULL(config.get_ptr("nodes"))->values()) {
+    nodes.emplace_back(CHECK_NOTNULL(node.get_ptr("address"))->getString(),
+                       CHECK_NOTNULL(node.get_ptr("start_shard_index"))->getInt(),
+                       CHECK_NOTNULL(node.get_ptr("local_virtual_shard_count"))->getInt(),
+                       CHECK_NOTNULL(node.get_ptr("shard_index_increment"))->getInt());
+  }
+  return ShardRouter(std::move(nodes), seed);
+}
+
+ShardRouter::ShardRouter(std::vector<Node> nodes, uint32_t seed) : nodes_(std::move(nodes)), seed_(seed) {
+  CHECK(!nodes_.empty()) << "Shard map must contain at least one node";
+  int shardCount = 0;
+  for (const auto& node : nodes_) {
+    CHECK_GT(node.localVirtualShardCount, 0) << "Node " << node.address << " owns no shards";
+    CHECK_GT(node.shardIndexIncrement, 0) << "Node " << node.address << " has invalid shard_index_increment";
+    shardCount += node.localVirtualShardCount;
+  }
+
+  constexpr size_t kUnowned = std::numeric_limits<size_t>::max();
+  shardToNode_.assign(shardCount, kUnowned);
+  for (size_t i = 0; i < nodes_.size(); i++) {
+    const Node& node = nodes_[i];
+    for (int j = 0; j < node.localVirtualShardCount; j++) {
+      int shard = node.startShardIndex + j * node.shardIndexIncrement;
+      CHECK(shard >= 0 && shard < shardCount) << "Shard " << shard << " of node " << node.address
+                                              << " is out of range [0, " << shardCount << ")";
+      CHECK_EQ(shardToNode_[shard], kUnowned) << "Shard " << shard << " is owned by multiple nodes";
+      shardToNode_[shard] = i;
+    }
+  }
+}
+
+}  // namespace proxy
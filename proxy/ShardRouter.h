@@ -0,0 +1,73 @@
+#ifndef PROXY_SHARDROUTER_H_
+#define PROXY_SHARDROUTER_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "folly/dynamic.h"
+#include "pipeline/DatabaseManager.h"
+
+namespace proxy {
+
+// ShardRouter maps keys to the nodes of a virtual-sharded deployment. A node owns the shards
+// start_shard_index + i * shard_index_increment for i in [0, local_virtual_shard_count), the same layout as
+// --rocksdb_cf_group_configs. Keys are hashed to shards with DatabaseManager::getShardNum, so the proxy agrees with
+// the servers on where every key lives.
+class ShardRouter {
+ public:
+  struct Node {
+    std::string address;  // host:port
+    int startShardIndex;
+    int localVirtualShardCount;
+    int shardIndexIncrement;
+
+    Node(std::string _address, int _startShardIndex, int _localVirtualShardCount, int _shardIndexIncrement)
+        : address(std::move(_address)),
+          startShardIndex(_startShardIndex),
+          localVirtualShardCount(_localVirtualShardCount),
+          shardIndexIncrement(_shardIndexIncrement) {}
+  };
+
+  // Extract the shard map from JSON, e.g.,
+  // {
+  //   "seed": 0,
+  //   "nodes": [
+  //     {"address": "127.0.0.1:9049", "start_shard_index": 0, "local_virtual_shard_count": 4,
+  //      "shard_index_increment": 2},
+  //     {"address": "127.0.0.1:9050", "start_shard_index": 1, "local_virtual_shard_count": 4,
+  //      "shard_index_increment": 2}
+  //   ]
+  // }
+  // The optional seed must match the one servers use for hashing.
+  static ShardRouter createFromJson(const folly::dynamic& config);
+
+  // Every shard in [0, total shard count) must be owned by exactly one node
+  ShardRouter(std::vector<Node> nodes, uint32_t seed);
+
+  int getShard(const std::string& key) const {
+    return pipeline::DatabaseManager::getShardNum(key, shardToNode_.size(), seed_);
+  }
+
+  size_t getNodeIndex(const std::string& key) const {
+    return shardToNode_[getShard(key)];
+  }
+
+  const std::vector<Node>& nodes() const {
+    return nodes_;
+  }
+
+  int shardCount() const {
+    return shardToNode_.size();
+  }
+
+ private:
+  const std::vector<Node> nodes_;
+  const uint32_t seed_;
+  std::vector<size_t> shardToNode_;
+};
+
+}  // namespace proxy
+
+#endif  // PROXY_SHARDROUTER_H_
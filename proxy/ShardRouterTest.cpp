@@ -0,0 +1,45 @@
+#include <string>
+#include <vector>
+
+#include "folly/dynamic.h"
+#include "gtest/gtest.h"
+#include "pipeline/DatabaseManager.h"
+#include "proxy/ShardRouter.h"
+
+namespace proxy {
+
+static folly::dynamic node(const std::string& address, int start, int count, int increment) {
+  return folly::dynamic::object("address", address)("start_shard_index", start)("local_virtual_shard_count", count)(
+      "shard_index_increment", increment);
+}
+
+TEST(ShardRouter, CreateFromJson) {
+  auto router = ShardRouter::createFromJson(folly::dynamic::object("seed", 7)(
+      "nodes", folly::dynamic::array(node("127.0.0.1:9049", 0, 4, 2), node("127.0.0.1:9050", 1, 4, 2))));
+  EXPECT_EQ(8, router.shardCount());
+  ASSERT_EQ(2, router.nodes().size());
+  EXPECT_EQ("127.0.0.1:9050", router.nodes()[1].address);
+
+  for (const std::string key : {"a", "b", "c", "foo", "bar", "baz"}) {
+    int shard = pipeline::DatabaseManager::getShardNum(key, 8, 7);
+    EXPECT_EQ(shard, router.getShard(key));
+    // even shards live on the first node and odd shards on the second
+    EXPECT_EQ(shard % 2, router.getNodeIndex(key));
+  }
+}
+
+TEST(ShardRouter, MissingNodes) {
+  EXPECT_DEATH(ShardRouter::createFromJson(folly::dynamic::object("seed", 0)), "Check failed.*non NULL");
+}
+
+TEST(ShardRouter, OverlappingShards) {
+  EXPECT_DEATH(ShardRouter({ShardRouter::Node("a:1", 0, 2, 1), ShardRouter::Node("b:1", 1, 2, 2)}, 0),
+               "owned by multiple nodes");
+}
+
+TEST(ShardRouter, ShardOutOfRange) {
+  EXPECT_DEATH(ShardRouter({ShardRouter::Node("a:1", 0, 2, 2), ShardRouter::Node("b:1", 1, 2, 4)}, 0),
+               "out of range");
+}
+
+}  // namespace proxy
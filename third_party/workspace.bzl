@@ -313,6 +313,19 @@ def smyte_workspace(workspace_name):
         actual = workspace_name + "//third_party/libunwind:config"
     )
 
+    # lua
+    native.new_http_archive(
+        name = "lua_archive",
+        url = "https://www.lua.org/ftp/lua-5.3.4.tar.gz",
+        strip_prefix = "lua-5.3.4",
+        sha256 = "f681aa518233bc407e23acf0f5887c884f17436f000d453b2491a9f11a52400c",
+        build_file = workspace_name + "//third_party:lua.BUILD",
+    )
+    native.bind(
+        name = "lua",
+        actual = "@lua_archive//:lua",
+    )
+
     # murmurhash3
     native.new_http_archive(
         name = "murmurhash3_archive",